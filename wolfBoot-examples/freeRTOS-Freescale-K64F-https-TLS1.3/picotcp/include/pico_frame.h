@@ -16,6 +16,19 @@
 #define PICO_FRAME_FLAG_SLP_FRAG            (0x20)
 #define IS_BCAST(f) ((f->flags & PICO_FRAME_FLAG_BCAST) == PICO_FRAME_FLAG_BCAST)
 
+/* Frames and their buffers come from pools, which grow by slabs of up to
+ * PICO_FRAME_SLAB_SIZE elements and PICO_FRAME_SLAB_BYTES bytes. Buffers
+ * larger than the biggest size class (PICO_FRAME_POOL_MAX_SIZE), or that
+ * cannot get a new slab, are allocated on their own.
+ */
+#ifndef PICO_FRAME_SLAB_SIZE
+#define PICO_FRAME_SLAB_SIZE 8
+#endif
+#ifndef PICO_FRAME_SLAB_BYTES
+#define PICO_FRAME_SLAB_BYTES 2048
+#endif
+#define PICO_FRAME_POOL_MAX_SIZE 1536
+
 
 struct pico_socket;
 
@@ -92,6 +105,9 @@ struct pico_frame {
 
     uint8_t send_ttl; /* Special TTL/HOPS value, 0 = auto assign */
     uint8_t send_tos; /* Type of service */
+
+    /* Parts of the frame that come from the frame pools (see pico_frame.c) */
+    uint8_t pool;
 };
 
 /** frame alloc/dealloc/copy **/
@@ -103,8 +119,11 @@ int pico_frame_grow(struct pico_frame *f, uint32_t size);
 int pico_frame_grow_head(struct pico_frame *f, uint32_t size);
 struct pico_frame *pico_frame_alloc_skeleton(uint32_t size, int ext_buffer);
 int pico_frame_skeleton_set_buffer(struct pico_frame *f, void *buf);
+int pico_frame_set_ext_buffer(struct pico_frame *f, uint8_t *buf, uint32_t headroom, uint32_t len, void (*notify_free)(uint8_t *));
 uint16_t pico_checksum(void *inbuf, uint32_t len);
 uint16_t pico_dualbuffer_checksum(void *b1, uint32_t len1, void *b2, uint32_t len2);
+uint16_t pico_checksum_adjust16(uint16_t crc, uint16_t old_val, uint16_t new_val);
+uint16_t pico_checksum_adjust32(uint16_t crc, uint32_t old_val, uint32_t new_val);
 
 static inline int pico_is_digit(char c)
 {
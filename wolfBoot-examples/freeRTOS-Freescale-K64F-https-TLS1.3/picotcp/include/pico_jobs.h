@@ -3,6 +3,10 @@
 #include "pico_defines.h"
 #include "pico_stack.h"
 
+#ifndef PICO_JOB_SLAB_SIZE
+#define PICO_JOB_SLAB_SIZE 8
+#endif
+
 void pico_schedule_job(void (*exe)(void*), void *arg);
 void pico_execute_pending_jobs(void);
 
@@ -0,0 +1,45 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+ *********************************************************************/
+#ifndef INCLUDE_PICO_LPM
+#define INCLUDE_PICO_LPM
+#include "pico_config.h"
+
+/* Longest prefix match table: path-compressed binary (Patricia) trie of the
+ * prefixes of keys of up to PICO_LPM_KEY_SIZE bytes, in network order.
+ * A lookup visits at most one node per distinct prefix length on the way,
+ * whatever the number of prefixes in the table.
+ */
+#define PICO_LPM_KEY_SIZE 16
+
+struct pico_lpm_node;
+
+struct pico_lpm
+{
+    struct pico_lpm_node *root;
+    uint8_t key_size; /* in bytes: PICO_SIZE_IP4 or PICO_SIZE_IP6 */
+};
+
+#define PICO_LPM_DECLARE(name, keySize) \
+    struct pico_lpm name = \
+    { \
+        NULL, \
+        keySize \
+    }
+
+/* Adds the prefix (the first 'len' bits of 'prefix'), or replaces its value.
+ * Replacing never allocates, so it can't fail. Returns -1 if out of memory.
+ */
+int pico_lpm_insert(struct pico_lpm *lpm, const uint8_t *prefix, uint8_t len, void *value);
+/* Removes the prefix, returns its value or NULL if it was not in the table */
+void *pico_lpm_delete(struct pico_lpm *lpm, const uint8_t *prefix, uint8_t len);
+/* Exact match of the prefix */
+void *pico_lpm_find(struct pico_lpm *lpm, const uint8_t *prefix, uint8_t len);
+/* Value of the longest prefix of 'key' in the table, or NULL */
+void *pico_lpm_lookup(struct pico_lpm *lpm, const uint8_t *key);
+/* Length of the prefix selected by a netmask, or -1 if it is not contiguous */
+int pico_lpm_prefix_len(const uint8_t *netmask, uint8_t size);
+
+#endif
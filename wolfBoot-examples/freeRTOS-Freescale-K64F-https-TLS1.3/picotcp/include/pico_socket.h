@@ -160,6 +160,16 @@ struct pico_ip_mreq_source {
 #define PICO_SOCKET_LINGER_TIMEOUT            3000u /* 3 seconds */
 #define PICO_SOCKET_BOUND_TIMEOUT             30000u /* 30 seconds */
 
+/* Connected sockets are found by a hash of their 4-tuple: a bucket of the
+ * table is one cache line, the table grows up to PICO_SOCKET_FLOWS_MAX buckets.
+ */
+#ifndef PICO_SOCKET_FLOW_BUCKET_SIZE
+#define PICO_SOCKET_FLOW_BUCKET_SIZE          64
+#endif
+#ifndef PICO_SOCKET_FLOWS_MAX
+#define PICO_SOCKET_FLOWS_MAX                 65536
+#endif
+
 #define PICO_SOCKET_SHUTDOWN_WRITE 0x01u
 #define PICO_SOCKET_SHUTDOWN_READ  0x02u
 #define TCPSTATE(s) ((s)->state & PICO_SOCKET_STATE_TCP)
@@ -191,6 +201,15 @@ int pico_socket_recvfrom_extended(struct pico_socket *s, void *buf, int len, voi
                                   uint16_t *remote_port, struct pico_msginfo *msginfo);
 
 int pico_socket_send(struct pico_socket *s, const void *buf, int len);
+/* Zero-copy send: buf holds pico_socket_zerocopy_headroom() bytes of room for
+ * the headers, then len bytes of payload, and is released with notify_free()
+ * once sent (UDP) or acknowledged (TCP). The headers are written in place, so
+ * one call sends one segment: len must fit in a segment (the MSS for TCP),
+ * larger buffers fail with PICO_ERR_EMSGSIZE and must be sent in several
+ * buffers, or with pico_socket_send().
+ */
+int pico_socket_send_zerocopy(struct pico_socket *s, uint8_t *buf, uint32_t headroom, int len, void (*notify_free)(uint8_t *buffer));
+int pico_socket_zerocopy_headroom(struct pico_socket *s);
 int pico_socket_recv(struct pico_socket *s, void *buf, int len);
 
 int pico_socket_bind(struct pico_socket *s, void *local_addr, uint16_t *port);
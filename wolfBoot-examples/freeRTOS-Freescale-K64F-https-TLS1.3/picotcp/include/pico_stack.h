@@ -11,6 +11,11 @@
 
 #define PICO_MAX_TIMERS 20
 
+/* Timers allocated at once when the pool is empty */
+#ifndef PICO_TIMER_SLAB_SIZE
+#define PICO_TIMER_SLAB_SIZE 16
+#endif
+
 #define PICO_ETH_MRU (1514u)
 #define PICO_IP_MRU (1500u)
 
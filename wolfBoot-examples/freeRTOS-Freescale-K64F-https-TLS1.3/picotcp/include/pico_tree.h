@@ -21,6 +21,10 @@
 #define USE_PICO_PAGE0_ZALLOC (1)
 #define USE_PICO_ZALLOC (2)
 
+#ifndef PICO_TREE_SLAB_SIZE
+#define PICO_TREE_SLAB_SIZE 16
+#endif
+
 struct pico_tree_node
 {
     void*keyValue; /* generic key */
@@ -19,6 +19,7 @@
 #include "pico_nat.h"
 #include "pico_igmp.h"
 #include "pico_tree.h"
+#include "pico_lpm.h"
 #include "pico_aodv.h"
 #include "pico_socket_multicast.h"
 #include "pico_fragments.h"
@@ -591,6 +592,13 @@ static int pico_ipv4_process_in(struct pico_protocol *self, struct pico_frame *f
 
 PICO_TREE_DECLARE(Routes, ipv4_route_compare);
 
+/* Best route to each prefix of Routes, for route_find(). Routes with a
+ * non-contiguous netmask don't fit in it: while there are any, route_find()
+ * walks Routes instead.
+ */
+static PICO_LPM_DECLARE(Routes_lpm, PICO_SIZE_IP4);
+static uint32_t Routes_noncontig = 0;
+
 
 static int pico_ipv4_process_out(struct pico_protocol *self, struct pico_frame *f)
 {
@@ -698,6 +706,9 @@ static struct pico_ipv4_route *route_find(const struct pico_ip4 *addr)
     }
 
     if (addr->addr != PICO_IP4_BCAST) {
+        if (!Routes_noncontig)
+            return pico_lpm_lookup(&Routes_lpm, (const uint8_t *)&addr->addr);
+
         pico_tree_foreach_reverse(index, &Routes) {
             r = index->keyValue;
             if ((addr->addr & (r->netmask.addr)) == (r->dest.addr)) {
@@ -1270,6 +1281,52 @@ static int pico_ipv4_frame_sock_push(struct pico_protocol *self, struct pico_fra
 }
 
 
+/* route_find() returns the last matching route in Routes: the one with the
+ * longest netmask, and the highest metric for that netmask.
+ */
+static int ipv4_route_lpm_add(struct pico_ipv4_route *r)
+{
+    struct pico_ipv4_route *best;
+    int len = pico_lpm_prefix_len((uint8_t *)&r->netmask.addr, PICO_SIZE_IP4);
+
+    if (len < 0) {
+        Routes_noncontig++;
+        return 0;
+    }
+
+    /* Never matched */
+    if ((r->dest.addr & r->netmask.addr) != r->dest.addr)
+        return 0;
+
+    best = pico_lpm_find(&Routes_lpm, (uint8_t *)&r->dest.addr, (uint8_t)len);
+    if (best && (ipv4_route_compare(best, r) > 0))
+        return 0;
+
+    return pico_lpm_insert(&Routes_lpm, (uint8_t *)&r->dest.addr, (uint8_t)len, r);
+}
+
+/* Called before removing r from Routes */
+static void ipv4_route_lpm_del(struct pico_ipv4_route *r)
+{
+    struct pico_ipv4_route *prev;
+    int len = pico_lpm_prefix_len((uint8_t *)&r->netmask.addr, PICO_SIZE_IP4);
+
+    if (len < 0) {
+        Routes_noncontig--;
+        return;
+    }
+
+    if (pico_lpm_find(&Routes_lpm, (uint8_t *)&r->dest.addr, (uint8_t)len) != r)
+        return;
+
+    /* The next best route to the prefix, if any, comes just before r */
+    prev = pico_tree_prev(pico_tree_findNode(&Routes, r))->keyValue;
+    if (prev && (prev->netmask.addr == r->netmask.addr) && (prev->dest.addr == r->dest.addr))
+        pico_lpm_insert(&Routes_lpm, (uint8_t *)&r->dest.addr, (uint8_t)len, prev);
+    else
+        pico_lpm_delete(&Routes_lpm, (uint8_t *)&r->dest.addr, (uint8_t)len);
+}
+
 int MOCKABLE pico_ipv4_route_add(struct pico_ip4 address, struct pico_ip4 netmask, struct pico_ip4 gateway, int metric, struct pico_ipv4_link *link)
 {
     struct pico_ipv4_route test, *new;
@@ -1324,6 +1381,13 @@ int MOCKABLE pico_ipv4_route_add(struct pico_ip4 address, struct pico_ip4 netmas
 		return -1;
 	}
 
+    if (ipv4_route_lpm_add(new) < 0) {
+        pico_tree_delete(&Routes, new);
+        PICO_FREE(new);
+        pico_err = PICO_ERR_ENOMEM;
+        return -1;
+    }
+
     dbg_route();
     return 0;
 }
@@ -1339,6 +1403,7 @@ int pico_ipv4_route_del(struct pico_ip4 address, struct pico_ip4 netmask, int me
     found = pico_tree_findKey(&Routes, &test);
     if (found) {
 
+        ipv4_route_lpm_del(found);
         pico_tree_delete(&Routes, found);
         PICO_FREE(found);
 
@@ -1656,6 +1721,7 @@ static int pico_ipv4_pre_forward_checks(struct pico_frame *f)
         0
     };
     struct pico_ipv4_hdr *hdr = (struct pico_ipv4_hdr *)f->net_hdr;
+    uint16_t ttl_proto = short_be((uint16_t)((hdr->ttl << 8) | hdr->proto));
 
     /* Decrease TTL, check if expired */
     hdr->ttl = (uint8_t)(hdr->ttl - 1);
@@ -1665,8 +1731,8 @@ static int pico_ipv4_pre_forward_checks(struct pico_frame *f)
         return -1;
     }
 
-    /* HACK: increase crc to compensate decreased TTL */
-    hdr->crc++;
+    /* Update the crc for the decreased TTL */
+    hdr->crc = pico_checksum_adjust16(hdr->crc, ttl_proto, short_be((uint16_t)((hdr->ttl << 8) | hdr->proto)));
 
     /* If source is local, discard anyway (packets bouncing back and forth) */
     if (pico_ipv4_link_get(&hdr->src))
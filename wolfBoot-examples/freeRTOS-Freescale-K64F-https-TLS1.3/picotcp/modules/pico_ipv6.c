@@ -16,6 +16,7 @@
 #include "pico_socket.h"
 #include "pico_device.h"
 #include "pico_tree.h"
+#include "pico_lpm.h"
 #include "pico_fragments.h"
 #include "pico_ethernet.h"
 #include "pico_6lowpan_ll.h"
@@ -136,6 +137,10 @@ static PICO_TREE_DECLARE(Tree_dev_ip6_link, ipv6_link_compare);
 PICO_TREE_DECLARE(IPV6Routes, ipv6_route_compare);
 PICO_TREE_DECLARE(IPV6Links, ipv6_link_compare);
 
+/* Best route to each prefix of IPV6Routes, see pico_ipv4.c */
+static PICO_LPM_DECLARE(IPV6Routes_lpm, PICO_SIZE_IP6);
+static uint32_t IPV6Routes_noncontig = 0;
+
 static char pico_ipv6_dec_to_char(uint8_t u)
 {
     if (u < 10)
@@ -404,6 +409,9 @@ static struct pico_ipv6_route *pico_ipv6_route_find(const struct pico_ip6 *addr)
         return NULL;
     }
 
+    if (!IPV6Routes_noncontig)
+        return pico_lpm_lookup(&IPV6Routes_lpm, addr->addr);
+
     pico_tree_foreach_reverse(index, &IPV6Routes) {
         r = index->keyValue;
         for (i = 0; i < PICO_SIZE_IP6; ++i) {
@@ -1556,6 +1564,62 @@ struct pico_ipv6_route *pico_ipv6_gateway_by_dev_next(struct pico_device *dev, s
     return NULL;
 }
 
+static int ipv6_route_same_prefix(struct pico_ipv6_route *a, struct pico_ipv6_route *b)
+{
+    int i;
+
+    for (i = 0; i < PICO_SIZE_IP6; i++) {
+        if (a->netmask.addr[i] != b->netmask.addr[i])
+            return 0;
+
+        if ((a->dest.addr[i] & a->netmask.addr[i]) != (b->dest.addr[i] & b->netmask.addr[i]))
+            return 0;
+    }
+    return 1;
+}
+
+/* pico_ipv6_route_find() returns the last matching route in IPV6Routes. The
+ * destination is masked: routes to the same prefix may have different
+ * destinations, but they are next to each other in the tree.
+ */
+static int ipv6_route_lpm_add(struct pico_ipv6_route *r)
+{
+    struct pico_ipv6_route *best;
+    int len = pico_lpm_prefix_len(r->netmask.addr, PICO_SIZE_IP6);
+
+    if (len < 0) {
+        IPV6Routes_noncontig++;
+        return 0;
+    }
+
+    best = pico_lpm_find(&IPV6Routes_lpm, r->dest.addr, (uint8_t)len);
+    if (best && (ipv6_route_compare(best, r) > 0))
+        return 0;
+
+    return pico_lpm_insert(&IPV6Routes_lpm, r->dest.addr, (uint8_t)len, r);
+}
+
+/* Called before removing r from IPV6Routes */
+static void ipv6_route_lpm_del(struct pico_ipv6_route *r)
+{
+    struct pico_ipv6_route *prev;
+    int len = pico_lpm_prefix_len(r->netmask.addr, PICO_SIZE_IP6);
+
+    if (len < 0) {
+        IPV6Routes_noncontig--;
+        return;
+    }
+
+    if (pico_lpm_find(&IPV6Routes_lpm, r->dest.addr, (uint8_t)len) != r)
+        return;
+
+    prev = pico_tree_prev(pico_tree_findNode(&IPV6Routes, r))->keyValue;
+    if (prev && ipv6_route_same_prefix(prev, r))
+        pico_lpm_insert(&IPV6Routes_lpm, r->dest.addr, (uint8_t)len, prev);
+    else
+        pico_lpm_delete(&IPV6Routes_lpm, r->dest.addr, (uint8_t)len);
+}
+
 int pico_ipv6_route_add(struct pico_ip6 address, struct pico_ip6 netmask, struct pico_ip6 gateway, int metric, struct pico_ipv6_link *link)
 {
     struct pico_ip6 zerogateway = {{0}};
@@ -1613,6 +1677,13 @@ int pico_ipv6_route_add(struct pico_ip6 address, struct pico_ip6 netmask, struct
 		return -1;
 	}
 
+    if (ipv6_route_lpm_add(new) < 0) {
+        pico_tree_delete(&IPV6Routes, new);
+        PICO_FREE(new);
+        pico_err = PICO_ERR_ENOMEM;
+        return -1;
+    }
+
     pico_ipv6_dbg_route();
     return 0;
 }
@@ -1634,6 +1705,7 @@ int pico_ipv6_route_del(struct pico_ip6 address, struct pico_ip6 netmask, struct
 
     found = pico_tree_findKey(&IPV6Routes, &test);
     if (found) {
+        ipv6_route_lpm_del(found);
         pico_tree_delete(&IPV6Routes, found);
         PICO_FREE(found);
         pico_ipv6_dbg_route();
@@ -426,6 +426,8 @@ int pico_ipv4_nat_inbound(struct pico_frame *f, struct pico_ip4 *link_addr)
     struct pico_nat_tuple *tuple = NULL;
     struct pico_trans *trans = NULL;
     struct pico_ipv4_hdr *net = (struct pico_ipv4_hdr *)f->net_hdr;
+    struct pico_ip4 orig_addr = net->dst;
+    uint16_t orig_port;
 
     if (!pico_ipv4_nat_is_enabled(link_addr))
         return -1;
@@ -441,11 +443,12 @@ int pico_ipv4_nat_inbound(struct pico_frame *f, struct pico_ip4 *link_addr)
             return -1;
 
         /* replace dst IP and dst PORT */
+        orig_port = trans->dport;
         net->dst = tuple->src_addr;
         trans->dport = tuple->src_port;
-        /* recalculate CRC */
-        tcp->crc = 0;
-        tcp->crc = short_be(pico_tcp_checksum_ipv4(f));
+        /* update CRC */
+        tcp->crc = pico_checksum_adjust32(tcp->crc, orig_addr.addr, net->dst.addr);
+        tcp->crc = pico_checksum_adjust16(tcp->crc, orig_port, trans->dport);
         break;
     }
 #endif
@@ -459,11 +462,16 @@ int pico_ipv4_nat_inbound(struct pico_frame *f, struct pico_ip4 *link_addr)
             return -1;
 
         /* replace dst IP and dst PORT */
+        orig_port = trans->dport;
         net->dst = tuple->src_addr;
         trans->dport = tuple->src_port;
-        /* recalculate CRC */
-        udp->crc = 0;
-        udp->crc = short_be(pico_udp_checksum_ipv4(f));
+        /* update CRC */
+        if (udp->crc) {
+            udp->crc = pico_checksum_adjust32(udp->crc, orig_addr.addr, net->dst.addr);
+            udp->crc = pico_checksum_adjust16(udp->crc, orig_port, trans->dport);
+            if (!udp->crc)
+                udp->crc = 0xFFFF;
+        }
         break;
     }
 #endif
@@ -477,8 +485,7 @@ int pico_ipv4_nat_inbound(struct pico_frame *f, struct pico_ip4 *link_addr)
     }
 
     pico_ipv4_nat_sniff_session(tuple, f, PICO_NAT_INBOUND);
-    net->crc = 0;
-    net->crc = short_be(pico_checksum(net, f->net_len));
+    net->crc = pico_checksum_adjust32(net->crc, orig_addr.addr, net->dst.addr);
 
     nat_dbg("NAT: inbound translation {dst.addr, dport}: {%08X,%u} -> {%08X,%u}\n",
             tuple->nat_addr.addr, short_be(tuple->nat_port), tuple->src_addr.addr, short_be(tuple->src_port));
@@ -491,6 +498,8 @@ int pico_ipv4_nat_outbound(struct pico_frame *f, struct pico_ip4 *link_addr)
     struct pico_nat_tuple *tuple = NULL;
     struct pico_trans *trans = NULL;
     struct pico_ipv4_hdr *net = (struct pico_ipv4_hdr *)f->net_hdr;
+    struct pico_ip4 orig_addr = net->src;
+    uint16_t orig_port;
 
     if (!pico_ipv4_nat_is_enabled(link_addr))
         return -1;
@@ -506,11 +515,12 @@ int pico_ipv4_nat_outbound(struct pico_frame *f, struct pico_ip4 *link_addr)
             tuple = pico_ipv4_nat_generate_tuple(f);
 
         /* replace src IP and src PORT */
+        orig_port = trans->sport;
         net->src = tuple->nat_addr;
         trans->sport = tuple->nat_port;
-        /* recalculate CRC */
-        tcp->crc = 0;
-        tcp->crc = short_be(pico_tcp_checksum_ipv4(f));
+        /* update CRC */
+        tcp->crc = pico_checksum_adjust32(tcp->crc, orig_addr.addr, net->src.addr);
+        tcp->crc = pico_checksum_adjust16(tcp->crc, orig_port, trans->sport);
         break;
     }
 #endif
@@ -524,11 +534,16 @@ int pico_ipv4_nat_outbound(struct pico_frame *f, struct pico_ip4 *link_addr)
             tuple = pico_ipv4_nat_generate_tuple(f);
 
         /* replace src IP and src PORT */
+        orig_port = trans->sport;
         net->src = tuple->nat_addr;
         trans->sport = tuple->nat_port;
-        /* recalculate CRC */
-        udp->crc = 0;
-        udp->crc = short_be(pico_udp_checksum_ipv4(f));
+        /* update CRC */
+        if (udp->crc) {
+            udp->crc = pico_checksum_adjust32(udp->crc, orig_addr.addr, net->src.addr);
+            udp->crc = pico_checksum_adjust16(udp->crc, orig_port, trans->sport);
+            if (!udp->crc)
+                udp->crc = 0xFFFF;
+        }
         break;
     }
 #endif
@@ -542,8 +557,7 @@ int pico_ipv4_nat_outbound(struct pico_frame *f, struct pico_ip4 *link_addr)
     }
 
     pico_ipv4_nat_sniff_session(tuple, f, PICO_NAT_OUTBOUND);
-    net->crc = 0;
-    net->crc = short_be(pico_checksum(net, f->net_len));
+    net->crc = pico_checksum_adjust32(net->crc, orig_addr.addr, net->src.addr);
 
     nat_dbg("NAT: outbound translation {src.addr, sport}: {%08X,%u} -> {%08X,%u}\n",
             tuple->src_addr.addr, short_be(tuple->src_port), tuple->nat_addr.addr, short_be(tuple->nat_port));
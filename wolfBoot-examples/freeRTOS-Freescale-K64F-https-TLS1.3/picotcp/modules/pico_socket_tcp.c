@@ -225,6 +225,11 @@ int pico_socket_tcp_deliver(struct pico_sockport *sp, struct pico_frame *f)
     return socket_tcp_do_deliver(target, f);
 }
 
+int pico_socket_tcp_deliver_flow(struct pico_socket *s, struct pico_frame *f)
+{
+    return socket_tcp_do_deliver(s, f);
+}
+
 struct pico_socket *pico_socket_tcp_open(uint16_t family)
 {
     struct pico_socket *s = NULL;
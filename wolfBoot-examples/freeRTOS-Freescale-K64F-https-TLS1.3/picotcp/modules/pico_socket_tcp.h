@@ -10,6 +10,7 @@
 int pico_setsockopt_tcp(struct pico_socket *s, int option, void *value);
 int pico_getsockopt_tcp(struct pico_socket *s, int option, void *value);
 int pico_socket_tcp_deliver(struct pico_sockport *sp, struct pico_frame *f);
+int pico_socket_tcp_deliver_flow(struct pico_socket *s, struct pico_frame *f);
 void pico_socket_tcp_delete(struct pico_socket *s);
 void pico_socket_tcp_cleanup(struct pico_socket *sock);
 struct pico_socket *pico_socket_tcp_open(uint16_t family);
@@ -20,6 +21,7 @@ void transport_flags_update(struct pico_frame *, struct pico_socket *);
 #   define pico_getsockopt_tcp(...) (-1)
 #   define pico_setsockopt_tcp(...) (-1)
 #   define pico_socket_tcp_deliver(...) (-1)
+#   define pico_socket_tcp_deliver_flow(...) (-1)
 #   define IS_NAGLE_ENABLED(s) (0)
 #   define pico_socket_tcp_delete(...) do {} while(0)
 #   define pico_socket_tcp_cleanup(...) do {} while(0)
@@ -182,6 +182,25 @@ static int pico_socket_udp_deliver_ipv6(struct pico_socket *s, struct pico_frame
 #endif
 
 
+int pico_socket_udp_deliver_flow(struct pico_socket *s, struct pico_frame *f)
+{
+    pico_err = PICO_ERR_NOERR;
+    if (IS_IPV4(f)) { /* IPV4 */
+#ifdef PICO_SUPPORT_IPV4
+        return pico_socket_udp_deliver_ipv4(s, f);
+#endif
+    } else if (IS_IPV6(f)) {
+#ifdef PICO_SUPPORT_IPV6
+        return pico_socket_udp_deliver_ipv6(s, f);
+#endif
+    } else {
+        /* something wrong in the packet header*/
+    }
+
+    pico_frame_discard(f);
+    return 0;
+}
+
 int pico_socket_udp_deliver(struct pico_sockport *sp, struct pico_frame *f)
 {
     struct pico_tree_node *index = NULL;
@@ -6,6 +6,7 @@
 
 struct pico_socket *pico_socket_udp_open(void);
 int pico_socket_udp_deliver(struct pico_sockport *sp, struct pico_frame *f);
+int pico_socket_udp_deliver_flow(struct pico_socket *s, struct pico_frame *f);
 
 
 #ifdef PICO_SUPPORT_UDP
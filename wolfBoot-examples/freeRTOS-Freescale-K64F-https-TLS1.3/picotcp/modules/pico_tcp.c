@@ -82,7 +82,7 @@ static void *Mutex = NULL;
 struct tcp_input_segment
 {
     uint32_t seq;
-    /* Pointer to payload */
+    /* Pointer to payload, allocated right after the segment */
     unsigned char *payload;
     uint16_t payload_len;
 };
@@ -101,17 +101,11 @@ static struct tcp_input_segment *segment_from_frame(struct pico_frame *f)
     if (!f->payload_len)
         return NULL;
 
-    seg = PICO_ZALLOC(sizeof(struct tcp_input_segment));
+    seg = PICO_ZALLOC(sizeof(struct tcp_input_segment) + f->payload_len);
     if (!seg)
         return NULL;
 
-    seg->payload = PICO_ZALLOC(f->payload_len);
-    if(!seg->payload)
-    {
-        PICO_FREE(seg);
-        return NULL;
-    }
-
+    seg->payload = (unsigned char *)(seg + 1);
     seg->seq = SEQN(f);
     seg->payload_len = f->payload_len;
     memcpy(seg->payload, f->payload, seg->payload_len);
@@ -248,11 +242,7 @@ static void pico_discard_segment(struct pico_tcp_queue *tq, void *f)
     }
 
     if(f1 && IS_INPUT_QUEUE(tq))
-    {
-        struct tcp_input_segment *inp = f1;
-        PICO_FREE(inp->payload);
-        PICO_FREE(inp);
-    }
+        PICO_FREE(f1);
     else
         pico_frame_discard(f);
 
@@ -1671,7 +1661,6 @@ static inline int tcp_data_in_expected(struct pico_socket_tcp *t, struct pico_fr
         if(pico_enqueue_segment(&t->tcpq_in, input) <= 0)
         {
             /* failed to enqueue, destroy segment */
-            PICO_FREE(input->payload);
             PICO_FREE(input);
             return -1;
         } else {
@@ -1704,7 +1693,6 @@ static inline int tcp_data_in_high_segment(struct pico_socket_tcp *t, struct pic
 
         if(pico_enqueue_segment(&t->tcpq_in, input) <= 0) {
             /* failed to enqueue, destroy segment */
-            PICO_FREE(input->payload);
             PICO_FREE(input);
             return -1;
         }
@@ -3201,11 +3189,7 @@ static void tcp_discard_all_segments(struct pico_tcp_queue *tq)
 
         pico_tree_delete(&tq->pool, f);
         if(IS_INPUT_QUEUE(tq))
-        {
-            struct tcp_input_segment *inp = (struct tcp_input_segment *)f;
-            PICO_FREE(inp->payload);
-            PICO_FREE(inp);
-        }
+            PICO_FREE(f);
         else
             pico_frame_discard(f);
     }
@@ -1 +1,2 @@
+OPTIONS+=-DPICO_SUPPORT_TAP
 MOD_OBJ+=$(LIBBASE)modules/pico_dev_tap.o
@@ -13,10 +13,190 @@
 #include "pico_stack.h"
 #include "pico_socket.h"
 
+#ifndef PICO_CHECKSUM_NO_SIMD
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PICO_CHECKSUM_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PICO_CHECKSUM_NEON
+#endif
+#endif
+
 #ifdef PICO_SUPPORT_DEBUG_MEMORY
 static int n_frames_allocated;
 #endif
 
+/* Parts of a frame that come from the pools (f->pool) */
+#define PICO_FRAME_POOL_FRAME   (0x01)
+#define PICO_FRAME_POOL_BUFFER  (0x02)
+#define PICO_FRAME_POOL_COUNTER (0x04)
+
+/* A pool hands out elements of one size, and never gives memory back. The
+ * free elements are linked through their first word. A pooled buffer is
+ * preceded by a pointer to its pool, and followed by its usage counter.
+ */
+struct pico_frame_pool {
+    uint32_t size;
+    uint32_t slab;      /* elements per slab */
+    void *free;
+};
+
+#define PICO_FRAME_POOL_ELEMENT(size) ((uint32_t)(((size) + 7u) & ~7u))
+#define PICO_FRAME_POOL_BUFFER_ELEMENT(size) PICO_FRAME_POOL_ELEMENT((size) + sizeof(void *) + sizeof(uint32_t))
+
+/* Up to PICO_FRAME_SLAB_SIZE elements, within PICO_FRAME_SLAB_BYTES */
+#define PICO_FRAME_POOL_SLAB(esize) \
+    (((esize) >= PICO_FRAME_SLAB_BYTES) ? 1u : \
+     ((PICO_FRAME_SLAB_BYTES / (esize)) < PICO_FRAME_SLAB_SIZE) ? (uint32_t)(PICO_FRAME_SLAB_BYTES / (esize)) : \
+     (uint32_t)PICO_FRAME_SLAB_SIZE)
+#define PICO_FRAME_POOL(esize) { (esize), PICO_FRAME_POOL_SLAB(esize), NULL }
+
+static struct pico_frame_pool Frame_pool =
+    PICO_FRAME_POOL(PICO_FRAME_POOL_ELEMENT(sizeof(struct pico_frame)));
+static struct pico_frame_pool Counter_pool =
+    PICO_FRAME_POOL(PICO_FRAME_POOL_ELEMENT(sizeof(void *)));
+/* Buffer size classes, the smallest one that fits is used */
+static struct pico_frame_pool Buffer_pools[] = {
+    PICO_FRAME_POOL(PICO_FRAME_POOL_BUFFER_ELEMENT(128)),
+    PICO_FRAME_POOL(PICO_FRAME_POOL_BUFFER_ELEMENT(512)),
+    PICO_FRAME_POOL(PICO_FRAME_POOL_BUFFER_ELEMENT(PICO_FRAME_POOL_MAX_SIZE))
+};
+#define PICO_FRAME_POOL_CLASSES (int)(sizeof(Buffer_pools) / sizeof(Buffer_pools[0]))
+
+static int pico_frame_pool_grow(struct pico_frame_pool *pool)
+{
+    uint8_t *slab = PICO_ZALLOC((size_t)pool->slab * pool->size);
+    uint32_t i;
+
+    if (!slab)
+        return -1;
+
+    for (i = 0; i < pool->slab; i++) {
+        void **e = (void **)(void *)(slab + i * pool->size);
+        *e = pool->free;
+        pool->free = e;
+    }
+    return 0;
+}
+
+static void *pico_frame_pool_get(struct pico_frame_pool *pool)
+{
+    void **e;
+
+    if (!pool->free && (pico_frame_pool_grow(pool) < 0))
+        return NULL;
+
+    e = pool->free;
+    pool->free = *e;
+    return e;
+}
+
+static void pico_frame_pool_put(struct pico_frame_pool *pool, void *e)
+{
+    *(void **)e = pool->free;
+    pool->free = e;
+}
+
+/* When there is no memory for a new slab, a single element can still be
+ * taken from the heap. It is freed with PICO_FREE (pool bit not set).
+ */
+static int pico_frame_pool_fallback(struct pico_frame_pool *pool)
+{
+    return pool->slab > 1;
+}
+
+static struct pico_frame *pico_frame_struct_alloc(void)
+{
+    struct pico_frame *f = pico_frame_pool_get(&Frame_pool);
+    if (!f) {
+        if (!pico_frame_pool_fallback(&Frame_pool))
+            return NULL;
+
+        return PICO_ZALLOC(sizeof(struct pico_frame));
+    }
+
+    memset(f, 0, sizeof(struct pico_frame));
+    f->pool = PICO_FRAME_POOL_FRAME;
+    return f;
+}
+
+static void pico_frame_struct_free(struct pico_frame *f)
+{
+    if (f->pool & PICO_FRAME_POOL_FRAME)
+        pico_frame_pool_put(&Frame_pool, f);
+    else
+        PICO_FREE(f);
+}
+
+/* Zeroed buffer of 'size' bytes (a multiple of 4), followed by the room for
+ * its usage counter. '*pool' tells whether it comes from a pool.
+ */
+static uint8_t *pico_frame_buffer_alloc(uint32_t size, uint8_t *pool)
+{
+    void **e;
+    int i;
+
+    for (i = 0; i < PICO_FRAME_POOL_CLASSES; i++) {
+        if ((size_t)size + sizeof(void *) + sizeof(uint32_t) <= Buffer_pools[i].size)
+            break;
+    }
+    if (i < PICO_FRAME_POOL_CLASSES)
+        e = pico_frame_pool_get(&Buffer_pools[i]);
+    else
+        e = NULL;
+
+    if (!e) {
+        *pool = 0;
+        if ((i < PICO_FRAME_POOL_CLASSES) && !pico_frame_pool_fallback(&Buffer_pools[i]))
+            return NULL;
+
+        return PICO_ZALLOC((size_t)size + sizeof(uint32_t));
+    }
+
+    *e = &Buffer_pools[i];
+    memset(e + 1, 0, (size_t)size + sizeof(uint32_t));
+    *pool = PICO_FRAME_POOL_BUFFER;
+    return (uint8_t *)(e + 1);
+}
+
+static void pico_frame_buffer_free(uint8_t *buf, uint8_t pool)
+{
+    void **e;
+
+    if (!(pool & PICO_FRAME_POOL_BUFFER)) {
+        PICO_FREE(buf);
+        return;
+    }
+
+    e = (void **)(void *)buf - 1;
+    pico_frame_pool_put(*e, e);
+}
+
+static uint32_t *pico_frame_counter_alloc(uint8_t *pool)
+{
+    uint32_t *c = pico_frame_pool_get(&Counter_pool);
+    if (!c) {
+        *pool = 0;
+        if (!pico_frame_pool_fallback(&Counter_pool))
+            return NULL;
+
+        return PICO_ZALLOC(sizeof(uint32_t));
+    }
+
+    *c = 0;
+    *pool = PICO_FRAME_POOL_COUNTER;
+    return c;
+}
+
+static void pico_frame_counter_free(uint32_t *c, uint8_t pool)
+{
+    if (pool & PICO_FRAME_POOL_COUNTER)
+        pico_frame_pool_put(&Counter_pool, c);
+    else
+        PICO_FREE(c);
+}
+
 /** frame alloc/dealloc/copy **/
 void pico_frame_discard(struct pico_frame *f)
 {
@@ -26,14 +206,14 @@ void pico_frame_discard(struct pico_frame *f)
     (*f->usage_count)--;
     if (*f->usage_count == 0) {
         if (f->flags & PICO_FRAME_FLAG_EXT_USAGE_COUNTER)
-            PICO_FREE(f->usage_count);
+            pico_frame_counter_free(f->usage_count, f->pool);
 
 #ifdef PICO_SUPPORT_DEBUG_MEMORY
         dbg("Discarded buffer @%p, caller: %p\n", f->buffer, __builtin_return_address(3));
         dbg("DEBUG MEMORY: %d frames in use.\n", --n_frames_allocated);
 #endif
         if (!(f->flags & PICO_FRAME_FLAG_EXT_BUFFER))
-            PICO_FREE(f->buffer);
+            pico_frame_buffer_free(f->buffer, f->pool);
         else if (f->notify_free)
             f->notify_free(f->buffer);
 
@@ -46,16 +226,19 @@ void pico_frame_discard(struct pico_frame *f)
         dbg("Removed frame @%p(copy), usage count now: %d\n", f, *f->usage_count);
     }
 #endif
-    PICO_FREE(f);
+    pico_frame_struct_free(f);
 }
 
 struct pico_frame *pico_frame_copy(struct pico_frame *f)
 {
-    struct pico_frame *new = PICO_ZALLOC(sizeof(struct pico_frame));
+    struct pico_frame *new = pico_frame_struct_alloc();
+    uint8_t pool;
     if (!new)
         return NULL;
 
+    pool = new->pool;
     memcpy(new, f, sizeof(struct pico_frame));
+    new->pool = (uint8_t)((f->pool & ~PICO_FRAME_POOL_FRAME) | pool);
     *(new->usage_count) += 1;
 #ifdef PICO_SUPPORT_DEBUG_MEMORY
     dbg("Copied frame @%p, into %p, usage count now: %d\n", f, new, *new->usage_count);
@@ -68,13 +251,14 @@ static struct pico_frame *pico_frame_do_alloc(uint32_t size, int zerocopy, int e
 {
     struct pico_frame *p = NULL;
     uint32_t frame_buffer_size = size;
+    uint8_t pool = 0;
 
     if (ext_buffer && !zerocopy) {
         /* external buffer implies zerocopy flag! */
         return NULL;
     }
 
-    p = PICO_ZALLOC(sizeof(struct pico_frame));
+    p = pico_frame_struct_alloc();
     if (!p)
         return NULL;
 
@@ -85,21 +269,24 @@ static struct pico_frame *pico_frame_do_alloc(uint32_t size, int zerocopy, int e
             frame_buffer_size += (uint32_t)sizeof(uint32_t) - align;
         }
 
-        p->buffer = PICO_ZALLOC((size_t)frame_buffer_size + sizeof(uint32_t));
+        p->buffer = pico_frame_buffer_alloc(frame_buffer_size, &pool);
         if (!p->buffer) {
-            PICO_FREE(p);
+            pico_frame_struct_free(p);
             return NULL;
         }
 
+        p->pool |= pool;
         p->usage_count = (uint32_t *)(((uint8_t*)p->buffer) + frame_buffer_size);
     } else {
         p->buffer = NULL;
         p->flags |= PICO_FRAME_FLAG_EXT_USAGE_COUNTER;
-        p->usage_count = PICO_ZALLOC(sizeof(uint32_t));
+        p->usage_count = pico_frame_counter_alloc(&pool);
         if (!p->usage_count) {
-            PICO_FREE(p);
+            pico_frame_struct_free(p);
             return NULL;
         }
+
+        p->pool |= pool;
     }
 
     p->buffer_len = size;
@@ -130,12 +317,13 @@ struct pico_frame *pico_frame_alloc(uint32_t size)
 }
 
 static uint8_t *
-pico_frame_new_buffer(struct pico_frame *f, uint32_t size, uint32_t *oldsize)
+pico_frame_new_buffer(struct pico_frame *f, uint32_t size, uint32_t *oldsize, uint8_t *oldpool)
 {
     uint8_t *oldbuf;
     uint32_t usage_count, *p_old_usage;
     uint32_t frame_buffer_size;
     unsigned int align;
+    uint8_t pool = 0;
 
     if (!f || (size < f->buffer_len)) {
         return NULL;
@@ -149,9 +337,10 @@ pico_frame_new_buffer(struct pico_frame *f, uint32_t size, uint32_t *oldsize)
 
     oldbuf = f->buffer;
     *oldsize = f->buffer_len;
+    *oldpool = f->pool;
     usage_count = *(f->usage_count);
     p_old_usage = f->usage_count;
-    f->buffer = PICO_ZALLOC((size_t)frame_buffer_size + sizeof(uint32_t));
+    f->buffer = pico_frame_buffer_alloc(frame_buffer_size, &pool);
     if (!f->buffer) {
         f->buffer = oldbuf;
         return NULL;
@@ -162,13 +351,14 @@ pico_frame_new_buffer(struct pico_frame *f, uint32_t size, uint32_t *oldsize)
     f->buffer_len = size;
 
     if (f->flags & PICO_FRAME_FLAG_EXT_USAGE_COUNTER)
-        PICO_FREE(p_old_usage);
+        pico_frame_counter_free(p_old_usage, f->pool);
     /* Now, the frame is not zerocopy anymore, and the usage counter has been moved within it */
+    f->pool = (uint8_t)((f->pool & PICO_FRAME_POOL_FRAME) | pool);
     return oldbuf;
 }
 
 static int
-pico_frame_update_pointers(struct pico_frame *f, ptrdiff_t addr_diff, uint8_t *oldbuf)
+pico_frame_update_pointers(struct pico_frame *f, ptrdiff_t addr_diff, uint8_t *oldbuf, uint8_t oldpool)
 {
     f->net_hdr += addr_diff;
     f->datalink_hdr += addr_diff;
@@ -178,7 +368,7 @@ pico_frame_update_pointers(struct pico_frame *f, ptrdiff_t addr_diff, uint8_t *o
     f->payload += addr_diff;
 
     if (!(f->flags & PICO_FRAME_FLAG_EXT_BUFFER))
-        PICO_FREE(oldbuf);
+        pico_frame_buffer_free(oldbuf, oldpool);
     else if (f->notify_free)
         f->notify_free(oldbuf);
 
@@ -190,7 +380,8 @@ int pico_frame_grow_head(struct pico_frame *f, uint32_t size)
 {
     ptrdiff_t addr_diff = 0;
     uint32_t oldsize = 0;
-    uint8_t *oldbuf = pico_frame_new_buffer(f, size, &oldsize);
+    uint8_t oldpool = 0;
+    uint8_t *oldbuf = pico_frame_new_buffer(f, size, &oldsize, &oldpool);
     if (!oldbuf)
         return -1;
 
@@ -198,14 +389,15 @@ int pico_frame_grow_head(struct pico_frame *f, uint32_t size)
     memcpy(f->buffer + f->buffer_len - oldsize, oldbuf, (size_t)oldsize);
     addr_diff = (ptrdiff_t)(f->buffer + f->buffer_len - oldsize - oldbuf);
 
-    return pico_frame_update_pointers(f, addr_diff, oldbuf);
+    return pico_frame_update_pointers(f, addr_diff, oldbuf, oldpool);
 }
 
 int pico_frame_grow(struct pico_frame *f, uint32_t size)
 {
     ptrdiff_t addr_diff = 0;
     uint32_t oldsize = 0;
-    uint8_t *oldbuf = pico_frame_new_buffer(f, size, &oldsize);
+    uint8_t oldpool = 0;
+    uint8_t *oldbuf = pico_frame_new_buffer(f, size, &oldsize, &oldpool);
     if (!oldbuf)
         return -1;
 
@@ -213,7 +405,7 @@ int pico_frame_grow(struct pico_frame *f, uint32_t size)
     memcpy(f->buffer, oldbuf, (size_t)oldsize);
     addr_diff = (ptrdiff_t)(f->buffer - oldbuf);
 
-    return pico_frame_update_pointers(f, addr_diff, oldbuf);
+    return pico_frame_update_pointers(f, addr_diff, oldbuf, oldpool);
 }
 
 struct pico_frame *pico_frame_alloc_skeleton(uint32_t size, int ext_buffer)
@@ -231,18 +423,55 @@ int pico_frame_skeleton_set_buffer(struct pico_frame *f, void *buf)
     return 0;
 }
 
+/* Moves a frame that holds only headers to an application buffer. The headers
+ * are copied right before the 'len' bytes of payload found at buf + headroom.
+ * The buffer is handed to notify_free() when the last copy of the frame is
+ * discarded.
+ */
+int pico_frame_set_ext_buffer(struct pico_frame *f, uint8_t *buf, uint32_t headroom, uint32_t len, void (*notify_free)(uint8_t *))
+{
+    uint32_t *usage_count;
+    uint8_t *hdr;
+    uint8_t flags, pool;
+
+    if (!f || !buf || (f->flags & (PICO_FRAME_FLAG_EXT_BUFFER | PICO_FRAME_FLAG_EXT_USAGE_COUNTER)) ||
+        (*f->usage_count != 1) || (f->buffer_len > headroom))
+        return -1;
+
+    usage_count = pico_frame_counter_alloc(&pool);
+    if (!usage_count)
+        return -1;
+
+    hdr = buf + headroom - f->buffer_len;
+    memcpy(hdr, f->buffer, (size_t)f->buffer_len);
+    flags = f->flags;
+    pico_frame_update_pointers(f, (ptrdiff_t)(hdr - f->buffer), f->buffer, f->pool);
+
+    f->buffer = buf;
+    f->buffer_len = headroom + len;
+    f->len += len;
+    f->usage_count = usage_count;
+    *f->usage_count = 1;
+    f->pool = (uint8_t)((f->pool & PICO_FRAME_POOL_FRAME) | pool);
+    f->flags = (uint8_t)(flags | PICO_FRAME_FLAG_EXT_BUFFER | PICO_FRAME_FLAG_EXT_USAGE_COUNTER);
+    f->notify_free = notify_free;
+    return 0;
+}
+
 struct pico_frame *pico_frame_deepcopy(struct pico_frame *f)
 {
     struct pico_frame *new = pico_frame_alloc(f->buffer_len);
     ptrdiff_t addr_diff;
     unsigned char *buf;
     uint32_t *uc;
+    uint8_t pool;
     if (!new)
         return NULL;
 
     /* Save the two key pointers... */
     buf = new->buffer;
     uc  = new->usage_count;
+    pool = new->pool;
 
     /* Overwrite all fields with originals */
     memcpy(new, f, sizeof(struct pico_frame));
@@ -250,6 +479,11 @@ struct pico_frame *pico_frame_deepcopy(struct pico_frame *f)
     /* ...restore the two key pointers */
     new->buffer = buf;
     new->usage_count = uc;
+    new->pool = pool;
+
+    /* The copy owns its buffer, even if the original one is external */
+    new->flags &= (uint8_t)~(PICO_FRAME_FLAG_EXT_BUFFER | PICO_FRAME_FLAG_EXT_USAGE_COUNTER);
+    new->notify_free = NULL;
 
     /* Update in-buffer pointers with offset */
     addr_diff = (ptrdiff_t)(new->buffer - f->buffer);
@@ -277,26 +511,116 @@ struct pico_frame *pico_frame_deepcopy(struct pico_frame *f)
 }
 
 
-static inline uint32_t pico_checksum_adder(uint32_t sum, void *data, uint32_t len)
+static inline uint32_t pico_checksum_fold(uint64_t sum)
+{
+    while (sum >> 16) {
+        sum = (sum & 0x0000FFFFu) + (sum >> 16);
+    }
+    return (uint32_t)sum;
+}
+
+#if defined(PICO_CHECKSUM_SSE2)
+static inline uint64_t pico_checksum_adder_simd(uint64_t sum, const uint8_t **buf, uint32_t *len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc0 = zero, acc1 = zero, v;
+    uint64_t lanes[2];
+
+    while (*len >= 32) {
+        v = _mm_loadu_si128((const __m128i *)(*buf));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v, zero));
+        v = _mm_loadu_si128((const __m128i *)(*buf + 16));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v, zero));
+        *buf += 32;
+        *len -= 32;
+    }
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(acc0, acc1));
+    return sum + pico_checksum_fold(lanes[0]) + pico_checksum_fold(lanes[1]);
+}
+#elif defined(PICO_CHECKSUM_NEON)
+static inline uint64_t pico_checksum_adder_simd(uint64_t sum, const uint8_t **buf, uint32_t *len)
+{
+    uint64x2_t acc0 = vdupq_n_u64(0), acc1 = vdupq_n_u64(0);
+
+    while (*len >= 32) {
+        acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(vld1q_u8(*buf)));
+        acc1 = vpadalq_u32(acc1, vreinterpretq_u32_u8(vld1q_u8(*buf + 16)));
+        *buf += 32;
+        *len -= 32;
+    }
+    acc0 = vaddq_u64(acc0, acc1);
+    return sum + pico_checksum_fold(vgetq_lane_u64(acc0, 0)) + pico_checksum_fold(vgetq_lane_u64(acc0, 1));
+}
+#endif
+
+/* One's complement sum of 'len' bytes at a 16-bit aligned address, added to
+ * 'sum'. The 32-bit words are summed in a 64-bit accumulator: folded, this is
+ * the same as the sum of the 16-bit words, with one carry every 4 bytes.
+ */
+static inline uint32_t pico_checksum_adder_aligned(uint64_t acc, const uint8_t *buf, uint32_t len)
 {
-    uint16_t *buf = (uint16_t *)data;
-    uint16_t *stop;
+    const uint32_t *w;
 
     if (len & 0x01) {
         --len;
 #ifdef PICO_BIGENDIAN
-        sum += (((uint8_t *)data)[len]) << 8;
+        acc += (uint32_t)buf[len] << 8;
 #else
-        sum += ((uint8_t *)data)[len];
+        acc += buf[len];
 #endif
     }
 
-    stop = (uint16_t *)(((uint8_t *)data) + len);
+    if (((uintptr_t)buf & 0x02) && (len >= 2)) {
+        acc += *(const uint16_t *)buf;
+        buf += 2;
+        len -= 2;
+    }
+
+#if defined(PICO_CHECKSUM_SSE2) || defined(PICO_CHECKSUM_NEON)
+    if (len >= 64)
+        acc = pico_checksum_adder_simd(acc, &buf, &len);
+#endif
 
-    while (buf < stop) {
-        sum += *buf++;
+    w = (const uint32_t *)buf;
+    while (len >= 16) {
+        acc += w[0];
+        acc += w[1];
+        acc += w[2];
+        acc += w[3];
+        w += 4;
+        len -= 16;
+    }
+    while (len >= 4) {
+        acc += *w++;
+        len -= 4;
     }
-    return sum;
+    if (len)
+        acc += *(const uint16_t *)w;
+
+    return pico_checksum_fold(acc);
+}
+
+static inline uint32_t pico_checksum_adder(uint32_t sum, void *data, uint32_t len)
+{
+    const uint8_t *buf = (const uint8_t *)data;
+    uint32_t odd;
+
+    if (!((uintptr_t)buf & 0x01) || (len == 0))
+        return pico_checksum_adder_aligned(sum, buf, len);
+
+    /* Odd address: the first byte is the first half of a word, the sum of
+     * the next ones from the aligned address has its bytes swapped (RFC 1071).
+     */
+    odd = pico_checksum_adder_aligned(0, buf + 1, len - 1);
+    odd = ((odd & 0xFFu) << 8) | (odd >> 8);
+#ifdef PICO_BIGENDIAN
+    odd += (uint32_t)buf[0] << 8;
+#else
+    odd += buf[0];
+#endif
+    return pico_checksum_fold((uint64_t)sum + odd);
 }
 
 static inline uint16_t pico_checksum_finalize(uint32_t sum)
@@ -328,3 +652,28 @@ uint16_t pico_dualbuffer_checksum(void *inbuf1, uint32_t len1, void *inbuf2, uin
     return pico_checksum_finalize(sum);
 }
 
+/* Incremental update of a checksum, RFC 1624 (eqn. 3): 'crc' is the checksum
+ * field as found in the header, 'old_val' and 'new_val' the 16-bit word it
+ * covers, before and after the change. All in network order.
+ */
+uint16_t pico_checksum_adjust16(uint16_t crc, uint16_t old_val, uint16_t new_val)
+{
+    uint32_t sum = (uint16_t)~crc;
+
+    sum += (uint16_t)~old_val;
+    sum += new_val;
+    return (uint16_t)~pico_checksum_fold(sum);
+}
+
+/* Same for a 32-bit field, e.g. an IPv4 address */
+uint16_t pico_checksum_adjust32(uint16_t crc, uint32_t old_val, uint32_t new_val)
+{
+    uint32_t sum = (uint16_t)~crc;
+
+    sum += (uint16_t)~(old_val >> 16);
+    sum += (uint16_t)~old_val;
+    sum += new_val >> 16;
+    sum += new_val & 0xFFFFu;
+    return (uint16_t)~pico_checksum_fold(sum);
+}
+
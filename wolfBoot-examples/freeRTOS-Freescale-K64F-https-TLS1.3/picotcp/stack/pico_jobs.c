@@ -3,7 +3,7 @@ struct pico_job
 {
     void (*exe)(void *);
     void *arg;
-    struct pico_job *next;
+    struct pico_job *next; /* in the backlog, or in the free list */
 };
 
 
@@ -11,11 +11,47 @@ struct pico_job
 struct pico_job *pico_jobs_backlog = NULL;
 struct pico_job *pico_jobs_backlog_tail = NULL;
 
+/* The jobs come from a pool, which grows by slabs of PICO_JOB_SLAB_SIZE jobs
+ * (or by a single job if a slab cannot be allocated) and never shrinks.
+ */
+static struct pico_job *pico_jobs_free = NULL;
+
 /* static int max_jobs; */
 
+static struct pico_job *pico_job_alloc(void)
+{
+    struct pico_job *job, *slab;
+    int i;
+
+    if (!pico_jobs_free) {
+        slab = PICO_ZALLOC(PICO_JOB_SLAB_SIZE * sizeof(struct pico_job));
+        if (!slab)
+            return PICO_ZALLOC(sizeof(struct pico_job));
+
+        for (i = 0; i < PICO_JOB_SLAB_SIZE; i++) {
+            slab[i].next = pico_jobs_free;
+            pico_jobs_free = &slab[i];
+        }
+    }
+
+    job = pico_jobs_free;
+    pico_jobs_free = job->next;
+    job->next = NULL;
+    return job;
+}
+
 void pico_schedule_job(void (*exe)(void*), void *arg)
 {
-    struct pico_job *job = PICO_ZALLOC(sizeof(struct pico_job));
+    struct pico_job *job;
+#ifndef PICO_SUPPORT_TICKLESS
+    /* Only pico_stack_go() runs the backlog: the legacy tick polls every
+     * layer instead, and the jobs would never be freed.
+     */
+    IGNORE_PARAMETER(exe);
+    IGNORE_PARAMETER(arg);
+    return;
+#endif
+    job = pico_job_alloc();
     if  (!job)
         return;
     job->exe = exe;
@@ -39,7 +75,8 @@ void pico_execute_pending_jobs(void)
             job->exe(job->arg);
         }
         pico_jobs_backlog = job->next;
-        PICO_FREE(job);
+        job->next = pico_jobs_free;
+        pico_jobs_free = job;
         /* count++; */
         if (!pico_jobs_backlog)
             pico_jobs_backlog_tail = NULL;
@@ -0,0 +1,226 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+ *********************************************************************/
+
+#include "pico_lpm.h"
+#include "pico_config.h"
+
+/* Each node holds a prefix, and a value unless it is a glue node. The
+ * children of a node are the longer prefixes, on the side of the bit that
+ * follows its prefix. Nodes with a single child have a value: glue nodes only
+ * exist where two prefixes diverge, so the depth of the trie is bounded by
+ * the key size in bits, and its size by twice the number of prefixes.
+ */
+struct pico_lpm_node
+{
+    struct pico_lpm_node *child[2];
+    void *value;
+    uint8_t len;
+    uint8_t prefix[PICO_LPM_KEY_SIZE]; /* only lpm->key_size bytes allocated */
+};
+
+#define LPM_BITS(lpm) ((uint8_t)((lpm)->key_size << 3))
+#define LPM_BIT(key, i) (((key)[(i) >> 3] >> (7 - ((i) & 7))) & 1)
+
+/* Position of the first bit that differs between a and b, or 'limit'.
+ * The bits before 'from' are known to be equal.
+ */
+static uint8_t lpm_diff(const uint8_t *a, const uint8_t *b, uint8_t from, uint8_t limit)
+{
+    uint8_t i, x;
+
+    for (i = (uint8_t)(from & 0xF8); i < limit; i = (uint8_t)(i + 8)) {
+        x = (uint8_t)(a[i >> 3] ^ b[i >> 3]);
+        if (x) {
+            while (!(x & 0x80)) {
+                x = (uint8_t)(x << 1);
+                i++;
+            }
+            break;
+        }
+    }
+    return (i < limit) ? i : limit;
+}
+
+static struct pico_lpm_node *lpm_node_alloc(struct pico_lpm *lpm, const uint8_t *prefix, uint8_t len, void *value)
+{
+    struct pico_lpm_node *n;
+    uint8_t bytes = (uint8_t)((len + 7) >> 3);
+
+    n = PICO_ZALLOC(sizeof(struct pico_lpm_node) - PICO_LPM_KEY_SIZE + lpm->key_size);
+    if (!n)
+        return NULL;
+
+    memcpy(n->prefix, prefix, bytes);
+    if (len & 7)
+        n->prefix[bytes - 1] &= (uint8_t)(0xFF << (8 - (len & 7)));
+
+    n->len = len;
+    n->value = value;
+    return n;
+}
+
+/* Link to the node of the prefix, or to where it would be inserted.
+ * '*parent' is set to the link to its parent, if any.
+ */
+static struct pico_lpm_node **lpm_find_link(struct pico_lpm *lpm, const uint8_t *prefix, uint8_t len, struct pico_lpm_node ***parent)
+{
+    struct pico_lpm_node **link = &lpm->root, *n;
+    uint8_t checked = 0;
+
+    if (parent)
+        *parent = NULL;
+
+    while ((n = *link) != NULL) {
+        if ((n->len > len) || (lpm_diff(n->prefix, prefix, checked, n->len) < n->len))
+            break;
+
+        if (n->len == len)
+            break;
+
+        checked = n->len;
+        if (parent)
+            *parent = link;
+
+        link = &n->child[LPM_BIT(prefix, n->len)];
+    }
+    return link;
+}
+
+int pico_lpm_insert(struct pico_lpm *lpm, const uint8_t *prefix, uint8_t len, void *value)
+{
+    struct pico_lpm_node **link, *n, *new, *glue;
+    uint8_t diff;
+
+    if (!value || (len > LPM_BITS(lpm)))
+        return -1;
+
+    link = lpm_find_link(lpm, prefix, len, NULL);
+    n = *link;
+    if (n && (n->len == len) && (lpm_diff(n->prefix, prefix, 0, len) == len)) {
+        n->value = value;
+        return 0;
+    }
+
+    new = lpm_node_alloc(lpm, prefix, len, value);
+    if (!new)
+        return -1;
+
+    if (n) {
+        /* n is a longer prefix, or diverges from the new one */
+        diff = lpm_diff(n->prefix, prefix, 0, (n->len < len) ? n->len : len);
+        if (diff == len) {
+            new->child[LPM_BIT(n->prefix, len)] = n;
+        } else {
+            glue = lpm_node_alloc(lpm, prefix, diff, NULL);
+            if (!glue) {
+                PICO_FREE(new);
+                return -1;
+            }
+
+            glue->child[LPM_BIT(prefix, diff)] = new;
+            glue->child[LPM_BIT(n->prefix, diff)] = n;
+            new = glue;
+        }
+    }
+
+    *link = new;
+    return 0;
+}
+
+void *pico_lpm_delete(struct pico_lpm *lpm, const uint8_t *prefix, uint8_t len)
+{
+    struct pico_lpm_node **link, **parent, *n, *child;
+    void *value;
+
+    if (len > LPM_BITS(lpm))
+        return NULL;
+
+    link = lpm_find_link(lpm, prefix, len, &parent);
+    n = *link;
+    if (!n || (n->len != len) || !n->value || (lpm_diff(n->prefix, prefix, 0, len) != len))
+        return NULL;
+
+    value = n->value;
+    if (n->child[0] && n->child[1]) {
+        n->value = NULL;
+        return value;
+    }
+
+    child = n->child[0] ? n->child[0] : n->child[1];
+    *link = child;
+    PICO_FREE(n);
+
+    /* A glue node left with a single child is not needed anymore */
+    if (!child && parent && !(*parent)->value) {
+        n = *parent;
+        *parent = n->child[0] ? n->child[0] : n->child[1];
+        PICO_FREE(n);
+    }
+
+    return value;
+}
+
+void *pico_lpm_find(struct pico_lpm *lpm, const uint8_t *prefix, uint8_t len)
+{
+    struct pico_lpm_node *n;
+
+    if (len > LPM_BITS(lpm))
+        return NULL;
+
+    n = *lpm_find_link(lpm, prefix, len, NULL);
+    if (!n || (n->len != len) || (lpm_diff(n->prefix, prefix, 0, len) != len))
+        return NULL;
+
+    return n->value;
+}
+
+void *pico_lpm_lookup(struct pico_lpm *lpm, const uint8_t *key)
+{
+    struct pico_lpm_node *n = lpm->root;
+    void *best = NULL;
+    uint8_t checked = 0;
+
+    while (n) {
+        if (lpm_diff(n->prefix, key, checked, n->len) < n->len)
+            break;
+
+        if (n->value)
+            best = n->value;
+
+        if (n->len == LPM_BITS(lpm))
+            break;
+
+        checked = n->len;
+        n = n->child[LPM_BIT(key, n->len)];
+    }
+    return best;
+}
+
+int pico_lpm_prefix_len(const uint8_t *netmask, uint8_t size)
+{
+    uint8_t i = 0, len = 0, x;
+
+    while ((i < size) && (netmask[i] == 0xFF)) {
+        len = (uint8_t)(len + 8);
+        i++;
+    }
+    if (i == size)
+        return len;
+
+    x = netmask[i++];
+    while (x & 0x80) {
+        x = (uint8_t)(x << 1);
+        len++;
+    }
+    if (x)
+        return -1;
+
+    while (i < size) {
+        if (netmask[i++])
+            return -1;
+    }
+    return len;
+}
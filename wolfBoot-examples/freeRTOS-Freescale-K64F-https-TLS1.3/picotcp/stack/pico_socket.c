@@ -192,6 +192,213 @@ struct pico_sockport *pico_get_sockport(uint16_t proto, uint16_t port)
     else return NULL;
 }
 
+/* Established flows: the connected sockets, by hash of the remote address,
+ * remote port and local port. A lookup reads a single bucket whatever the
+ * number of connections, instead of walking all the sockets of the local port.
+ * The local address is not hashed: it may be ANY, it is compared instead.
+ * Listening and unconnected sockets, and the rare flow that didn't fit in its
+ * bucket, are still found in the socket tree of the port.
+ */
+#define FLOW_SLOTS (PICO_SOCKET_FLOW_BUCKET_SIZE / (sizeof(uint32_t) + sizeof(struct pico_socket *)))
+#define FLOW_INIT_SIZE 4
+
+struct pico_flow_bucket {
+    uint32_t hash[FLOW_SLOTS];
+    struct pico_socket *sock[FLOW_SLOTS];
+};
+
+static struct pico_flow_table {
+    struct pico_flow_bucket *buckets; /* aligned on a bucket in 'mem' */
+    void *mem;
+    uint32_t size; /* in buckets, power of 2 */
+    uint32_t count;
+    uint32_t seed;
+} Flows;
+
+static uint32_t pico_flow_mix(uint32_t h, uint32_t w)
+{
+    h ^= w;
+    h *= 0x9E3779B1u;
+    return h ^ (h >> 15);
+}
+
+static uint32_t pico_flow_hash(uint16_t proto, union pico_address *remote, int ipv6, uint16_t remote_port, uint16_t local_port)
+{
+    uint32_t h = Flows.seed ^ proto, w;
+    int i, words = ipv6 ? (PICO_SIZE_IP6 >> 2) : 1;
+
+    h = pico_flow_mix(h, ((uint32_t)remote_port << 16) | local_port);
+    for (i = 0; i < words; i++) {
+        memcpy(&w, (uint8_t *)remote + (i << 2), sizeof(w));
+        h = pico_flow_mix(h, w);
+    }
+    h *= 0x85EBCA6Bu;
+    return h ^ (h >> 13);
+}
+
+static uint32_t pico_flow_hash_socket(struct pico_socket *s)
+{
+    return pico_flow_hash(PROTO(s), &s->remote_addr, is_sock_ipv6(s), s->remote_port, s->local_port);
+}
+
+static int pico_flow_alloc(uint32_t size)
+{
+    struct pico_flow_bucket *old = Flows.buckets;
+    void *old_mem = Flows.mem;
+    uint32_t old_size = Flows.size, i, j, k;
+    struct pico_flow_bucket *b;
+    void *mem;
+
+    mem = PICO_ZALLOC(size * sizeof(struct pico_flow_bucket) + PICO_SOCKET_FLOW_BUCKET_SIZE - 1);
+    if (!mem)
+        return -1;
+
+    Flows.mem = mem;
+    Flows.buckets = (struct pico_flow_bucket *)(((uintptr_t)mem + PICO_SOCKET_FLOW_BUCKET_SIZE - 1) & ~(uintptr_t)(PICO_SOCKET_FLOW_BUCKET_SIZE - 1));
+    Flows.size = size;
+    if (!old) {
+        Flows.seed = pico_rand();
+        return 0;
+    }
+
+    /* The flows of a bucket are split between two buckets: they all fit */
+    for (i = 0; i < old_size; i++) {
+        for (j = 0; j < FLOW_SLOTS; j++) {
+            if (!old[i].sock[j])
+                continue;
+
+            b = &Flows.buckets[old[i].hash[j] & (size - 1)];
+            k = 0;
+            while (b->sock[k])
+                k++;
+            b->hash[k] = old[i].hash[j];
+            b->sock[k] = old[i].sock[j];
+        }
+    }
+    PICO_FREE(old_mem);
+    return 0;
+}
+
+static struct pico_flow_bucket *pico_flow_bucket_get(uint32_t hash)
+{
+    return &Flows.buckets[hash & (Flows.size - 1)];
+}
+
+/* Returns -1 if the socket could not be added: it is then found in the tree */
+static int pico_socket_flow_add(struct pico_socket *s)
+{
+    struct pico_flow_bucket *b;
+    uint32_t h, i, free_slot;
+
+    if (!(s->state & PICO_SOCKET_STATE_CONNECTED) || (s->remote_port == 0))
+        return 0;
+
+    if (!Flows.buckets && (pico_flow_alloc(FLOW_INIT_SIZE) < 0))
+        return -1;
+
+    if ((Flows.count >= ((Flows.size * FLOW_SLOTS) >> 1)) && (Flows.size < PICO_SOCKET_FLOWS_MAX))
+        pico_flow_alloc(Flows.size << 1);
+
+    h = pico_flow_hash_socket(s);
+    do {
+        b = pico_flow_bucket_get(h);
+        free_slot = FLOW_SLOTS;
+        for (i = 0; i < FLOW_SLOTS; i++) {
+            if (b->sock[i] == s)
+                return 0;
+
+            if (!b->sock[i] && (free_slot == FLOW_SLOTS))
+                free_slot = i;
+        }
+        if (free_slot < FLOW_SLOTS) {
+            b->hash[free_slot] = h;
+            b->sock[free_slot] = s;
+            Flows.count++;
+            return 0;
+        }
+    } while ((Flows.size < PICO_SOCKET_FLOWS_MAX) && (pico_flow_alloc(Flows.size << 1) == 0));
+    return -1;
+}
+
+static void pico_socket_flow_del(struct pico_socket *s)
+{
+    struct pico_flow_bucket *b;
+    uint32_t i;
+
+    if (!Flows.buckets)
+        return;
+
+    b = pico_flow_bucket_get(pico_flow_hash_socket(s));
+    for (i = 0; i < FLOW_SLOTS; i++) {
+        if (b->sock[i] == s) {
+            b->sock[i] = NULL;
+            Flows.count--;
+            break;
+        }
+    }
+    if (Flows.count == 0) {
+        PICO_FREE(Flows.mem);
+        Flows.mem = NULL;
+        Flows.buckets = NULL;
+        Flows.size = 0;
+    }
+}
+
+static int pico_socket_flow_match(struct pico_socket *s, uint16_t proto, union pico_address *src, union pico_address *dst, int ipv6, struct pico_trans *tr)
+{
+    size_t size = ipv6 ? PICO_SIZE_IP6 : PICO_SIZE_IP4;
+
+    if ((PROTO(s) != proto) || (s->remote_port != tr->sport) || (s->local_port != tr->dport))
+        return 0;
+
+    if ((is_sock_ipv6(s) != 0) != (ipv6 != 0))
+        return 0;
+
+    if (memcmp(&s->remote_addr, src, size) != 0)
+        return 0;
+
+    if (ipv6)
+        return pico_ipv6_is_unspecified(s->local_addr.ip6.addr) || (memcmp(&s->local_addr, dst, size) == 0);
+
+    return (s->local_addr.ip4.addr == PICO_IPV4_INADDR_ANY) || (memcmp(&s->local_addr, dst, size) == 0);
+}
+
+static struct pico_socket *pico_socket_flow_find(uint16_t proto, struct pico_frame *f)
+{
+    struct pico_trans *tr = (struct pico_trans *) f->transport_hdr;
+    union pico_address src, dst;
+    struct pico_flow_bucket *b;
+    uint32_t h, i;
+    int ipv6 = 0;
+
+    if (!Flows.buckets)
+        return NULL;
+
+    memset(&src, 0, sizeof(src));
+    memset(&dst, 0, sizeof(dst));
+#ifdef PICO_SUPPORT_IPV4
+    if (IS_IPV4(f)) {
+        src.ip4 = ((struct pico_ipv4_hdr *)f->net_hdr)->src;
+        dst.ip4 = ((struct pico_ipv4_hdr *)f->net_hdr)->dst;
+    }
+#endif
+#ifdef PICO_SUPPORT_IPV6
+    if (IS_IPV6(f)) {
+        src.ip6 = ((struct pico_ipv6_hdr *)f->net_hdr)->src;
+        dst.ip6 = ((struct pico_ipv6_hdr *)f->net_hdr)->dst;
+        ipv6 = 1;
+    }
+#endif
+
+    h = pico_flow_hash(proto, &src, ipv6, tr->sport, tr->dport);
+    b = pico_flow_bucket_get(h);
+    for (i = 0; i < FLOW_SLOTS; i++) {
+        if (b->sock[i] && (b->hash[i] == h) && pico_socket_flow_match(b->sock[i], proto, &src, &dst, ipv6, tr))
+            return b->sock[i];
+    }
+    return NULL;
+}
+
 #ifdef PICO_SUPPORT_IPV4
 
 static int pico_port_in_use_by_nat(uint16_t proto, uint16_t port)
@@ -425,6 +632,7 @@ int8_t pico_socket_add(struct pico_socket *s)
 		return -1;
 	}
     s->state |= PICO_SOCKET_STATE_BOUND;
+    pico_socket_flow_add(s);
     PICOTCP_MUTEX_UNLOCK(Mutex);
 #ifdef DEBUG_SOCKET_TREE
     {
@@ -499,6 +707,7 @@ static void pico_socket_check_empty_sockport(struct pico_socket *s, struct pico_
 int8_t pico_socket_del(struct pico_socket *s)
 {
     struct pico_sockport *sp = pico_get_sockport(PROTO(s), s->local_port);
+    pico_socket_flow_del(s);
     if (!sp) {
         pico_err = PICO_ERR_ENXIO;
         return -1;
@@ -548,6 +757,9 @@ static int8_t pico_socket_alter_state(struct pico_socket *s, uint16_t more_state
     s->state |= more_states;
     s->state = (uint16_t)(s->state & (~less_states));
     pico_socket_update_tcp_state(s, tcp_state);
+    if (more_states & PICO_SOCKET_STATE_CONNECTED)
+        pico_socket_flow_add(s);
+
     return 0;
 }
 
@@ -570,14 +782,36 @@ static int pico_socket_transport_deliver(struct pico_protocol *p, struct pico_so
 }
 
 
+static int pico_socket_transport_deliver_flow(struct pico_protocol *p, struct pico_socket *s, struct pico_frame *f)
+{
+#ifdef PICO_SUPPORT_TCP
+    if (p->proto_number == PICO_PROTO_TCP)
+        return pico_socket_tcp_deliver_flow(s, f);
+
+#endif
+
+#ifdef PICO_SUPPORT_UDP
+    if (p->proto_number == PICO_PROTO_UDP)
+        return pico_socket_udp_deliver_flow(s, f);
+
+#endif
+
+    return -1;
+}
+
 static int pico_socket_deliver(struct pico_protocol *p, struct pico_frame *f, uint16_t localport)
 {
     struct pico_sockport *sp = NULL;
+    struct pico_socket *s = NULL;
     struct pico_trans *tr = (struct pico_trans *) f->transport_hdr;
 
     if (!tr)
         return -1;
 
+    s = pico_socket_flow_find(p->proto_number, f);
+    if (s)
+        return pico_socket_transport_deliver_flow(p, s, f);
+
     sp = pico_get_sockport(p->proto_number, localport);
     if (!sp) {
         dbg("No such port %d\n", short_be(localport));
@@ -805,14 +1039,23 @@ static uint16_t pico_socket_high_port(uint16_t proto)
         (proto == PICO_PROTO_UDP) ||
 #endif
         0) {
-        do {
-            uint32_t rand = pico_rand();
-            port = (uint16_t) (rand & 0xFFFFU);
-            port = (uint16_t)((port % (65535 - 1024)) + 1024U);
-            if (pico_is_port_free(proto, port, NULL, NULL)) {
+        uint32_t rand = pico_rand();
+        uint32_t i;
+        port = (uint16_t) (rand & 0xFFFFU);
+        port = (uint16_t)((port % (65535 - 1024)) + 1024U);
+        /* The first port unused by any socket from a random one, as two
+         * connections can't have the same 4-tuple. Drawing again instead
+         * may never end: pico_tick doesn't change within this loop, and
+         * pico_rand() can cycle over ports in use.
+         */
+        for (i = 0; i < (65535 - 1024); i++) {
+            if (!pico_get_sockport(proto, short_be(port)) && pico_is_port_free(proto, short_be(port), NULL, NULL)) {
                 return short_be(port);
             }
-        } while(1);
+
+            port = (port == 65534) ? 1024U : (uint16_t)(port + 1U);
+        }
+        return 0U;
     }
     else return 0U;
 }
@@ -1452,6 +1695,103 @@ int pico_socket_send(struct pico_socket *s, const void *buf, int len)
     return pico_socket_sendto(s, buf, len, &s->remote_addr, s->remote_port);
 }
 
+/* Zero-copy send: the frame of a segment is built around a buffer of the
+ * application, which keeps the room for the headers before the payload.
+ */
+static int pico_socket_zerocopy_check(struct pico_socket *s)
+{
+    if (!s || (pico_check_socket(s) != 0)) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    if ((PROTO(s) != PICO_PROTO_TCP) && (PROTO(s) != PICO_PROTO_UDP)) {
+        pico_err = PICO_ERR_EPROTONOSUPPORT;
+        return -1;
+    }
+
+    if ((s->state & PICO_SOCKET_STATE_CONNECTED) == 0) {
+        pico_err = PICO_ERR_ENOTCONN;
+        return -1;
+    }
+
+    if (!get_sock_dev(s)) {
+        pico_err = PICO_ERR_EHOSTUNREACH;
+        return -1;
+    }
+
+    return 0;
+}
+
+int pico_socket_zerocopy_headroom(struct pico_socket *s)
+{
+    struct pico_frame *f;
+    int headroom;
+
+    if (pico_socket_zerocopy_check(s) < 0)
+        return -1;
+
+    f = pico_socket_frame_alloc(s, s->dev, (uint16_t)pico_socket_sendto_transport_offset(s));
+    if (!f)
+        return -1;
+
+    headroom = (int)f->buffer_len;
+    pico_frame_discard(f);
+    return headroom;
+}
+
+int pico_socket_send_zerocopy(struct pico_socket *s, uint8_t *buf, uint32_t headroom, int len, void (*notify_free)(uint8_t *buffer))
+{
+    struct pico_frame *f;
+    uint16_t hdr_offset;
+
+    if (!buf || (len < 0)) {
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    if (pico_socket_zerocopy_check(s) < 0)
+        return -1;
+
+    if (len == 0)
+        return 0;
+
+    if (len > pico_socket_xmit_avail_space(s)) {
+        pico_err = PICO_ERR_EMSGSIZE;
+        return -1;
+    }
+
+    hdr_offset = (uint16_t)pico_socket_sendto_transport_offset(s);
+    f = pico_socket_frame_alloc(s, s->dev, hdr_offset);
+    if (!f)
+        return -1;
+
+    if (headroom < f->buffer_len) {
+        pico_frame_discard(f);
+        pico_err = PICO_ERR_EINVAL;
+        return -1;
+    }
+
+    if (pico_frame_set_ext_buffer(f, buf, headroom, (uint32_t)len, notify_free) < 0) {
+        pico_frame_discard(f);
+        pico_err = PICO_ERR_ENOMEM;
+        return -1;
+    }
+
+    f->payload += hdr_offset;
+    f->payload_len = (uint16_t)len;
+    f->transport_len = (uint16_t)(f->transport_len + len);
+    transport_flags_update(f, s);
+    pico_xmit_frame_set_nofrag(f);
+    if (s->proto->push(s->proto, f) > 0)
+        return len;
+
+    /* Not queued: the buffer stays with the application */
+    f->notify_free = NULL;
+    pico_frame_discard(f);
+    return 0;
+}
+
 int pico_socket_recvfrom_extended(struct pico_socket *s, void *buf, int len, void *orig,
                                   uint16_t *remote_port, struct pico_msginfo *msginfo)
 {
@@ -1674,6 +2014,8 @@ int pico_socket_connect(struct pico_socket *s, const void *remote_addr, uint16_t
         return -1;
     }
 
+    /* A connected socket is hashed by its remote address and port */
+    pico_socket_flow_del(s);
     s->remote_port = remote_port;
 
     if (s->local_port == 0) {
@@ -33,7 +33,6 @@
 #include "pico_tcp.h"
 #include "pico_socket.h"
 #include "pico_ethernet.h"
-#include "heap.h"
 #include "pico_jobs.h"
 
 /* Mockables */
@@ -498,8 +497,7 @@ static int32_t _pico_stack_recv_zerocopy(struct pico_device *dev, uint8_t *buffe
     if (pico_frame_skeleton_set_buffer(f, buffer) < 0)
     {
         dbg("Invalid zero-copy buffer!\n");
-        PICO_FREE(f->usage_count);
-        PICO_FREE(f);
+        pico_frame_discard(f);
         return -1;
     }
 
@@ -548,27 +546,37 @@ int32_t pico_sendto_dev(struct pico_frame *f)
     }
 }
 
+/* The timers come from a pool, which grows by slabs of PICO_TIMER_SLAB_SIZE
+ * timers and never shrinks. The armed timers are kept in a binary heap
+ * ordered by expiration, where each timer knows its position, and in a hash
+ * table of their ids: cancelling a timer doesn't search for it.
+ */
 struct pico_timer
 {
     void *arg;
     void (*timer)(pico_time timestamp, void *arg);
-};
-
-
-static uint32_t tmr_id = 0u;
-struct pico_timer_ref
-{
     pico_time expire;
-    uint32_t id;
+    uint32_t id; /* 0 when not armed */
     uint32_t hash;
-    struct pico_timer *tmr;
+    uint32_t heap_idx;
+    struct pico_timer *next; /* in the id table bucket, or in the free list */
+    struct pico_timer *next_hashed;
 };
 
-typedef struct pico_timer_ref pico_timer_ref;
+static uint32_t tmr_id = 0u;
 
-DECLARE_HEAP(pico_timer_ref, expire);
+static struct pico_timer_pool
+{
+    struct pico_timer **heap; /* heap[1] expires first */
+    struct pico_timer **ids;
+    uint32_t n;    /* armed timers */
+    uint32_t size; /* timers in the pool */
+    uint32_t table_size; /* entries of heap and ids: a power of 2 >= size */
+    struct pico_timer *free;
+    struct pico_timer *hashed; /* the timers with a hash */
+} Timers;
 
-static heap_pico_timer_ref *Timers;
+#define TIMER_BUCKET(id) (Timers.ids[(id) & (Timers.table_size - 1)])
 
 int32_t pico_seq_compare(uint32_t a, uint32_t b)
 {
@@ -595,79 +603,187 @@ int32_t pico_seq_compare(uint32_t a, uint32_t b)
     return 0;
 }
 
-static void pico_check_timers(void)
+static void pico_timer_heap_set(uint32_t i, struct pico_timer *t)
+{
+    Timers.heap[i] = t;
+    t->heap_idx = i;
+}
+
+static void pico_timer_heap_up(uint32_t i)
+{
+    struct pico_timer *t = Timers.heap[i];
+
+    while ((i > 1) && (Timers.heap[i >> 1]->expire > t->expire)) {
+        pico_timer_heap_set(i, Timers.heap[i >> 1]);
+        i >>= 1;
+    }
+    pico_timer_heap_set(i, t);
+}
+
+static void pico_timer_heap_down(uint32_t i)
+{
+    struct pico_timer *t = Timers.heap[i];
+    uint32_t child;
+
+    while ((child = i << 1) <= Timers.n) {
+        if ((child < Timers.n) && (Timers.heap[child + 1]->expire < Timers.heap[child]->expire))
+            child++;
+
+        if (Timers.heap[child]->expire >= t->expire)
+            break;
+
+        pico_timer_heap_set(i, Timers.heap[child]);
+        i = child;
+    }
+    pico_timer_heap_set(i, t);
+}
+
+static struct pico_timer *pico_timer_find(uint32_t id)
 {
     struct pico_timer *t;
-    struct pico_timer_ref tref_unused, *tref = heap_first(Timers);
-    pico_tick = PICO_TIME_MS();
-    while((tref) && (tref->expire <= pico_tick)) {
-        t = tref->tmr;
-        if (t && t->timer)
-            t->timer(pico_tick, t->arg);
-
-        if (t)
-        {
-            PICO_FREE(t);
+
+    if ((id == 0u) || (Timers.table_size == 0))
+        return NULL;
+
+    for (t = TIMER_BUCKET(id); t; t = t->next) {
+        if (t->id == id)
+            return t;
+    }
+    return NULL;
+}
+
+/* Disarms the timer, and returns it to the pool */
+static void pico_timer_release(struct pico_timer *t)
+{
+    struct pico_timer **pt, *last;
+    uint32_t i = t->heap_idx;
+
+    for (pt = &TIMER_BUCKET(t->id); *pt != t; pt = &(*pt)->next)
+        ;
+    *pt = t->next;
+
+    if (t->hash) {
+        for (pt = &Timers.hashed; *pt != t; pt = &(*pt)->next_hashed)
+            ;
+        *pt = t->next_hashed;
+    }
+
+    last = Timers.heap[Timers.n--];
+    if (last != t) {
+        pico_timer_heap_set(i, last);
+        if ((i > 1) && (Timers.heap[i >> 1]->expire > last->expire))
+            pico_timer_heap_up(i);
+        else
+            pico_timer_heap_down(i);
+    }
+
+    t->id = 0;
+    t->next = Timers.free;
+    Timers.free = t;
+}
+
+/* Adds a slab to the pool, and doubles the tables if needed */
+static int pico_timer_pool_grow(void)
+{
+    struct pico_timer **heap, **ids, *slab, *t, *next;
+    uint32_t i, size = Timers.size + PICO_TIMER_SLAB_SIZE;
+    uint32_t table_size = Timers.table_size ? Timers.table_size : PICO_TIMER_SLAB_SIZE;
+
+    while (table_size < size)
+        table_size <<= 1;
+
+    if (table_size != Timers.table_size) {
+        heap = PICO_ZALLOC((table_size + 1) * sizeof(struct pico_timer *));
+        ids = PICO_ZALLOC(table_size * sizeof(struct pico_timer *));
+        if (!heap || !ids) {
+            if (heap)
+                PICO_FREE(heap);
+
+            if (ids)
+                PICO_FREE(ids);
+
+            return -1;
         }
 
-        heap_peek(Timers, &tref_unused);
-        tref = heap_first(Timers);
+        for (i = 0; i < Timers.table_size; i++) {
+            for (t = Timers.ids[i]; t; t = next) {
+                next = t->next;
+                t->next = ids[t->id & (table_size - 1)];
+                ids[t->id & (table_size - 1)] = t;
+            }
+        }
+        if (Timers.heap) {
+            memcpy(heap, Timers.heap, (Timers.n + 1) * sizeof(struct pico_timer *));
+            PICO_FREE(Timers.heap);
+            PICO_FREE(Timers.ids);
+        }
+
+        Timers.heap = heap;
+        Timers.ids = ids;
+        Timers.table_size = table_size;
+    }
+
+    slab = PICO_ZALLOC(PICO_TIMER_SLAB_SIZE * sizeof(struct pico_timer));
+    if (!slab)
+        return -1;
+
+    for (i = 0; i < PICO_TIMER_SLAB_SIZE; i++) {
+        slab[i].next = Timers.free;
+        Timers.free = &slab[i];
+    }
+    Timers.size = size;
+    return 0;
+}
+
+static void pico_check_timers(void)
+{
+    struct pico_timer *t;
+    void (*timer)(pico_time timestamp, void *arg);
+    void *arg;
+
+    pico_tick = PICO_TIME_MS();
+    while ((Timers.n > 0) && (Timers.heap[1]->expire <= pico_tick)) {
+        t = Timers.heap[1];
+        timer = t->timer;
+        arg = t->arg;
+        pico_timer_release(t);
+        if (timer)
+            timer(pico_tick, arg);
     }
 }
 
 #ifdef PICO_SUPPORT_TICKLESS
 long long int pico_stack_go(void)
 {
-    struct pico_timer_ref *tref; 
     pico_execute_pending_jobs();
     pico_check_timers();
-    tref = heap_first(Timers);
-    if (!tref)
+    if (Timers.n == 0)
         return -1;
     /* Execute jobs again, in case they were scheduled in timer execution */
     pico_execute_pending_jobs();
-    return(long long int)((tref->expire - pico_tick) + 1); 
+    return(long long int)((Timers.heap[1]->expire - pico_tick) + 1); 
 }
 #endif
 
 void MOCKABLE pico_timer_cancel(uint32_t id)
 {
-    uint32_t i;
-    struct pico_timer_ref *tref;
-    if (id == 0u)
-        return;
+    struct pico_timer *t = pico_timer_find(id);
 
-    for (i = 1; i <= Timers->n; i++) {
-        tref = heap_get_element(Timers, i);
-        if (tref->id == id) {
-            if (tref->tmr)
-            {
-                PICO_FREE(tref->tmr);
-                tref->tmr = NULL;
-                tref->id = 0;
-            }
-            break;
-        }
-    }
+    if (t)
+        pico_timer_release(t);
 }
 
 void pico_timer_cancel_hashed(uint32_t hash)
 {
-    uint32_t i;
-    struct pico_timer_ref *tref;
+    struct pico_timer *t, *next;
+
     if (hash == 0u)
         return;
 
-    for (i = 1; i <= Timers->n; i++) {
-        tref = heap_get_element(Timers, i);
-        if (tref->hash == hash) {
-            if (tref->tmr)
-            {
-                PICO_FREE(tref->tmr);
-                tref->tmr = NULL;
-                tref[i].id = 0;
-            }
-        }
+    for (t = Timers.hashed; t; t = next) {
+        next = t->next_hashed;
+        if (t->hash == hash)
+            pico_timer_release(t);
     }
 }
 
@@ -837,72 +953,55 @@ void pico_stack_loop(void)
 }
 
 static uint32_t
-pico_timer_ref_add(pico_time expire, struct pico_timer *t, uint32_t id, uint32_t hash)
+pico_timer_ref_add(pico_time expire, void (*timer)(pico_time, void *), void *arg, uint32_t hash)
 {
-    struct pico_timer_ref tref;
-
-    tref.expire = PICO_TIME_MS() + expire;
-    tref.tmr = t;
-    tref.id = id;
-    tref.hash = hash;
+    struct pico_timer *t;
 
-    if (heap_insert(Timers, &tref) < 0) {
-        dbg("Error: failed to insert timer(ID %u) into heap\n", id);
-        PICO_FREE(t);
+    if (!Timers.free && (pico_timer_pool_grow() < 0)) {
+        dbg("Error: failed to allocate timer\n");
         pico_err = PICO_ERR_ENOMEM;
         return 0;
     }
-    if (Timers->n > PICO_MAX_TIMERS) {
-        dbg("Warning: I have %d timers\n", (int)Timers->n);
-    }
 
-    return tref.id;
-}
-
-static struct pico_timer *
-pico_timer_create(void (*timer)(pico_time, void *), void *arg)
-{
-    struct pico_timer *t = PICO_ZALLOC(sizeof(struct pico_timer));
+    t = Timers.free;
+    Timers.free = t->next;
 
-    if (!t) {
-        pico_err = PICO_ERR_ENOMEM;
-        return NULL;
+    /* zero is guard for timers */
+    if (tmr_id == 0u) {
+        tmr_id++;
     }
 
-    t->arg = arg;
+    t->expire = PICO_TIME_MS() + expire;
     t->timer = timer;
+    t->arg = arg;
+    t->id = tmr_id++;
+    t->hash = hash;
+
+    t->next = TIMER_BUCKET(t->id);
+    TIMER_BUCKET(t->id) = t;
+    if (hash) {
+        t->next_hashed = Timers.hashed;
+        Timers.hashed = t;
+    }
+
+    Timers.n++;
+    pico_timer_heap_set(Timers.n, t);
+    pico_timer_heap_up(Timers.n);
+    if (Timers.n == PICO_MAX_TIMERS + 1) {
+        dbg("Warning: I have %d timers\n", (int)Timers.n);
+    }
 
-    return t;
+    return t->id;
 }
 
 MOCKABLE uint32_t pico_timer_add(pico_time expire, void (*timer)(pico_time, void *), void *arg)
 {
-    struct pico_timer *t = pico_timer_create(timer, arg);
-
-    /* zero is guard for timers */
-    if (tmr_id == 0u) {
-        tmr_id++;
-    }
-
-    if (!t)
-        return 0;
-
-    return pico_timer_ref_add(expire, t, tmr_id++, 0);
+    return pico_timer_ref_add(expire, timer, arg, 0);
 }
 
 uint32_t pico_timer_add_hashed(pico_time expire, void (*timer)(pico_time, void *), void *arg, uint32_t hash)
 {
-    struct pico_timer *t = pico_timer_create(timer, arg);
-
-    /* zero is guard for timers */
-    if (tmr_id == 0u) {
-        tmr_id++;
-    }
-
-    if (!t)
-        return 0;
-
-    return pico_timer_ref_add(expire, t, tmr_id++, hash);
+    return pico_timer_ref_add(expire, timer, arg, hash);
 } /* Static path count: 4 */
 
 int MOCKABLE pico_stack_init(void)
@@ -950,9 +1049,8 @@ int MOCKABLE pico_stack_init(void)
 
     pico_rand_feed(123456);
 
-    /* Initialize timer heap */
-    Timers = heap_init();
-    if (!Timers)
+    /* Timers allocated on demand: make sure that there are some */
+    if (!Timers.free && (pico_timer_pool_grow() < 0))
         return -1;
 
 #if ((defined PICO_SUPPORT_IPV4) && (defined PICO_SUPPORT_ETH))
@@ -30,6 +30,12 @@ struct pico_tree_node LEAF = {
 #define PARENT(x) (x->parent)
 #define GRANPA(x) (x->parent->parent)
 
+/* The nodes allocated with USE_PICO_ZALLOC come from a pool, which grows by
+ * slabs of PICO_TREE_SLAB_SIZE nodes (or by a single node if a slab cannot be
+ * allocated) and never shrinks. Free nodes are linked through their parent.
+ */
+static struct pico_tree_node *Node_pool = NULL;
+
 /*
  * Local Functions
  */
@@ -39,6 +45,8 @@ static void rotateToRight(struct pico_tree*root, struct pico_tree_node*node);
 static void fix_insert_collisions(struct pico_tree*tree, struct pico_tree_node*node);
 static void fix_delete_collisions(struct pico_tree*tree, struct pico_tree_node *node);
 static void switchNodes(struct pico_tree*tree, struct pico_tree_node*nodeA, struct pico_tree_node*nodeB);
+static struct pico_tree_node *pico_tree_node_alloc(void);
+static void pico_tree_node_free(struct pico_tree_node *node);
 void *pico_tree_insert_implementation(struct pico_tree *tree, void *key, uint8_t allocator);
 void *pico_tree_delete_implementation(struct pico_tree *tree, void *key, uint8_t allocator);
 
@@ -316,7 +324,7 @@ void *pico_tree_delete_implementation(struct pico_tree *tree, void *key, uint8_t
     if_nodecolor_black_fix_collisions(tree, temp, nodeColor);
 
     if(allocator == USE_PICO_ZALLOC)
-        PICO_FREE(delete);
+        pico_tree_node_free(delete);
 
 #ifdef PICO_SUPPORT_MM
     else
@@ -388,12 +396,37 @@ static void rotateToRight(struct pico_tree *tree, struct pico_tree_node *node)
     return;
 }
 
+static struct pico_tree_node *pico_tree_node_alloc(void)
+{
+    struct pico_tree_node *node, *slab;
+    int i;
+
+    if (!Node_pool) {
+        slab = PICO_ZALLOC(PICO_TREE_SLAB_SIZE * sizeof(struct pico_tree_node));
+        if (!slab)
+            return PICO_ZALLOC(sizeof(struct pico_tree_node));
+
+        for (i = 0; i < PICO_TREE_SLAB_SIZE; i++)
+            pico_tree_node_free(&slab[i]);
+    }
+
+    node = Node_pool;
+    Node_pool = node->parent;
+    return node;
+}
+
+static void pico_tree_node_free(struct pico_tree_node *node)
+{
+    node->parent = Node_pool;
+    Node_pool = node;
+}
+
 static struct pico_tree_node *create_node(struct pico_tree *tree, void*key, uint8_t allocator)
 {
     struct pico_tree_node *temp = NULL;
     IGNORE_PARAMETER(tree);
     if(allocator == USE_PICO_ZALLOC)
-        temp = (struct pico_tree_node *)PICO_ZALLOC(sizeof(struct pico_tree_node));
+        temp = pico_tree_node_alloc();
 
 #ifdef PICO_SUPPORT_MM
     else
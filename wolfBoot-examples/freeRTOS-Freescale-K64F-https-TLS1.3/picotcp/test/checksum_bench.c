@@ -0,0 +1,133 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   Checksum benchmark: compares pico_checksum() with the former routine,
+   which added the 16-bit words one by one, on buffers of 20 to 65535 bytes
+   at even and odd offsets. The results of both must be the same.
+
+   Usage: checksum_bench
+ *********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico_stack.h"
+#include "pico_frame.h"
+
+#define BENCH_MAX_LEN 65535
+#define BENCH_BYTES (64u * 1024u * 1024u)
+
+static const uint32_t bench_sizes[] = {
+    20, 64, 576, 1500, 9000, BENCH_MAX_LEN
+};
+#define BENCH_SIZES (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+static uint8_t bench_buf[BENCH_MAX_LEN + 8] __attribute__((aligned(16)));
+
+static uint32_t rnd_state = 0x2545F491;
+
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* The former pico_checksum() */
+static uint16_t ref_checksum(void *data, uint32_t len)
+{
+    uint16_t *buf = (uint16_t *)data;
+    uint16_t *stop;
+    uint32_t sum = 0;
+
+    if (len & 0x01) {
+        --len;
+#ifdef PICO_BIGENDIAN
+        sum += (uint32_t)(((uint8_t *)data)[len]) << 8;
+#else
+        sum += ((uint8_t *)data)[len];
+#endif
+    }
+
+    stop = (uint16_t *)(((uint8_t *)data) + len);
+    while (buf < stop) {
+        sum += *buf++;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0x0000FFFF) + (sum >> 16);
+    }
+    return short_be((uint16_t) ~sum);
+}
+
+static int bench_check(void)
+{
+    uint32_t len, off;
+    int i;
+
+    for (i = 0; i < 20000; i++) {
+        len = rnd() % 1600;
+        off = rnd() % 8;
+        if (pico_checksum(bench_buf + off, len) != ref_checksum(bench_buf + off, len))
+            return -1;
+    }
+    /* Carries: all ones */
+    memset(bench_buf, 0xFF, sizeof(bench_buf));
+    for (len = 0; len < 200; len++) {
+        if (pico_checksum(bench_buf + (len & 7), len) != ref_checksum(bench_buf + (len & 7), len))
+            return -1;
+    }
+    if (pico_checksum(bench_buf, BENCH_MAX_LEN) != ref_checksum(bench_buf, BENCH_MAX_LEN))
+        return -1;
+
+    return 0;
+}
+
+static double bench_run(uint16_t (*csum)(void *, uint32_t), uint32_t off, uint32_t len, volatile uint16_t *res)
+{
+    uint32_t n = BENCH_BYTES / len, i;
+    double t0 = now();
+
+    for (i = 0; i < n; i++)
+        *res = (uint16_t)(*res + csum(bench_buf + off, len));
+    return (now() - t0) * 1e9 / n;
+}
+
+int main(void)
+{
+    volatile uint16_t res = 0;
+    double ref, cur, ref_odd, cur_odd;
+    uint32_t i;
+    int size;
+
+    for (i = 0; i < sizeof(bench_buf); i++)
+        bench_buf[i] = (uint8_t)rnd();
+
+    if (bench_check() < 0) {
+        printf("Checksum equivalence test FAILED\n");
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(bench_buf); i++)
+        bench_buf[i] = (uint8_t)rnd();
+
+    printf("Checksum of a buffer (ns), 16-bit words vs pico_checksum()\n");
+    printf("    len    16-bit  pico_checksum  | odd offset: 16-bit  pico_checksum\n");
+    for (size = 0; size < BENCH_SIZES; size++) {
+        ref = bench_run(ref_checksum, 0, bench_sizes[size], &res);
+        cur = bench_run(pico_checksum, 0, bench_sizes[size], &res);
+        ref_odd = bench_run(ref_checksum, 1, bench_sizes[size], &res);
+        cur_odd = bench_run(pico_checksum, 1, bench_sizes[size], &res);
+        printf("%7u  %8.1f  %13.1f  |         %8.1f  %13.1f\n", bench_sizes[size], ref, cur, ref_odd, cur_odd);
+    }
+
+    return 0;
+}
@@ -0,0 +1,243 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   Frame benchmark: measures the cost of allocating and discarding a frame,
+   then sends a TCP stream over the loop device with pico_socket_write() and
+   with pico_socket_send_zerocopy(). The heap allocations are counted by
+   wrapping calloc() (glibc), and the stream is checked on the server side.
+   A zero-copy buffer larger than a segment must fail with EMSGSIZE.
+
+   Usage: frame_bench
+ *********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico_stack.h"
+#include "pico_ipv4.h"
+#include "pico_socket.h"
+#include "pico_dev_loop.h"
+
+#define BENCH_FRAMES 1000000
+#define BENCH_SEGMENTS 20000
+#define BENCH_PAYLOAD 1400
+#define BENCH_BUFFERS 64
+#define BENCH_PORT 5555
+
+static const uint32_t bench_sizes[] = {
+    64, 576, 1514, 9000
+};
+#define BENCH_SIZES (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+extern void *__libc_calloc(size_t nmemb, size_t size);
+static unsigned long n_allocs;
+
+void *calloc(size_t nmemb, size_t size)
+{
+    n_allocs++;
+    return __libc_calloc(nmemb, size);
+}
+
+static struct pico_socket *listener, *client, *server;
+static uint8_t zc_buf[BENCH_BUFFERS][256 + BENCH_PAYLOAD];
+static int zc_busy[BENCH_BUFFERS];
+static uint8_t rx_buf[BENCH_PAYLOAD];
+static uint32_t rx_seq;
+static int rx_errors;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_fill(uint8_t *p, uint32_t seq)
+{
+    uint32_t i;
+    for (i = 0; i < BENCH_PAYLOAD; i++)
+        p[i] = (uint8_t)(seq + i);
+}
+
+static void bench_wakeup(uint16_t ev, struct pico_socket *s)
+{
+    struct pico_ip4 orig;
+    uint16_t port;
+    (void)ev;
+
+    if ((s == listener) && !server)
+        server = pico_socket_accept(s, &orig, &port);
+}
+
+static void bench_zc_release(uint8_t *buf)
+{
+    zc_busy[(buf - zc_buf[0]) / (long)sizeof(zc_buf[0])] = 0;
+}
+
+/* Ticks until the server has read one more segment */
+static int bench_receive(void)
+{
+    static int got;
+    int r, tries, i;
+
+    for (tries = 0; tries < 1000; tries++) {
+        r = pico_socket_read(server, rx_buf + got, BENCH_PAYLOAD - got);
+        if (r > 0)
+            got += r;
+
+        if (got == BENCH_PAYLOAD) {
+            for (i = 0; i < BENCH_PAYLOAD; i++) {
+                if (rx_buf[i] != (uint8_t)(rx_seq + (uint32_t)i)) {
+                    rx_errors++;
+                    break;
+                }
+            }
+            rx_seq++;
+            got = 0;
+            return 0;
+        }
+
+        pico_stack_tick();
+    }
+    return -1;
+}
+
+static void bench_alloc(uint32_t size)
+{
+    struct pico_frame *f;
+    unsigned long allocs = n_allocs;
+    double t0 = now();
+    int i;
+
+    for (i = 0; i < BENCH_FRAMES; i++) {
+        f = pico_frame_alloc(size);
+        if (!f)
+            return;
+
+        f->buffer[0] = (uint8_t)i;
+        pico_frame_discard(f);
+    }
+    printf("%7u  %14.1f  %12.2f\n", size, (now() - t0) * 1e9 / BENCH_FRAMES,
+           (double)(n_allocs - allocs) / BENCH_FRAMES);
+}
+
+static int bench_stream(int zerocopy)
+{
+    static uint8_t tx_buf[BENCH_PAYLOAD];
+    unsigned long allocs = n_allocs;
+    double t_send = 0, t0, t_all = now();
+    int headroom = pico_socket_zerocopy_headroom(client);
+    uint32_t seq, end = rx_seq + BENCH_SEGMENTS;
+    int r, b = 0, tries;
+
+    if (headroom < 0 || headroom > 256)
+        return -1;
+
+    for (seq = rx_seq; seq < end; seq++) {
+        uint8_t *p = tx_buf;
+        if (zerocopy) {
+            for (tries = 0; zc_busy[b] && (tries < 1000); tries++)
+                pico_stack_tick();
+            if (zc_busy[b])
+                return -1;
+
+            p = zc_buf[b] + headroom;
+        }
+
+        bench_fill(p, seq);
+        t0 = now();
+        if (zerocopy) {
+            zc_busy[b] = 1;
+            r = pico_socket_send_zerocopy(client, zc_buf[b], (uint32_t)headroom, BENCH_PAYLOAD, bench_zc_release);
+            if (r <= 0)
+                zc_busy[b] = 0;
+        } else {
+            r = pico_socket_write(client, p, BENCH_PAYLOAD);
+        }
+
+        t_send += now() - t0;
+        if (r != BENCH_PAYLOAD)
+            return -1;
+
+        if (bench_receive() < 0)
+            return -1;
+
+        b = (b + 1) % BENCH_BUFFERS;
+    }
+    printf("%-9s  %14.1f  %12.1f  %12.2f\n", zerocopy ? "zerocopy" : "write",
+           t_send * 1e9 / BENCH_SEGMENTS, (now() - t_all) * 1e9 / BENCH_SEGMENTS,
+           (double)(n_allocs - allocs) / BENCH_SEGMENTS);
+    return 0;
+}
+
+/* A zero-copy send is one segment: a larger buffer is refused */
+static int bench_zerocopy_limit(void)
+{
+    static uint8_t big_buf[256 + 65536];
+
+    if ((pico_socket_send_zerocopy(client, big_buf, 256, 65536, bench_zc_release) != -1) ||
+        (pico_err != PICO_ERR_EMSGSIZE))
+        return -1;
+
+    return 0;
+}
+
+int main(void)
+{
+    struct pico_device *dev;
+    struct pico_ip4 address, netmask, any = {
+        0
+    };
+    uint16_t port = short_be(BENCH_PORT);
+    int nodelay = 1, size, tries;
+
+    pico_stack_init();
+    dev = pico_loop_create();
+    if (!dev) {
+        fprintf(stderr, "loop device creation failed\n");
+        return 2;
+    }
+
+    address.addr = long_be(0x7F000001); /* 127.0.0.1 */
+    netmask.addr = long_be(0xFF000000);
+    pico_ipv4_link_add(dev, address, netmask);
+
+    printf("Frame alloc + discard\n");
+    printf("   size  ns per frame  calloc/frame\n");
+    for (size = 0; size < BENCH_SIZES; size++)
+        bench_alloc(bench_sizes[size]);
+
+    listener = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, bench_wakeup);
+    client = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, bench_wakeup);
+    if (!listener || !client || (pico_socket_bind(listener, &any, &port) < 0) ||
+        (pico_socket_listen(listener, 1) < 0)) {
+        fprintf(stderr, "socket setup failed\n");
+        return 2;
+    }
+
+    pico_socket_setoption(client, PICO_TCP_NODELAY, &nodelay);
+    pico_socket_connect(client, &address, short_be(BENCH_PORT));
+    for (tries = 0; !server && (tries < 1000); tries++)
+        pico_stack_tick();
+    for (tries = 0; tries < 100; tries++)
+        pico_stack_tick();
+    if (!server) {
+        fprintf(stderr, "connection failed\n");
+        return 2;
+    }
+
+    printf("\nTCP stream on the loop device, %d byte segments\n", BENCH_PAYLOAD);
+    printf("send call  ns per send call  ns per segment  calloc/segment\n");
+    if ((bench_zerocopy_limit() < 0) || (bench_stream(0) < 0) || (bench_stream(1) < 0)) {
+        fprintf(stderr, "stream failed\n");
+        return 1;
+    }
+
+    if (rx_errors) {
+        printf("%d segments received with wrong data\n", rx_errors);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,337 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   Route lookup benchmark: random routes (as injected by OLSR/AODV) are added
+   through a gateway on the loop device, or on a tap device, and the cost of
+   a route lookup is measured with 16 to 65536 routes.
+
+   The routes are found by the longest prefix match table, unless a route with
+   a non-contiguous netmask exists: then the routing table is walked, as
+   before. Both are timed, and must find the same routes.
+
+   Usage: route_bench [tap_name]    (tap devices need a TAP=1 build)
+ *********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico_stack.h"
+#include "pico_ipv4.h"
+#include "pico_ipv6.h"
+#include "pico_dev_loop.h"
+#ifdef PICO_SUPPORT_TAP
+#include "pico_dev_tap.h"
+#endif
+
+#define BENCH_MAX_ROUTES 65536
+#define BENCH_LOOKUPS 100000
+/* The walk is O(routes): fewer lookups with large tables */
+#define BENCH_WALK_VISITS (1 << 25)
+
+static const int bench_sizes[] = {
+    16, 256, 4096, BENCH_MAX_ROUTES
+};
+#define BENCH_SIZES (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+static uint32_t rnd_state = 0x2545F491;
+
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int walk_lookups(int routes)
+{
+    int n = BENCH_WALK_VISITS / routes;
+    return (n < BENCH_LOOKUPS) ? n : BENCH_LOOKUPS;
+}
+
+static void print_result(int routes, double lpm, double walk, int errors)
+{
+    printf("%8d  %15.1f  %16.1f  %7.1fx  %s\n", routes, lpm * 1e9, walk * 1e9,
+           walk / lpm, errors ? "MISMATCH" : "ok");
+}
+
+static struct pico_ip4 dest4[BENCH_MAX_ROUTES], mask4[BENCH_MAX_ROUTES];
+static struct pico_ip4 lookup4[BENCH_LOOKUPS], gw4[BENCH_LOOKUPS];
+
+/* Random host of one of the routes, or random address */
+static void ipv4_lookups(int routes)
+{
+    int i, r;
+    for (i = 0; i < BENCH_LOOKUPS; i++) {
+        if (i & 1) {
+            r = (int)(rnd() % (uint32_t)routes);
+            lookup4[i].addr = dest4[r].addr | (rnd() & ~mask4[r].addr);
+        } else {
+            lookup4[i].addr = long_be(0x80000000 | (rnd() % 0x60000000));
+        }
+    }
+}
+
+static double ipv4_time(int n, int check)
+{
+    struct pico_ip4 gw;
+    double t0 = now();
+    int i, errors = 0;
+
+    for (i = 0; i < n; i++) {
+        gw = pico_ipv4_route_get_gateway(&lookup4[i]);
+        if (check)
+            errors += (gw.addr != gw4[i].addr);
+        else
+            gw4[i] = gw;
+    }
+    if (errors)
+        return -1.0;
+
+    return (now() - t0) / n;
+}
+
+/* The netmask is not contiguous, and the route never matches */
+static int ipv4_walk(struct pico_ipv4_link *link, int enable)
+{
+    struct pico_ip4 dest = {
+        0xFFFFFFFF
+    }, netmask = {
+        long_be(0xFF00FF00)
+    }, gateway = {
+        0
+    };
+
+    if (enable)
+        return pico_ipv4_route_add(dest, netmask, gateway, 1, link);
+
+    return pico_ipv4_route_del(dest, netmask, 1);
+}
+
+static int ipv4_bench(struct pico_device *dev, uint32_t net)
+{
+    struct pico_ip4 address, netmask, gateway, any = {
+        0
+    };
+    struct pico_ipv4_link *link;
+    double lpm, walk;
+    int routes = 0, size, len, i, fail = 0;
+
+    address.addr = long_be(net | 1);
+    netmask.addr = long_be(0xFF000000);
+    if (pico_ipv4_link_add(dev, address, netmask) < 0)
+        return -1;
+
+    link = pico_ipv4_link_get(&address);
+    gateway.addr = long_be(net | 2);
+    if (pico_ipv4_route_add(any, any, gateway, 1, link) < 0)
+        return -1;
+
+    printf("\nIPv4\n  routes  lpm (ns/lookup)  walk (ns/lookup)   speedup\n");
+    for (size = 0; size < BENCH_SIZES; size++) {
+        while (routes < bench_sizes[size]) {
+            len = 8 + (int)(rnd() % 25);
+            mask4[routes].addr = long_be((uint32_t)(0xFFFFFFFFULL << (32 - len)));
+            dest4[routes].addr = long_be(0x80000000 | (rnd() % 0x60000000)) & mask4[routes].addr;
+            gateway.addr = long_be(net | (uint32_t)(routes + 3));
+            if (pico_ipv4_route_add(dest4[routes], mask4[routes], gateway, 1, NULL) == 0)
+                routes++;
+        }
+        ipv4_lookups(routes);
+        lpm = ipv4_time(BENCH_LOOKUPS, 0);
+        ipv4_walk(link, 1);
+        walk = ipv4_time(walk_lookups(routes), 1);
+        ipv4_walk(link, 0);
+        print_result(routes, lpm, walk, walk < 0);
+        fail |= (walk < 0);
+    }
+
+    /* Half of the routes removed */
+    for (i = 0; i < routes; i += 2)
+        fail |= pico_ipv4_route_del(dest4[i], mask4[i], 1);
+    ipv4_lookups(routes);
+    ipv4_time(BENCH_LOOKUPS, 0);
+    ipv4_walk(link, 1);
+    fail |= (ipv4_time(walk_lookups(routes / 2), 1) < 0);
+    ipv4_walk(link, 0);
+
+    for (i = 1; i < routes; i += 2)
+        fail |= pico_ipv4_route_del(dest4[i], mask4[i], 1);
+    return fail ? -1 : 0;
+}
+
+#ifdef PICO_SUPPORT_IPV6
+static struct pico_ip6 dest6[BENCH_MAX_ROUTES];
+static uint8_t len6[BENCH_MAX_ROUTES];
+static struct pico_ip6 lookup6[BENCH_LOOKUPS], gw6[BENCH_LOOKUPS];
+
+static void ipv6_mask(struct pico_ip6 *netmask, int len)
+{
+    int i;
+    memset(netmask, 0, sizeof(*netmask));
+    for (i = 0; i < len; i++)
+        netmask->addr[i >> 3] |= (uint8_t)(0x80 >> (i & 7));
+}
+
+/* In 2002::/16 */
+static void ipv6_random(struct pico_ip6 *a)
+{
+    int i;
+    a->addr[0] = 0x20;
+    a->addr[1] = 0x02;
+    for (i = 2; i < PICO_SIZE_IP6; i++)
+        a->addr[i] = (uint8_t)rnd();
+}
+
+static void ipv6_lookups(int routes)
+{
+    struct pico_ip6 netmask;
+    int i, j, r;
+    for (i = 0; i < BENCH_LOOKUPS; i++) {
+        ipv6_random(&lookup6[i]);
+        if (i & 1) {
+            r = (int)(rnd() % (uint32_t)routes);
+            ipv6_mask(&netmask, len6[r]);
+            for (j = 0; j < PICO_SIZE_IP6; j++)
+                lookup6[i].addr[j] = (uint8_t)(dest6[r].addr[j] | (lookup6[i].addr[j] & ~netmask.addr[j]));
+        }
+    }
+}
+
+static double ipv6_time(int n, int check)
+{
+    struct pico_ip6 gw;
+    double t0 = now();
+    int i, errors = 0;
+
+    for (i = 0; i < n; i++) {
+        gw = pico_ipv6_route_get_gateway(&lookup6[i]);
+        if (check)
+            errors += (memcmp(&gw, &gw6[i], sizeof(gw)) != 0);
+        else
+            gw6[i] = gw;
+    }
+    if (errors)
+        return -1.0;
+
+    return (now() - t0) / n;
+}
+
+static int ipv6_walk(struct pico_ipv6_link *link, int enable)
+{
+    struct pico_ip6 dest, netmask, gateway = {{0}};
+    int i;
+
+    for (i = 0; i < PICO_SIZE_IP6; i++) {
+        dest.addr[i] = 0xFF;
+        netmask.addr[i] = (uint8_t)((i & 1) ? 0 : 0xFF);
+    }
+    if (enable)
+        return pico_ipv6_route_add(dest, netmask, gateway, 1, link);
+
+    return pico_ipv6_route_del(dest, netmask, gateway, 1, link);
+}
+
+static int ipv6_bench(struct pico_device *dev)
+{
+    struct pico_ip6 address, netmask, gateway, any = {{0}};
+    struct pico_ipv6_link *link;
+    double lpm, walk;
+    int routes = 0, size, i, fail = 0;
+
+    pico_string_to_ipv6("2001:db8::1", address.addr);
+    ipv6_mask(&netmask, 64);
+    link = pico_ipv6_link_add_no_dad(dev, address, netmask);
+    if (!link)
+        return -1;
+
+    pico_string_to_ipv6("2001:db8::2", gateway.addr);
+    if (pico_ipv6_route_add(any, any, gateway, 1, link) < 0)
+        return -1;
+
+    printf("\nIPv6\n  routes  lpm (ns/lookup)  walk (ns/lookup)   speedup\n");
+    for (size = 0; size < BENCH_SIZES; size++) {
+        while (routes < bench_sizes[size]) {
+            len6[routes] = (uint8_t)(16 + rnd() % 113);
+            ipv6_random(&dest6[routes]);
+            ipv6_mask(&netmask, len6[routes]);
+            for (i = 0; i < PICO_SIZE_IP6; i++)
+                dest6[routes].addr[i] &= netmask.addr[i];
+            gateway.addr[13] = (uint8_t)((routes + 3) >> 16);
+            gateway.addr[14] = (uint8_t)((routes + 3) >> 8);
+            gateway.addr[15] = (uint8_t)(routes + 3);
+            if (pico_ipv6_route_add(dest6[routes], netmask, gateway, 1, link) == 0)
+                routes++;
+        }
+        ipv6_lookups(routes);
+        lpm = ipv6_time(BENCH_LOOKUPS, 0);
+        ipv6_walk(link, 1);
+        walk = ipv6_time(walk_lookups(routes), 1);
+        ipv6_walk(link, 0);
+        print_result(routes, lpm, walk, walk < 0);
+        fail |= (walk < 0);
+    }
+
+    for (i = 0; i < routes; i += 2) {
+        ipv6_mask(&netmask, len6[i]);
+        fail |= pico_ipv6_route_del(dest6[i], netmask, gateway, 1, link);
+    }
+    ipv6_lookups(routes);
+    ipv6_time(BENCH_LOOKUPS, 0);
+    ipv6_walk(link, 1);
+    fail |= (ipv6_time(walk_lookups(routes / 2), 1) < 0);
+    ipv6_walk(link, 0);
+
+    for (i = 1; i < routes; i += 2) {
+        ipv6_mask(&netmask, len6[i]);
+        fail |= pico_ipv6_route_del(dest6[i], netmask, gateway, 1, link);
+    }
+    return fail ? -1 : 0;
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    struct pico_device *dev;
+    uint32_t net = 0x7F000000; /* 127.0.0.0/8 */
+    int ret;
+
+    pico_stack_init();
+    if (argc > 1) {
+#ifdef PICO_SUPPORT_TAP
+        dev = pico_tap_create(argv[1]);
+        net = 0x0A000000; /* 10.0.0.0/8 */
+#else
+        fprintf(stderr, "%s: tap devices need a TAP=1 build\n", argv[0]);
+        return 2;
+#endif
+    } else {
+        dev = pico_loop_create();
+    }
+
+    if (!dev) {
+        fprintf(stderr, "%s: device creation failed\n", argv[0]);
+        return 2;
+    }
+
+    printf("Route lookups on %s\n", dev->name);
+    ret = ipv4_bench(dev, net);
+#ifdef PICO_SUPPORT_IPV6
+    if (ret == 0)
+        ret = ipv6_bench(dev);
+#endif
+    if (ret < 0) {
+        printf("Route lookup test FAILED\n");
+        return 1;
+    }
+
+    return 0;
+}
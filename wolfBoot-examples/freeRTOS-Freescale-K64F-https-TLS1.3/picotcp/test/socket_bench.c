@@ -0,0 +1,226 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   Socket demultiplexing benchmark: 16 to 16384 TCP connections are
+   established to the same server port on the loop device, and the cost of
+   delivering a segment of one of them to its socket is measured. The
+   segments are pure ACKs, which the established sockets ignore, injected in
+   the transport layer so that only the lookup of the socket and the TCP input
+   are timed.
+
+   Usage: socket_bench
+ *********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico_stack.h"
+#include "pico_ipv4.h"
+#include "pico_socket.h"
+#include "pico_tcp.h"
+#include "pico_dev_loop.h"
+
+#define BENCH_MAX_CONN 16384
+#define BENCH_SEGMENTS 20000
+#define BENCH_BATCH 1000
+#define BENCH_BACKLOG 64
+#define BENCH_PORT 5555
+
+static const int bench_sizes[] = {
+    16, 256, 4096, BENCH_MAX_CONN
+};
+#define BENCH_SIZES (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+static struct pico_socket *listener;
+static struct pico_socket *client[BENCH_MAX_CONN];
+static struct pico_socket *server_by_port[65536];
+static int accepted;
+
+static struct pico_frame *batch[BENCH_BATCH];
+
+static uint32_t rnd_state = 0x2545F491;
+
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_wakeup(uint16_t ev, struct pico_socket *s)
+{
+    struct pico_socket *child;
+    struct pico_ip4 orig;
+    uint16_t port;
+
+    if ((s != listener) || !(ev & PICO_SOCK_EV_CONN))
+        return;
+
+    while ((child = pico_socket_accept(s, &orig, &port)) != NULL) {
+        server_by_port[short_be(port)] = child;
+        accepted++;
+    }
+}
+
+static void bench_ticks(int n)
+{
+    while (n-- > 0)
+        pico_stack_tick();
+}
+
+static int bench_connect(int conns, struct pico_ip4 *server)
+{
+    int nodelay = 1, first = conns, tries;
+
+    while (conns < first + BENCH_BACKLOG / 2) {
+        client[conns] = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, bench_wakeup);
+        if (!client[conns])
+            return -1;
+
+        pico_socket_setoption(client[conns], PICO_TCP_NODELAY, &nodelay);
+        if (pico_socket_connect(client[conns], server, short_be(BENCH_PORT)) < 0)
+            return -1;
+
+        conns++;
+    }
+    for (tries = 0; (accepted < conns) && (tries < 1000); tries++) {
+        bench_ticks(1);
+        bench_wakeup(PICO_SOCK_EV_CONN, listener);
+    }
+    return (accepted == conns) ? conns : -1;
+}
+
+/* Pure ACK from the client, with a valid checksum */
+static struct pico_frame *bench_segment(struct pico_socket *c)
+{
+    struct pico_frame *f = pico_frame_alloc(20 + PICO_SIZE_TCPHDR);
+    struct pico_ipv4_hdr *ip;
+    struct pico_tcp_hdr *tcp;
+
+    if (!f)
+        return NULL;
+
+    memset(f->buffer, 0, f->buffer_len);
+    f->net_hdr = f->buffer;
+    f->net_len = 20;
+    f->transport_hdr = f->buffer + 20;
+    f->transport_len = (uint16_t)PICO_SIZE_TCPHDR;
+    f->len = f->buffer_len;
+    ip = (struct pico_ipv4_hdr *)f->net_hdr;
+    ip->vhl = 0x45;
+    ip->len = short_be((uint16_t)f->buffer_len);
+    ip->ttl = 64;
+    ip->proto = PICO_PROTO_TCP;
+    ip->src = c->local_addr.ip4;
+    ip->dst = c->remote_addr.ip4;
+    tcp = (struct pico_tcp_hdr *)f->transport_hdr;
+    tcp->trans.sport = c->local_port;
+    tcp->trans.dport = c->remote_port;
+    tcp->len = (uint8_t)(PICO_SIZE_TCPHDR << 2);
+    tcp->flags = PICO_TCP_ACK;
+    tcp->rwnd = short_be(0xFFFF);
+    tcp->crc = short_be(pico_tcp_checksum(f));
+    return f;
+}
+
+static double bench_deliver(int conns)
+{
+    double total = 0, t0;
+    int done, i, n;
+
+    for (done = 0; done < BENCH_SEGMENTS; done += BENCH_BATCH) {
+        for (n = 0; n < BENCH_BATCH; n++) {
+            batch[n] = bench_segment(client[rnd() % (uint32_t)conns]);
+            if (!batch[n])
+                return -1.0;
+        }
+        t0 = now();
+        for (i = 0; i < n; i++)
+            pico_transport_process_in(&pico_proto_tcp, batch[i]);
+        total += now() - t0;
+        bench_ticks(2);
+    }
+    return total / BENCH_SEGMENTS;
+}
+
+/* The segments still reach the right sockets */
+static int bench_check(int conns)
+{
+    struct pico_socket *server;
+    char c = 0;
+    int i, r, tries;
+
+    for (i = 0; i < 16; i++) {
+        r = (int)(rnd() % (uint32_t)conns);
+        server = server_by_port[short_be(client[r]->local_port)];
+        if (!server || (pico_socket_write(client[r], &c, 1) != 1))
+            return -1;
+
+        for (tries = 0; tries < 100; tries++) {
+            bench_ticks(1);
+            if (pico_socket_read(server, &c, 1) == 1)
+                break;
+        }
+        if (tries == 100)
+            return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    struct pico_device *dev;
+    struct pico_ip4 address, netmask, any = {
+        0
+    };
+    uint16_t port = short_be(BENCH_PORT);
+    double t;
+    int conns = 0, size;
+
+    pico_stack_init();
+    dev = pico_loop_create();
+    if (!dev) {
+        fprintf(stderr, "loop device creation failed\n");
+        return 2;
+    }
+
+    address.addr = long_be(0x7F000001); /* 127.0.0.1 */
+    netmask.addr = long_be(0xFF000000);
+    pico_ipv4_link_add(dev, address, netmask);
+
+    listener = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_TCP, bench_wakeup);
+    if (!listener || (pico_socket_bind(listener, &any, &port) < 0) ||
+        (pico_socket_listen(listener, BENCH_BACKLOG) < 0)) {
+        fprintf(stderr, "listen failed\n");
+        return 2;
+    }
+
+    printf("Segments to established connections of port %d\n  conns  deliver (ns/segment)\n", BENCH_PORT);
+    for (size = 0; size < BENCH_SIZES; size++) {
+        while (conns < bench_sizes[size]) {
+            conns = bench_connect(conns, &address);
+            if (conns < 0) {
+                printf("Connection setup FAILED\n");
+                return 1;
+            }
+        }
+        t = bench_deliver(conns);
+        if ((t < 0) || (bench_check(conns) < 0)) {
+            printf("Socket demultiplexing test FAILED\n");
+            return 1;
+        }
+
+        printf("%7d  %20.1f\n", conns, t * 1e9);
+    }
+
+    return 0;
+}
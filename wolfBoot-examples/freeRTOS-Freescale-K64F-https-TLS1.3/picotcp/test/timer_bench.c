@@ -0,0 +1,107 @@
+/*********************************************************************
+   PicoTCP. Copyright (c) 2012-2017 Altran Intelligent Systems. Some rights reserved.
+   See COPYING, LICENSE.GPLv2 and LICENSE.GPLv3 for usage.
+
+   Timer benchmark: with 100 to 100000 active timers, measures the cost of
+   pico_timer_add(), pico_timer_cancel() and of the expiration of a timer,
+   which should not depend on the number of timers.
+
+   Usage: timer_bench
+ *********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pico_stack.h"
+
+#define BENCH_MAX_TIMERS 100000
+#define BENCH_OPS 100000
+
+static const int bench_sizes[] = {
+    100, 1000, 10000, BENCH_MAX_TIMERS
+};
+#define BENCH_SIZES (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+static uint32_t active[BENCH_MAX_TIMERS];
+static uint32_t expired;
+
+static uint32_t rnd_state = 0x2545F491;
+
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_timer(pico_time t, void *arg)
+{
+    IGNORE_PARAMETER(t);
+    IGNORE_PARAMETER(arg);
+    expired++;
+}
+
+/* Between 1 and 2 hours: never expires during the test */
+static uint32_t bench_add(void)
+{
+    return pico_timer_add(3600000 + rnd() % 3600000, bench_timer, NULL);
+}
+
+int main(void)
+{
+    double t0, add, cancel, expire;
+    int timers = 0, size, i, r;
+
+    pico_stack_init();
+
+    printf("  timers  add (ns)  cancel (ns)  expire (ns)\n");
+    for (size = 0; size < BENCH_SIZES; size++) {
+        while (timers < bench_sizes[size]) {
+            active[timers] = bench_add();
+            if (!active[timers]) {
+                printf("pico_timer_add failed\n");
+                return 1;
+            }
+
+            timers++;
+        }
+
+        /* A random timer is cancelled and replaced: the count stays the same */
+        add = cancel = 0;
+        for (i = 0; i < BENCH_OPS; i++) {
+            r = (int)(rnd() % (uint32_t)timers);
+            t0 = now();
+            pico_timer_cancel(active[r]);
+            cancel += now() - t0;
+            t0 = now();
+            active[r] = bench_add();
+            add += now() - t0;
+        }
+
+        /* Timers that are already expired */
+        for (i = 0; i < BENCH_OPS; i++)
+            pico_timer_add(0, bench_timer, NULL);
+        expired = 0;
+        t0 = now();
+        pico_stack_tick();
+        expire = now() - t0;
+        if (expired != BENCH_OPS) {
+            printf("%u timers expired instead of %d\n", expired, BENCH_OPS);
+            return 1;
+        }
+
+        printf("%8d  %8.1f  %11.1f  %11.1f\n", timers, add * 1e9 / BENCH_OPS,
+               cancel * 1e9 / BENCH_OPS, expire * 1e9 / BENCH_OPS);
+    }
+
+    for (i = 0; i < timers; i++)
+        pico_timer_cancel(active[i]);
+    return 0;
+}
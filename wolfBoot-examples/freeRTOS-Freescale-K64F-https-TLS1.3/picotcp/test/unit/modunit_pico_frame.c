@@ -10,6 +10,63 @@ volatile pico_err_t pico_err;
 
 Suite *pico_suite(void);
 
+#define POOLS (2 + PICO_FRAME_POOL_CLASSES)
+static void *pool_stash[POOLS];
+
+static struct pico_frame_pool *test_pool(int i)
+{
+    if (i == 0)
+        return &Frame_pool;
+
+    if (i == 1)
+        return &Counter_pool;
+
+    return &Buffer_pools[i - 2];
+}
+
+/* Moves the free elements of the pools aside, so that the next allocations
+ * hit the heap (and pico_set_mm_failure())
+ */
+static void pools_stash(void)
+{
+    int i;
+    for (i = 0; i < POOLS; i++) {
+        struct pico_frame_pool *pool = test_pool(i);
+        void **e = pool->free;
+        if (!e)
+            continue;
+
+        while (*e)
+            e = *e;
+        *e = pool_stash[i];
+        pool_stash[i] = pool->free;
+        pool->free = NULL;
+    }
+}
+
+static void pools_unstash(void)
+{
+    int i;
+    for (i = 0; i < POOLS; i++) {
+        struct pico_frame_pool *pool = test_pool(i);
+        void **e = pool_stash[i];
+        if (!e)
+            continue;
+
+        while (*e)
+            e = *e;
+        *e = pool->free;
+        pool->free = pool_stash[i];
+        pool_stash[i] = NULL;
+    }
+}
+
+static uint8_t *notified;
+static void notify_free(uint8_t *buf)
+{
+    notified = buf;
+}
+
 START_TEST(tc_pico_frame_alloc_discard)
 {
     struct pico_frame *f = pico_frame_alloc(FRAME_SIZE);
@@ -28,20 +85,28 @@ START_TEST(tc_pico_frame_alloc_discard)
     pico_frame_discard(NULL);
 
 #ifdef PICO_FAULTY
-    printf("Testing with faulty memory in frame_alloc (1)\n");
+    printf("Testing with faulty memory in frame_alloc (1), frame from the heap\n");
+    pools_stash();
     pico_set_mm_failure(1);
     f = pico_frame_alloc(FRAME_SIZE);
-    fail_if(f);
+    fail_if(!f);
+    fail_if(f->pool != PICO_FRAME_POOL_BUFFER);
+    pico_frame_discard(f);
 
     printf("Testing with faulty memory in frame_alloc (2)\n");
+    pools_stash();
     pico_set_mm_failure(2);
     f = pico_frame_alloc(FRAME_SIZE);
     fail_if(f);
 
-    printf("Testing with faulty memory in frame_do_alloc, with external buffer, failing to allocate usage_count \n");
+    printf("Testing with faulty memory in frame_do_alloc, with external buffer, usage_count from the heap\n");
+    pools_stash();
     pico_set_mm_failure(2);
     f = pico_frame_do_alloc(FRAME_SIZE, 1, 1);
-    fail_if(f);
+    fail_if(!f);
+    fail_if(f->pool != PICO_FRAME_POOL_FRAME);
+    pico_frame_discard(f);
+    pools_unstash();
 #endif
     printf("Testing frame_do_alloc, with invalid flags combination\n");
     f = pico_frame_do_alloc(FRAME_SIZE, 0, 1);
@@ -105,8 +170,10 @@ START_TEST(tc_pico_frame_grow)
     f2->net_hdr[0] = 1;
     f2->net_hdr[1] = 2;
 
+    pools_stash();
     pico_set_mm_failure(1);
-    fail_if(pico_frame_grow(f, 21) == 0);
+    fail_if(pico_frame_grow(f, PICO_FRAME_POOL_MAX_SIZE) == 0);
+    pools_unstash();
 
     /* Now, the good one. */
     fail_if(pico_frame_grow(f, 21) != 0);
@@ -170,11 +237,16 @@ START_TEST(tc_pico_frame_copy)
 
 
 #ifdef PICO_FAULTY
-    printf("Testing with faulty memory in frame_copy (1)\n");
+    printf("Testing with faulty memory in frame_copy (1), frame from the heap\n");
+    pools_stash();
     pico_set_mm_failure(1);
     c3 = pico_frame_copy(f);
-    fail_if(c3);
+    fail_if(!c3);
     fail_if(!f);
+    fail_if(c3->pool != (f->pool & ~PICO_FRAME_POOL_FRAME));
+    fail_if(c3->buffer != f->buffer);
+    pico_frame_discard(c3);
+    pools_unstash();
 #endif
 
     /* Discard 1 */
@@ -199,14 +271,130 @@ START_TEST(tc_pico_frame_deepcopy)
     fail_if(dc->buffer == f->buffer);
 #ifdef PICO_FAULTY
     printf("Testing with faulty memory in frame_deepcopy (1)\n");
-    pico_set_mm_failure(1);
+    pools_stash();
+    pico_set_mm_failure(2);
     dc = pico_frame_deepcopy(f);
     fail_if(dc);
     fail_if(!f);
+    pools_unstash();
 #endif
 }
 END_TEST
 
+START_TEST(tc_pico_frame_pool)
+{
+    struct pico_frame *f, *frames[PICO_FRAME_SLAB_SIZE + 1];
+    uint8_t *buf;
+    uint32_t sizes[] = { 0, 128, 200, 512, 600, PICO_FRAME_POOL_MAX_SIZE };
+    int classes[] = { 0, 0, 1, 1, 2, 2 };
+    int i, j;
+
+    /* The freed frame and buffer are the first ones handed out again */
+    f = pico_frame_alloc(FRAME_SIZE);
+    fail_if(!f);
+    fail_if(f->pool != (PICO_FRAME_POOL_FRAME | PICO_FRAME_POOL_BUFFER));
+    buf = f->buffer;
+    memset(buf, 0xAA, FRAME_SIZE);
+    pico_frame_discard(f);
+    fail_if(pico_frame_alloc(FRAME_SIZE) != f);
+    fail_if(f->buffer != buf);
+    fail_if(*f->usage_count != 1);
+    fail_if(f->buffer[0] != 0 || f->buffer[FRAME_SIZE - 1] != 0);
+    pico_frame_discard(f);
+
+    /* The smallest size class that fits is used */
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        f = pico_frame_alloc(sizes[i]);
+        fail_if(!f);
+        fail_if(*((struct pico_frame_pool **)(void *)f->buffer - 1) != &Buffer_pools[classes[i]]);
+        fail_if((uint8_t *)f->usage_count != f->buffer + ((sizes[i] + 3) & ~3u));
+        pico_frame_discard(f);
+    }
+
+    /* Larger buffers come from the heap */
+    f = pico_frame_alloc(2 * PICO_FRAME_POOL_MAX_SIZE);
+    fail_if(!f);
+    fail_if(f->pool != PICO_FRAME_POOL_FRAME);
+    pico_frame_discard(f);
+
+    /* Slabs hold up to PICO_FRAME_SLAB_SIZE elements, and PICO_FRAME_SLAB_BYTES
+     * unless a single element is larger
+     */
+    for (i = 0; i < POOLS; i++) {
+        struct pico_frame_pool *pool = test_pool(i);
+        fail_if(pool->slab < 1 || pool->slab > PICO_FRAME_SLAB_SIZE);
+        fail_if(pool->slab > 1 && pool->slab * pool->size > PICO_FRAME_SLAB_BYTES);
+    }
+    fail_if(Buffer_pools[PICO_FRAME_POOL_CLASSES - 1].slab != 1);
+
+    /* A pool grows by one slab when empty */
+    for (i = 0; i < PICO_FRAME_SLAB_SIZE + 1; i++) {
+        frames[i] = pico_frame_alloc(FRAME_SIZE);
+        fail_if(!frames[i]);
+        for (j = 0; j < i; j++)
+            fail_if(frames[i] == frames[j] || frames[i]->buffer == frames[j]->buffer);
+    }
+    for (i = 0; i < PICO_FRAME_SLAB_SIZE + 1; i++)
+        pico_frame_discard(frames[i]);
+}
+END_TEST
+
+START_TEST(tc_pico_frame_set_ext_buffer)
+{
+    uint8_t ext[64 + 100];
+    struct pico_frame *f = pico_frame_alloc(20);
+    struct pico_frame *c, *dc;
+    int i;
+
+    fail_if(!f);
+    for (i = 0; i < 20; i++)
+        f->buffer[i] = (uint8_t)i;
+    f->net_hdr = f->buffer;
+    f->net_len = 20;
+    f->transport_hdr = f->buffer + 20;
+
+    /* First, the failing cases */
+    fail_if(pico_frame_set_ext_buffer(NULL, ext, 64, 100, notify_free) == 0);
+    fail_if(pico_frame_set_ext_buffer(f, NULL, 64, 100, notify_free) == 0);
+    fail_if(pico_frame_set_ext_buffer(f, ext, 19, 100, notify_free) == 0);
+    c = pico_frame_copy(f);
+    fail_if(pico_frame_set_ext_buffer(f, ext, 64, 100, notify_free) == 0);
+    pico_frame_discard(c);
+
+    /* The headers are moved right before the payload */
+    memset(ext, 0x55, sizeof(ext));
+    fail_if(pico_frame_set_ext_buffer(f, ext, 64, 100, notify_free) != 0);
+    fail_if(f->buffer != ext);
+    fail_if(f->buffer_len != 164);
+    fail_if(f->start != ext + 44);
+    fail_if(f->len != 120);
+    fail_if(f->net_hdr != ext + 44);
+    fail_if(f->transport_hdr != ext + 64);
+    for (i = 0; i < 20; i++)
+        fail_if(ext[44 + i] != (uint8_t)i);
+    fail_if(ext[64] != 0x55);
+    fail_if(!(f->flags & PICO_FRAME_FLAG_EXT_BUFFER));
+    fail_if(*f->usage_count != 1);
+    fail_if(pico_frame_set_ext_buffer(f, ext, 64, 100, notify_free) == 0);
+
+    /* A deep copy owns its buffer */
+    dc = pico_frame_deepcopy(f);
+    fail_if(!dc);
+    fail_if(dc->buffer == ext);
+    fail_if(dc->flags & PICO_FRAME_FLAG_EXT_BUFFER);
+    fail_if(dc->notify_free);
+    pico_frame_discard(dc);
+    fail_if(notified);
+
+    /* The application is notified when the last copy is gone */
+    c = pico_frame_copy(f);
+    pico_frame_discard(f);
+    fail_if(notified);
+    pico_frame_discard(c);
+    fail_if(notified != ext);
+}
+END_TEST
+
 START_TEST(tc_pico_is_digit)
 {
     fail_if(pico_is_digit('a'));
@@ -237,6 +425,86 @@ START_TEST(tc_pico_is_hex)
 }
 END_TEST
 
+/* The former pico_checksum(), 16-bit words one by one */
+static uint16_t checksum_16bit(uint8_t *data, uint32_t len)
+{
+    uint32_t sum = 0, i;
+
+    for (i = 0; i + 1 < len; i += 2)
+        sum += (uint32_t)(data[i] << 8) | data[i + 1];
+    if (len & 0x01)
+        sum += (uint32_t)data[len - 1] << 8;
+
+    while (sum >> 16)
+        sum = (sum & 0x0000FFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+START_TEST(tc_pico_checksum)
+{
+    uint8_t buf[1600 + 8];
+    uint32_t len, off, i, r = 0x2545F491;
+
+    for (i = 0; i < sizeof(buf); i++) {
+        r = r * 1103515245 + 12345;
+        buf[i] = (uint8_t)(r >> 16);
+    }
+    for (off = 0; off < 8; off++) {
+        for (len = 0; len <= 1600; len++) {
+            fail_if(pico_checksum(buf + off, len) != checksum_16bit(buf + off, len));
+        }
+    }
+
+    /* Two buffers, the first one of even length */
+    fail_if(pico_dualbuffer_checksum(buf, 20, buf + 20, 99) != pico_checksum(buf, 119));
+
+    /* Carries */
+    memset(buf, 0xFF, sizeof(buf));
+    for (off = 0; off < 8; off++) {
+        for (len = 0; len <= 1600; len += 7) {
+            fail_if(pico_checksum(buf + off, len) != checksum_16bit(buf + off, len));
+        }
+    }
+}
+END_TEST
+
+START_TEST(tc_pico_checksum_adjust)
+{
+    uint8_t hdr[20] = {
+        0x45, 0x00, 0x00, 0x40, 0x91, 0xc3, 0x40, 0x00,
+        0x40, 0x11, 0x00, 0x00, 0xc0, 0xa8, 0x01, 0x66,
+        0xc0, 0xa8, 0x01, 0x64
+    };
+    uint16_t crc, old16, new16;
+    uint32_t old32, new32, i;
+
+    crc = short_be(pico_checksum(hdr, 20));
+    memcpy(hdr + 10, &crc, 2);
+
+    for (i = 0; i < 300; i++) {
+        /* TTL */
+        memcpy(&old16, hdr + 8, 2);
+        hdr[8] = (uint8_t)(hdr[8] - 1);
+        memcpy(&new16, hdr + 8, 2);
+        crc = pico_checksum_adjust16(crc, old16, new16);
+        memcpy(hdr + 10, &crc, 2);
+        fail_if(pico_checksum(hdr, 20) != 0);
+
+        /* Source address */
+        memcpy(&old32, hdr + 12, 4);
+        new32 = old32 * 2654435761u + i;
+        if (i == 7)
+            new32 = 0;
+        if (i == 8)
+            new32 = 0xFFFFFFFF;
+        memcpy(hdr + 12, &new32, 4);
+        crc = pico_checksum_adjust32(crc, old32, new32);
+        memcpy(hdr + 10, &crc, 2);
+        fail_if(pico_checksum(hdr, 20) != 0);
+    }
+}
+END_TEST
+
 Suite *pico_suite(void)
 {
     Suite *s = suite_create("pico_frame.c");
@@ -245,20 +513,32 @@ Suite *pico_suite(void)
     TCase *TCase_pico_frame_grow = tcase_create("Unit test for pico_frame_grow");
     TCase *TCase_pico_frame_grow_head = tcase_create("Unit test for pico_frame_grow_head");
     TCase *TCase_pico_frame_deepcopy = tcase_create("Unit test for pico_frame_deepcopy");
+    TCase *TCase_pico_frame_pool = tcase_create("Unit test for the frame pools");
+    TCase *TCase_pico_frame_set_ext_buffer = tcase_create("Unit test for pico_frame_set_ext_buffer");
     TCase *TCase_pico_is_digit = tcase_create("Unit test for pico_is_digit");
     TCase *TCase_pico_is_hex = tcase_create("Unit test for pico_is_hex");
+    TCase *TCase_pico_checksum = tcase_create("Unit test for pico_checksum");
+    TCase *TCase_pico_checksum_adjust = tcase_create("Unit test for pico_checksum_adjust");
     tcase_add_test(TCase_pico_frame_alloc_discard, tc_pico_frame_alloc_discard);
     tcase_add_test(TCase_pico_frame_copy, tc_pico_frame_copy);
     tcase_add_test(TCase_pico_frame_grow, tc_pico_frame_grow);
     tcase_add_test(TCase_pico_frame_grow_head, tc_pico_frame_grow_head);
     tcase_add_test(TCase_pico_frame_deepcopy, tc_pico_frame_deepcopy);
+    tcase_add_test(TCase_pico_frame_pool, tc_pico_frame_pool);
+    tcase_add_test(TCase_pico_frame_set_ext_buffer, tc_pico_frame_set_ext_buffer);
     tcase_add_test(TCase_pico_is_digit, tc_pico_is_digit);
     tcase_add_test(TCase_pico_is_hex, tc_pico_is_hex);
+    tcase_add_test(TCase_pico_checksum, tc_pico_checksum);
+    tcase_add_test(TCase_pico_checksum_adjust, tc_pico_checksum_adjust);
     suite_add_tcase(s, TCase_pico_frame_alloc_discard);
     suite_add_tcase(s, TCase_pico_frame_copy);
     suite_add_tcase(s, TCase_pico_frame_grow);
     suite_add_tcase(s, TCase_pico_frame_grow_head);
     suite_add_tcase(s, TCase_pico_frame_deepcopy);
+    suite_add_tcase(s, TCase_pico_frame_pool);
+    suite_add_tcase(s, TCase_pico_frame_set_ext_buffer);
+    suite_add_tcase(s, TCase_pico_checksum);
+    suite_add_tcase(s, TCase_pico_checksum_adjust);
     return s;
 }
 
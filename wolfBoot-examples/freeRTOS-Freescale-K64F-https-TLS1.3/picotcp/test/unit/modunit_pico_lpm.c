@@ -0,0 +1,171 @@
+#include "pico_config.h"
+#include "pico_lpm.h"
+#include "stack/pico_lpm.c"
+#include "check.h"
+
+Suite *pico_suite(void);
+
+static PICO_LPM_DECLARE(lpm4, 4);
+static PICO_LPM_DECLARE(lpm6, 16);
+
+static char v[8];
+
+START_TEST(tc_lpm_prefix_len)
+{
+    uint8_t m[4] = {
+        0xFF, 0xFF, 0xF0, 0x00
+    };
+    uint8_t m6[16] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+    };
+
+    fail_if(pico_lpm_prefix_len(m, 4) != 20);
+    m[3] = 0x01;
+    fail_if(pico_lpm_prefix_len(m, 4) != -1);
+    m[3] = 0x00;
+    m[2] = 0xF1;
+    fail_if(pico_lpm_prefix_len(m, 4) != -1);
+    m[0] = m[1] = m[2] = 0;
+    fail_if(pico_lpm_prefix_len(m, 4) != 0);
+    fail_if(pico_lpm_prefix_len(m6, 16) != 128);
+    m6[8] = 0xFE;
+    fail_if(pico_lpm_prefix_len(m6, 16) != -1);
+}
+END_TEST
+
+START_TEST(tc_lpm_ipv4)
+{
+    uint8_t p0[4] = {
+        0, 0, 0, 0
+    };
+    uint8_t p8[4] = {
+        10, 0, 0, 0
+    };
+    uint8_t p16[4] = {
+        10, 1, 0, 0
+    };
+    uint8_t p24[4] = {
+        10, 1, 2, 0
+    };
+    uint8_t p24b[4] = {
+        10, 1, 3, 0
+    };
+    uint8_t p32[4] = {
+        10, 1, 2, 3
+    };
+    uint8_t k[4] = {
+        10, 1, 2, 0xFF
+    };
+
+    fail_if(pico_lpm_lookup(&lpm4, k) != NULL);
+    fail_if(pico_lpm_insert(&lpm4, p0, 33, &v[0]) == 0);
+    fail_if(pico_lpm_insert(&lpm4, p24, 24, NULL) == 0);
+
+    /* Longer prefix first: a glue node is needed between p24 and p24b */
+    fail_if(pico_lpm_insert(&lpm4, p24, 24, &v[3]) != 0);
+    fail_if(pico_lpm_insert(&lpm4, p24b, 24, &v[4]) != 0);
+    fail_if(pico_lpm_insert(&lpm4, p8, 8, &v[1]) != 0);
+    fail_if(pico_lpm_insert(&lpm4, p32, 32, &v[5]) != 0);
+    fail_if(pico_lpm_insert(&lpm4, p0, 0, &v[0]) != 0);
+
+    fail_if(pico_lpm_lookup(&lpm4, k) != &v[3]);
+    fail_if(pico_lpm_lookup(&lpm4, p32) != &v[5]);
+    k[2] = 3;
+    fail_if(pico_lpm_lookup(&lpm4, k) != &v[4]);
+    k[2] = 4;
+    fail_if(pico_lpm_lookup(&lpm4, k) != &v[1]);
+    k[0] = 11;
+    fail_if(pico_lpm_lookup(&lpm4, k) != &v[0]);
+
+    /* Exact match: the glue node 10.1.2.0/23 has no value */
+    fail_if(pico_lpm_find(&lpm4, p24, 23) != NULL);
+    fail_if(pico_lpm_find(&lpm4, p24, 24) != &v[3]);
+    fail_if(pico_lpm_find(&lpm4, p16, 16) != NULL);
+    fail_if(pico_lpm_delete(&lpm4, p16, 16) != NULL);
+
+    /* Bits past the prefix length are ignored */
+    fail_if(pico_lpm_insert(&lpm4, p32, 16, &v[2]) != 0);
+    fail_if(pico_lpm_find(&lpm4, p16, 16) != &v[2]);
+    fail_if(pico_lpm_insert(&lpm4, p16, 16, &v[6]) != 0);
+    fail_if(pico_lpm_find(&lpm4, p32, 16) != &v[6]);
+    k[0] = 10;
+    fail_if(pico_lpm_lookup(&lpm4, k) != &v[6]);
+
+    fail_if(pico_lpm_delete(&lpm4, p24b, 24) != &v[4]);
+    k[2] = 3;
+    fail_if(pico_lpm_lookup(&lpm4, k) != &v[6]);
+    fail_if(pico_lpm_delete(&lpm4, p24, 24) != &v[3]);
+    fail_if(pico_lpm_delete(&lpm4, p24, 24) != NULL);
+    fail_if(pico_lpm_lookup(&lpm4, p24) != &v[6]);
+    fail_if(pico_lpm_lookup(&lpm4, p32) != &v[5]);
+    fail_if(pico_lpm_delete(&lpm4, p16, 16) != &v[6]);
+    fail_if(pico_lpm_delete(&lpm4, p8, 8) != &v[1]);
+    fail_if(pico_lpm_lookup(&lpm4, p24) != &v[0]);
+    fail_if(pico_lpm_delete(&lpm4, p0, 0) != &v[0]);
+    fail_if(pico_lpm_delete(&lpm4, p32, 32) != &v[5]);
+    fail_if(lpm4.root != NULL);
+}
+END_TEST
+
+START_TEST(tc_lpm_ipv6)
+{
+    uint8_t p[16] = {
+        0x20, 0x01, 0x0d, 0xb8
+    };
+    uint8_t k[16] = {
+        0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1
+    };
+
+    fail_if(pico_lpm_insert(&lpm6, p, 32, &v[0]) != 0);
+    fail_if(pico_lpm_insert(&lpm6, k, 128, &v[1]) != 0);
+    fail_if(pico_lpm_insert(&lpm6, k, 127, &v[2]) != 0);
+    fail_if(pico_lpm_lookup(&lpm6, k) != &v[1]);
+    k[15] = 0;
+    fail_if(pico_lpm_lookup(&lpm6, k) != &v[2]);
+    k[15] = 2;
+    fail_if(pico_lpm_lookup(&lpm6, k) != &v[0]);
+    k[3] = 0xb9;
+    fail_if(pico_lpm_lookup(&lpm6, k) != NULL);
+
+    /* A node with two children becomes a glue node */
+    p[4] = 0x80;
+    fail_if(pico_lpm_insert(&lpm6, p, 33, &v[3]) != 0);
+    fail_if(pico_lpm_delete(&lpm6, p, 32) != &v[0]);
+    fail_if(pico_lpm_find(&lpm6, p, 33) != &v[3]);
+    k[3] = 0xb8;
+    k[15] = 1;
+    fail_if(pico_lpm_lookup(&lpm6, k) != &v[1]);
+    fail_if(pico_lpm_delete(&lpm6, k, 128) != &v[1]);
+    fail_if(pico_lpm_delete(&lpm6, k, 127) != &v[2]);
+    fail_if(pico_lpm_delete(&lpm6, p, 33) != &v[3]);
+    fail_if(lpm6.root != NULL);
+}
+END_TEST
+
+Suite *pico_suite(void)
+{
+    Suite *s = suite_create("Longest prefix match");
+
+    TCase *TCase_lpm_prefix_len = tcase_create("Unit test for pico_lpm_prefix_len");
+    TCase *TCase_lpm_ipv4 = tcase_create("Unit test for pico_lpm with IPv4 keys");
+    TCase *TCase_lpm_ipv6 = tcase_create("Unit test for pico_lpm with IPv6 keys");
+
+    tcase_add_test(TCase_lpm_prefix_len, tc_lpm_prefix_len);
+    suite_add_tcase(s, TCase_lpm_prefix_len);
+    tcase_add_test(TCase_lpm_ipv4, tc_lpm_ipv4);
+    suite_add_tcase(s, TCase_lpm_ipv4);
+    tcase_add_test(TCase_lpm_ipv6, tc_lpm_ipv6);
+    suite_add_tcase(s, TCase_lpm_ipv6);
+    return s;
+}
+
+int main(void)
+{
+    int fails;
+    Suite *s = pico_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    fails = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return fails;
+}
@@ -14,7 +14,6 @@
 #include "pico_udp.h"
 #include "pico_tcp.h"
 #include "pico_socket.h"
-#include "heap.h"
 #include "stack/pico_stack.c"
 #include "check.h"
 
@@ -75,16 +74,86 @@ void fake_timer(pico_time __attribute__((unused)) now, void __attribute__((unuse
 }
 #endif
 
+static int timer_log[8];
+static int timer_log_n;
+
+static void log_timer(pico_time now, void *arg)
+{
+    IGNORE_PARAMETER(now);
+    timer_log[timer_log_n++] = *(int *)arg;
+}
+
+static int timer_heap_ok(void)
+{
+    uint32_t i;
+    for (i = 2; i <= Timers.n; i++) {
+        if (Timers.heap[i >> 1]->expire > Timers.heap[i]->expire)
+            return 0;
+
+        if (Timers.heap[i]->heap_idx != i)
+            return 0;
+    }
+    return 1;
+}
+
+START_TEST(tc_pico_timers)
+{
+    static int v[6] = {
+        0, 1, 2, 3, 4, 5
+    };
+    uint32_t id[6];
+    int i;
+
+    pico_stack_init();
+    timer_log_n = 0;
+    id[0] = pico_timer_add(30, log_timer, &v[0]);
+    id[1] = pico_timer_add(10, log_timer, &v[1]);
+    id[2] = pico_timer_add_hashed(20, log_timer, &v[2], 0x1234);
+    id[3] = pico_timer_add_hashed(0, log_timer, &v[3], 0x1234);
+    id[4] = pico_timer_add(0, log_timer, &v[4]);
+    id[5] = pico_timer_add_hashed(5, log_timer, &v[5], 0x5678);
+    for (i = 0; i < 6; i++)
+        fail_if(id[i] == 0);
+    fail_unless(timer_heap_ok());
+
+    pico_timer_cancel(id[1]);
+    pico_timer_cancel(id[1]);
+    pico_timer_cancel_hashed(0x1234);
+    fail_if(pico_timer_find(id[1]) != NULL);
+    fail_if(pico_timer_find(id[2]) != NULL);
+    fail_if(pico_timer_find(id[3]) != NULL);
+    fail_if(pico_timer_find(id[5]) == NULL);
+    fail_unless(timer_heap_ok());
+
+    for (i = 0; (i < 200) && (timer_log_n < 3); i++) {
+        usleep(1000);
+        pico_check_timers();
+    }
+    fail_if(timer_log_n != 3);
+    fail_if(timer_log[0] != 4);
+    fail_if(timer_log[1] != 5);
+    fail_if(timer_log[2] != 0);
+
+    /* Expired: the ids are not valid anymore */
+    fail_if(pico_timer_find(id[0]) != NULL);
+    pico_timer_cancel(id[0]);
+    fail_unless(timer_heap_ok());
+}
+END_TEST
+
 START_TEST(tc_stack_generic)
 {
 #ifdef PICO_FAULTY
-    printf("Testing with faulty memory in pico_stack_init (11)\n");
-    pico_set_mm_failure(13);
+    printf("Testing with faulty memory in pico_stack_init (3)\n");
+    pico_set_mm_failure(3);
     fail_if(pico_stack_init() != -1);
 #endif
     pico_stack_init();
 #ifdef PICO_FAULTY
     printf("Testing with faulty memory in pico_timer_add (1)\n");
+    /* Only allocates when the pool is empty */
+    while (Timers.free)
+        fail_if(pico_timer_add(1000, fake_timer, NULL) == 0);
     pico_set_mm_failure(1);
     fail_if(pico_timer_add(0, fake_timer, NULL) != 0);
 #endif
@@ -107,6 +176,7 @@ Suite *pico_suite(void)
     TCase *TCase_pico_ethsend_bcast = tcase_create("Unit test for pico_ethsend_bcast");
     TCase *TCase_pico_ethsend_dispatch = tcase_create("Unit test for pico_ethsend_dispatch");
     TCase *TCase_calc_score = tcase_create("Unit test for calc_score");
+    TCase *TCase_pico_timers = tcase_create("Unit test for pico_timer_add and pico_timer_cancel");
     TCase *TCase_stack_generic = tcase_create("GENERIC stack initialization unit test");
 
 
@@ -128,6 +198,8 @@ Suite *pico_suite(void)
     suite_add_tcase(s, TCase_pico_ethsend_dispatch);
     tcase_add_test(TCase_calc_score, tc_calc_score);
     suite_add_tcase(s, TCase_calc_score);
+    tcase_add_test(TCase_pico_timers, tc_pico_timers);
+    suite_add_tcase(s, TCase_pico_timers);
     tcase_add_test(TCase_stack_generic, tc_stack_generic);
     suite_add_tcase(s, TCase_stack_generic);
     return s;
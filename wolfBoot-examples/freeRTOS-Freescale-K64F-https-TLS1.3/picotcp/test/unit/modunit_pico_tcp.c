@@ -60,17 +60,15 @@ START_TEST(tc_tcp_input_segment)
     fail_if(seg->seq != 0xdeadbeef);
     fail_if(seg->payload_len != f->payload_len);
     fail_if(memcmp(seg->payload, f->payload, f->payload_len) != 0);
+    /* The payload is in the same allocation */
+    fail_if(seg->payload != (unsigned char *)(seg + 1));
+    PICO_FREE(seg);
 
 #ifdef PICO_FAULTY
     printf("Testing with faulty memory in segment_from_frame (1)\n");
     pico_set_mm_failure(1);
     seg = segment_from_frame(f);
     fail_if(seg);
-
-    printf("Testing with faulty memory in segment_from_frame (2)\n");
-    pico_set_mm_failure(2);
-    seg = segment_from_frame(f);
-    fail_if(seg);
 #endif
     printf("Testing segment_from_frame with empty payload\n");
     f->payload_len = 0;
@@ -141,10 +139,6 @@ START_TEST(tc_tcp_discard_all_segments)
     pico_set_mm_failure(1);
     is = segment_from_frame(f);
     fail_if(is);
-    printf("Testing input segment conversion with faulty mm(2)\n");
-    pico_set_mm_failure(2);
-    is = segment_from_frame(f);
-    fail_if(is);
 #endif
 
     /* Discard all segments */
@@ -197,6 +197,74 @@ START_TEST (test_nat_translation)
 }
 END_TEST
 
+START_TEST (test_nat_checksum)
+{
+    struct pico_ipv4_link link = {
+        .address = {.addr = long_be(0x0a320001)}
+    };                                                                       /* 10.50.0.1 */
+    struct pico_frame *f = pico_ipv4_alloc(&pico_proto_ipv4, NULL, PICO_UDPHDR_SIZE + 4);
+    struct pico_ipv4_hdr *net = (struct pico_ipv4_hdr *)f->net_hdr;
+    struct pico_udp_hdr *udp = (struct pico_udp_hdr *)f->transport_hdr;
+    const char *raw_data = "ello";
+    uint16_t crc;
+
+    net->vhl = 0x45; /* version = 4, hdr len = 5 (32-bit words) */
+    net->tos = 0;
+    net->len = short_be(32); /* hdr + data (bytes) */
+    net->id = short_be(0x91c0);
+    net->frag = short_be(0x4000); /* don't fragment flag, offset = 0 */
+    net->ttl = 64;
+    net->proto = 17; /* UDP */
+    net->src.addr = long_be(0x0a280008); /* 10.40.0.8 */
+    net->dst.addr = long_be(0x0a320009); /* 10.50.0.9 */
+
+    udp->trans.sport = short_be(5555);
+    udp->trans.dport = short_be(6667);
+    udp->len = short_be(12);
+    memcpy(f->transport_hdr + PICO_UDPHDR_SIZE, raw_data, 4);
+
+    net->crc = 0;
+    net->crc = short_be(pico_checksum(net, f->net_len));
+    udp->crc = 0;
+    udp->crc = short_be(pico_udp_checksum_ipv4(f));
+
+    printf(">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>> NAT CHECKSUM TEST\n");
+    pico_stack_init();
+    fail_if(pico_ipv4_nat_enable(&link));
+
+    /* The updated checksums are the ones of the translated frame */
+    fail_if(pico_ipv4_nat_outbound(f, &nat_link->address));
+    fail_if(pico_checksum(net, f->net_len) != 0, "IP checksum not updated");
+    crc = udp->crc;
+    udp->crc = 0;
+    fail_if(crc != short_be(pico_udp_checksum_ipv4(f)), "UDP checksum not updated");
+    udp->crc = crc;
+
+    /* And back */
+    net->src.addr = long_be(0x0a320009);
+    net->dst = link.address;
+    net->crc = 0;
+    net->crc = short_be(pico_checksum(net, f->net_len));
+    udp->trans.dport = udp->trans.sport;
+    udp->trans.sport = short_be(6667);
+    udp->crc = 0;
+    udp->crc = short_be(pico_udp_checksum_ipv4(f));
+    fail_if(pico_ipv4_nat_inbound(f, &nat_link->address));
+    fail_if(net->dst.addr != long_be(0x0a280008), "destination address not translated correctly");
+    fail_if(pico_checksum(net, f->net_len) != 0, "IP checksum not updated");
+    crc = udp->crc;
+    udp->crc = 0;
+    fail_if(crc != short_be(pico_udp_checksum_ipv4(f)), "UDP checksum not updated");
+
+    /* No UDP checksum stays so */
+    fail_if(pico_ipv4_nat_outbound(f, &nat_link->address));
+    fail_if(udp->crc != 0, "UDP checksum added");
+    pico_ipv4_nat_table_cleanup(pico_tick, NULL);
+
+    fail_if(pico_ipv4_nat_disable());
+}
+END_TEST
+
 START_TEST (test_nat_port_forwarding)
 {
     struct pico_ipv4_link link = {
@@ -307,7 +375,7 @@ START_TEST (test_ipfilter)
     ret = pico_ipv4_filter_del(filter_id1);
     fail_if(ret != -1, "Deleting non existing filter failed\n");
 
-    f = (struct pico_frame *)PICO_ZALLOC(200);
+    f = (struct pico_frame *)PICO_ZALLOC(sizeof(struct pico_frame));
     f->buffer = PICO_ZALLOC(20);
     f->usage_count = PICO_ZALLOC(sizeof(uint32_t));
     f->buffer = ipv4_buf;
@@ -339,7 +407,7 @@ START_TEST (test_ipfilter)
     filter_id1 = pico_ipv4_filter_add(dev, proto, &src_addr, &saddr_netmask, &dst_addr, &daddr_netmask, sport, dport, priority, tos, FILTER_DROP);
     fail_if(filter_id1 <= 0, "Error adding masked filter\n");
 
-    f = (struct pico_frame *)PICO_ZALLOC(200);
+    f = (struct pico_frame *)PICO_ZALLOC(sizeof(struct pico_frame));
     f->buffer = PICO_ZALLOC(20);
     f->usage_count = PICO_ZALLOC(sizeof(uint32_t));
     f->buffer = ipv4_buf;
@@ -359,7 +427,7 @@ START_TEST (test_ipfilter)
     filter_id1 = pico_ipv4_filter_add(dev, proto, &src_addr, &saddr_netmask, &dst_addr, &daddr_netmask, sport, dport, priority, tos, FILTER_DROP);
     fail_if(filter_id1 <= 0, "Error adding bad filter\n");
 
-    f = (struct pico_frame *)PICO_ZALLOC(200);
+    f = (struct pico_frame *)PICO_ZALLOC(sizeof(struct pico_frame));
     f->buffer = PICO_ZALLOC(20);
     f->usage_count = PICO_ZALLOC(sizeof(uint32_t));
     f->buffer = ipv4_buf;
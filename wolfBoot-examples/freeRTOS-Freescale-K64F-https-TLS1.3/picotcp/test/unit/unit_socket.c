@@ -412,6 +412,91 @@ START_TEST (test_socket)
 }
 END_TEST
 
+static struct pico_frame *flow_frame(struct pico_ip4 *src, uint16_t sport, struct pico_ip4 *dst, uint16_t dport)
+{
+    struct pico_frame *f = pico_frame_alloc(PICO_SIZE_IP4HDR + PICO_UDPHDR_SIZE);
+    struct pico_ipv4_hdr *hdr;
+    struct pico_udp_hdr *udp;
+
+    fail_if(f == NULL, "socket> frame alloc failed");
+    memset(f->buffer, 0, f->buffer_len);
+    f->net_hdr = f->buffer;
+    f->net_len = PICO_SIZE_IP4HDR;
+    f->transport_hdr = f->buffer + PICO_SIZE_IP4HDR;
+    f->transport_len = PICO_UDPHDR_SIZE;
+    hdr = (struct pico_ipv4_hdr *)f->net_hdr;
+    hdr->vhl = 0x45;
+    hdr->proto = PICO_PROTO_UDP;
+    hdr->src = *src;
+    hdr->dst = *dst;
+    udp = (struct pico_udp_hdr *)f->transport_hdr;
+    udp->trans.sport = sport;
+    udp->trans.dport = dport;
+    return f;
+}
+
+START_TEST (test_socket_flows)
+{
+    struct pico_socket *sk[200], *found;
+    struct pico_device *dev;
+    struct pico_ip4 inaddr_link, netmask, remote;
+    struct pico_frame *f;
+    uint16_t port_be = short_be(7777);
+    int i, ret;
+
+    pico_stack_init();
+    printf("START SOCKET FLOWS TEST\n");
+
+    pico_string_to_ipv4("10.50.0.2", &inaddr_link.addr);
+    dev = pico_null_create("flows");
+    netmask.addr = long_be(0xFFFF0000);
+    ret = pico_ipv4_link_add(dev, inaddr_link, netmask);
+    fail_if(ret < 0, "socket> error adding link");
+
+    /* Enough connected sockets for the table to grow a few times */
+    for (i = 0; i < 200; i++) {
+        sk[i] = pico_socket_open(PICO_PROTO_IPV4, PICO_PROTO_UDP, NULL);
+        fail_if(sk[i] == NULL, "socket> udp socket open failed");
+        remote.addr = long_be(0x0A320100 + (uint32_t)i); /* 10.50.1.x */
+        ret = pico_socket_connect(sk[i], &remote, port_be);
+        fail_if(ret < 0, "socket> udp socket connect failed");
+    }
+    fail_if(Flows.count != 200, "socket> connected sockets not in the flow table");
+
+    for (i = 0; i < 200; i++) {
+        remote.addr = long_be(0x0A320100 + (uint32_t)i);
+        f = flow_frame(&remote, port_be, &inaddr_link, sk[i]->local_port);
+        found = pico_socket_flow_find(PICO_PROTO_UDP, f);
+        fail_if(found != sk[i], "socket> flow of socket %d not found", i);
+        /* Another remote port is not the same flow */
+        ((struct pico_trans *)f->transport_hdr)->sport = short_be(7778);
+        found = pico_socket_flow_find(PICO_PROTO_UDP, f);
+        fail_if(found != NULL, "socket> wrong flow found for socket %d", i);
+        pico_frame_discard(f);
+    }
+
+    /* Connecting again moves the flow */
+    remote.addr = long_be(0x0A320200);
+    ret = pico_socket_connect(sk[0], &remote, port_be);
+    fail_if(ret < 0, "socket> udp socket connect failed");
+    fail_if(Flows.count != 200, "socket> flow of reconnected socket duplicated");
+    f = flow_frame(&remote, port_be, &inaddr_link, sk[0]->local_port);
+    fail_if(pico_socket_flow_find(PICO_PROTO_UDP, f) != sk[0], "socket> reconnected flow not found");
+    pico_frame_discard(f);
+    remote.addr = long_be(0x0A320100);
+    f = flow_frame(&remote, port_be, &inaddr_link, sk[0]->local_port);
+    fail_if(pico_socket_flow_find(PICO_PROTO_UDP, f) != NULL, "socket> old flow still found");
+    pico_frame_discard(f);
+
+    for (i = 0; i < 200; i++) {
+        ret = pico_socket_close(sk[i]);
+        fail_if(ret < 0, "socket> udp socket close failed");
+    }
+    fail_if(Flows.count != 0, "socket> closed sockets left in the flow table");
+    fail_if(Flows.buckets != NULL, "socket> empty flow table not freed");
+}
+END_TEST
+
 #ifdef PICO_SUPPORT_CRC_FAULTY_UNIT_TEST
 START_TEST (test_crc_check)
 {
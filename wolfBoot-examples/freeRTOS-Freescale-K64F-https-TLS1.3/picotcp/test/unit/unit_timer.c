@@ -1,12 +1,11 @@
-#define EXISTING_TIMERS 9
-
-
 START_TEST (test_timers)
 {
     uint32_t T[128];
     int i;
-    struct pico_timer_ref *tref;
+    uint32_t existing;
+    struct pico_timer *t;
     pico_stack_init();
+    existing = Timers.n;
     for (i = 0; i < 128; i++) {
         pico_time expire = (pico_time)(999999 + i);
         void (*timer)(pico_time, void *) =(void (*)(pico_time, void *))0xff00 + i;
@@ -15,22 +14,24 @@ START_TEST (test_timers)
         T[i] = pico_timer_add(expire, timer, arg);
         printf("New timer %u\n", T[i]);
     }
+    fail_if(Timers.n != existing + 128);
     for (i = 0; i < 128; i++) {
         void (*timer)(pico_time, void *) =(void (*)(pico_time, void *))0xff00 + i;
         void *arg = ((void*)0xaa00 + i);
 
-        fail_if((uint32_t)(i + 1) > Timers->n);
-        tref = heap_get_element(Timers, (uint32_t)i + EXISTING_TIMERS);
-        fail_unless(tref->id == T[i]);
-        fail_unless(tref->tmr->timer == timer);
-        fail_unless(tref->tmr->arg == arg);
+        t = pico_timer_find(T[i]);
+        fail_if(t == NULL);
+        fail_unless(t->id == T[i]);
+        fail_unless(t->timer == timer);
+        fail_unless(t->arg == arg);
+        fail_unless(Timers.heap[t->heap_idx] == t);
     }
     for (i = 127; i >= 0; i--) {
         printf("Deleting timer %d \n", i );
         pico_timer_cancel(T[i]);
         printf("Deleted timer %d \n", i );
-        tref = heap_get_element(Timers, (uint32_t)i + EXISTING_TIMERS);
-        fail_unless(tref->tmr == NULL);
+        fail_unless(pico_timer_find(T[i]) == NULL);
+        fail_unless(Timers.n == existing + (uint32_t)i);
     }
     pico_stack_tick();
     pico_stack_tick();
@@ -36,6 +36,7 @@
 #include "pico_nat.c"
 #include "pico_ipfilter.c"
 #include "pico_tree.c"
+#include "pico_lpm.c"
 #include "pico_slaacv4.c"
 #include "pico_hotplug_detection.c"
 #ifdef PICO_SUPPORT_MCAST
@@ -169,11 +170,13 @@ Suite *pico_suite(void)
     suite_add_tcase(s, rb2);
 
     tcase_add_test(socket, test_socket);
+    tcase_add_test(socket, test_socket_flows);
     suite_add_tcase(s, socket);
 
     tcase_add_test(nat, test_nat_enable_disable);
     tcase_add_test(nat, test_nat_translation);
     tcase_add_test(nat, test_nat_port_forwarding);
+    tcase_add_test(nat, test_nat_checksum);
     tcase_set_timeout(nat, 30);
     suite_add_tcase(s, nat);
 
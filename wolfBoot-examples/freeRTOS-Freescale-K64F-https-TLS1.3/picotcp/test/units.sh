@@ -20,6 +20,7 @@ ASAN_OPTIONS="detect_leaks=0" ./build/test/modunit_mdns.elf || exit 1
 ASAN_OPTIONS="detect_leaks=0" ./build/test/modunit_dns_sd.elf || exit 1
 ASAN_OPTIONS="detect_leaks=0" ./build/test/modunit_ipfilter.elf || exit 1
 ASAN_OPTIONS="detect_leaks=0" ./build/test/modunit_queue.elf || exit 1
+ASAN_OPTIONS="detect_leaks=0" ./build/test/modunit_lpm.elf || exit 1
 ASAN_OPTIONS="detect_leaks=0" ./build/test/modunit_tftp.elf || exit 1
 ASAN_OPTIONS="detect_leaks=0" ./build/test/modunit_aodv.elf || exit 1
 ASAN_OPTIONS="detect_leaks=0" ./build/test/modunit_dev_ppp.elf || exit 1
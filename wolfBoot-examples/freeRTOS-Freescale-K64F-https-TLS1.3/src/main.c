@@ -161,50 +161,40 @@ uint8_t fw_buffer[2048];
 
 static void parse_update(WOLFSSL *ssl, char *inbuf, size_t size)
 {
-    uint32_t fw_off = 0;
-    uint32_t buf_off = 0;
-    uint32_t fw_siz = 0;
     int i = 0;
     int res;
     while (i < size) {
         if (strncmp(&inbuf[i], "\r\n\r\nWOLF", 8) == 0) {
             i+=4;
-            fw_siz = inbuf[i + 4] + ((inbuf[i + 5]) << 8) + ((inbuf[i + 6]) << 16) + ((inbuf[i + 7]) << 24);
-
             break;
         }
         i++;
     }
-    if ((fw_siz > WOLFBOOT_PARTITION_SIZE) || (fw_siz < WOLFBOOT_SECTOR_SIZE))
+    if ((i >= size) || (wolfBoot_update_open() < 0))
         goto internal_error;
-    fw_siz += 0x100;
 
-    if (i < size) {
-        memcpy(fw_buffer, &inbuf[i], (size - i));
-        buf_off = size - i;
-    }
-    hal_flash_unlock();
-    while(fw_off < fw_siz) {
-        res = wolfSSL_read(ssl, fw_buffer + buf_off, 2048 - buf_off);
+    /* The image is checked and programmed by libwolfboot while it is
+     * received. The flash is polled when no data is pending, so that the
+     * next segments are received while the previous ones are programmed.
+     */
+    if (wolfBoot_update_write((uint8_t *)&inbuf[i], size - i) < 0)
+        goto internal_error;
+    while (wolfBoot_update_remaining() > 0) {
+        res = wolfSSL_read(ssl, fw_buffer, sizeof(fw_buffer));
         if (res > 0) {
-            buf_off += res;
-            if ((buf_off == 2048) || (fw_siz - fw_off <= buf_off)) {
-                if ((fw_off % WOLFBOOT_SECTOR_SIZE) == 0)
-                    hal_flash_erase(WOLFBOOT_PARTITION_UPDATE_ADDRESS + fw_off, WOLFBOOT_SECTOR_SIZE);
-                if (fw_off + buf_off > fw_siz) {
-                    buf_off = fw_siz - fw_off;
-                    memset(fw_buffer + buf_off, 0xFF, 2048 - buf_off);
-                }
-                hal_flash_write(WOLFBOOT_PARTITION_UPDATE_ADDRESS + fw_off, fw_buffer, 2048);
-                fw_off += buf_off;
-                buf_off = 0;
-            }
+            if (wolfBoot_update_write(fw_buffer, res) < 0)
+                goto internal_error;
+            continue;
         }
-        xSemaphoreTake(picotcp_rx_data, pdMS_TO_TICKS(100));
+        res = wolfBoot_update_poll();
+        if (res < 0)
+            goto internal_error;
+        if (res == 0)
+            xSemaphoreTake(picotcp_rx_data, pdMS_TO_TICKS(100));
     }
-    if (fw_off == fw_siz) {
+    /* Verifies the signature, then triggers the update */
+    if (wolfBoot_update_finalize() == 0) {
         wolfSSL_write(ssl, http_html_transfer_complete, strlen(http_html_transfer_complete));
-        wolfBoot_update_trigger();
         
         /* Wait one second, reboot */
         vTaskDelay(pdMS_TO_TICKS(1000));
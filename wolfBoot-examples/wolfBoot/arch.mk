@@ -110,6 +110,12 @@ ifeq ($(ARCH),ARM)
         CFLAGS+=-DWOLFSSL_SP_ASM -DWOLFSSL_SP_ARM_CORTEX_M_ASM
         MATH_OBJS += ./lib/wolfssl/wolfcrypt/src/sp_cortexm.o
       endif
+      # Thumb-2 SHA-256 and ChaCha20, unless THUMB2_ASM=0 (unused objects are
+      # garbage-collected)
+      ifneq ($(THUMB2_ASM),0)
+        CFLAGS+=-DWOLFBOOT_THUMB2_ASM
+        OBJS+=src/sha256_thumb2.o src/chacha_thumb2.o
+      endif
     endif
   endif
 endif
@@ -130,6 +136,28 @@ ifeq ($(ARCH),RISCV)
   ARCH_FLASH_OFFSET=0x20010000
 endif
 
+## Host simulator
+ifeq ($(ARCH),sim)
+  CROSS_COMPILE:=
+  CFLAGS+=-DARCH_SIM -g -fno-strict-aliasing
+  ARCH_FLASH_OFFSET=0x80000000
+  # Native Linux process: no linker script, use the host libc
+  LSCRIPT:=
+  LDFLAGS:=-Wl,-gc-sections -Wl,-Map=wolfboot.map
+  OBJS:=$(filter-out ./src/string.o,$(OBJS))
+  ifeq ($(SPMATH),1)
+    MATH_OBJS += ./lib/wolfssl/wolfcrypt/src/sp_c32.o
+  endif
+  ifeq ($(MULTI_IMAGE),1)
+    # Secondary cores emulated with threads
+    LDFLAGS+=-pthread
+  endif
+  ifeq ($(SIM_UPDATE_RAM),1)
+    CFLAGS+=-DSIM_UPDATE_RAM
+    UPDATE_OBJS:=src/update_ram.o
+  endif
+endif
+
 HOME:=../../SDK_2_10_0_FRDM-K64F
 MCUXPRESSO_DRIVERS:=$(HOME)/devices/MK64F12
 MCUXPRESSO_CMSIS:=$(HOME)/CMSIS/Core
@@ -0,0 +1,681 @@
+/* sim.c
+ *
+ * Host-side flash simulator HAL.
+ *
+ * Runs wolfBoot as a normal Linux process. The internal flash is backed by a
+ * file mapped at ARCH_FLASH_OFFSET, so that the partitions can be accessed
+ * in place as on a real target. The optional external flash (EXT_FLASH=1)
+ * is backed by a second file, accessed via ext_flash_* calls, unless it is
+ * provided by a remote uart-flash-server (UART_FLASH=1, see
+ * hal/uart/uart_drv_sim.c). With SPI_FLASH=1, the same file is the storage
+ * of the NOR flash emulated behind the mock SPI controller of
+ * hal/spi/spi_drv_sim.c, driven by src/spi_flash.c.
+ *
+ * Every erase/program operation is accounted against a configurable timing
+ * model, and a report is printed right before handing over to the
+ * application, so that the update mechanism can be benchmarked and
+ * regression-tested without a board.
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#ifdef MULTI_IMAGE
+#include <pthread.h>
+#endif
+#include <target.h>
+#include "image.h"
+#include "hal.h"
+#include "wolfboot/wolfboot.h"
+#ifdef SPI_FLASH
+#include "spi_drv.h"
+#endif
+#include "profile.h"
+#ifndef ARCH_SIM
+#   error "wolfBoot sim HAL: wrong architecture selected. Please compile with ARCH=sim."
+#endif
+
+#if defined(EXT_FLASH) && !defined(UART_FLASH)
+#   define SIM_EXT_FLASH
+#endif
+
+/* Flash timing model. All values can be overridden at runtime
+ * via the corresponding WOLFBOOT_SIM_* environment variables.
+ */
+#ifndef SIM_FLASH_PAGE_SIZE
+#define SIM_FLASH_PAGE_SIZE        256
+#endif
+#ifndef SIM_FLASH_ERASE_US
+#define SIM_FLASH_ERASE_US         20000   /* per sector */
+#endif
+#ifndef SIM_FLASH_PROGRAM_US
+#define SIM_FLASH_PROGRAM_US       1000    /* per page */
+#endif
+/* With NVM_FLASH_WRITEONCE, the internal flash is programmed in units of
+ * SIM_FLASH_WRITE_UNIT bytes, and a unit can only be programmed once after
+ * being erased (as the double-words of STM32L4/L5/G0/WB).
+ */
+#ifndef SIM_FLASH_WRITE_UNIT
+#define SIM_FLASH_WRITE_UNIT       8
+#endif
+#ifndef SIM_EXT_FLASH_SECTOR_SIZE
+#ifdef SPI_FLASH
+#define SIM_EXT_FLASH_SECTOR_SIZE  SPI_FLASH_SECTOR_SIZE
+#else
+#define SIM_EXT_FLASH_SECTOR_SIZE  WOLFBOOT_SECTOR_SIZE
+#endif
+#endif
+#ifndef SIM_EXT_FLASH_ERASE_US
+#define SIM_EXT_FLASH_ERASE_US     45000   /* per sector */
+#endif
+#ifndef SIM_EXT_FLASH_PROGRAM_US
+#define SIM_EXT_FLASH_PROGRAM_US   700     /* per page */
+#endif
+#ifndef SIM_EXT_FLASH_READ_NS
+#define SIM_EXT_FLASH_READ_NS      400     /* per byte, ~20 MHz SPI */
+#endif
+
+#define SIM_INTERNAL_FLASH_FILE    "internal_flash.dd"
+#define SIM_EXTERNAL_FLASH_FILE    "external_flash.dd"
+
+#ifdef WOLFBOOT_FLAGS_INVERT
+#   define SIM_ERASED 0x00
+#else
+#   define SIM_ERASED 0xFF
+#endif
+
+struct sim_flash {
+    const char *name;
+    uint8_t *base;
+    uint32_t size;
+    uint32_t sector_size;
+    uint32_t write_unit;    /* write-once unit, 0 if not write-once */
+    uint64_t erase_ns;
+    uint64_t program_ns;
+    uint64_t read_ns;
+    /* Counters */
+    uint32_t erase_ops;
+    uint32_t sectors_erased;
+    uint32_t write_ops;
+    uint32_t pages_programmed;
+    uint64_t bytes_programmed;
+    uint32_t read_ops;
+    uint64_t bytes_read;
+    uint64_t time_ns;
+};
+
+static struct sim_flash int_flash = {
+    .name = "internal",
+    .sector_size = WOLFBOOT_SECTOR_SIZE,
+#ifdef NVM_FLASH_WRITEONCE
+    .write_unit = SIM_FLASH_WRITE_UNIT,
+#endif
+    .erase_ns = SIM_FLASH_ERASE_US * 1000ULL,
+    .program_ns = SIM_FLASH_PROGRAM_US * 1000ULL,
+};
+
+#ifdef SIM_EXT_FLASH
+static struct sim_flash ext_flash = {
+    .name = "external",
+    .sector_size = SIM_EXT_FLASH_SECTOR_SIZE,
+    .erase_ns = SIM_EXT_FLASH_ERASE_US * 1000ULL,
+    .program_ns = SIM_EXT_FLASH_PROGRAM_US * 1000ULL,
+    .read_ns = SIM_EXT_FLASH_READ_NS,
+};
+#endif
+
+static int flash_locked = 1;
+static uint32_t powerfail_at = 0;
+static uint32_t flash_ops = 0;
+static int erase_log = 0;
+
+static uint64_t env_u64(const char *var, uint64_t dflt)
+{
+    const char *val = getenv(var);
+    if (!val || !*val)
+        return dflt;
+    return strtoull(val, NULL, 0);
+}
+
+/* Simulated power loss: stop dead after the configured number of
+ * erase/program operations, leaving the flash files in their
+ * intermediate state.
+ */
+static void sim_powerfail_check(void)
+{
+    flash_ops++;
+    if ((powerfail_at != 0) && (flash_ops >= powerfail_at)) {
+        fprintf(stderr, "wolfBoot sim: simulated power failure at flash operation %u\n",
+                flash_ops);
+        _exit(2);
+    }
+}
+
+static uint8_t *sim_map_file(const char *file, uint32_t size, void *at)
+{
+    int fd;
+    struct stat st;
+    uint8_t *mem;
+    uint8_t ff[256];
+
+    fd = open(file, O_RDWR | O_CREAT, 0660);
+    if (fd < 0) {
+        perror(file);
+        exit(1);
+    }
+    if (fstat(fd, &st) < 0) {
+        perror(file);
+        exit(1);
+    }
+    /* Grow the file to the full flash size, as erased memory */
+    if ((uint32_t)st.st_size < size) {
+        uint32_t pos = st.st_size;
+        memset(ff, SIM_ERASED, sizeof(ff));
+        lseek(fd, pos, SEEK_SET);
+        while (pos < size) {
+            uint32_t len = size - pos;
+            if (len > sizeof(ff))
+                len = sizeof(ff);
+            if (write(fd, ff, len) != (ssize_t)len) {
+                perror(file);
+                exit(1);
+            }
+            pos += len;
+        }
+    }
+    mem = mmap(at, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if ((mem == MAP_FAILED) || (at && (mem != at))) {
+        fprintf(stderr, "wolfBoot sim: cannot map %s at %p\n", file, at);
+        exit(1);
+    }
+    close(fd);
+    return mem;
+}
+
+static void sim_report(const struct sim_flash *f)
+{
+    if (!f->base)
+        return;
+    printf("  %-8s erase: %u ops, %u sectors | program: %u ops, %u pages, %llu bytes",
+            f->name, f->erase_ops, f->sectors_erased, f->write_ops,
+            f->pages_programmed, (unsigned long long)f->bytes_programmed);
+    if (f->read_ns)
+        printf(" | read: %u ops, %llu bytes", f->read_ops,
+                (unsigned long long)f->bytes_read);
+    printf(" | time: %llu.%03llu ms\n",
+            (unsigned long long)(f->time_ns / 1000000ULL),
+            (unsigned long long)((f->time_ns / 1000ULL) % 1000ULL));
+}
+
+/* Simulated time spent in flash operations so far, in ns */
+static uint64_t sim_flash_time(void)
+{
+    uint64_t total = int_flash.time_ns;
+#ifdef SIM_EXT_FLASH
+    total += ext_flash.time_ns;
+#endif
+#ifdef SPI_FLASH
+    total += sim_spi_time();
+#endif
+    return total;
+}
+
+static void sim_flash_report(void)
+{
+    uint64_t total = sim_flash_time();
+    printf("wolfBoot sim: flash statistics\n");
+    sim_report(&int_flash);
+#ifdef SIM_EXT_FLASH
+    sim_report(&ext_flash);
+#endif
+#ifdef SPI_FLASH
+    sim_spi_report();
+#endif
+    printf("  simulated flash time: %llu.%03llu ms\n",
+            (unsigned long long)(total / 1000000ULL),
+            (unsigned long long)((total / 1000ULL) % 1000ULL));
+    fflush(stdout);
+}
+
+static int sim_erase(struct sim_flash *f, uint32_t off, int len)
+{
+    uint32_t sectors;
+    if ((len <= 0) || (off % f->sector_size) != 0 ||
+            ((uint32_t)len % f->sector_size) != 0 ||
+            (off + (uint32_t)len > f->size)) {
+        fprintf(stderr, "wolfBoot sim: invalid %s erase at 0x%08x, len %d\n",
+                f->name, off, len);
+        return -1;
+    }
+    sim_powerfail_check();
+    if (erase_log)
+        printf("wolfBoot sim: %s erase at 0x%08x, len %d\n", f->name, off, len);
+    sectors = (uint32_t)len / f->sector_size;
+    memset(f->base + off, SIM_ERASED, len);
+    f->erase_ops++;
+    f->sectors_erased += sectors;
+    f->time_ns += sectors * f->erase_ns;
+    return 0;
+}
+
+static int sim_program(struct sim_flash *f, uint32_t off, const uint8_t *data, int len)
+{
+    int i;
+    uint32_t pages;
+    if ((len < 0) || (off + (uint32_t)len > f->size)) {
+        fprintf(stderr, "wolfBoot sim: invalid %s write at 0x%08x, len %d\n",
+                f->name, off, len);
+        return -1;
+    }
+    if (len == 0)
+        return 0;
+    /* Write-once: refuse to program a unit that is not erased anymore */
+    if (f->write_unit) {
+        uint32_t u = off - (off % f->write_unit);
+        for (; u < off + (uint32_t)len; u += f->write_unit) {
+            for (i = 0; i < (int)f->write_unit; i++) {
+                if (f->base[u + i] != SIM_ERASED) {
+                    fprintf(stderr, "wolfBoot sim: %s flash unit at 0x%08x "
+                            "programmed twice\n", f->name, u);
+                    _exit(3);
+                }
+            }
+        }
+    }
+    sim_powerfail_check();
+    /* NOR semantics: programming can only move bits away from the
+     * erased state.
+     */
+    for (i = 0; i < len; i++) {
+#ifdef WOLFBOOT_FLAGS_INVERT
+        f->base[off + i] |= data[i];
+#else
+        f->base[off + i] &= data[i];
+#endif
+    }
+    pages = ((off + len - 1) / SIM_FLASH_PAGE_SIZE) - (off / SIM_FLASH_PAGE_SIZE) + 1;
+    f->write_ops++;
+    f->pages_programmed += pages;
+    f->bytes_programmed += len;
+    f->time_ns += pages * f->program_ns;
+    return 0;
+}
+
+static uint32_t sim_internal_flash_size(void)
+{
+    uint32_t end = WOLFBOOT_PARTITION_BOOT_ADDRESS;
+    if (!PARTN_IS_EXT(PART_BOOT))
+        end = WOLFBOOT_PARTITION_BOOT_ADDRESS + WOLFBOOT_PARTITION_SIZE;
+    if (!PARTN_IS_EXT(PART_UPDATE) &&
+            (WOLFBOOT_PARTITION_UPDATE_ADDRESS + WOLFBOOT_PARTITION_SIZE > end))
+        end = WOLFBOOT_PARTITION_UPDATE_ADDRESS + WOLFBOOT_PARTITION_SIZE;
+    if (!PARTN_IS_EXT(PART_SWAP) &&
+            (WOLFBOOT_PARTITION_SWAP_ADDRESS + WOLFBOOT_SECTOR_SIZE > end))
+        end = WOLFBOOT_PARTITION_SWAP_ADDRESS + WOLFBOOT_SECTOR_SIZE;
+#ifdef MULTI_IMAGE
+    if (WOLFBOOT_COMPONENT_SLOT_ADDRESS(WOLFBOOT_COMPONENTS, 0) > end)
+        end = WOLFBOOT_COMPONENT_SLOT_ADDRESS(WOLFBOOT_COMPONENTS, 0);
+#endif
+    /* All the partitions on external flash: map a single sector */
+    if (end <= ARCH_FLASH_OFFSET)
+        return WOLFBOOT_SECTOR_SIZE;
+    return end - ARCH_FLASH_OFFSET;
+}
+
+void hal_init(void)
+{
+    const char *file;
+
+    int_flash.erase_ns = env_u64("WOLFBOOT_SIM_ERASE_US", SIM_FLASH_ERASE_US) * 1000ULL;
+    int_flash.program_ns = env_u64("WOLFBOOT_SIM_PROGRAM_US", SIM_FLASH_PROGRAM_US) * 1000ULL;
+    powerfail_at = (uint32_t)env_u64("WOLFBOOT_SIM_POWERFAIL", 0);
+    erase_log = (getenv("WOLFBOOT_SIM_ERASE_LOG") != NULL);
+
+    file = getenv("WOLFBOOT_SIM_FLASH");
+    if (!file)
+        file = SIM_INTERNAL_FLASH_FILE;
+    int_flash.size = sim_internal_flash_size();
+    int_flash.base = sim_map_file(file, int_flash.size, (void *)ARCH_FLASH_OFFSET);
+
+#ifdef SIM_EXT_FLASH
+    ext_flash.erase_ns = env_u64("WOLFBOOT_SIM_EXT_ERASE_US", SIM_EXT_FLASH_ERASE_US) * 1000ULL;
+    ext_flash.program_ns = env_u64("WOLFBOOT_SIM_EXT_PROGRAM_US", SIM_EXT_FLASH_PROGRAM_US) * 1000ULL;
+#ifdef SPI_FLASH
+    /* Reads are accounted as bus time by the SPI mock */
+    ext_flash.read_ns = 0;
+#else
+    ext_flash.read_ns = env_u64("WOLFBOOT_SIM_EXT_READ_NS", SIM_EXT_FLASH_READ_NS);
+#endif
+    file = getenv("WOLFBOOT_SIM_EXT_FLASH");
+    if (!file)
+        file = SIM_EXTERNAL_FLASH_FILE;
+    ext_flash.size = WOLFBOOT_PARTITION_UPDATE_ADDRESS + WOLFBOOT_PARTITION_SIZE;
+    if (WOLFBOOT_PARTITION_SWAP_ADDRESS + WOLFBOOT_SECTOR_SIZE > ext_flash.size)
+        ext_flash.size = WOLFBOOT_PARTITION_SWAP_ADDRESS + WOLFBOOT_SECTOR_SIZE;
+    ext_flash.base = sim_map_file(file, ext_flash.size, NULL);
+#endif
+
+#ifdef SIM_UPDATE_RAM
+    /* RAM staging area, for images loaded from external flash */
+    if (mmap((void *)WOLFBOOT_LOAD_ADDRESS, WOLFBOOT_PARTITION_SIZE,
+                PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+            != (void *)WOLFBOOT_LOAD_ADDRESS) {
+        fprintf(stderr, "wolfBoot sim: cannot map RAM at 0x%08x\n",
+                WOLFBOOT_LOAD_ADDRESS);
+        exit(1);
+    }
+#endif
+}
+
+void hal_prepare_boot(void)
+{
+}
+
+int hal_flash_write(uint32_t address, const uint8_t *data, int len)
+{
+    if (flash_locked) {
+        fprintf(stderr, "wolfBoot sim: write to locked flash at 0x%08x\n", address);
+        return -1;
+    }
+    if (address < ARCH_FLASH_OFFSET)
+        return -1;
+    return sim_program(&int_flash, address - ARCH_FLASH_OFFSET, data, len);
+}
+
+void hal_flash_unlock(void)
+{
+    flash_locked = 0;
+}
+
+void hal_flash_lock(void)
+{
+    flash_locked = 1;
+}
+
+int hal_flash_erase(uint32_t address, int len)
+{
+    if (flash_locked) {
+        fprintf(stderr, "wolfBoot sim: erase of locked flash at 0x%08x\n", address);
+        return -1;
+    }
+    if (address < ARCH_FLASH_OFFSET)
+        return -1;
+    return sim_erase(&int_flash, address - ARCH_FLASH_OFFSET, len);
+}
+
+#ifdef VERIFY_CACHE
+/* Device secret derived from WOLFBOOT_SIM_DEVICE_SECRET, so that different
+ * simulated devices can be emulated.
+ */
+int hal_device_secret(uint8_t *secret, int len)
+{
+    uint64_t seed = env_u64("WOLFBOOT_SIM_DEVICE_SECRET", 0x5EC2E7);
+    int i;
+    for (i = 0; i < len; i++)
+        secret[i] = (uint8_t)((seed >> (8 * (i % 8))) ^ (i * 0x3B));
+    return 0;
+}
+#endif
+
+#ifdef MULTI_IMAGE
+/* Secondary cores are emulated with one thread per job, at most
+ * WOLFBOOT_SIM_CORES - 1 running at the same time.
+ */
+#define SIM_MAX_CORES 16
+
+static pthread_t sim_core[SIM_MAX_CORES];
+static int sim_cores_busy;
+
+struct sim_job {
+    void (*job)(void *);
+    void *arg;
+};
+static struct sim_job sim_job[SIM_MAX_CORES];
+
+static void *sim_core_run(void *arg)
+{
+    struct sim_job *j = (struct sim_job *)arg;
+    j->job(j->arg);
+    return NULL;
+}
+
+int arch_secondary_start(void (*job)(void *), void *arg)
+{
+    uint64_t cores = env_u64("WOLFBOOT_SIM_CORES", 4);
+    int cpu = sim_cores_busy + 1;
+    if (cores > SIM_MAX_CORES)
+        cores = SIM_MAX_CORES;
+    if ((uint64_t)cpu >= cores)
+        return -1;
+    sim_job[cpu].job = job;
+    sim_job[cpu].arg = arg;
+    if (pthread_create(&sim_core[cpu], NULL, sim_core_run, &sim_job[cpu]) != 0)
+        return -1;
+    sim_cores_busy++;
+    return cpu;
+}
+
+void arch_secondary_wait(void)
+{
+    int cpu;
+    for (cpu = 1; cpu <= sim_cores_busy; cpu++)
+        pthread_join(sim_core[cpu], NULL);
+    sim_cores_busy = 0;
+}
+#endif /* MULTI_IMAGE */
+
+#if defined(SIM_EXT_FLASH) && defined(SPI_FLASH)
+uint8_t *sim_spi_nor_map(uint32_t *size)
+{
+    *size = ext_flash.size;
+    return ext_flash.base;
+}
+
+int sim_spi_nor_program(uint32_t off, const uint8_t *data, int len,
+        uint64_t program_ns)
+{
+    uint64_t time_ns = ext_flash.time_ns;
+    if (sim_program(&ext_flash, off, data, len) < 0)
+        return -1;
+    if (program_ns)
+        ext_flash.time_ns = time_ns + program_ns;
+    return 0;
+}
+
+int sim_spi_nor_erase(uint32_t off, int len, uint64_t erase_ns)
+{
+    uint64_t time_ns = ext_flash.time_ns;
+    if (sim_erase(&ext_flash, off, len) < 0)
+        return -1;
+    if (erase_ns)
+        ext_flash.time_ns = time_ns + erase_ns;
+    return 0;
+}
+#elif defined(SIM_EXT_FLASH)
+int ext_flash_write(uintptr_t address, const uint8_t *data, int len)
+{
+    return sim_program(&ext_flash, address, data, len);
+}
+
+int ext_flash_read(uintptr_t address, uint8_t *data, int len)
+{
+    if ((len < 0) || (address + len > ext_flash.size))
+        return -1;
+    memcpy(data, ext_flash.base + address, len);
+    ext_flash.read_ops++;
+    ext_flash.bytes_read += len;
+    ext_flash.time_ns += len * ext_flash.read_ns;
+    return len;
+}
+
+int ext_flash_erase(uintptr_t address, int len)
+{
+    return sim_erase(&ext_flash, address, len);
+}
+
+void ext_flash_lock(void)
+{
+}
+
+void ext_flash_unlock(void)
+{
+}
+#endif /* SIM_EXT_FLASH */
+
+/* Header of the image starting at 'app', if it is still in front of it
+ * (i.e. booting in place from flash).
+ */
+static uint8_t *sim_image_header(const uint8_t *app)
+{
+    uint8_t *hdr = (uint8_t *)app - IMAGE_HEADER_SIZE;
+    if (((uintptr_t)hdr < ARCH_FLASH_OFFSET) ||
+            ((uintptr_t)app > ARCH_FLASH_OFFSET + int_flash.size))
+        return NULL;
+    if (*((uint32_t *)hdr) != WOLFBOOT_MAGIC)
+        return NULL;
+    return hdr;
+}
+
+static uint32_t sim_image_version(const uint8_t *app)
+{
+    uint8_t *hdr = sim_image_header(app);
+    uint32_t *version = NULL;
+    if (hdr == NULL)
+        return 0;
+    if (wolfBoot_find_header(hdr + IMAGE_HEADER_OFFSET, HDR_VERSION,
+                (void *)&version) != sizeof(uint32_t))
+        return 0;
+    return *version;
+}
+
+#ifdef MULTI_IMAGE
+/* List the components selected by the manifest of the booted image */
+static void sim_report_components(const uint8_t *app)
+{
+    uint8_t *hdr = sim_image_header(app);
+    uint8_t *manifest = NULL;
+    uint32_t version;
+    uint16_t len, i;
+    if (hdr == NULL)
+        return;
+    len = wolfBoot_find_header(hdr + IMAGE_HEADER_OFFSET, HDR_COMPONENTS,
+            &manifest);
+    for (i = 0; i + WOLFBOOT_COMPONENT_ENTRY_SIZE <= len;
+            i += WOLFBOOT_COMPONENT_ENTRY_SIZE) {
+        memcpy(&version, manifest + i + 4, sizeof(version));
+        printf("wolfBoot sim: component %u version %u slot %c\n",
+                manifest[i], version, 'A' + manifest[i + 1]);
+    }
+}
+#endif
+
+#ifdef WOLFBOOT_PROFILE
+/* Profiling clock: host time, plus the simulated time of the flash
+ * operations, so that each phase includes the cost of its flash accesses.
+ */
+void arch_profile_init(void)
+{
+}
+
+uint64_t arch_profile_ticks(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec + sim_flash_time();
+}
+
+uint64_t arch_profile_hz(void)
+{
+    return 1000000000ULL;
+}
+
+static void sim_report_profile(void)
+{
+    static const char *name[] = WOLFBOOT_PROFILE_PHASE_NAMES;
+    const struct wolfBoot_profile *p = wolfBoot_get_profile();
+    int i;
+    printf("wolfBoot sim: boot profile\n");
+    for (i = 0; i < WOLFBOOT_PROFILE_PHASES; i++) {
+        printf("  %-12s %6u calls | time: %llu.%03llu ms\n", name[i],
+                p->phase[i].calls,
+                (unsigned long long)(p->phase[i].ticks / 1000000ULL),
+                (unsigned long long)((p->phase[i].ticks / 1000ULL) % 1000ULL));
+    }
+}
+#endif
+
+#ifdef SIM_UPDATE_RAM
+/* Save the RAM staging area to the file named by WOLFBOOT_SIM_RAM_DUMP,
+ * so that the image loaded by update_ram can be compared to the original.
+ */
+static void sim_dump_ram(void)
+{
+    const char *file = getenv("WOLFBOOT_SIM_RAM_DUMP");
+    FILE *f;
+    if (!file)
+        return;
+    f = fopen(file, "wb");
+    if (!f || (fwrite((void *)WOLFBOOT_LOAD_ADDRESS, 1, WOLFBOOT_PARTITION_SIZE, f)
+                != WOLFBOOT_PARTITION_SIZE)) {
+        perror(file);
+        exit(1);
+    }
+    fclose(f);
+}
+#endif
+
+/* There is no application to run: report and terminate the process.
+ * Setting WOLFBOOT_SIM_SUCCESS emulates an application that confirms
+ * the running firmware by calling wolfBoot_success().
+ */
+void do_boot(const uint32_t *app_offset)
+{
+    sim_flash_report();
+#ifdef WOLFBOOT_PROFILE
+    sim_report_profile();
+#endif
+    printf("wolfBoot sim: booting version %u at %p\n",
+            sim_image_version((const uint8_t *)app_offset), (void *)app_offset);
+#ifdef SIM_UPDATE_RAM
+    sim_dump_ram();
+#endif
+#ifdef MULTI_IMAGE
+    sim_report_components((const uint8_t *)app_offset);
+#endif
+    if (getenv("WOLFBOOT_SIM_SUCCESS"))
+        wolfBoot_success();
+    fflush(stdout);
+    exit(0);
+}
+
+void arch_reboot(void)
+{
+    sim_flash_report();
+    printf("wolfBoot sim: reboot\n");
+    fflush(stdout);
+    exit(0);
+}
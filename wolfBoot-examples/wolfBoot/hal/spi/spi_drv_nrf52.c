@@ -93,6 +93,33 @@ void RAMFUNCTION spi_write(const char byte)
         reg = SPI_EV_RDY;
 }
 
+/* TXD is double buffered: the second byte is queued while the first one is
+ * shifted out, then a new byte is queued each time one is received.
+ */
+void RAMFUNCTION spi_xfer(const uint8_t *tx, uint8_t *rx, uint32_t len)
+{
+    uint32_t tx_i = 0, rx_i = 0;
+    uint8_t byte;
+    SPI_EV_RDY = 0;
+    while ((tx_i < len) && (tx_i < 2)) {
+        SPI_TXDATA = tx ? tx[tx_i] : 0xFF;
+        tx_i++;
+    }
+    while (rx_i < len) {
+        while (!SPI_EV_RDY)
+            ;
+        SPI_EV_RDY = 0;
+        byte = (uint8_t)SPI_RXDATA;
+        if (rx)
+            rx[rx_i] = byte;
+        rx_i++;
+        if (tx_i < len) {
+            SPI_TXDATA = tx ? tx[tx_i] : 0xFF;
+            tx_i++;
+        }
+    }
+}
+
 
 void spi_init(int polarity, int phase)
 {
@@ -0,0 +1,498 @@
+/* spi_drv_sim.c
+ *
+ * Driver for the SPI back-end of the SPI_FLASH module.
+ *
+ * Host simulator (TARGET=sim): a mock SPI controller, with a behavioral
+ * model of a NOR flash chip on SPI_CS_FLASH: write enable latch, page
+ * program with wrap-around detection, erase types, 4-byte addressing,
+ * JEDEC ID and SFDP tables of a few real parts. The content of the chip is
+ * stored in the external flash file of hal/sim.c.
+ *
+ * Every transaction, chip select toggle, driver call and byte on the bus
+ * is counted, and converted to bus time with a simple model:
+ *   - SIM_SPI_BYTE_NS per byte clocked (bus frequency)
+ *   - SIM_SPI_CALL_NS per driver call (register polling, call overhead)
+ *   - SIM_SPI_CS_NS per chip select toggle (GPIO, setup/hold time)
+ * so that byte-wide and buffer-oriented access can be compared.
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "spi_drv.h"
+
+#ifdef SPI_FLASH
+
+/* Bus timing model. All values can be overridden at runtime
+ * via the corresponding WOLFBOOT_SIM_SPI_* environment variables.
+ */
+#ifndef SIM_SPI_BYTE_NS
+#define SIM_SPI_BYTE_NS     400     /* ~20 MHz */
+#endif
+#ifndef SIM_SPI_CALL_NS
+#define SIM_SPI_CALL_NS     250
+#endif
+#ifndef SIM_SPI_CS_NS
+#define SIM_SPI_CS_NS       100
+#endif
+
+/* Erase time of the block erase types: 4KB sectors use the erase time
+ * of the external flash model of hal/sim.c (WOLFBOOT_SIM_EXT_ERASE_US).
+ */
+#ifndef SIM_SPI_ERASE_32K_US
+#define SIM_SPI_ERASE_32K_US 120000
+#endif
+#ifndef SIM_SPI_ERASE_64K_US
+#define SIM_SPI_ERASE_64K_US 150000
+#endif
+
+/* Commands of the emulated chip */
+#define NOR_WRSR            0x01
+#define NOR_PAGE_PROGRAM    0x02
+#define NOR_READ            0x03
+#define NOR_WRDI            0x04
+#define NOR_RDSR            0x05
+#define NOR_WREN            0x06
+#define NOR_FAST_READ       0x0B
+#define NOR_READ_SFDP       0x5A
+#define NOR_MDID            0x90
+#define NOR_JEDEC_ID        0x9F
+#define NOR_ENTER_4B        0xB7
+#define NOR_EXIT_4B         0xE9
+#define NOR_ST_WEL          (1 << 1)
+
+#define NOR_MAX_PAGE_SIZE   512
+#define NOR_SFDP_SIZE       0x70
+#define NOR_SFDP_BFPT       0x30
+
+/* Emulated parts, selected with WOLFBOOT_SIM_SPI_PART. The geometry is
+ * the one of the datasheets, and is published in the SFDP Basic Flash
+ * Parameter Table with the revision and length of the real part.
+ */
+struct nor_erase {
+    uint32_t size;
+    uint8_t opcode;
+};
+
+struct nor_part {
+    const char *name;
+    uint8_t jedec_id[3];
+    uint8_t mdid[2];            /* 0xFF 0xFF: not supported */
+    uint32_t size;
+    uint32_t page_size;         /* 1: single-byte program only */
+    uint32_t program_us;        /* per command, 0: external flash model */
+    struct nor_erase erase[4];
+    uint8_t sfdp_minor;
+    uint8_t bfpt_dwords;        /* 0: no SFDP */
+    uint8_t addr_mode;          /* BFPT DWORD 1 bits 18:17 */
+    uint8_t enter_4b;           /* BFPT DWORD 16 bits 31:24 */
+};
+
+static const struct nor_part nor_parts[] = {
+    { "w25q128jv", { 0xEF, 0x40, 0x18 }, { 0xEF, 0x17 }, 16 << 20, 256, 0,
+        { { 0x1000, 0x20 }, { 0x8000, 0x52 }, { 0x10000, 0xD8 } },
+        5, 16, 0, 0x00 },
+    { "mx25l12835f", { 0xC2, 0x20, 0x18 }, { 0xC2, 0x17 }, 16 << 20, 256, 0,
+        { { 0x1000, 0x20 }, { 0x8000, 0x52 }, { 0x10000, 0xD8 } },
+        0, 9, 0, 0x00 },
+    { "mt25ql256", { 0x20, 0xBA, 0x19 }, { 0xFF, 0xFF }, 32 << 20, 256, 0,
+        { { 0x1000, 0x20 }, { 0x8000, 0x52 }, { 0x10000, 0xD8 } },
+        6, 16, 1, 0x03 },
+    { "s25fl256l", { 0x01, 0x60, 0x19 }, { 0x01, 0x18 }, 32 << 20, 256, 0,
+        { { 0x1000, 0x20 }, { 0x8000, 0x52 }, { 0x10000, 0xD8 } },
+        6, 16, 1, 0x01 },
+    { "sst25vf016b", { 0xBF, 0x25, 0x41 }, { 0xBF, 0x41 }, 2 << 20, 1, 10,
+        { { 0x1000, 0x20 }, { 0x8000, 0x52 }, { 0x10000, 0xD8 } },
+        0, 0, 0, 0x00 },
+    /* Uniform 256KB sectors: no erase type small enough for wolfBoot sectors */
+    { "s25fl512s", { 0x01, 0x02, 0x20 }, { 0x01, 0x19 }, 64 << 20, 512, 0,
+        { { 0x40000, 0xD8 } },
+        6, 16, 1, 0x01 },
+};
+#define NOR_PARTS (sizeof(nor_parts) / sizeof(nor_parts[0]))
+
+static struct {
+    uint64_t byte_ns;
+    uint64_t call_ns;
+    uint64_t cs_ns;
+    /* Counters */
+    uint32_t transactions;
+    uint32_t cs_toggles;
+    uint32_t xfer_calls;
+    uint32_t byte_calls;
+    uint64_t bytes;
+    uint32_t erase_cmds[4];     /* per erase type of the part */
+} bus;
+
+static struct {
+    const struct nor_part *part;
+    uint8_t sfdp[NOR_SFDP_SIZE];
+    uint64_t erase_32k_ns;
+    uint64_t erase_64k_ns;
+    uint8_t *base;
+    uint32_t size;
+    int cs;                 /* chip selected */
+    int wel;                /* write enable latch */
+    int addr4;              /* 4-byte address mode */
+    uint8_t op;
+    uint32_t pos;           /* bytes received in the current transaction */
+    uint32_t addr_bytes;
+    uint32_t address;
+    uint8_t page[NOR_MAX_PAGE_SIZE];
+    uint32_t page_lo, page_hi;
+} nor;
+
+static uint8_t last_rx = 0xFF;
+
+static uint64_t env_u64(const char *var, uint64_t dflt)
+{
+    const char *val = getenv(var);
+    if (!val || !*val)
+        return dflt;
+    return strtoull(val, NULL, 0);
+}
+
+static void nor_error(const char *msg)
+{
+    fprintf(stderr, "wolfBoot sim: SPI flash %s: %s (command 0x%02x)\n",
+            nor.part->name, msg, nor.op);
+    _exit(3);
+}
+
+static void sfdp_put(uint32_t off, uint32_t dword)
+{
+    nor.sfdp[off] = dword & 0xFF;
+    nor.sfdp[off + 1] = (dword >> 8) & 0xFF;
+    nor.sfdp[off + 2] = (dword >> 16) & 0xFF;
+    nor.sfdp[off + 3] = dword >> 24;
+}
+
+static uint32_t log2_u32(uint32_t v)
+{
+    uint32_t n = 0;
+    while (v > 1) {
+        v >>= 1;
+        n++;
+    }
+    return n;
+}
+
+/* SFDP header, one parameter header, and the Basic Flash Parameter Table */
+static void nor_build_sfdp(const struct nor_part *p)
+{
+    uint32_t dw[16];
+    int i;
+    memset(nor.sfdp, 0xFF, sizeof(nor.sfdp));
+    if (p->bfpt_dwords == 0)
+        return;
+    sfdp_put(0, 0x50444653);
+    nor.sfdp[4] = p->sfdp_minor;
+    nor.sfdp[5] = 1;
+    nor.sfdp[6] = 0;                /* one parameter header */
+    nor.sfdp[7] = 0xFF;
+    nor.sfdp[8] = 0x00;             /* ID LSB: JEDEC basic table */
+    nor.sfdp[9] = p->sfdp_minor;
+    nor.sfdp[10] = 1;
+    nor.sfdp[11] = p->bfpt_dwords;
+    nor.sfdp[12] = NOR_SFDP_BFPT;
+    nor.sfdp[13] = 0;
+    nor.sfdp[14] = 0;
+    nor.sfdp[15] = 0xFF;            /* ID MSB */
+    memset(dw, 0, sizeof(dw));
+    /* DWORD 1: 4KB erase, write granularity, addressing */
+    dw[0] = 0xFF800000 | ((uint32_t)p->addr_mode << 17) | (0xFF << 8) | 0x03;
+    for (i = 0; i < 4; i++) {
+        if (p->erase[i].size == 0x1000)
+            dw[0] = (dw[0] & ~0xFF03) | (p->erase[i].opcode << 8) | 0x01;
+    }
+    if (p->page_size >= 64)
+        dw[0] |= (1 << 2);
+    /* DWORD 2: density in bits, minus one */
+    dw[1] = p->size * 8 - 1;
+    /* DWORD 8-9: erase types */
+    for (i = 0; i < 4; i++) {
+        if (p->erase[i].size == 0)
+            continue;
+        dw[7 + (i >> 1)] |= (log2_u32(p->erase[i].size) |
+                (p->erase[i].opcode << 8)) << (16 * (i & 1));
+    }
+    /* DWORD 11: page size */
+    dw[10] = log2_u32(p->page_size) << 4;
+    /* DWORD 16: 4-byte address entry methods */
+    dw[15] = (uint32_t)p->enter_4b << 24;
+    for (i = 0; i < p->bfpt_dwords; i++)
+        sfdp_put(NOR_SFDP_BFPT + 4 * i, dw[i]);
+}
+
+static int nor_erase_type(uint8_t opcode)
+{
+    int i;
+    for (i = 0; i < 4; i++) {
+        if ((nor.part->erase[i].size != 0) &&
+                (nor.part->erase[i].opcode == opcode))
+            return i;
+    }
+    return -1;
+}
+
+/* Bus cycle: one byte in, one byte out */
+static uint8_t nor_exchange(uint8_t mosi)
+{
+    uint32_t n = nor.pos++;
+    uint32_t data_start;
+    if (!nor.cs)
+        return 0xFF;
+    if (n == 0) {
+        nor.op = mosi;
+        nor.address = 0;
+        nor.addr_bytes = nor.addr4 ? 4 : 3;
+        nor.page_lo = NOR_MAX_PAGE_SIZE;
+        nor.page_hi = 0;
+        return 0xFF;
+    }
+    switch (nor.op) {
+        case NOR_RDSR:
+            return nor.wel ? NOR_ST_WEL : 0;
+        case NOR_JEDEC_ID:
+            return (n <= 3) ? nor.part->jedec_id[n - 1] : 0xFF;
+        case NOR_MDID:
+            if (n == 4)
+                return nor.part->mdid[0];
+            if (n == 5)
+                return nor.part->mdid[1];
+            return 0xFF;
+        case NOR_READ_SFDP:
+            nor.addr_bytes = 3;
+            break;
+        case NOR_READ:
+        case NOR_FAST_READ:
+        case NOR_PAGE_PROGRAM:
+            break;
+        default:
+            if (nor_erase_type(nor.op) >= 0)
+                break;
+            return 0xFF;
+    }
+    if (n <= nor.addr_bytes) {
+        nor.address = (nor.address << 8) | mosi;
+        return 0xFF;
+    }
+    data_start = 1 + nor.addr_bytes;
+    if ((nor.op == NOR_FAST_READ) || (nor.op == NOR_READ_SFDP))
+        data_start++;
+    if (n < data_start)
+        return 0xFF;
+    n -= data_start;
+    if (nor.op == NOR_READ_SFDP)
+        return nor.sfdp[(nor.address + n) % NOR_SFDP_SIZE];
+    if ((nor.op == NOR_READ) || (nor.op == NOR_FAST_READ))
+        return nor.base[(nor.address + n) % nor.size];
+    if (nor.op == NOR_PAGE_PROGRAM) {
+        /* A real chip would wrap around within the page, overwriting
+         * the data just sent: spi_flash.c must never do that */
+        uint32_t off = (nor.address + n) % nor.part->page_size;
+        if (n >= nor.part->page_size)
+            nor_error("page program wraps around");
+        nor.page[off] = mosi;
+        if (off < nor.page_lo)
+            nor.page_lo = off;
+        if (off + 1 > nor.page_hi)
+            nor.page_hi = off + 1;
+    }
+    return 0xFF;
+}
+
+/* Chip select released: program/erase commands are executed */
+static void nor_execute(void)
+{
+    const struct nor_erase *e;
+    uint64_t erase_ns = 0;
+    uint32_t base;
+    int i;
+    if (nor.pos == 0)
+        return;
+    switch (nor.op) {
+        case NOR_WREN:
+            nor.wel = 1;
+            return;
+        case NOR_WRDI:
+            nor.wel = 0;
+            return;
+        case NOR_ENTER_4B:
+            if ((nor.part->enter_4b & 0x03) == 0x02 && !nor.wel)
+                nor_error("4-byte mode without write enable");
+            nor.addr4 = 1;
+            nor.wel = 0;
+            return;
+        case NOR_EXIT_4B:
+            nor.addr4 = 0;
+            return;
+        case NOR_PAGE_PROGRAM:
+            if (!nor.wel)
+                nor_error("program without write enable");
+            if (nor.page_hi > nor.page_lo) {
+                base = nor.address & ~(nor.part->page_size - 1);
+                if (sim_spi_nor_program(base + nor.page_lo,
+                            nor.page + nor.page_lo,
+                            nor.page_hi - nor.page_lo,
+                            nor.part->program_us * 1000ULL) < 0)
+                    nor_error("program out of range");
+            }
+            nor.wel = 0;
+            return;
+        default:
+            break;
+    }
+    i = nor_erase_type(nor.op);
+    if (i < 0)
+        return;
+    e = &nor.part->erase[i];
+    bus.erase_cmds[i]++;
+    if (!nor.wel)
+        nor_error("erase without write enable");
+    if (nor.pos != 1 + nor.addr_bytes)
+        nor_error("bad erase command length");
+    if (e->size == 0x8000)
+        erase_ns = nor.erase_32k_ns;
+    else if (e->size == 0x10000)
+        erase_ns = nor.erase_64k_ns;
+    base = nor.address & ~(e->size - 1);
+    if (sim_spi_nor_erase(base, e->size, erase_ns) < 0)
+        nor_error("erase out of range");
+    nor.wel = 0;
+}
+
+void spi_cs_on(int pin)
+{
+    bus.cs_toggles++;
+    bus.transactions++;
+    if (pin == SPI_CS_FLASH) {
+        nor.cs = 1;
+        nor.pos = 0;
+    }
+}
+
+void spi_cs_off(int pin)
+{
+    bus.cs_toggles++;
+    if ((pin == SPI_CS_FLASH) && nor.cs) {
+        nor_execute();
+        nor.cs = 0;
+    }
+}
+
+uint8_t spi_read(void)
+{
+    bus.byte_calls++;
+    return last_rx;
+}
+
+void spi_write(const char byte)
+{
+    bus.byte_calls++;
+    bus.bytes++;
+    last_rx = nor_exchange((uint8_t)byte);
+}
+
+void spi_xfer(const uint8_t *tx, uint8_t *rx, uint32_t len)
+{
+    uint32_t i;
+    uint8_t byte;
+    bus.xfer_calls++;
+    bus.bytes += len;
+    for (i = 0; i < len; i++) {
+        byte = nor_exchange(tx ? tx[i] : 0xFF);
+        if (rx)
+            rx[i] = byte;
+    }
+}
+
+void spi_init(int polarity, int phase)
+{
+    static int initialized = 0;
+    const char *part;
+    unsigned int i;
+    (void)polarity;
+    (void)phase;
+    if (!initialized) {
+        initialized++;
+        bus.byte_ns = env_u64("WOLFBOOT_SIM_SPI_BYTE_NS", SIM_SPI_BYTE_NS);
+        bus.call_ns = env_u64("WOLFBOOT_SIM_SPI_CALL_NS", SIM_SPI_CALL_NS);
+        bus.cs_ns = env_u64("WOLFBOOT_SIM_SPI_CS_NS", SIM_SPI_CS_NS);
+        nor.erase_32k_ns = env_u64("WOLFBOOT_SIM_SPI_ERASE_32K_US",
+                SIM_SPI_ERASE_32K_US) * 1000ULL;
+        nor.erase_64k_ns = env_u64("WOLFBOOT_SIM_SPI_ERASE_64K_US",
+                SIM_SPI_ERASE_64K_US) * 1000ULL;
+        nor.part = &nor_parts[0];
+        part = getenv("WOLFBOOT_SIM_SPI_PART");
+        if (part && *part) {
+            for (i = 0; i < NOR_PARTS; i++) {
+                if (strcmp(part, nor_parts[i].name) == 0)
+                    break;
+            }
+            if (i == NOR_PARTS) {
+                fprintf(stderr, "wolfBoot sim: unknown SPI flash part %s\n",
+                        part);
+                exit(1);
+            }
+            nor.part = &nor_parts[i];
+        }
+        nor_build_sfdp(nor.part);
+        nor.base = sim_spi_nor_map(&nor.size);
+    }
+}
+
+void spi_release(void)
+{
+}
+
+uint64_t sim_spi_time(void)
+{
+    return bus.bytes * bus.byte_ns +
+        (bus.xfer_calls + bus.byte_calls) * bus.call_ns +
+        bus.cs_toggles * bus.cs_ns;
+}
+
+uint64_t sim_spi_report(void)
+{
+    int i;
+    uint64_t time_ns = sim_spi_time();
+    if (!nor.part)
+        return 0;
+    printf("  spi      %s | %u transactions, %u CS toggles | calls: %u xfer, "
+            "%u byte | %llu bytes | time: %llu.%03llu ms\n",
+            nor.part->name, bus.transactions, bus.cs_toggles, bus.xfer_calls, bus.byte_calls,
+            (unsigned long long)bus.bytes,
+            (unsigned long long)(time_ns / 1000000ULL),
+            (unsigned long long)((time_ns / 1000ULL) % 1000ULL));
+    printf("  spi      erase commands:");
+    for (i = 0; i < 4; i++) {
+        if (nor.part->erase[i].size != 0)
+            printf(" %uK x %u", nor.part->erase[i].size >> 10,
+                    bus.erase_cmds[i]);
+    }
+    printf("\n");
+    return time_ns;
+}
+
+#endif /* SPI_FLASH */
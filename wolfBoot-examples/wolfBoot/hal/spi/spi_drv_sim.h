@@ -0,0 +1,47 @@
+/* spi_drv_sim.h
+ *
+ * Host simulator (TARGET=sim) SPI back-end, see spi_drv_sim.c
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef SPI_DRV_SIM_H_INCLUDED
+#define SPI_DRV_SIM_H_INCLUDED
+#include <stdint.h>
+
+#define SPI_CS_FLASH 0
+#define SPI_CS_TPM   1
+
+/* Storage of the emulated NOR flash, provided by hal/sim.c: program and
+ * erase go through the flash timing model and the power failure checks.
+ * A non-zero program_ns/erase_ns replaces the per-page program time and
+ * the per-sector erase time, for single-byte program and block erase.
+ */
+uint8_t *sim_spi_nor_map(uint32_t *size);
+int sim_spi_nor_program(uint32_t off, const uint8_t *data, int len,
+        uint64_t program_ns);
+int sim_spi_nor_erase(uint32_t off, int len, uint64_t erase_ns);
+
+/* Simulated bus time so far, in ns */
+uint64_t sim_spi_time(void);
+
+/* Prints the bus statistics, returns the simulated bus time in ns */
+uint64_t sim_spi_report(void);
+
+#endif /* !SPI_DRV_SIM_H_INCLUDED */
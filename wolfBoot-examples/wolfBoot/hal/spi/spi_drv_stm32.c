@@ -160,6 +160,30 @@ void RAMFUNCTION spi_write(const char byte)
     } while ((reg & SPI_SR_TX_EMPTY) == 0);
 }
 
+/* The next byte is loaded into the TX buffer while the previous one is
+ * being shifted out, so the clock runs without gaps. At most two bytes are
+ * in flight: the RX buffer is always emptied before it can be overrun.
+ */
+void RAMFUNCTION spi_xfer(const uint8_t *tx, uint8_t *rx, uint32_t len)
+{
+    uint32_t tx_i = 0, rx_i = 0;
+    volatile uint32_t reg;
+    uint8_t byte;
+    while (rx_i < len) {
+        reg = SPI1_SR;
+        if ((tx_i < len) && ((tx_i - rx_i) < 2) && (reg & SPI_SR_TX_EMPTY)) {
+            SPI1_DR = tx ? tx[tx_i] : 0xFF;
+            tx_i++;
+        }
+        if (reg & SPI_SR_RX_NOTEMPTY) {
+            byte = (uint8_t)SPI1_DR;
+            if (rx)
+                rx[rx_i] = byte;
+            rx_i++;
+        }
+    }
+}
+
 
 void spi_init(int polarity, int phase)
 {
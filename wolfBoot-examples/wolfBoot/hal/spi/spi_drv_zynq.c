@@ -51,6 +51,18 @@ void spi_write(const char byte)
 
 }
 
+void spi_xfer(const uint8_t *tx, uint8_t *rx, uint32_t len)
+{
+    uint32_t i;
+    uint8_t byte;
+    for (i = 0; i < len; i++) {
+        spi_write(tx ? tx[i] : 0xFF);
+        byte = spi_read();
+        if (rx)
+            rx[i] = byte;
+    }
+}
+
 
 void spi_init(int polarity, int phase)
 {
@@ -0,0 +1,77 @@
+/* uart_drv_sim.c
+ *
+ * Driver for the back-end of the UART_FLASH module.
+ *
+ * Host simulator (TARGET=sim): the UART is the serial device (or pty) named
+ * by the WOLFBOOT_SIM_UART environment variable, e.g. the one exported by
+ * tools/uart-flash-server/ufserver.
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "uart_flash.h"
+
+static int uart_fd = -1;
+
+int uart_tx(const uint8_t c)
+{
+    int ret;
+    do {
+        ret = write(uart_fd, &c, 1);
+    } while ((ret < 0) && ((errno == EAGAIN) || (errno == EINTR)));
+    return (ret == 1) ? 1 : -1;
+}
+
+int uart_rx(uint8_t *c)
+{
+    if (read(uart_fd, c, 1) == 1)
+        return 1;
+    return 0;
+}
+
+int uart_init(uint32_t bitrate, uint8_t data, char parity, uint8_t stop)
+{
+    struct termios options;
+    const char *dev = getenv("WOLFBOOT_SIM_UART");
+    (void)bitrate;
+    (void)data;
+    (void)parity;
+    (void)stop;
+    if (!dev) {
+        fprintf(stderr, "wolfBoot sim: WOLFBOOT_SIM_UART not set\n");
+        exit(1);
+    }
+    uart_fd = open(dev, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (uart_fd < 0) {
+        perror(dev);
+        exit(1);
+    }
+    if (tcgetattr(uart_fd, &options) == 0) {
+        cfmakeraw(&options);
+        tcsetattr(uart_fd, TCSANOW, &options);
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+/* compress.h
+ *
+ * Payload format of compressed images (COMPRESSED_IMAGES).
+ * Shared between wolfBoot (decoder) and the sign tool (encoder).
+ *
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef WOLFBOOT_COMPRESS_H
+#define WOLFBOOT_COMPRESS_H
+
+/* The manifest header of a compressed image is stored as is, and its size
+ * field is the size of the decompressed payload: the digest and the
+ * signature cover the decompressed image. The payload that follows is an
+ * LZSS bitstream, compatible with heatshrink with a window of 2^W bytes and
+ * a lookahead of 2^L bytes. Bits are stored MSB first:
+ *   - literal:        | 1 | BYTE (8 bits) |
+ *   - back-reference: | 0 | DISTANCE - 1 (W bits) | LENGTH - 1 (L bits) |
+ * A back-reference repeats LENGTH bytes found DISTANCE bytes before in the
+ * output (DISTANCE may be smaller than LENGTH). The last byte is padded
+ * with zero bits.
+ *
+ * The parameters are found in a HDR_IMG_COMPRESSED tag, added after the
+ * signature, outside of the area covered by the digest:
+ *   | ALGO (1B) | W (1B) | L (1B) | 0xFF | COMPRESSED SIZE (4B) |
+ * Altering them can only make the verification of the image fail.
+ */
+
+#define COMPRESS_ALGO_LZSS          0x01
+#define COMPRESS_TLV_LEN            8
+
+/* Encoder defaults */
+#define COMPRESS_WINDOW_BITS        11
+#define COMPRESS_LOOKAHEAD_BITS     4
+
+/* Decoder limits: the window is kept in RAM */
+#define COMPRESS_WINDOW_BITS_MIN    4
+#define COMPRESS_WINDOW_BITS_MAX    11
+#define COMPRESS_LOOKAHEAD_BITS_MIN 3
+
+#endif /* !WOLFBOOT_COMPRESS_H */
@@ -0,0 +1,58 @@
+/* delta.h
+ *
+ * Binary patch format used for delta updates.
+ * Shared between wolfBoot (decoder) and the sign tool (encoder).
+ *
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef WOLFBOOT_DELTA_H
+#define WOLFBOOT_DELTA_H
+
+/* A patch transforms a signed image (source, in BOOT) into another signed
+ * image (target), in place.
+ *
+ *  | MAGIC (4B) | TARGET SIZE (4B) | OP | OP | ... |
+ *
+ * All fields are little-endian. Each operation produces a run of bytes of
+ * the target image, in order:
+ *   - INSERT: | 0x01 | LEN (2B) | LEN bytes of data |
+ *   - COPY:   | 0x02 | SOURCE OFFSET (4B) | LEN (2B) |
+ *
+ * The target is rebuilt one sector at a time, in the order 1, 2, ... N-1, 0,
+ * so the header of the source image stays in place until the very end.
+ * To make this possible, the encoder guarantees that:
+ *   - no operation crosses a sector boundary in the target;
+ *   - a COPY producing sector S only reads from source sector 0, or
+ *     (if S > 0) from source offsets at or after the beginning of sector S,
+ *     i.e. from sectors that have not been overwritten yet.
+ */
+
+#define DELTA_PATCH_MAGIC    0x544C4457 /* WDLT */
+#define DELTA_PATCH_HDR_SIZE 8
+
+#define DELTA_OP_INSERT      0x01
+#define DELTA_OP_COPY        0x02
+
+#define DELTA_OP_INSERT_SIZE 3
+#define DELTA_OP_COPY_SIZE   7
+#define DELTA_OP_MAX_LEN     0xFFFF
+
+#endif /* !WOLFBOOT_DELTA_H */
@@ -31,7 +31,11 @@
 #include "target.h"
 #include "wolfboot/wolfboot.h"
 
+#if defined(ENCRYPT_WITH_AES128) || defined(ENCRYPT_WITH_AES256)
+#include <wolfssl/wolfcrypt/aes.h>
+#else
 #include <wolfssl/wolfcrypt/chacha.h>
+#endif
 #include <wolfssl/wolfcrypt/pwdbased.h>
 
 
@@ -48,6 +48,23 @@ void hal_prepare_boot(void);
     void hal_flash_dualbank_swap(void);
 #endif
 
+#ifdef VERIFY_CACHE
+    /* Device-unique secret, used to authenticate the verification cache */
+    int hal_device_secret(uint8_t *secret, int len);
+#endif
+
+#if defined(MULTI_IMAGE) && (defined(ARCH_AARCH64) || defined(ARCH_SIM))
+    /* Run job(arg) on an idle secondary core. Returns the core number, or
+     * -1 if no core is available: the caller then runs the job itself.
+     */
+    int arch_secondary_start(void (*job)(void *), void *arg);
+    /* Wait until all the jobs started on secondary cores are done */
+    void arch_secondary_wait(void);
+#else
+    #define arch_secondary_start(job, arg) (-1)
+    #define arch_secondary_wait() do{}while(0)
+#endif
+
 #ifndef SPI_FLASH
     /* user supplied external flash interfaces */
     int  ext_flash_write(uintptr_t address, const uint8_t *data, int len);
@@ -61,15 +78,7 @@ void hal_prepare_boot(void);
     #define ext_flash_unlock() do{}while(0)
     #define ext_flash_read spi_flash_read
     #define ext_flash_write spi_flash_write
-
-    static int ext_flash_erase(uintptr_t address, int len)
-    {
-        uint32_t end = address + len - 1;
-        uint32_t p;
-        for (p = address; p <= end; p += SPI_FLASH_SECTOR_SIZE)
-            spi_flash_sector_erase(p);
-        return 0;
-    }
+    #define ext_flash_erase spi_flash_erase
 #endif /* !SPI_FLASH */
 
 #endif /* H_HAL_FLASH_ */
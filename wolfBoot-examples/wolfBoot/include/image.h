@@ -47,11 +47,13 @@
 #define SECT_FLAG_SWAPPING 0x07
 #define SECT_FLAG_BACKUP   0x03
 #define SECT_FLAG_UPDATED  0x00
+#define SECT_FLAG_UNCHANGED 0x0B
 #else
 #define SECT_FLAG_NEW       0x00
 #define SECT_FLAG_SWAPPING  0x08
 #define SECT_FLAG_BACKUP    0x0c
 #define SECT_FLAG_UPDATED   0x0f
+#define SECT_FLAG_UNCHANGED 0x04
 #endif
 
 
@@ -71,12 +73,52 @@ struct wolfBoot_image {
 int wolfBoot_open_image(struct wolfBoot_image *img, uint8_t part);
 int wolfBoot_verify_integrity(struct wolfBoot_image *img);
 int wolfBoot_verify_authenticity(struct wolfBoot_image *img);
+int wolfBoot_verify_authenticity_batch(struct wolfBoot_image **img, int n);
 int wolfBoot_get_partition_state(uint8_t part, uint8_t *st);
 int wolfBoot_set_partition_state(uint8_t part, uint8_t newst);
 int wolfBoot_get_update_sector_flag(uint16_t sector, uint8_t *flag);
 int wolfBoot_set_update_sector_flag(uint16_t sector, uint8_t newflag);
 
 uint8_t* wolfBoot_peek_image(struct wolfBoot_image *img, uint32_t offset, uint32_t* sz);
+#ifdef MERKLE_TREE
+uint32_t wolfBoot_get_merkle_block_size(struct wolfBoot_image *img);
+#endif
+#if defined(MERKLE_TREE) || defined(COMPRESSED_IMAGES) || defined(EXT_FLASH)
+int wolfBoot_verify_integrity_copy(struct wolfBoot_image *img, uint8_t *dst);
+#endif
+#ifdef COMPRESSED_IMAGES
+#include "compress.h"
+
+/* Streaming decoder for the payload of a compressed image */
+struct wolfBoot_decompress {
+    struct wolfBoot_image *img;
+    uint32_t in_pos;
+    uint32_t in_size;
+    uint32_t out_pos;
+    uint32_t bits;
+    uint8_t n_bits;
+    uint8_t window_bits;
+    uint8_t lookahead_bits;
+    uint8_t in_idx;
+    uint8_t in_len;
+    uint8_t in_buf[64];
+    uint16_t ref_dist;
+    uint16_t ref_count;
+    uint32_t head;
+    uint8_t window[1 << COMPRESS_WINDOW_BITS_MAX];
+};
+
+uint32_t wolfBoot_get_compressed_size(struct wolfBoot_image *img);
+int wolfBoot_decompress_init(struct wolfBoot_decompress *d,
+        struct wolfBoot_image *img);
+int wolfBoot_decompress(struct wolfBoot_decompress *d, uint8_t *out,
+        uint32_t len);
+int wolfBoot_decompress_seek(struct wolfBoot_decompress *d, uint32_t pos);
+#endif
+#ifdef DELTA_UPDATES
+int wolfBoot_get_delta_info(struct wolfBoot_image *img, int inverse,
+        uint32_t *base_version, uint32_t *patch_offset, uint32_t *patch_size);
+#endif
 
 /* Defined in libwolfboot */
 uint16_t wolfBoot_find_header(uint8_t *haystack, uint16_t type, uint8_t **ptr);
@@ -25,18 +25,45 @@
 #ifndef LOADER_H
 #define LOADER_H
 
+/* Batch verification of the signatures (VERIFY_BATCH=1): maximum number of
+ * signatures in a batch, and size of the randomizers
+ */
+#ifdef WOLFBOOT_VERIFY_BATCH
+#   ifndef WOLFBOOT_VERIFY_BATCH_MAX
+#       define WOLFBOOT_VERIFY_BATCH_MAX 4
+#   endif
+#   define WOLFBOOT_VERIFY_BATCH_Z_SIZE 16
+#endif
+
 #if defined(WOLFBOOT_SIGN_ED25519)
     extern const unsigned char ed25519_pub_key[];
     extern unsigned int ed25519_pub_key_len;
 #   define KEY_BUFFER  ed25519_pub_key
 #   define KEY_LEN     ed25519_pub_key_len
 #   define IMAGE_SIGNATURE_SIZE (64)
+#   ifdef WOLFBOOT_VERIFY_BATCH
+    /* src/ed25519_batch.c */
+    int ed25519_verify_batch(int n, const unsigned char **hash,
+            unsigned int hash_len, const unsigned char **sig,
+            const unsigned char **z, int *res);
+#   endif
 #elif defined(WOLFBOOT_SIGN_ECC256)
     extern const unsigned char ecc256_pub_key[];
     extern unsigned int ecc256_pub_key_len;
 #   define KEY_BUFFER  ecc256_pub_key
 #   define KEY_LEN     ecc256_pub_key_len
 #   define IMAGE_SIGNATURE_SIZE (64)
+#   ifdef WOLFBOOT_ECC_TABLE
+    /* Pre-computed multiples of G and of the public key (src/ecc256_verify.c) */
+    extern const unsigned char ecc256_base_table[];
+    extern const unsigned char ecc256_pub_key_table[];
+    int ecc256_verify_table(const unsigned char *hash, const unsigned char *sig,
+            int *res);
+#       ifdef WOLFBOOT_VERIFY_BATCH
+    int ecc256_verify_table_batch(int n, const unsigned char **hash,
+            const unsigned char **sig, const unsigned char **z, int *res);
+#       endif
+#   endif
 #elif defined(WOLFBOOT_SIGN_RSA2048)
     extern const unsigned char rsa2048_pub_key[];
     extern unsigned int rsa2048_pub_key_len;
@@ -58,4 +85,21 @@
 #endif
 
 void wolfBoot_start(void);
+
+#ifdef ARCH_SIM
+#include <stdio.h>
+#include <stdlib.h>
+static inline void wolfBoot_panic(void)
+{
+    fprintf(stderr, "wolfBoot: PANIC!\n");
+    exit(1);
+}
+#else
+static inline void wolfBoot_panic(void)
+{
+    while(1)
+        ;
+}
+#endif
+
 #endif /* LOADER_H */
@@ -0,0 +1,64 @@
+/* profile.h
+ *
+ * Boot time profiling hooks.
+ *
+ * Compile with WOLFBOOT_PROFILE=1
+ *
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef WOLFBOOT_PROFILE_H
+#define WOLFBOOT_PROFILE_H
+
+#ifdef WOLFBOOT_PROFILE
+
+#include <stdint.h>
+#include "wolfboot/wolfboot.h"
+
+/* Frequency of the cycle counter, if it is not known by the architecture
+ * code (e.g. the core clock on Cortex-M). 0: report raw ticks.
+ */
+#ifndef WOLFBOOT_PROFILE_HZ
+#define WOLFBOOT_PROFILE_HZ 0
+#endif
+
+/* Architecture cycle counter (src/boot_*.c, hal/sim.c) */
+void arch_profile_init(void);
+uint64_t arch_profile_ticks(void);
+uint64_t arch_profile_hz(void);
+
+void wolfBoot_profile_init(void);
+void wolfBoot_profile_start(int phase);
+void wolfBoot_profile_end(int phase);
+void wolfBoot_profile_report(void);
+
+#define PROFILE_START(p) wolfBoot_profile_start(p)
+#define PROFILE_END(p) wolfBoot_profile_end(p)
+
+#else
+
+#define wolfBoot_profile_init() do{}while(0)
+#define wolfBoot_profile_report() do{}while(0)
+#define PROFILE_START(p) do{}while(0)
+#define PROFILE_END(p) do{}while(0)
+
+#endif /* WOLFBOOT_PROFILE */
+
+#endif /* !WOLFBOOT_PROFILE_H */
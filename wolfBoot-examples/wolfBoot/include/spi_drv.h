@@ -5,6 +5,10 @@
  *   * Compile with SPI_FLASH=1
  *   * Define your platform specific SPI driver in spi_drv_$PLATFORM.c,
  *     implementing the spi_ calls below.
+ *   * spi_xfer() moves a whole buffer within the current chip select.
+ *     Drivers keep the transmit path busy while the received bytes are
+ *     collected, so that there are no gaps between bytes on the bus.
+ *     spi_write()/spi_read() are kept for single byte access.
  *
  *
  * Copyright (C) 2020 wolfSSL Inc.
@@ -44,10 +48,19 @@
 #include "hal/spi/spi_drv_nrf52.h"
 #endif
 
+#if defined(PLATFORM_sim)
+#include "hal/spi/spi_drv_sim.h"
+#endif
+
 void spi_init(int polarity, int phase);
 void spi_write(const char byte);
 uint8_t spi_read(void);
 void spi_cs_on(int pin);
 void spi_cs_off(int pin);
 
+/* Full-duplex transfer of 'len' bytes. 'tx' may be NULL to clock out 0xFF
+ * (reads), 'rx' may be NULL to discard the incoming bytes (writes).
+ */
+void spi_xfer(const uint8_t *tx, uint8_t *rx, uint32_t len);
+
 #endif /* !SPI_DRV_H_INCLUDED */
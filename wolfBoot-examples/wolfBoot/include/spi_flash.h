@@ -39,6 +39,7 @@ uint16_t spi_flash_probe(void);
 void spi_release(void);
 
 void spi_flash_sector_erase(uint32_t address);
+int spi_flash_erase(uint32_t address, int len);
 int spi_flash_read(uint32_t address, void *data, int len);
 int spi_flash_write(uint32_t address, const void *data, int len);
 
@@ -32,6 +32,40 @@
 #define UART_FLASH_DRI_H
 #include <stdint.h>
 
+/* Framed protocol, shared with tools/uart-flash-server.
+ *
+ * Every frame is: SOF | type | seq | address (LE32) | len (LE32) |
+ *                 payload | CRC16 (LE16)
+ *
+ * The payload is 'len' bytes long for UF_WRITE, UF_DATA and UF_VERSION
+ * frames, and empty for the others. The CRC (CCITT, init 0xFFFF) covers all
+ * the fields from 'type' to the end of the payload.
+ *
+ * Requests (UF_WRITE, UF_READ, UF_ERASE, UF_VERSION) are idempotent: the
+ * target may keep several of them in flight, up to UART_FLASH_WINDOW, and
+ * resend the ones not acknowledged before the timeout. The host replies
+ * to each valid request with a frame carrying the same seq/address: UF_ACK
+ * for writes, erase and version, UF_DATA for reads. Corrupted frames are
+ * dropped without reply.
+ */
+#define UF_SOF          0x7E
+#define UF_WRITE        0x01
+#define UF_READ         0x02
+#define UF_ERASE        0x03
+#define UF_DATA         0x04
+#define UF_ACK          0x06
+#define UF_VERSION      0x56
+
+#define UF_HDR_SIZE     11
+#define UF_CRC_SIZE     2
+
+#ifndef UART_FLASH_FRAME_SIZE
+#   define UART_FLASH_FRAME_SIZE 256
+#endif
+#ifndef UART_FLASH_WINDOW
+#   define UART_FLASH_WINDOW 4
+#endif
+
 #ifdef UART_FLASH
     #ifndef UART_FLASH_BITRATE
       #define UART_FLASH_BITRATE 460800
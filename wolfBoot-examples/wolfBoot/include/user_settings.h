@@ -113,8 +113,22 @@
 # define NO_SHA256
 #endif
 
+/* SHA-256 compression function in Thumb-2 assembly (src/sha256_thumb2.S),
+ * in place of the C transform of wolfCrypt
+ */
+#if defined(WOLFBOOT_THUMB2_ASM) && defined(__WOLFBOOT) && !defined(NO_SHA256)
+int sha256_transform_thumb2(unsigned int *digest, const unsigned int *data);
+# define XTRANSFORM(S, D) \
+    sha256_transform_thumb2((S)->digest, (const unsigned int *)(D))
+#endif
+
 #ifdef EXT_ENCRYPTED
-#  define HAVE_CHACHA
+#  if defined(ENCRYPT_WITH_AES128) || defined(ENCRYPT_WITH_AES256)
+#    define WOLFSSL_AES_COUNTER
+#    define WOLFSSL_AES_DIRECT
+#  else
+#    define HAVE_CHACHA
+#  endif
 #  define HAVE_PWDBASED
 #else
 #  define NO_PWDBASED
@@ -122,7 +136,9 @@
 
 /* Disables - For minimum wolfCrypt build */
 #ifndef WOLFBOOT_TPM
-    #define NO_AES
+    #if !defined(ENCRYPT_WITH_AES128) && !defined(ENCRYPT_WITH_AES256)
+        #define NO_AES
+    #endif
     #define NO_HMAC
 #endif
 
@@ -48,6 +48,14 @@
 #define HDR_TIMESTAMP   0x02
 #define HDR_SHA256      0x03
 #define HDR_IMG_TYPE    0x04
+#define HDR_IMG_DELTA_BASE          0x05
+#define HDR_IMG_DELTA_SIZE          0x06
+#define HDR_MERKLE_BLOCK_SIZE       0x07
+#define HDR_MERKLE_ROOT             0x08
+#define HDR_COMPONENTS              0x09
+#define HDR_IMG_COMPRESSED          0x0A
+#define HDR_IMG_DELTA_INVERSE       0x15
+#define HDR_IMG_DELTA_INVERSE_SIZE  0x16
 #define HDR_PUBKEY      0x10
 #define HDR_SIGNATURE   0x20
 #define HDR_SHA3_384    0x13
@@ -59,6 +67,8 @@
 #define HDR_IMG_TYPE_AUTH_RSA4096 0x0400
 #define HDR_IMG_TYPE_WOLFBOOT     0x0000
 #define HDR_IMG_TYPE_APP          0x0001
+#define HDR_IMG_TYPE_DIFF         0x00D0
+#define HDR_IMG_TYPE_PART_MASK    0x000F
 
 
 #ifdef __WOLFBOOT
@@ -108,6 +118,18 @@ uint16_t wolfBoot_get_image_type(uint8_t part);
 int wolfBoot_fallback_is_possible(void);
 int wolfBoot_dualboot_candidate(void);
 
+/* Streaming receive of an update into the UPDATE partition
+ * (src/update_stream.c): wolfBoot_update_write() returns the number of
+ * bytes consumed, wolfBoot_update_poll() 1 if it programmed or erased
+ * flash, and wolfBoot_update_finalize() triggers the update if the image
+ * is authentic. All return -1 on errors.
+ */
+int wolfBoot_update_open(void);
+int wolfBoot_update_write(const uint8_t *data, uint32_t len);
+int wolfBoot_update_poll(void);
+uint32_t wolfBoot_update_remaining(void);
+int wolfBoot_update_finalize(void);
+
 /* Hashing function configuration */
 #if defined(WOLFBOOT_HASH_SHA256)
 #   define WOLFBOOT_SHA_BLOCK_SIZE (16)
@@ -125,10 +147,81 @@ int wolfBoot_dualboot_candidate(void);
 #   error "No valid hash algorithm defined!"
 #endif
 
+#ifdef MULTI_IMAGE
+/* Components (e.g. co-processor firmware, filesystem) listed in the manifest
+ * of the application image. Each component has two slots (A/B) of
+ * WOLFBOOT_COMPONENT_SIZE bytes, starting at WOLFBOOT_COMPONENT_ADDRESS.
+ * Manifest entry: id | slot | reserved (2) | version | size | digest
+ */
+#ifndef WOLFBOOT_COMPONENTS
+#   define WOLFBOOT_COMPONENTS 1
+#endif
+/* The manifest parser tracks the component ids in a 32-bit mask */
+#if (WOLFBOOT_COMPONENTS < 1) || (WOLFBOOT_COMPONENTS > 32)
+#   error "WOLFBOOT_COMPONENTS must be between 1 and 32"
+#endif
+#define WOLFBOOT_COMPONENT_ENTRY_SIZE (12 + WOLFBOOT_SHA_DIGEST_SIZE)
+#define WOLFBOOT_COMPONENT_SLOT_ADDRESS(id, slot) \
+    (WOLFBOOT_COMPONENT_ADDRESS + (2 * (id) + (slot)) * WOLFBOOT_COMPONENT_SIZE)
+
+uint32_t wolfBoot_get_component_version(uint8_t part, uint8_t id);
+uint32_t wolfBoot_get_component_address(uint8_t part, uint8_t id);
+#endif
+
+#ifdef WOLFBOOT_PROFILE
+/* Boot time profile (WOLFBOOT_PROFILE=1): time spent by wolfBoot in each
+ * phase of the last boot, in ticks of the architecture cycle counter
+ * (tick_hz is 0 if its frequency is unknown, e.g. Cortex-M core clock).
+ * The times are inclusive: e.g. the header lookups done while computing
+ * the image hash are also accounted in WOLFBOOT_PROF_HEADER.
+ * If WOLFBOOT_PROFILE_ADDRESS is defined, the table is left there for the
+ * application, which can access it via wolfBoot_get_profile().
+ */
+#define WOLFBOOT_PROFILE_MAGIC      0x464F5250 /* PROF */
+
+enum wolfBoot_profile_phase {
+    WOLFBOOT_PROF_OPEN_IMAGE = 0,
+    WOLFBOOT_PROF_HEADER,
+    WOLFBOOT_PROF_IMAGE_HASH,
+    WOLFBOOT_PROF_KEY_HASH,
+    WOLFBOOT_PROF_SIG_VERIFY,
+    WOLFBOOT_PROF_COPY_SECTOR,
+    WOLFBOOT_PROF_PREPARE_BOOT,
+    WOLFBOOT_PROF_TOTAL,
+    WOLFBOOT_PROFILE_PHASES
+};
+
+#define WOLFBOOT_PROFILE_PHASE_NAMES { "open_image", "header", "image_hash", \
+    "key_hash", "sig_verify", "copy_sector", "prepare_boot", "total" }
+
+struct wolfBoot_profile {
+    uint32_t magic;
+    uint32_t n_phases;
+    uint64_t tick_hz;
+    struct {
+        uint64_t ticks;
+        uint32_t calls;
+        uint32_t reserved;
+    } phase[WOLFBOOT_PROFILE_PHASES];
+};
+
+const struct wolfBoot_profile *wolfBoot_get_profile(void);
+#endif
+
 /* Encryption support */
-#define ENCRYPT_BLOCK_SIZE 16 
-#define ENCRYPT_KEY_SIZE 32 /* Chacha20 - 256bit */
-#define ENCRYPT_NONCE_SIZE 12 /* 96 bit*/
+#if defined(ENCRYPT_WITH_AES128) || defined(ENCRYPT_WITH_AES256)
+    #define ENCRYPT_BLOCK_SIZE 16 /* AES block */
+    #ifdef ENCRYPT_WITH_AES128
+        #define ENCRYPT_KEY_SIZE 16 /* AES128 - 128bit */
+    #else
+        #define ENCRYPT_KEY_SIZE 32 /* AES256 - 256bit */
+    #endif
+    #define ENCRYPT_NONCE_SIZE 16 /* Initial CTR block, 128 bit */
+#else
+    #define ENCRYPT_BLOCK_SIZE 64 /* Chacha20 block */
+    #define ENCRYPT_KEY_SIZE 32 /* Chacha20 - 256bit */
+    #define ENCRYPT_NONCE_SIZE 12 /* 96 bit*/
+#endif
 
 int wolfBoot_set_encrypt_key(const uint8_t *key, const uint8_t *nonce);
 int wolfBoot_get_encrypt_key(uint8_t *key, uint8_t *nonce);
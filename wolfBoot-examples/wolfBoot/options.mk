@@ -10,6 +10,29 @@ ifeq ($(SIGN),ECC256)
   KEYGEN_OPTIONS+=--ecc256
   SIGN_OPTIONS+=--ecc256
   PRIVATE_KEY=ecc256.der
+  # Pre-computed tables for the embedded key, unless ECC_TABLE=0: the SP
+  # object is replaced by src/ecc256_verify.c, which includes it.
+  # Not used with TPM or hardware PKA.
+  ECC_SP_OBJ:=$(filter %/sp_c32.o %/sp_cortexm.o,$(MATH_OBJS))
+  ifeq ($(WOLFTPM),1)
+    ECC_SP_OBJ:=
+  endif
+  ifeq ($(PKA),1)
+    ifneq ($(PKA_EXTRA_OBJS),)
+      ECC_SP_OBJ:=
+    endif
+  endif
+  ifneq ($(ECC_TABLE),0)
+    ifneq ($(ECC_SP_OBJ),)
+      MATH_OBJS:=$(filter-out $(ECC_SP_OBJ),$(MATH_OBJS)) ./src/ecc256_verify.o
+      CFLAGS+=-DWOLFBOOT_ECC_TABLE
+      PUBLIC_KEY_OBJS+=./src/ecc256_pub_key_table.o
+      # Batch verification of the signatures, sharing the comb
+      ifneq ($(VERIFY_BATCH),0)
+        CFLAGS+=-DWOLFBOOT_VERIFY_BATCH
+      endif
+    endif
+  endif
   WOLFCRYPT_OBJS+= \
     $(MATH_OBJS) \
     ./lib/wolfssl/wolfcrypt/src/ecc.o \
@@ -23,7 +46,7 @@ ifeq ($(SIGN),ECC256)
   else
     CFLAGS+=-Wstack-usage=6680
   endif
-  PUBLIC_KEY_OBJS=./src/ecc256_pub_key.o
+  PUBLIC_KEY_OBJS+=./src/ecc256_pub_key.o
 endif
 
 ifeq ($(SIGN),ED25519)
@@ -39,6 +62,11 @@ ifeq ($(SIGN),ED25519)
     ./lib/wolfssl/wolfcrypt/src/fe_low_mem.o
   PUBLIC_KEY_OBJS=./src/ed25519_pub_key.o
   CFLAGS+=-DWOLFBOOT_SIGN_ED25519 -Wstack-usage=1024
+  # Batch verification of the signatures
+  ifneq ($(VERIFY_BATCH),0)
+    WOLFCRYPT_OBJS+=./src/ed25519_batch.o
+    CFLAGS+=-DWOLFBOOT_VERIFY_BATCH
+  endif
 endif
 
 ifeq ($(SIGN),RSA2048)
@@ -102,6 +130,13 @@ ifeq ($(FLAGS_INVERT),1)
   CFLAGS+=-DWOLFBOOT_FLAGS_INVERT=1
 endif
 
+ifeq ($(FLAGS_JOURNAL),1)
+  CFLAGS+=-DFLAGS_JOURNAL=1
+  ifneq ($(FLAGS_JOURNAL_SLOTS),)
+    CFLAGS+=-DWOLFBOOT_JOURNAL_SLOTS=$(FLAGS_JOURNAL_SLOTS)
+  endif
+endif
+
 ifeq ($(DUALBANK_SWAP),1)
   CFLAGS+=-DDUALBANK_SWAP=1
 endif
@@ -119,7 +154,22 @@ endif
 
 ifeq ($(ENCRYPT),1)
   CFLAGS+=-DEXT_ENCRYPTED=1
-  WOLFCRYPT_OBJS+=./lib/wolfssl/wolfcrypt/src/chacha.o
+  ifeq ($(ENCRYPT_WITH_AES128),1)
+    CFLAGS+=-DENCRYPT_WITH_AES128
+    ENCRYPT_AES=1
+  endif
+  ifeq ($(ENCRYPT_WITH_AES256),1)
+    CFLAGS+=-DENCRYPT_WITH_AES256
+    ENCRYPT_AES=1
+  endif
+  ifeq ($(ENCRYPT_AES),1)
+    # AES is already part of the build with WOLFTPM
+    ifneq ($(WOLFTPM),1)
+      WOLFCRYPT_OBJS+=./lib/wolfssl/wolfcrypt/src/aes.o
+    endif
+  else
+    WOLFCRYPT_OBJS+=./lib/wolfssl/wolfcrypt/src/chacha.o
+  endif
 endif
 
 ifeq ($(EXT_FLASH),1)
@@ -148,6 +198,58 @@ ifeq ($(DISABLE_BACKUP),1)
   CFLAGS+= -DDISABLE_BACKUP
 endif
 
+ifeq ($(SKIP_UNCHANGED_SECTORS),1)
+  CFLAGS+= -DSKIP_UNCHANGED_SECTORS
+endif
+
+ifeq ($(MERKLE_TREE),1)
+  MERKLE_BLOCK_SIZE?=4096
+  CFLAGS+= -DMERKLE_TREE
+  SIGN_OPTIONS+=--merkle $(MERKLE_BLOCK_SIZE)
+endif
+
+ifeq ($(VERIFY_CACHE),1)
+  CFLAGS+= -DVERIFY_CACHE
+  ifneq ($(WOLFBOOT_VERIFY_CACHE_ADDRESS),)
+    CFLAGS+= -DWOLFBOOT_VERIFY_CACHE_ADDRESS=$(WOLFBOOT_VERIFY_CACHE_ADDRESS)
+  endif
+endif
+
+ifeq ($(DELTA_UPDATES),1)
+  CFLAGS+= -DDELTA_UPDATES
+endif
+
+ifeq ($(COMPRESSED_IMAGES),1)
+  CFLAGS+= -DCOMPRESSED_IMAGES
+endif
+
+ifeq ($(MULTI_IMAGE),1)
+  CFLAGS+= -DMULTI_IMAGE -DWOLFBOOT_COMPONENTS=$(WOLFBOOT_COMPONENTS)
+  CFLAGS+= -DWOLFBOOT_COMPONENT_ADDRESS=$(WOLFBOOT_COMPONENT_ADDRESS)
+  CFLAGS+= -DWOLFBOOT_COMPONENT_SIZE=$(WOLFBOOT_COMPONENT_SIZE)
+endif
+
+ifeq ($(WOLFBOOT_PROFILE),1)
+  CFLAGS+= -DWOLFBOOT_PROFILE
+  OBJS+=src/profile.o
+  ifneq ($(WOLFBOOT_PROFILE_ADDRESS),)
+    CFLAGS+= -DWOLFBOOT_PROFILE_ADDRESS=$(WOLFBOOT_PROFILE_ADDRESS)
+  endif
+  ifneq ($(WOLFBOOT_PROFILE_HZ),)
+    CFLAGS+= -DWOLFBOOT_PROFILE_HZ=$(WOLFBOOT_PROFILE_HZ)ULL
+  endif
+endif
+
+## Manifest header larger than the default for the signature algorithm
+## (e.g. to fit the component manifest). The sign tool reads it from the
+## environment.
+ifneq ($(IMAGE_HEADER_SIZE),256)
+  ifeq ($(filter -DIMAGE_HEADER_SIZE=%,$(CFLAGS)),)
+    CFLAGS+= -DIMAGE_HEADER_SIZE=$(IMAGE_HEADER_SIZE)
+  endif
+endif
+export IMAGE_HEADER_SIZE
+
 
 ifeq ($(DEBUG),1)
   CFLAGS+=-O0 -g -ggdb3 -DDEBUG=1
@@ -24,6 +24,8 @@
 #include "image.h"
 #include "loader.h"
 #include "wolfboot/wolfboot.h"
+#include "hal.h"
+#include "profile.h"
 
 extern unsigned int __bss_start__;
 extern unsigned int __bss_end__;
@@ -47,6 +49,87 @@ void boot_entry_C(void)
     main();
 }
 
+#ifdef MULTI_IMAGE
+/* Secondary cores run the jobs dispatched by the primary core via
+ * arch_secondary_start (e.g. hashing the image components). The mailboxes
+ * live in .data, because the BSS is cleared by the primary core while the
+ * secondary cores may already be registering. Cores that are not released
+ * from reset never come online: the jobs then run on the primary core.
+ */
+#define AARCH64_CORES 4
+
+struct secondary_mbox {
+    void (*job)(void *);
+    void *arg;
+    uint32_t online;
+    uint32_t busy;
+};
+
+static volatile struct secondary_mbox mbox[AARCH64_CORES]
+    __attribute__((section(".data")));
+
+void boot_secondary_C(unsigned int cpu)
+{
+    volatile struct secondary_mbox *m = &mbox[cpu];
+    m->online = 1;
+    asm volatile("dsb sy");
+    while (1) {
+        while (m->busy == 0)
+            asm volatile("wfe");
+        m->job(m->arg);
+        asm volatile("dsb sy");
+        m->busy = 0;
+        asm volatile("dsb sy; sev");
+    }
+}
+
+int arch_secondary_start(void (*job)(void *), void *arg)
+{
+    unsigned int cpu;
+    for (cpu = 1; cpu < AARCH64_CORES; cpu++) {
+        if (mbox[cpu].online && !mbox[cpu].busy) {
+            mbox[cpu].job = job;
+            mbox[cpu].arg = arg;
+            asm volatile("dsb sy");
+            mbox[cpu].busy = 1;
+            asm volatile("dsb sy; sev");
+            return cpu;
+        }
+    }
+    return -1;
+}
+
+void arch_secondary_wait(void)
+{
+    unsigned int cpu;
+    for (cpu = 1; cpu < AARCH64_CORES; cpu++) {
+        while (mbox[cpu].busy)
+            asm volatile("wfe");
+    }
+}
+#endif /* MULTI_IMAGE */
+
+#ifdef WOLFBOOT_PROFILE
+/* Generic timer: physical count, at the frequency programmed in CNTFRQ */
+void arch_profile_init(void)
+{
+}
+
+uint64_t arch_profile_ticks(void)
+{
+    uint64_t cnt;
+    asm volatile("isb; mrs %0, cntpct_el0" : "=r"(cnt));
+    return cnt;
+}
+
+uint64_t arch_profile_hz(void)
+{
+    uint64_t frq;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frq));
+    return frq;
+}
+#endif /* WOLFBOOT_PROFILE */
+
 /* This is the main loop for the bootloader.
  *
  * It performs the following actions:
@@ -23,6 +23,7 @@
 
 #include "image.h"
 #include "loader.h"
+#include "profile.h"
 #include "wolfboot/wolfboot.h"
 
 extern unsigned int _start_text;
@@ -283,6 +284,49 @@ void RAMFUNCTION do_boot(const uint32_t *app_offset)
 }
 #endif
 
+#ifdef WOLFBOOT_PROFILE
+/* DWT cycle counter, extended to 64 bits: it must be read at least once
+ * every 2^32 cycles, which is the case between the profiling hooks.
+ */
+#if defined(__ARM_ARCH_6M__)
+#   error "WOLFBOOT_PROFILE: no DWT cycle counter on Cortex-M0"
+#endif
+#define DEMCR               (*(volatile uint32_t *)(0xE000EDFC))
+#define DEMCR_TRCENA        (1 << 24)
+#define DWT_CTRL            (*(volatile uint32_t *)(0xE0001000))
+#define DWT_CTRL_CYCCNTENA  (1 << 0)
+#define DWT_CYCCNT          (*(volatile uint32_t *)(0xE0001004))
+#define DWT_LAR             (*(volatile uint32_t *)(0xE0001FB0))
+#define DWT_LAR_KEY         (0xC5ACCE55) /* Cortex-M7 */
+
+static uint32_t cyccnt_last;
+static uint32_t cyccnt_wraps;
+
+void arch_profile_init(void)
+{
+    DEMCR |= DEMCR_TRCENA;
+    DWT_LAR = DWT_LAR_KEY;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+    cyccnt_last = 0;
+    cyccnt_wraps = 0;
+}
+
+uint64_t arch_profile_ticks(void)
+{
+    uint32_t now = DWT_CYCCNT;
+    if (now < cyccnt_last)
+        cyccnt_wraps++;
+    cyccnt_last = now;
+    return ((uint64_t)cyccnt_wraps << 32) | now;
+}
+
+uint64_t arch_profile_hz(void)
+{
+    return WOLFBOOT_PROFILE_HZ;
+}
+#endif /* WOLFBOOT_PROFILE */
+
 #ifdef PLATFORM_psoc6
 typedef void(*NMIHANDLER)(void);
 #   define isr_NMI (NMIHANDLER)(0x0000000D)
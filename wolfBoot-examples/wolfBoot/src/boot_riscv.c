@@ -22,6 +22,7 @@
 #include <stdint.h>
 
 #include "image.h"
+#include "profile.h"
 
 extern void trap_entry(void);
 extern void trap_exit(void);
@@ -90,6 +91,29 @@ void isr_empty(void)
 
 }
 
+#ifdef WOLFBOOT_PROFILE
+/* mcycle counter, read as two halves on RV32 */
+void arch_profile_init(void)
+{
+}
+
+uint64_t arch_profile_ticks(void)
+{
+    uint32_t hi, lo, hi2;
+    do {
+        asm volatile("rdcycleh %0" : "=r"(hi));
+        asm volatile("rdcycle %0" : "=r"(lo));
+        asm volatile("rdcycleh %0" : "=r"(hi2));
+    } while (hi != hi2);
+    return ((uint64_t)hi << 32) | lo;
+}
+
+uint64_t arch_profile_hz(void)
+{
+    return WOLFBOOT_PROFILE_HZ;
+}
+#endif /* WOLFBOOT_PROFILE */
+
 #ifdef RAM_CODE
 
 #define AON_WDOGCFG  *(volatile uint32_t *)(0x10000000UL)
@@ -0,0 +1,410 @@
+/* ecc256_verify.c
+ *
+ * ECDSA P-256 verification against the embedded public key, using the
+ * pre-computed tables of src/ecc256_pub_key_table.c ('keygen --table').
+ *
+ * Compile with ECC_TABLE=1 (default with SIGN=ECC256 and SPMATH=1)
+ *
+ * u1.G + u2.Q is computed with a single comb over the two tables: 64
+ * doublings and up to 128 additions of table entries, instead of the two
+ * 256-step ladders of the generic SP verification.
+ *
+ * The field and point arithmetic are the (static) functions of the wolfCrypt
+ * SP implementation for the target, which is compiled as part of this file,
+ * in place of its own object (see options.mk).
+ *
+ * With VERIFY_BATCH=1, ecc256_verify_table_batch() checks several signatures
+ * with a single comb: see the comment of the function.
+ *
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include "loader.h"
+
+#if defined(WOLFSSL_SP_ARM_CORTEX_M_ASM)
+#   include "wolfcrypt/src/sp_cortexm.c"
+#   define SP256_DIGITS      8
+#   define SP256_DIGIT_BITS  32
+#   define SP256(f) f##_8
+#else
+#   include "wolfcrypt/src/sp_c32.c"
+#   define SP256_DIGITS      10
+#   define SP256_DIGIT_BITS  26
+#   define SP256(f) f##_10
+#endif
+
+#if !defined(WOLFSSL_SP_SMALL)
+#   error "ECC_TABLE requires WOLFSSL_SP_SMALL"
+#endif
+
+/* Table layout: see keygen_ecc256_table() in tools/keytools/keygen.c */
+#define ECC256_TABLE_TEETH      4
+#define ECC256_TABLE_SPACING    (256 / ECC256_TABLE_TEETH)
+#define ECC256_COORD_SIZE       32
+
+/* Working points and scratch buffer, too large for the stack */
+static sp_point_256 ecc256_r;
+static sp_point_256 ecc256_t;
+static sp_digit ecc256_tmp[2 * SP256_DIGITS * 5];
+
+/* Bits col, col + 64, col + 128 and col + 192 of k */
+static int ecc256_comb_index(const sp_digit *k, int col)
+{
+    int j, bit, idx = 0;
+    for (j = 0; j < ECC256_TABLE_TEETH; j++) {
+        bit = j * ECC256_TABLE_SPACING + col;
+        idx |= (int)((k[bit / SP256_DIGIT_BITS] >>
+                    (bit % SP256_DIGIT_BITS)) & 1) << j;
+    }
+    return idx;
+}
+
+/* ecc256_r += table[idx]. '*inf' is set while ecc256_r is the point at
+ * infinity, which the SP point addition does not handle.
+ */
+static void ecc256_comb_add(const uint8_t *table, int idx, int *inf)
+{
+    const uint8_t *entry;
+
+    if (idx == 0)
+        return;
+    entry = table + (idx - 1) * 2 * ECC256_COORD_SIZE;
+    XMEMSET(&ecc256_t, 0, sizeof(ecc256_t));
+    sp_256_from_bin(ecc256_t.x, SP256_DIGITS, entry, ECC256_COORD_SIZE);
+    sp_256_from_bin(ecc256_t.y, SP256_DIGITS, entry + ECC256_COORD_SIZE,
+            ECC256_COORD_SIZE);
+    XMEMCPY(ecc256_t.z, p256_norm_mod, sizeof(p256_norm_mod));
+    if (*inf) {
+        XMEMCPY(&ecc256_r, &ecc256_t, sizeof(ecc256_r));
+        *inf = 0;
+    } else {
+        SP256(sp_256_proj_point_add)(&ecc256_r, &ecc256_r, &ecc256_t,
+                ecc256_tmp);
+    }
+}
+
+/* R = k1.G + k2.Q in ecc256_r, with a single comb over the two tables.
+ * Returns 1 if R is the point at infinity.
+ */
+static int ecc256_comb(const sp_digit *k1, const sp_digit *k2)
+{
+    int col, inf = 1;
+
+    for (col = ECC256_TABLE_SPACING - 1; col >= 0; col--) {
+        if (!inf)
+            SP256(sp_256_proj_point_dbl)(&ecc256_r, &ecc256_r, ecc256_tmp);
+        ecc256_comb_add(ecc256_base_table, ecc256_comb_index(k1, col), &inf);
+        ecc256_comb_add(ecc256_pub_key_table, ecc256_comb_index(k2, col),
+                &inf);
+    }
+    return inf || SP256(sp_256_iszero)(ecc256_r.z);
+}
+
+/* Load s from the signature (r | s), in Montgomery form (modulo the order).
+ * Returns 1, 0 if r or s is out of range, or a negative error code.
+ */
+static int ecc256_load_s(const uint8_t *sig, sp_digit *s)
+{
+    sp_digit r[2 * SP256_DIGITS];
+    int err;
+
+    sp_256_from_bin(r, SP256_DIGITS, sig, ECC256_COORD_SIZE);
+    sp_256_from_bin(s, SP256_DIGITS, sig + ECC256_COORD_SIZE,
+            ECC256_COORD_SIZE);
+    /* r and s must be in [1, order - 1] */
+    if (SP256(sp_256_iszero)(r) || SP256(sp_256_iszero)(s) ||
+            (SP256(sp_256_cmp)(r, p256_order) >= 0) ||
+            (SP256(sp_256_cmp)(s, p256_order) >= 0))
+        return 0;
+    SP256(sp_256_mul)(s, s, p256_norm_order);
+    err = SP256(sp_256_mod)(s, s, p256_order);
+    if (err != MP_OKAY)
+        return err;
+    SP256(sp_256_norm)(s);
+    return 1;
+}
+
+/* u1 = hash.w, u2 = r.w (mod order), with w = 1 / s in Montgomery form */
+static void ecc256_scalars(const uint8_t *hash, const uint8_t *sig,
+        const sp_digit *w, sp_digit *u1, sp_digit *u2)
+{
+    sp_256_from_bin(u1, SP256_DIGITS, hash, ECC256_COORD_SIZE);
+    sp_256_from_bin(u2, SP256_DIGITS, sig, ECC256_COORD_SIZE);
+    SP256(sp_256_mont_mul_order)(u1, u1, w);
+    SP256(sp_256_mont_mul_order)(u2, u2, w);
+}
+
+/* '*res' = (x(p) == r), comparing X with r.Z^2 in Montgomery form.
+ * p->z is modified.
+ */
+static int ecc256_check_x(sp_point_256 *p, const uint8_t *sig, int *res)
+{
+    sp_digit r[2 * SP256_DIGITS];
+    sp_digit t[2 * SP256_DIGITS];
+    sp_digit carry;
+    int err;
+
+    sp_256_from_bin(r, SP256_DIGITS, sig, ECC256_COORD_SIZE);
+    err = SP256(sp_256_mod_mul_norm)(r, r, p256_mod);
+    if (err != MP_OKAY)
+        return err;
+    SP256(sp_256_mont_sqr)(p->z, p->z, p256_mod, p256_mp_mod);
+    SP256(sp_256_mont_mul)(t, r, p->z, p256_mod, p256_mp_mod);
+    *res = (int)(SP256(sp_256_cmp)(p->x, t) == 0);
+    if (*res == 0) {
+        /* x(R) may also be r + order, if smaller than the prime */
+        sp_256_from_bin(r, SP256_DIGITS, sig, ECC256_COORD_SIZE);
+        carry = SP256(sp_256_add)(r, r, p256_order);
+        SP256(sp_256_norm)(r);
+        if ((carry == 0) && (SP256(sp_256_cmp)(r, p256_mod) < 0)) {
+            err = SP256(sp_256_mod_mul_norm)(r, r, p256_mod);
+            if (err != MP_OKAY)
+                return err;
+            SP256(sp_256_mont_mul)(t, r, p->z, p256_mod, p256_mp_mod);
+            *res = (int)(SP256(sp_256_cmp)(p->x, t) == 0);
+        }
+    }
+    return 0;
+}
+
+/* Verify the signature (r | s) of the digest 'hash' with the embedded key.
+ * '*res' is set to 1 if the signature is valid. Returns 0, or a negative
+ * error code.
+ */
+int ecc256_verify_table(const uint8_t *hash, const uint8_t *sig, int *res)
+{
+    sp_digit u1[2 * SP256_DIGITS];
+    sp_digit u2[2 * SP256_DIGITS];
+    sp_digit s[2 * SP256_DIGITS];
+    int err;
+
+    *res = 0;
+    err = ecc256_load_s(sig, s);
+    if (err <= 0)
+        return err;
+    SP256(sp_256_mont_inv_order)(s, s, ecc256_tmp);
+    ecc256_scalars(hash, sig, s, u1, u2);
+
+    /* R = u1.G + u2.Q */
+    if (ecc256_comb(u1, u2))
+        return 0;
+    return ecc256_check_x(&ecc256_r, sig, res);
+}
+
+#ifdef WOLFBOOT_VERIFY_BATCH
+/* s of each signature, and the products s_0...s_i (Montgomery form) */
+static sp_digit ecc256_s[WOLFBOOT_VERIFY_BATCH_MAX][2 * SP256_DIGITS];
+static sp_digit ecc256_prod[WOLFBOOT_VERIFY_BATCH_MAX][2 * SP256_DIGITS];
+/* u1.G + u2.Q combined for all signatures, and z_i.R_i */
+static sp_point_256 ecc256_c;
+static sp_point_256 ecc256_d[WOLFBOOT_VERIFY_BATCH_MAX];
+
+/* Coefficient b of the curve */
+static const uint8_t ecc256_b[ECC256_COORD_SIZE] = {
+    0x5a, 0xc6, 0x35, 0xd8, 0xaa, 0x3a, 0x93, 0xe7,
+    0xb3, 0xeb, 0xbd, 0x55, 0x76, 0x98, 0x86, 0xbc,
+    0x65, 0x1d, 0x06, 0xb0, 0xcc, 0x53, 0xb0, 0xf6,
+    0x3b, 0xce, 0x3c, 0x3e, 0x27, 0xd2, 0x60, 0x4b
+};
+
+/* a = a + b (mod order) */
+static void ecc256_add_order(sp_digit *a, const sp_digit *b)
+{
+    sp_digit carry;
+
+    carry = SP256(sp_256_add)(a, a, b);
+    SP256(sp_256_norm)(a);
+    if ((carry != 0) || (SP256(sp_256_cmp)(a, p256_order) >= 0)) {
+        (void)SP256(sp_256_sub)(a, a, p256_order);
+        SP256(sp_256_norm)(a);
+    }
+}
+
+/* One of the two points with x == r, affine in Montgomery form.
+ * '*ok' is set to 0 if there is none.
+ */
+static int ecc256_lift_x(sp_point_256 *p, const uint8_t *r, int *ok)
+{
+    sp_digit t[2 * SP256_DIGITS];
+    sp_digit b[2 * SP256_DIGITS];
+    int bit, err;
+
+    XMEMSET(p, 0, sizeof(*p));
+    sp_256_from_bin(p->x, SP256_DIGITS, r, ECC256_COORD_SIZE);
+    err = SP256(sp_256_mod_mul_norm)(p->x, p->x, p256_mod);
+    if (err == MP_OKAY) {
+        sp_256_from_bin(b, SP256_DIGITS, ecc256_b, ECC256_COORD_SIZE);
+        err = SP256(sp_256_mod_mul_norm)(b, b, p256_mod);
+    }
+    if (err != MP_OKAY)
+        return err;
+
+    /* t = x^3 - 3.x + b */
+    SP256(sp_256_mont_sqr)(t, p->x, p256_mod, p256_mp_mod);
+    SP256(sp_256_mont_mul)(t, t, p->x, p256_mod, p256_mp_mod);
+    SP256(sp_256_mont_tpl)(p->y, p->x, p256_mod);
+    SP256(sp_256_mont_sub)(t, t, p->y, p256_mod);
+    SP256(sp_256_mont_add)(t, t, b, p256_mod);
+
+    /* y = t^((prime + 1) / 4): bits 94, 190 and 222 to 253 are set */
+    XMEMCPY(p->y, t, sizeof(t));
+    for (bit = 252; bit >= 0; bit--) {
+        SP256(sp_256_mont_sqr)(p->y, p->y, p256_mod, p256_mp_mod);
+        if ((bit >= 222) || (bit == 190) || (bit == 94))
+            SP256(sp_256_mont_mul)(p->y, p->y, t, p256_mod, p256_mp_mod);
+    }
+    SP256(sp_256_mont_sqr)(b, p->y, p256_mod, p256_mp_mod);
+    *ok = (SP256(sp_256_cmp)(b, t) == 0);
+    XMEMCPY(p->z, p256_norm_mod, sizeof(p256_norm_mod));
+    return 0;
+}
+
+/* r = k.p, for k < 2^(8 * WOLFBOOT_VERIFY_BATCH_Z_SIZE) */
+static void ecc256_mul_z(sp_point_256 *r, const sp_point_256 *p,
+        const sp_digit *k)
+{
+    int bit, inf = 1;
+
+    for (bit = WOLFBOOT_VERIFY_BATCH_Z_SIZE * 8 - 1; bit >= 0; bit--) {
+        if (!inf)
+            SP256(sp_256_proj_point_dbl)(r, r, ecc256_tmp);
+        if ((k[bit / SP256_DIGIT_BITS] >> (bit % SP256_DIGIT_BITS)) & 1) {
+            if (inf)
+                XMEMCPY(r, p, sizeof(*r));
+            else
+                SP256(sp_256_proj_point_add)(r, r, p, ecc256_tmp);
+            inf = 0;
+        }
+    }
+    if (inf)
+        r->infinity = 1;
+}
+
+/* Verify the n signatures 'sig' of the digests 'hash' with the embedded key.
+ * 'z[i]' (i >= 1) points to the WOLFBOOT_VERIFY_BATCH_Z_SIZE bytes
+ * randomizer of signature i.
+ *
+ * With R_i = u1_i.G + u2_i.Q for a valid signature, z_0 = 1:
+ *
+ *     (sum z_i.u1_i).G + (sum z_i.u2_i).Q - sum z_i.R_i == R_0
+ *
+ * The left side costs a single comb. R_i (i >= 1) is recovered from r_i, but
+ * the signature does not tell the sign of its y coordinate: each of the
+ * 2^(n-1) combinations of signs is tried, comparing x with r_0. The
+ * inversions of s_i are shared as well (Montgomery's trick).
+ *
+ * '*res' is set to 1 if all the signatures are valid. If it is 0, at least
+ * one of them is invalid, or is one that the batch cannot handle (x(R_i) ==
+ * r_i + order): the signatures can still be checked one by one.
+ * Returns 0, or a negative error code.
+ */
+int ecc256_verify_table_batch(int n, const uint8_t **hash, const uint8_t **sig,
+        const uint8_t **z, int *res)
+{
+    sp_digit w[2 * SP256_DIGITS];
+    sp_digit inv[2 * SP256_DIGITS];
+    sp_digit u1[2 * SP256_DIGITS];
+    sp_digit u2[2 * SP256_DIGITS];
+    sp_digit k[2 * SP256_DIGITS];
+    sp_digit k1[2 * SP256_DIGITS];
+    sp_digit k2[2 * SP256_DIGITS];
+    int i, signs, ok, err;
+
+    *res = 0;
+    if ((n < 1) || (n > WOLFBOOT_VERIFY_BATCH_MAX))
+        return BAD_FUNC_ARG;
+
+    /* 1 / (s_0...s_n-1), then 1 / s_i from the partial products */
+    for (i = 0; i < n; i++) {
+        err = ecc256_load_s(sig[i], ecc256_s[i]);
+        if (err <= 0)
+            return err;
+        XMEMCPY(ecc256_prod[i], ecc256_s[i], sizeof(ecc256_prod[i]));
+        if (i > 0)
+            SP256(sp_256_mont_mul_order)(ecc256_prod[i], ecc256_prod[i],
+                    ecc256_prod[i - 1]);
+    }
+    SP256(sp_256_mont_inv_order)(inv, ecc256_prod[n - 1], ecc256_tmp);
+
+    /* k1 = sum z_i.u1_i, k2 = sum z_i.u2_i */
+    XMEMSET(k1, 0, sizeof(k1));
+    XMEMSET(k2, 0, sizeof(k2));
+    for (i = n - 1; i >= 0; i--) {
+        if (i > 0) {
+            SP256(sp_256_mont_mul_order)(w, inv, ecc256_prod[i - 1]);
+            SP256(sp_256_mont_mul_order)(inv, inv, ecc256_s[i]);
+        } else {
+            XMEMCPY(w, inv, sizeof(w));
+        }
+        ecc256_scalars(hash[i], sig[i], w, u1, u2);
+        if (i > 0) {
+            /* z_i in Montgomery form */
+            sp_256_from_bin(k, SP256_DIGITS, z[i],
+                    WOLFBOOT_VERIFY_BATCH_Z_SIZE);
+            SP256(sp_256_mul)(k, k, p256_norm_order);
+            err = SP256(sp_256_mod)(k, k, p256_order);
+            if (err != MP_OKAY)
+                return err;
+            SP256(sp_256_norm)(k);
+            SP256(sp_256_mont_mul_order)(u1, u1, k);
+            SP256(sp_256_mont_mul_order)(u2, u2, k);
+        }
+        ecc256_add_order(k1, u1);
+        ecc256_add_order(k2, u2);
+    }
+    if (ecc256_comb(k1, k2))
+        return 0;
+    XMEMCPY(&ecc256_c, &ecc256_r, sizeof(ecc256_c));
+
+    /* z_i.R_i */
+    for (i = 1; i < n; i++) {
+        err = ecc256_lift_x(&ecc256_t, sig[i], &ok);
+        if (err != 0)
+            return err;
+        if (!ok)
+            return 0;
+        sp_256_from_bin(k, SP256_DIGITS, z[i], WOLFBOOT_VERIFY_BATCH_Z_SIZE);
+        ecc256_mul_z(&ecc256_d[i], &ecc256_t, k);
+        if (ecc256_d[i].infinity)
+            return 0;
+    }
+
+    /* C - sum (+/-)z_i.R_i, for each choice of signs */
+    for (signs = 0; signs < (1 << (n - 1)); signs++) {
+        XMEMCPY(&ecc256_r, &ecc256_c, sizeof(ecc256_r));
+        for (i = 1; i < n; i++) {
+            XMEMCPY(&ecc256_t, &ecc256_d[i], sizeof(ecc256_t));
+            if ((signs >> (i - 1)) & 1) {
+                (void)SP256(sp_256_sub)(ecc256_t.y, p256_mod, ecc256_d[i].y);
+                SP256(sp_256_norm)(ecc256_t.y);
+            }
+            SP256(sp_256_proj_point_add)(&ecc256_r, &ecc256_r, &ecc256_t,
+                    ecc256_tmp);
+        }
+        if (SP256(sp_256_iszero)(ecc256_r.z))
+            continue;
+        err = ecc256_check_x(&ecc256_r, sig[0], res);
+        if ((err != 0) || (*res != 0))
+            return err;
+    }
+    return 0;
+}
+#endif /* WOLFBOOT_VERIFY_BATCH */
@@ -0,0 +1,237 @@
+/* ed25519_batch.c
+ *
+ * Batch verification of Ed25519 signatures with the embedded public key
+ * (see wolfBoot_verify_authenticity_batch() in src/image.c).
+ *
+ * Compile with VERIFY_BATCH=1 (default with SIGN=ED25519)
+ *
+ * The n signatures (R_i, S_i) of the digests M_i are checked together, with
+ * a random linear combination: with h_i = H(R_i | A | M_i), z_0 = 1 and the
+ * 128-bit randomizers z_1..z_n-1 provided by the caller,
+ *
+ *     (sum z_i.S_i).B - (sum z_i.h_i).A - sum z_i.R_i == 0
+ *
+ * The multi-scalar multiplication is variable-time (all of its inputs are
+ * public) and shares its doublings between all the terms; the scalars of B
+ * and -A are processed together, with B - A pre-computed (Shamir's trick).
+ * Even a batch of one is faster than wc_ed25519_verify_msg(), whose
+ * ge_low_mem scalar multiplications are constant-time; each additional
+ * signature only adds a 128-bit scalar to the shared loop.
+ *
+ * wc_ed25519_verify_msg() checks S.B - h.A == R without the cofactor. If R
+ * (or A) had a small-order component T, that check fails, but the random
+ * combination above would still cancel z_i.T for about one z_i in 8. R_i and
+ * A must therefore be in the prime-order subgroup (l.P == 0): otherwise the
+ * batch is not used, and the signatures are checked one by one. With that,
+ * the batch accepts the same signatures as wc_ed25519_verify_msg(), except
+ * with a probability of 2^-128 (the size of the randomizers).
+ *
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "loader.h"
+
+#include <wolfssl/wolfcrypt/settings.h>
+#include <wolfssl/wolfcrypt/ge_operations.h>
+#include <wolfssl/wolfcrypt/sha512.h>
+#include <wolfssl/wolfcrypt/error-crypt.h>
+
+#if !defined(ED25519_SMALL)
+#   error "VERIFY_BATCH with ED25519 requires ED25519_SMALL"
+#endif
+
+/* Point arithmetic of wolfcrypt/src/ge_low_mem.c */
+extern const ge_p3 ed25519_base;
+extern const ge_p3 ed25519_neutral;
+void ed25519_add(ge_p3 *r, const ge_p3 *a, const ge_p3 *b);
+void ed25519_double(ge_p3 *r, const ge_p3 *a);
+
+#define ED25519_SCALAR_SIZE     32
+#define ED25519_SCALAR_BITS     253
+#define ED25519_Z_BITS          (WOLFBOOT_VERIFY_BATCH_Z_SIZE * 8)
+
+/* B, -A, B - A, then -R_i. Too large for the stack. */
+static ge_p3 batch_pair[3];
+static ge_p3 batch_r[WOLFBOOT_VERIFY_BATCH_MAX];
+static ge_p3 batch_acc;
+
+/* Order l of the base point, little-endian */
+static const uint8_t ed25519_order[ED25519_SCALAR_SIZE] = {
+    0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58,
+    0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+#define SCALAR_BIT(k, i) (((k)[(i) >> 3] >> ((i) & 7)) & 1)
+
+/* wc_ed25519_verify_msg() compares the encoding of S.B - h.A with R, which
+ * only accepts the canonical encodings of R: reject y >= p, and x == 0 with
+ * the sign bit set (encodings of -0).
+ */
+static int ed25519_r_canonical(const uint8_t *r)
+{
+    int i;
+
+    for (i = 1; i < 31; i++) {
+        if (r[i] != 0xFF)
+            break;
+    }
+    if ((i == 31) && ((r[31] & 0x7F) == 0x7F) && (r[0] >= 0xED))
+        return 0;
+    /* x == 0 for y == 1 and y == p - 1 only */
+    if ((r[31] & 0x80) != 0) {
+        for (i = 1; i < 31; i++) {
+            if (r[i] != 0)
+                break;
+        }
+        if ((i == 31) && (r[0] == 0x01) && (r[31] == 0x80))
+            return 0;
+        for (i = 1; i < 31; i++) {
+            if (r[i] != 0xFF)
+                break;
+        }
+        if ((i == 31) && (r[0] == 0xEC) && (r[31] == 0xFF))
+            return 0;
+    }
+    return 1;
+}
+
+/* h = H(R | A | M) mod l */
+static int ed25519_challenge(uint8_t *h, const uint8_t *sig,
+        const uint8_t *msg, unsigned int msg_len)
+{
+    wc_Sha512 sha;
+    int ret;
+
+    ret = wc_InitSha512(&sha);
+    if (ret == 0)
+        ret = wc_Sha512Update(&sha, sig, ED25519_SCALAR_SIZE);
+    if (ret == 0)
+        ret = wc_Sha512Update(&sha, KEY_BUFFER, ED25519_SCALAR_SIZE);
+    if (ret == 0)
+        ret = wc_Sha512Update(&sha, msg, msg_len);
+    if (ret == 0)
+        ret = wc_Sha512Final(&sha, h);
+    wc_Sha512Free(&sha);
+    if (ret == 0)
+        sc_reduce(h);
+    return ret;
+}
+
+/* (X:Y:Z:T) is the neutral element if X == 0 and Y == Z */
+static int ed25519_is_neutral(ge_p3 *p)
+{
+    uint8_t d[F25519_SIZE];
+    int i;
+    uint8_t acc = 0;
+
+    lm_sub(d, p->Y, p->Z);
+    fe_normalize(d);
+    fe_normalize(p->X);
+    for (i = 0; i < F25519_SIZE; i++)
+        acc |= d[i] | p->X[i];
+    return acc == 0;
+}
+
+/* l.P == 0: P has no small-order component. Uses batch_acc. */
+static int ed25519_torsion_free(const ge_p3 *p)
+{
+    int bit;
+
+    memcpy(&batch_acc, p, sizeof(ge_p3));
+    for (bit = ED25519_SCALAR_BITS - 2; bit >= 0; bit--) {
+        ed25519_double(&batch_acc, &batch_acc);
+        if (SCALAR_BIT(ed25519_order, bit))
+            ed25519_add(&batch_acc, &batch_acc, p);
+    }
+    return ed25519_is_neutral(&batch_acc);
+}
+
+/* Verify the n signatures 'sig' of the 'hash_len' bytes digests 'hash'
+ * with the embedded key. 'z[i]' (i >= 1) points to the
+ * WOLFBOOT_VERIFY_BATCH_Z_SIZE bytes randomizer of signature i.
+ * '*res' is set to 1 if all the signatures are valid. If it is 0, at least
+ * one of them is invalid, or is one that the batch cannot handle: the
+ * signatures can still be checked one by one.
+ * Returns 0, or a negative error code.
+ */
+int ed25519_verify_batch(int n, const uint8_t **hash, unsigned int hash_len,
+        const uint8_t **sig, const uint8_t **z, int *res)
+{
+    uint8_t h[WC_SHA512_DIGEST_SIZE];
+    uint8_t zi[ED25519_SCALAR_SIZE];
+    uint8_t sb[ED25519_SCALAR_SIZE];
+    uint8_t hb[ED25519_SCALAR_SIZE];
+    int i, bit, idx, ret;
+
+    *res = 0;
+    if ((n < 1) || (n > WOLFBOOT_VERIFY_BATCH_MAX))
+        return BAD_FUNC_ARG;
+    if (ge_frombytes_negate_vartime(&batch_pair[1], KEY_BUFFER) != 0)
+        return BAD_FUNC_ARG;
+    if (!ed25519_torsion_free(&batch_pair[1]))
+        return 0;
+
+    /* sb = sum z_i.S_i, hb = sum z_i.h_i (mod l) */
+    memset(sb, 0, sizeof(sb));
+    memset(hb, 0, sizeof(hb));
+    for (i = 0; i < n; i++) {
+        /* S < 2^253, as in wc_ed25519_verify_msg() */
+        if ((sig[i][2 * ED25519_SCALAR_SIZE - 1] & 0xE0) != 0)
+            return 0;
+        if (!ed25519_r_canonical(sig[i]) ||
+                (ge_frombytes_negate_vartime(&batch_r[i], sig[i]) != 0) ||
+                !ed25519_torsion_free(&batch_r[i]))
+            return 0;
+        ret = ed25519_challenge(h, sig[i], hash[i], hash_len);
+        if (ret != 0)
+            return ret;
+        memset(zi, 0, sizeof(zi));
+        if (i == 0)
+            zi[0] = 1;
+        else
+            memcpy(zi, z[i], WOLFBOOT_VERIFY_BATCH_Z_SIZE);
+        sc_muladd(sb, zi, sig[i] + ED25519_SCALAR_SIZE, sb);
+        sc_muladd(hb, zi, h, hb);
+    }
+
+    /* sb.B + hb.(-A) + sum z_i.(-R_i) */
+    memcpy(&batch_pair[0], &ed25519_base, sizeof(ge_p3));
+    ed25519_add(&batch_pair[2], &batch_pair[0], &batch_pair[1]);
+    memcpy(&batch_acc, &ed25519_neutral, sizeof(ge_p3));
+    for (bit = ED25519_SCALAR_BITS - 1; bit >= 0; bit--) {
+        ed25519_double(&batch_acc, &batch_acc);
+        idx = SCALAR_BIT(sb, bit) | (SCALAR_BIT(hb, bit) << 1);
+        if (idx != 0)
+            ed25519_add(&batch_acc, &batch_acc, &batch_pair[idx - 1]);
+        if (bit >= ED25519_Z_BITS)
+            continue;
+        for (i = 1; i < n; i++) {
+            if (SCALAR_BIT(z[i], bit))
+                ed25519_add(&batch_acc, &batch_acc, &batch_r[i]);
+        }
+    }
+    ed25519_add(&batch_acc, &batch_acc, &batch_r[0]);
+    *res = ed25519_is_neutral(&batch_acc);
+    return 0;
+}
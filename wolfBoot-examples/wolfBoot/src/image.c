@@ -23,6 +23,7 @@
 #include "image.h"
 #include "hal.h"
 #include "spi_drv.h"
+#include "profile.h"
 
 #include <wolfssl/wolfcrypt/settings.h>
 
@@ -93,6 +94,9 @@ static int wolfBoot_verify_signature(uint8_t *hash, uint8_t *sig)
     #endif
         ret = -1;
     }
+#elif defined(WOLFBOOT_ECC_TABLE)
+    /* Fixed-key verify with the pre-computed tables */
+    ret = ecc256_verify_table(hash, sig, &verify_res);
 #else
     /* wolfCrypt software ECC verify */
     mp_int r, s;
@@ -293,19 +297,190 @@ static uint16_t get_header_ext(struct wolfBoot_image *img, uint16_t type, uint8_
 
 static uint16_t get_header(struct wolfBoot_image *img, uint16_t type, uint8_t **ptr)
 {
+    uint16_t len;
+    PROFILE_START(WOLFBOOT_PROF_HEADER);
     if (PART_IS_EXT(img))
-        return get_header_ext(img, type, ptr);
+        len = get_header_ext(img, type, ptr);
     else
-        return wolfBoot_find_header(img->hdr + IMAGE_HEADER_OFFSET, type, ptr);
+        len = wolfBoot_find_header(img->hdr + IMAGE_HEADER_OFFSET, type, ptr);
+    PROFILE_END(WOLFBOOT_PROF_HEADER);
+    return len;
 }
 
+#ifdef COMPRESSED_IMAGES
+/* Size of the compressed payload, or 0 if the payload is stored as is or
+ * the compression parameters are not supported.
+ */
+uint32_t wolfBoot_get_compressed_size(struct wolfBoot_image *img)
+{
+    uint8_t *tlv = NULL;
+    uint32_t size;
+    if (get_header(img, HDR_IMG_COMPRESSED, &tlv) != COMPRESS_TLV_LEN)
+        return 0;
+    size = tlv[4] | (tlv[5] << 8) | (tlv[6] << 16) | ((uint32_t)tlv[7] << 24);
+    if ((tlv[0] != COMPRESS_ALGO_LZSS) ||
+            (tlv[1] < COMPRESS_WINDOW_BITS_MIN) ||
+            (tlv[1] > COMPRESS_WINDOW_BITS_MAX) ||
+            (tlv[2] < COMPRESS_LOOKAHEAD_BITS_MIN) || (tlv[2] >= tlv[1]) ||
+            (size == 0) || (size > WOLFBOOT_PARTITION_SIZE - IMAGE_HEADER_SIZE))
+        return 0;
+    return size;
+}
+
+int wolfBoot_decompress_init(struct wolfBoot_decompress *d,
+        struct wolfBoot_image *img)
+{
+    uint8_t *tlv = NULL;
+    memset(d, 0, sizeof(struct wolfBoot_decompress));
+    d->in_size = wolfBoot_get_compressed_size(img);
+    if (d->in_size == 0)
+        return -1;
+    get_header(img, HDR_IMG_COMPRESSED, &tlv);
+    d->img = img;
+    d->window_bits = tlv[1];
+    d->lookahead_bits = tlv[2];
+    return 0;
+}
+
+static int decompress_bits(struct wolfBoot_decompress *d, uint8_t n,
+        uint16_t *val)
+{
+    uint32_t len;
+    while (d->n_bits < n) {
+        if (d->in_idx == d->in_len) {
+            len = d->in_size - d->in_pos;
+            if (len == 0)
+                return -1;
+            if (len > sizeof(d->in_buf))
+                len = sizeof(d->in_buf);
+#ifdef EXT_FLASH
+            if (PART_IS_EXT(d->img))
+                ext_flash_check_read((uintptr_t)(d->img->fw_base) + d->in_pos,
+                        d->in_buf, len);
+            else
+#endif
+                memcpy(d->in_buf, d->img->fw_base + d->in_pos, len);
+            d->in_pos += len;
+            d->in_len = (uint8_t)len;
+            d->in_idx = 0;
+        }
+        d->bits = (d->bits << 8) | d->in_buf[d->in_idx++];
+        d->n_bits += 8;
+    }
+    d->n_bits -= n;
+    *val = (uint16_t)((d->bits >> d->n_bits) & ((1U << n) - 1));
+    return 0;
+}
+
+/* Decompress the next 'len' bytes of the payload to 'out' (or skip them,
+ * if 'out' is NULL). Returns 'len', or -1 if the stream is corrupted.
+ */
+int wolfBoot_decompress(struct wolfBoot_decompress *d, uint8_t *out,
+        uint32_t len)
+{
+    const uint32_t mask = (1U << d->window_bits) - 1;
+    uint16_t val;
+    uint32_t i;
+    uint8_t b = 0;
+
+    if ((d->img == NULL) || (len > d->img->fw_size - d->out_pos))
+        return -1;
+    for (i = 0; i < len; i++) {
+        if (d->ref_count == 0) {
+            if (decompress_bits(d, 1, &val) < 0)
+                return -1;
+            if (val) {
+                if (decompress_bits(d, 8, &val) < 0)
+                    return -1;
+                b = (uint8_t)val;
+            } else {
+                if (decompress_bits(d, d->window_bits, &val) < 0)
+                    return -1;
+                d->ref_dist = val + 1;
+                if (decompress_bits(d, d->lookahead_bits, &val) < 0)
+                    return -1;
+                d->ref_count = val + 1;
+            }
+        }
+        if (d->ref_count > 0) {
+            b = d->window[(d->head - d->ref_dist) & mask];
+            d->ref_count--;
+        }
+        d->window[d->head & mask] = b;
+        d->head++;
+        if (out)
+            out[i] = b;
+    }
+    d->out_pos += len;
+    return (int)len;
+}
+
+/* Move to position 'pos' of the decompressed payload. Going backwards
+ * restarts from the beginning of the stream.
+ */
+int wolfBoot_decompress_seek(struct wolfBoot_decompress *d, uint32_t pos)
+{
+    if ((pos < d->out_pos) && (wolfBoot_decompress_init(d, d->img) < 0))
+        return -1;
+    if (wolfBoot_decompress(d, NULL, pos - d->out_pos) < 0)
+        return -1;
+    return 0;
+}
+
+/* Set by verify_integrity while the digest of a compressed image is
+ * computed: get_sha_block returns the decompressed payload.
+ */
+static struct wolfBoot_decompress hash_dctx;
+static int hash_decompress = 0;
+#endif /* COMPRESSED_IMAGES */
+
+#if defined(COMPRESSED_IMAGES) || defined(EXT_FLASH)
+/* Set by verify_integrity when the payload is loaded to RAM while its
+ * digest is computed: get_sha_block copies the payload to 'hash_copy_dst',
+ * and returns blocks from the copy. Payloads on external flash are read in
+ * chunks of WOLFBOOT_LOAD_CHUNK_SIZE, so each byte crosses the bus once,
+ * and the digest covers the bytes that are going to be executed.
+ */
+#ifndef WOLFBOOT_LOAD_CHUNK_SIZE
+#define WOLFBOOT_LOAD_CHUNK_SIZE 4096
+#endif
+static uint8_t *hash_copy_dst = NULL;
+static uint32_t hash_copy_end = 0;
+#endif
+
 static uint8_t ext_hash_block[WOLFBOOT_SHA_BLOCK_SIZE];
 static uint8_t digest[WOLFBOOT_SHA_DIGEST_SIZE];
 static uint8_t *get_sha_block(struct wolfBoot_image *img, uint32_t offset)
 {
     if (offset > img->fw_size)
         return NULL;
+#ifdef COMPRESSED_IMAGES
+    if (hash_decompress) {
+        uint8_t *blk = ext_hash_block;
+        uint32_t len = img->fw_size - offset;
+        if (len > WOLFBOOT_SHA_BLOCK_SIZE)
+            len = WOLFBOOT_SHA_BLOCK_SIZE;
+        if (hash_copy_dst != NULL)
+            blk = hash_copy_dst + offset;
+        if ((wolfBoot_decompress_seek(&hash_dctx, offset) < 0) ||
+                (wolfBoot_decompress(&hash_dctx, blk, len) < 0))
+            return NULL;
+        return blk;
+    }
+#endif
 #ifdef EXT_FLASH
+    if (PART_IS_EXT(img) && (hash_copy_dst != NULL)) {
+        if (offset >= hash_copy_end) {
+            uint32_t len = img->fw_size - offset;
+            if (len > WOLFBOOT_LOAD_CHUNK_SIZE)
+                len = WOLFBOOT_LOAD_CHUNK_SIZE;
+            if (ext_flash_check_read((uintptr_t)(img->fw_base) + offset,
+                        hash_copy_dst + offset, len) < 0)
+                return NULL;
+            hash_copy_end = offset + len;
+        }
+        return hash_copy_dst + offset;
+    }
     if (PART_IS_EXT(img)) {
         ext_flash_check_read((uintptr_t)(img->fw_base) + offset, ext_hash_block, WOLFBOOT_SHA_BLOCK_SIZE);
         return ext_hash_block;
@@ -411,7 +586,12 @@ static int image_sha256(struct wolfBoot_image *img, uint8_t *hash)
         wc_Sha256Update(&sha256_ctx, p, blksz);
         p += blksz;
     }
-    do {
+#ifdef MERKLE_TREE
+    /* The payload is covered by the merkle root in the header */
+    if (wolfBoot_get_merkle_block_size(img) != 0)
+        position = img->fw_size;
+#endif
+    while (position < img->fw_size) {
         p = get_sha_block(img, position);
         if (p == NULL)
             break;
@@ -420,7 +600,7 @@ static int image_sha256(struct wolfBoot_image *img, uint8_t *hash)
             blksz = img->fw_size - position;
         wc_Sha256Update(&sha256_ctx, p, blksz);
         position += blksz;
-    } while(position < img->fw_size);
+    }
 
     wc_Sha256Final(&sha256_ctx, hash);
     return 0;
@@ -494,7 +674,12 @@ static int image_sha3_384(struct wolfBoot_image *img, uint8_t *hash)
         wc_Sha3_384_Update(&sha3_ctx, p, blksz);
         p += blksz;
     }
-    do {
+#ifdef MERKLE_TREE
+    /* The payload is covered by the merkle root in the header */
+    if (wolfBoot_get_merkle_block_size(img) != 0)
+        position = img->fw_size;
+#endif
+    while (position < img->fw_size) {
         p = get_sha_block(img, position);
         if (p == NULL)
             break;
@@ -503,7 +688,7 @@ static int image_sha3_384(struct wolfBoot_image *img, uint8_t *hash)
             blksz = img->fw_size - position;
         wc_Sha3_384_Update(&sha3_ctx, p, blksz);
         position += blksz;
-    } while(position < img->fw_size);
+    }
 
     wc_Sha3_384_Final(&sha3_ctx, hash);
     return 0;
@@ -527,6 +712,245 @@ static void key_sha3_384(uint8_t *hash)
 }
 #endif /* SHA3-384 */
 
+#if defined(MERKLE_TREE) || defined(VERIFY_CACHE) || defined(MULTI_IMAGE) || \
+    defined(WOLFBOOT_VERIFY_BATCH)
+/* Generic streaming hash, using the algorithm selected for the images */
+#if defined(WOLFBOOT_HASH_SHA256)
+typedef wc_Sha256 wb_hash_t;
+#   define WB_HASH_BLOCK_SIZE           WC_SHA256_BLOCK_SIZE
+#   define wb_hash_init(h)              wc_InitSha256(h)
+#   define wb_hash_update(h, d, l)      wc_Sha256Update(h, d, l)
+#   define wb_hash_final(h, o)          wc_Sha256Final(h, o)
+#elif defined(WOLFBOOT_HASH_SHA3_384)
+typedef wc_Sha3 wb_hash_t;
+#   define WB_HASH_BLOCK_SIZE           WC_SHA3_384_BLOCK_SIZE
+#   define wb_hash_init(h)              wc_InitSha3_384(h, NULL, INVALID_DEVID)
+#   define wb_hash_update(h, d, l)      wc_Sha3_384_Update(h, d, l)
+#   define wb_hash_final(h, o)          wc_Sha3_384_Final(h, o)
+#endif
+#endif /* MERKLE_TREE || VERIFY_CACHE || MULTI_IMAGE || VERIFY_BATCH */
+
+#ifdef MERKLE_TREE
+#if defined(WOLFBOOT_TPM) && defined(WOLFBOOT_HASH_TPM)
+#error "MERKLE_TREE is not supported in combination with WOLFBOOT_HASH_TPM"
+#endif
+
+/* Merkle tree over the firmware payload, split in blocks of fixed size:
+ *   - leaf:       H(0x00 | block)
+ *   - inner node: H(0x01 | left | right)
+ * A node without a sibling is promoted to the upper level as it is.
+ * The tree is computed on the fly, keeping only one pending node per level.
+ */
+#define MERKLE_MAX_DEPTH 32
+
+static struct merkle_ctx {
+    wb_hash_t leaf;
+    uint32_t block_size;
+    uint32_t fill;
+    uint32_t depth;
+    uint8_t level[MERKLE_MAX_DEPTH];
+    uint8_t node[MERKLE_MAX_DEPTH][WOLFBOOT_SHA_DIGEST_SIZE];
+} merkle;
+
+static void merkle_leaf_start(void)
+{
+    const uint8_t prefix = 0x00;
+    wb_hash_init(&merkle.leaf);
+    wb_hash_update(&merkle.leaf, &prefix, 1);
+    merkle.fill = 0;
+}
+
+/* Replace the two topmost pending nodes with their parent */
+static void merkle_merge(void)
+{
+    const uint8_t prefix = 0x01;
+    wb_hash_t h;
+    uint8_t *left = merkle.node[merkle.depth - 2];
+    uint8_t *right = merkle.node[merkle.depth - 1];
+    wb_hash_init(&h);
+    wb_hash_update(&h, &prefix, 1);
+    wb_hash_update(&h, left, WOLFBOOT_SHA_DIGEST_SIZE);
+    wb_hash_update(&h, right, WOLFBOOT_SHA_DIGEST_SIZE);
+    wb_hash_final(&h, left);
+    merkle.level[merkle.depth - 2]++;
+    merkle.depth--;
+}
+
+static int merkle_leaf_end(void)
+{
+    if (merkle.depth >= MERKLE_MAX_DEPTH)
+        return -1;
+    wb_hash_final(&merkle.leaf, merkle.node[merkle.depth]);
+    merkle.level[merkle.depth++] = 0;
+    while ((merkle.depth > 1) &&
+            (merkle.level[merkle.depth - 1] == merkle.level[merkle.depth - 2]))
+        merkle_merge();
+    return 0;
+}
+
+static int merkle_update(const uint8_t *data, uint32_t len)
+{
+    uint32_t chunk;
+    while (len > 0) {
+        chunk = merkle.block_size - merkle.fill;
+        if (chunk > len)
+            chunk = len;
+        wb_hash_update(&merkle.leaf, data, chunk);
+        merkle.fill += chunk;
+        data += chunk;
+        len -= chunk;
+        if (merkle.fill == merkle.block_size) {
+            if (merkle_leaf_end() < 0)
+                return -1;
+            merkle_leaf_start();
+        }
+    }
+    return 0;
+}
+
+uint32_t wolfBoot_get_merkle_block_size(struct wolfBoot_image *img)
+{
+    uint32_t *block_size = NULL;
+    if (get_header(img, HDR_MERKLE_BLOCK_SIZE, (void *)&block_size) != sizeof(uint32_t))
+        return 0;
+    return *block_size;
+}
+
+/* Compute the merkle root of the payload, and compare it with the one stored
+ * in the header. If 'dst' is not NULL, the payload is copied to 'dst' while
+ * it is being hashed, so each block is read from flash only once.
+ */
+static int merkle_verify(struct wolfBoot_image *img, uint8_t *dst)
+{
+    uint8_t *stored_root;
+    uint32_t block_size, pos = 0, len;
+    uint8_t *p;
+
+    block_size = wolfBoot_get_merkle_block_size(img);
+    if ((block_size == 0) || (block_size > WOLFBOOT_PARTITION_SIZE))
+        return -1;
+    if (get_header(img, HDR_MERKLE_ROOT, &stored_root) != WOLFBOOT_SHA_DIGEST_SIZE)
+        return -1;
+    merkle.block_size = block_size;
+    merkle.depth = 0;
+    merkle_leaf_start();
+    while (pos < img->fw_size) {
+        if (dst) {
+            len = block_size;
+            if (pos + len > img->fw_size)
+                len = img->fw_size - pos;
+            p = dst + pos;
+#ifdef EXT_FLASH
+            if (PART_IS_EXT(img))
+                ext_flash_check_read((uintptr_t)(img->fw_base) + pos, p, len);
+            else
+#endif
+                memcpy(p, img->fw_base + pos, len);
+        } else {
+            p = get_sha_block(img, pos);
+            if (p == NULL)
+                return -1;
+            len = WOLFBOOT_SHA_BLOCK_SIZE;
+            if (pos + len > img->fw_size)
+                len = img->fw_size - pos;
+        }
+        if (merkle_update(p, len) < 0)
+            return -1;
+        pos += len;
+    }
+    if (((merkle.fill > 0) || (merkle.depth == 0)) && (merkle_leaf_end() < 0))
+        return -1;
+    while (merkle.depth > 1)
+        merkle_merge();
+    if (memcmp(merkle.node[0], stored_root, WOLFBOOT_SHA_DIGEST_SIZE) != 0)
+        return -1;
+    return 0;
+}
+#endif /* MERKLE_TREE */
+
+#ifdef MULTI_IMAGE
+/* Components listed in the manifest (HDR_COMPONENTS) are hashed while the
+ * main image is, on the secondary cores when the architecture provides them
+ * (see arch_secondary_start). The components must be memory-mapped.
+ */
+#if !defined(WOLFBOOT_COMPONENT_ADDRESS) || !defined(WOLFBOOT_COMPONENT_SIZE)
+#   error "MULTI_IMAGE requires WOLFBOOT_COMPONENT_ADDRESS and WOLFBOOT_COMPONENT_SIZE"
+#endif
+
+struct component_job {
+    const uint8_t *entry;
+    const uint8_t *base;
+    uint32_t size;
+    uint8_t digest[WOLFBOOT_SHA_DIGEST_SIZE];
+};
+
+static struct component_job comp_job[WOLFBOOT_COMPONENTS];
+
+static uint32_t le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void component_hash(void *arg)
+{
+    struct component_job *job = (struct component_job *)arg;
+    wb_hash_t h;
+    wb_hash_init(&h);
+    wb_hash_update(&h, job->base, job->size);
+    wb_hash_final(&h, job->digest);
+}
+
+/* Parse the manifest and start hashing the components. Returns the number
+ * of components, or -1 if the manifest is invalid.
+ */
+static int components_start(struct wolfBoot_image *img)
+{
+    uint8_t *manifest;
+    uint16_t len;
+    uint32_t seen = 0;
+    int i, n;
+
+    len = get_header(img, HDR_COMPONENTS, &manifest);
+    if (len == 0)
+        return 0;
+    if ((len % WOLFBOOT_COMPONENT_ENTRY_SIZE) != 0)
+        return -1;
+    n = len / WOLFBOOT_COMPONENT_ENTRY_SIZE;
+    if (n > WOLFBOOT_COMPONENTS)
+        return -1;
+    for (i = 0; i < n; i++) {
+        const uint8_t *entry = manifest + i * WOLFBOOT_COMPONENT_ENTRY_SIZE;
+        if ((entry[0] >= WOLFBOOT_COMPONENTS) || (entry[1] > 1) ||
+                ((seen & (1U << entry[0])) != 0) ||
+                (le32(entry + 8) > WOLFBOOT_COMPONENT_SIZE))
+            return -1;
+        seen |= 1U << entry[0];
+        comp_job[i].entry = entry;
+        comp_job[i].base = (const uint8_t *)(uintptr_t)
+            WOLFBOOT_COMPONENT_SLOT_ADDRESS(entry[0], entry[1]);
+        comp_job[i].size = le32(entry + 8);
+    }
+    for (i = 0; i < n; i++) {
+        if (arch_secondary_start(component_hash, &comp_job[i]) < 0)
+            component_hash(&comp_job[i]);
+    }
+    return n;
+}
+
+/* Wait for the jobs started by components_start, and check the digests */
+static int components_check(int n)
+{
+    int i, ret = 0;
+    arch_secondary_wait();
+    for (i = 0; i < n; i++) {
+        if (memcmp(comp_job[i].digest, comp_job[i].entry + 12,
+                    WOLFBOOT_SHA_DIGEST_SIZE) != 0)
+            ret = -1;
+    }
+    return ret;
+}
+#endif /* MULTI_IMAGE */
+
 #ifdef WOLFBOOT_TPM
 
 static int TPM2_IoCb(TPM2_CTX* ctx, const byte* txBuf, byte* rxBuf,
@@ -534,14 +958,8 @@ static int TPM2_IoCb(TPM2_CTX* ctx, const byte* txBuf, byte* rxBuf,
 {
     (void)userCtx;
     (void)ctx;
-    word16 i;
     spi_cs_on(SPI_CS_TPM);
-    memset(rxBuf, 0, xferSz);
-    for (i = 0; i < xferSz; i++)
-    {
-        spi_write(txBuf[i]);
-        rxBuf[i] = spi_read();
-    }
+    spi_xfer(txBuf, rxBuf, xferSz);
     spi_cs_off(SPI_CS_TPM);
     /*
     printf("\r\nSPI TX: ");
@@ -610,7 +1028,7 @@ int wolfBoot_tpm2_init(void)
 #endif /* WOLFBOOT_TPM */
 
 
-int wolfBoot_open_image(struct wolfBoot_image *img, uint8_t part)
+static int open_image(struct wolfBoot_image *img, uint8_t part)
 {
     uint32_t *magic;
     uint32_t *size;
@@ -681,14 +1099,66 @@ int wolfBoot_open_image(struct wolfBoot_image *img, uint8_t part)
     return 0;
 }
 
-int wolfBoot_verify_integrity(struct wolfBoot_image *img)
+int wolfBoot_open_image(struct wolfBoot_image *img, uint8_t part)
+{
+    int ret;
+    PROFILE_START(WOLFBOOT_PROF_OPEN_IMAGE);
+    ret = open_image(img, part);
+    PROFILE_END(WOLFBOOT_PROF_OPEN_IMAGE);
+    return ret;
+}
+
+static int verify_integrity(struct wolfBoot_image *img, uint8_t *dst)
 {
     uint8_t *stored_sha;
     uint16_t stored_sha_len;
+    int ret;
+#ifdef MULTI_IMAGE
+    int n_components;
+#endif
+#ifdef COMPRESSED_IMAGES
+    int compressed = 0;
+#endif
     stored_sha_len = get_header(img, WOLFBOOT_SHA_HDR, &stored_sha);
     if (stored_sha_len != WOLFBOOT_SHA_DIGEST_SIZE)
         return -1;
-    if (image_hash(img, digest) != 0)
+#ifdef COMPRESSED_IMAGES
+    if (wolfBoot_get_compressed_size(img) != 0) {
+#ifdef MERKLE_TREE
+        if (wolfBoot_get_merkle_block_size(img) != 0)
+            return -1;
+#endif
+        if (wolfBoot_decompress_init(&hash_dctx, img) < 0)
+            return -1;
+        compressed = 1;
+    }
+#endif
+#ifdef MULTI_IMAGE
+    n_components = components_start(img);
+    if (n_components < 0)
+        return -1;
+#endif
+#ifdef COMPRESSED_IMAGES
+    hash_decompress = compressed;
+#endif
+#if defined(COMPRESSED_IMAGES) || defined(EXT_FLASH)
+    hash_copy_dst = dst;
+    hash_copy_end = 0;
+#endif
+    PROFILE_START(WOLFBOOT_PROF_IMAGE_HASH);
+    ret = image_hash(img, digest);
+    PROFILE_END(WOLFBOOT_PROF_IMAGE_HASH);
+#ifdef COMPRESSED_IMAGES
+    hash_decompress = 0;
+#endif
+#if defined(COMPRESSED_IMAGES) || defined(EXT_FLASH)
+    hash_copy_dst = NULL;
+#endif
+#ifdef MULTI_IMAGE
+    if ((n_components > 0) && (components_check(n_components) != 0))
+        ret = -1;
+#endif
+    if (ret != 0)
         return -1;
 #if defined(WOLFBOOT_TPM) && defined(WOLFBOOT_MEASURED_BOOT)
     /*
@@ -701,14 +1171,144 @@ int wolfBoot_verify_integrity(struct wolfBoot_image *img)
 #endif
     if (memcmp(digest, stored_sha, stored_sha_len) != 0)
         return -1;
+#ifdef MERKLE_TREE
+    if ((wolfBoot_get_merkle_block_size(img) != 0) && (merkle_verify(img, dst) < 0))
+        return -1;
+#endif
     img->sha_ok = 1;
     img->sha_hash = stored_sha;
     return 0;
 }
 
-int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
+int wolfBoot_verify_integrity(struct wolfBoot_image *img)
 {
-    int ret;
+    return verify_integrity(img, NULL);
+}
+
+#if defined(MERKLE_TREE) || defined(COMPRESSED_IMAGES) || defined(EXT_FLASH)
+/* Same as wolfBoot_verify_integrity, for images containing a merkle tree
+ * or a compressed payload, or stored on external flash. The (decompressed)
+ * payload is copied to 'dst' while being verified.
+ */
+int wolfBoot_verify_integrity_copy(struct wolfBoot_image *img, uint8_t *dst)
+{
+#ifdef COMPRESSED_IMAGES
+    if (wolfBoot_get_compressed_size(img) != 0)
+        return verify_integrity(img, dst);
+#endif
+#ifdef MERKLE_TREE
+    if (wolfBoot_get_merkle_block_size(img) != 0)
+        return verify_integrity(img, dst);
+#endif
+#ifdef EXT_FLASH
+    if (PART_IS_EXT(img))
+        return verify_integrity(img, dst);
+#endif
+    return -1;
+}
+#endif
+
+#ifdef VERIFY_CACHE
+/* Verification cache: once an image has been confirmed (state SUCCESS) and
+ * its signature verified, a MAC over the public key, the partition and the
+ * image header (containing the digest, the public key hint and the signature)
+ * is stored in a dedicated flash sector. The MAC is keyed with a device-unique
+ * secret provided by the HAL. On later boots, after the digest has been
+ * recomputed and checked against the header, a matching MAC replaces the
+ * signature verification. Any update, or change of state, requires a full
+ * verification again.
+ */
+#ifndef WOLFBOOT_VERIFY_CACHE_ADDRESS
+#   error "VERIFY_CACHE requires WOLFBOOT_VERIFY_CACHE_ADDRESS"
+#endif
+#define VERIFY_CACHE_MAGIC       0x43564257 /* WBVC */
+#define VERIFY_CACHE_SECRET_SIZE 32
+
+struct verify_cache_record {
+    uint32_t magic;
+    uint8_t mac[WOLFBOOT_SHA_DIGEST_SIZE];
+};
+
+static struct verify_cache_record cache_rec;
+
+/* HMAC(secret, KEY_BUFFER | part | header) */
+static int verify_cache_mac(struct wolfBoot_image *img, uint8_t *mac)
+{
+    uint8_t pad[WB_HASH_BLOCK_SIZE];
+    uint8_t secret[VERIFY_CACHE_SECRET_SIZE];
+    wb_hash_t h;
+    int i;
+
+    if (hal_device_secret(secret, VERIFY_CACHE_SECRET_SIZE) != 0)
+        return -1;
+    memset(pad, 0x36, WB_HASH_BLOCK_SIZE);
+    for (i = 0; i < VERIFY_CACHE_SECRET_SIZE; i++)
+        pad[i] ^= secret[i];
+    wb_hash_init(&h);
+    wb_hash_update(&h, pad, WB_HASH_BLOCK_SIZE);
+    wb_hash_update(&h, KEY_BUFFER, KEY_LEN);
+    wb_hash_update(&h, &img->part, 1);
+    wb_hash_update(&h, get_img_hdr(img), IMAGE_HEADER_SIZE);
+    wb_hash_final(&h, mac);
+    memset(pad, 0x5c, WB_HASH_BLOCK_SIZE);
+    for (i = 0; i < VERIFY_CACHE_SECRET_SIZE; i++)
+        pad[i] ^= secret[i];
+    wb_hash_init(&h);
+    wb_hash_update(&h, pad, WB_HASH_BLOCK_SIZE);
+    wb_hash_update(&h, mac, WOLFBOOT_SHA_DIGEST_SIZE);
+    wb_hash_final(&h, mac);
+    memset(secret, 0, VERIFY_CACHE_SECRET_SIZE);
+    memset(pad, 0, WB_HASH_BLOCK_SIZE);
+    return 0;
+}
+
+/* Returns 0 if the cache holds a valid MAC for the image, 1 if it doesn't
+ * but the image may be cached after a successful verification (the MAC to
+ * store is kept in cache_rec), -1 if the image cannot be cached.
+ */
+static int verify_cache_lookup(struct wolfBoot_image *img)
+{
+    uint8_t st;
+    const struct verify_cache_record *stored =
+        (const struct verify_cache_record *)WOLFBOOT_VERIFY_CACHE_ADDRESS;
+
+    if (!img->sha_ok)
+        return -1;
+    if ((wolfBoot_get_partition_state(img->part, &st) != 0) ||
+            (st != IMG_STATE_SUCCESS))
+        return -1;
+    if (verify_cache_mac(img, cache_rec.mac) != 0)
+        return -1;
+    cache_rec.magic = VERIFY_CACHE_MAGIC;
+    if ((stored->magic == VERIFY_CACHE_MAGIC) &&
+            (memcmp(stored->mac, cache_rec.mac, WOLFBOOT_SHA_DIGEST_SIZE) == 0))
+        return 0;
+    return 1;
+}
+
+static void RAMFUNCTION verify_cache_store(void)
+{
+    hal_flash_unlock();
+    hal_flash_erase(WOLFBOOT_VERIFY_CACHE_ADDRESS, WOLFBOOT_SECTOR_SIZE);
+    hal_flash_write(WOLFBOOT_VERIFY_CACHE_ADDRESS, (void *)&cache_rec,
+            sizeof(cache_rec));
+    hal_flash_lock();
+}
+#endif /* VERIFY_CACHE */
+
+/* Result of authenticity_start() */
+#define AUTH_VERIFY         0 /* The signature must be verified */
+#define AUTH_VERIFY_CACHE   1 /* Same, then the result can be cached */
+#define AUTH_CACHED         2 /* Found in the verification cache */
+
+/* Checks of the header before the verification of the signature: sets
+ * '*sig' to the signature, and '*hash' to the digest of the image.
+ * Returns one of AUTH_*, or -1 on error.
+ */
+static int authenticity_start(struct wolfBoot_image *img, uint8_t **sig,
+        uint8_t **hash)
+{
+    int ret, st;
     uint8_t *stored_signature;
     uint16_t stored_signature_size;
     uint8_t *pubkey_hint;
@@ -722,7 +1322,9 @@ int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
        return -1;
     pubkey_hint_size = get_header(img, HDR_PUBKEY, &pubkey_hint);
     if (pubkey_hint_size == WOLFBOOT_SHA_DIGEST_SIZE) {
+        PROFILE_START(WOLFBOOT_PROF_KEY_HASH);
         key_hash(digest);
+        PROFILE_END(WOLFBOOT_PROF_KEY_HASH);
         if (memcmp(digest, pubkey_hint, WOLFBOOT_SHA_DIGEST_SIZE) != 0)
             return -1;
     }
@@ -732,14 +1334,176 @@ int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
     image_type = (uint16_t)(image_type_buf[0] + (image_type_buf[1] << 8));
     if ((image_type & 0xFF00) != HDR_IMG_TYPE_AUTH)
         return -1;
+    st = AUTH_VERIFY;
+#ifdef VERIFY_CACHE
+    switch (verify_cache_lookup(img)) {
+        case 0:
+            img->signature_ok = 1;
+            return AUTH_CACHED;
+        case 1:
+            st = AUTH_VERIFY_CACHE;
+            break;
+    }
+#endif
     if (img->sha_hash == NULL) {
-        if (image_hash(img, digest) != 0)
+        PROFILE_START(WOLFBOOT_PROF_IMAGE_HASH);
+        ret = image_hash(img, digest);
+        PROFILE_END(WOLFBOOT_PROF_IMAGE_HASH);
+        if (ret != 0)
             return -1;
         img->sha_hash = digest;
     }
-    if ((ret = wolfBoot_verify_signature(img->sha_hash, stored_signature)) != 0)
-        return ret;
+    *sig = stored_signature;
+    *hash = img->sha_hash;
+    return st;
+}
+
+/* The signature of the image has been verified */
+static void authenticity_done(struct wolfBoot_image *img, int st)
+{
+#ifdef VERIFY_CACHE
+    /* Computes the MAC to store again: several images may have been looked
+     * up since (wolfBoot_verify_authenticity_batch())
+     */
+    if ((st == AUTH_VERIFY_CACHE) && (verify_cache_lookup(img) == 1))
+        verify_cache_store();
+#endif
+    (void)st;
     img->signature_ok = 1;
+}
+
+int wolfBoot_verify_authenticity(struct wolfBoot_image *img)
+{
+    int ret, st;
+    uint8_t *sig = NULL, *hash = NULL;
+
+    st = authenticity_start(img, &sig, &hash);
+    if (st < 0)
+        return -1;
+    if (st == AUTH_CACHED)
+        return 0;
+    PROFILE_START(WOLFBOOT_PROF_SIG_VERIFY);
+    ret = wolfBoot_verify_signature(hash, sig);
+    PROFILE_END(WOLFBOOT_PROF_SIG_VERIFY);
+    if (ret != 0)
+        return ret;
+    authenticity_done(img, st);
+    return 0;
+}
+
+#ifdef WOLFBOOT_VERIFY_BATCH
+/* Copies of the digests and signatures of a batch, which may be in shared
+ * buffers (digest, hdr_cpy), and the randomizers.
+ */
+static uint8_t batch_hash[WOLFBOOT_VERIFY_BATCH_MAX][WOLFBOOT_SHA_DIGEST_SIZE];
+static uint8_t batch_sig[WOLFBOOT_VERIFY_BATCH_MAX][IMAGE_SIGNATURE_SIZE];
+static uint8_t batch_z[WOLFBOOT_VERIFY_BATCH_MAX][WOLFBOOT_SHA_DIGEST_SIZE];
+
+/* z_i = H(i | public key | digests | signatures), truncated to
+ * WOLFBOOT_VERIFY_BATCH_Z_SIZE bytes: derived from all the inputs, the
+ * randomizers cannot be anticipated when crafting the signatures.
+ */
+static void verify_batch_randomizers(int n)
+{
+    wb_hash_t h;
+    uint8_t idx;
+
+    for (idx = 1; idx < n; idx++) {
+        wb_hash_init(&h);
+        wb_hash_update(&h, &idx, 1);
+        wb_hash_update(&h, KEY_BUFFER, KEY_LEN);
+        wb_hash_update(&h, (uint8_t *)batch_hash, n * WOLFBOOT_SHA_DIGEST_SIZE);
+        wb_hash_update(&h, (uint8_t *)batch_sig, n * IMAGE_SIGNATURE_SIZE);
+        wb_hash_final(&h, batch_z[idx]);
+    }
+}
+
+/* Verifies the signatures in batch_sig/batch_hash together. If the batch
+ * fails, they are verified one by one: the result is the same as with
+ * wolfBoot_verify_signature(), the batch is only faster when they are all
+ * valid.
+ */
+static int wolfBoot_verify_signature_batch(int n)
+{
+    const uint8_t *hash[WOLFBOOT_VERIFY_BATCH_MAX];
+    const uint8_t *sig[WOLFBOOT_VERIFY_BATCH_MAX];
+    const uint8_t *z[WOLFBOOT_VERIFY_BATCH_MAX];
+    int i, ret, res = 0;
+
+    for (i = 0; i < n; i++) {
+        hash[i] = batch_hash[i];
+        sig[i] = batch_sig[i];
+        z[i] = batch_z[i];
+    }
+    verify_batch_randomizers(n);
+#if defined(WOLFBOOT_SIGN_ED25519)
+    ret = ed25519_verify_batch(n, hash, WOLFBOOT_SHA_DIGEST_SIZE, sig, z,
+            &res);
+#else
+    ret = ecc256_verify_table_batch(n, hash, sig, z, &res);
+#endif
+    if ((ret == 0) && (res == 1))
+        return 0;
+    for (i = 0; i < n; i++) {
+        if (wolfBoot_verify_signature(batch_hash[i], batch_sig[i]) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* wolfBoot_verify_authenticity_batch() for 2 to WOLFBOOT_VERIFY_BATCH_MAX
+ * images
+ */
+static int verify_authenticity_batch(struct wolfBoot_image **img, int n)
+{
+    int st[WOLFBOOT_VERIFY_BATCH_MAX];
+    uint8_t *sig = NULL, *hash = NULL;
+    int i, ret = 0, m = 0;
+
+    for (i = 0; i < n; i++) {
+        st[i] = authenticity_start(img[i], &sig, &hash);
+        if (st[i] < 0)
+            return -1;
+        if (st[i] == AUTH_CACHED)
+            continue;
+        memcpy(batch_sig[m], sig, IMAGE_SIGNATURE_SIZE);
+        memcpy(batch_hash[m], hash, WOLFBOOT_SHA_DIGEST_SIZE);
+        m++;
+    }
+    PROFILE_START(WOLFBOOT_PROF_SIG_VERIFY);
+    if (m == 1)
+        ret = wolfBoot_verify_signature(batch_hash[0], batch_sig[0]);
+    else if (m > 1)
+        ret = wolfBoot_verify_signature_batch(m);
+    PROFILE_END(WOLFBOOT_PROF_SIG_VERIFY);
+    if (ret != 0)
+        return -1;
+    for (i = 0; i < n; i++) {
+        if (st[i] != AUTH_CACHED)
+            authenticity_done(img[i], st[i]);
+    }
+    return 0;
+}
+#endif /* WOLFBOOT_VERIFY_BATCH */
+
+/* Same as wolfBoot_verify_authenticity() on each of the 'n' images, but
+ * with VERIFY_BATCH=1 all the signatures are verified at once. Returns -1
+ * if any of them is not valid. The batch accepts the signatures that are
+ * valid one by one, and only those except with a probability of the order
+ * of 2^-128 (see ed25519_verify_batch() and ecc256_verify_table_batch()).
+ */
+int wolfBoot_verify_authenticity_batch(struct wolfBoot_image **img, int n)
+{
+    int i;
+
+#ifdef WOLFBOOT_VERIFY_BATCH
+    if ((n > 1) && (n <= WOLFBOOT_VERIFY_BATCH_MAX))
+        return verify_authenticity_batch(img, n);
+#endif
+    for (i = 0; i < n; i++) {
+        if (wolfBoot_verify_authenticity(img[i]) != 0)
+            return -1;
+    }
     return 0;
 }
 
@@ -753,3 +1517,32 @@ uint8_t* wolfBoot_peek_image(struct wolfBoot_image *img, uint32_t offset,
         *sz = WOLFBOOT_SHA_BLOCK_SIZE;
     return p;
 }
+
+#ifdef DELTA_UPDATES
+/* Retrieve the position of the forward (or inverse) patch within
+ * the payload of a delta image, and the version of its base image.
+ */
+int wolfBoot_get_delta_info(struct wolfBoot_image *img, int inverse,
+        uint32_t *base_version, uint32_t *patch_offset, uint32_t *patch_size)
+{
+    uint32_t *base = NULL, *off = NULL, *size = NULL;
+
+    if (get_header(img, HDR_IMG_DELTA_BASE, (void *)&base) != sizeof(uint32_t))
+        return -1;
+    if (inverse) {
+        if ((get_header(img, HDR_IMG_DELTA_INVERSE, (void *)&off) != sizeof(uint32_t)) ||
+            (get_header(img, HDR_IMG_DELTA_INVERSE_SIZE, (void *)&size) != sizeof(uint32_t)))
+            return -1;
+        *patch_offset = *off;
+    } else {
+        if (get_header(img, HDR_IMG_DELTA_SIZE, (void *)&size) != sizeof(uint32_t))
+            return -1;
+        *patch_offset = 0;
+    }
+    *base_version = *base;
+    *patch_size = *size;
+    if ((*patch_offset > img->fw_size) || (*patch_size > img->fw_size - *patch_offset))
+        return -1;
+    return 0;
+}
+#endif
@@ -51,6 +51,7 @@
     #define START_FLAGS_OFFSET (ENCRYPT_TMP_SECRET_OFFSET - TRAILER_OVERHEAD)
 #else
     #define XMEMCPY memcpy
+    #define XMEMSET memset
     #define ENCRYPT_TMP_SECRET_OFFSET (WOLFBOOT_PARTITION_SIZE - (TRAILER_SKIP))
 #endif
 
@@ -91,16 +92,175 @@ static const uint32_t wolfboot_magic_trail = WOLFBOOT_MAGIC_TRAIL;
 #define FLAGS_UPDATE_EXT() PARTN_IS_EXT(PART_UPDATE)
 #endif
 
+#if defined(FLAGS_JOURNAL) && !defined(NVM_FLASH_WRITEONCE)
+#error option FLAGS_JOURNAL requires NVM_FLASH_WRITEONCE
+#endif
+
 #ifdef NVM_FLASH_WRITEONCE
 #include <stddef.h>
 #include <string.h>
 static uint8_t NVM_CACHE[NVM_CACHE_SIZE] __attribute__((aligned(16)));
 
+#ifdef FLAGS_JOURNAL
+/*
+ * Journaled trailer (FLAGS_JOURNAL): instead of erasing and reprogramming the
+ * whole trailer sector for every change, each change is appended as a record
+ * to the next erased slot at the beginning of the sector:
+ *
+ *  |R0|R1|R2| ... |Rn| (erased slots) ...  |Sn| ... |S0|PS|  MAGIC  |
+ *   ^-- records, in order of writing        ^-- trailer, as written at the
+ *                                               last compaction
+ *
+ * A record overrides up to 4 bytes of the trailer at the end of the sector:
+ *  | OFFSET IN SECTOR (2B) | LEN (1B) | CHECK (1B) | DATA (4B) | padding |
+ * Records are read in order, so the last one written wins. A record is
+ * programmed with a single write, so each slot is programmed only once.
+ * When all the slots are used, the trailer is compacted: the sector is erased
+ * and the trailer is written back with all the records applied.
+ */
+#ifndef WOLFBOOT_JOURNAL_RECORD_SIZE
+#   define WOLFBOOT_JOURNAL_RECORD_SIZE 8
+#endif
+#if (WOLFBOOT_JOURNAL_RECORD_SIZE < 8) || \
+    ((WOLFBOOT_JOURNAL_RECORD_SIZE & (WOLFBOOT_JOURNAL_RECORD_SIZE - 1)) != 0)
+#   error WOLFBOOT_JOURNAL_RECORD_SIZE must be a power of 2, at least 8
+#endif
+#ifdef WOLFBOOT_FLAGS_INVERT
+#   define JOURNAL_ERASED 0x00
+#else
+#   define JOURNAL_ERASED 0xFF
+#endif
+#define JOURNAL_MAX_LEN 4
+/* Trailer bytes: MAGIC + PART_FLAG + SECTOR FLAGS, twice with FLAGS_HOME */
+#define JOURNAL_TRAILER_SIZE (2 * (4 + 1 + \
+            (WOLFBOOT_PARTITION_SIZE / (2 * WOLFBOOT_SECTOR_SIZE)) + 1))
+/* End of the trailer, relative to the beginning of its sector */
+#define JOURNAL_TRAILER_END (((ENCRYPT_TMP_SECRET_OFFSET - 1) % WOLFBOOT_SECTOR_SIZE) + 1)
+#ifdef WOLFBOOT_JOURNAL_SLOTS
+#   define JOURNAL_SLOTS WOLFBOOT_JOURNAL_SLOTS
+#else
+#   define JOURNAL_SLOTS ((JOURNAL_TRAILER_END - JOURNAL_TRAILER_SIZE) / WOLFBOOT_JOURNAL_RECORD_SIZE)
+#endif
+#if (JOURNAL_SLOTS < 4) || \
+    (JOURNAL_SLOTS * WOLFBOOT_JOURNAL_RECORD_SIZE + JOURNAL_TRAILER_SIZE > JOURNAL_TRAILER_END)
+#   error FLAGS_JOURNAL: no room for the journal in the trailer sector
+#endif
+
+struct journal_record {
+    uint16_t off;
+    uint8_t len;
+    uint8_t check;
+    uint8_t data[JOURNAL_MAX_LEN];
+};
+
+static uint32_t journal_cache;
+
+static uint8_t RAMFUNCTION journal_check(const struct journal_record *r)
+{
+    uint8_t c = 0x5A ^ (uint8_t)r->off ^ (uint8_t)(r->off >> 8) ^ r->len;
+    int i;
+    for (i = 0; i < JOURNAL_MAX_LEN; i++)
+        c ^= r->data[i];
+    return c;
+}
+
+static int RAMFUNCTION journal_slot_erased(uint32_t slot)
+{
+    const uint8_t *p = (const uint8_t *)(uintptr_t)slot;
+    int i;
+    for (i = 0; i < WOLFBOOT_JOURNAL_RECORD_SIZE; i++) {
+        if (p[i] != JOURNAL_ERASED)
+            return 0;
+    }
+    return 1;
+}
+
+static int RAMFUNCTION journal_record_valid(const struct journal_record *r)
+{
+    return (r->len > 0) && (r->len <= JOURNAL_MAX_LEN) &&
+        (r->off + r->len <= JOURNAL_TRAILER_END) &&
+        (r->check == journal_check(r));
+}
+
+/* Apply the records of the journal at 'base' to the copy of the trailer
+ * bytes [off, off + len) in 'buf'. Returns the index of the first erased
+ * slot, or JOURNAL_SLOTS if the journal is full. Incomplete records, e.g.
+ * interrupted by a power failure, are skipped.
+ */
+static uint32_t RAMFUNCTION journal_replay(uint32_t base, uint32_t off,
+        uint8_t *buf, uint32_t len)
+{
+    const struct journal_record *r;
+    uint32_t slot, i;
+    for (slot = 0; slot < JOURNAL_SLOTS; slot++) {
+        uint32_t slot_addr = base + slot * WOLFBOOT_JOURNAL_RECORD_SIZE;
+        if (journal_slot_erased(slot_addr))
+            break;
+        r = (const struct journal_record *)(uintptr_t)slot_addr;
+        if (!journal_record_valid(r))
+            continue;
+        for (i = 0; i < r->len; i++) {
+            if ((r->off + i >= off) && (r->off + i < off + len))
+                buf[r->off + i - off] = r->data[i];
+        }
+    }
+    return slot;
+}
+
+static uint8_t* RAMFUNCTION journal_read(uint32_t addr)
+{
+    uint32_t base = addr & (~(WOLFBOOT_SECTOR_SIZE - 1));
+    XMEMCPY(&journal_cache, (void *)(uintptr_t)addr, sizeof(uint32_t));
+    journal_replay(base, addr - base, (uint8_t *)&journal_cache, sizeof(uint32_t));
+    return (uint8_t *)&journal_cache;
+}
+
+static int RAMFUNCTION journal_write(uint32_t addr, const uint8_t *data, uint32_t len)
+{
+    uint32_t base = addr & (~(WOLFBOOT_SECTOR_SIZE - 1));
+    uint32_t tail = JOURNAL_SLOTS * WOLFBOOT_JOURNAL_RECORD_SIZE;
+    uint32_t slot;
+    union {
+        struct journal_record r;
+        uint8_t raw[WOLFBOOT_JOURNAL_RECORD_SIZE];
+        uint64_t align;
+    } rec;
+    int ret;
+
+    slot = journal_replay(base, 0, NULL, 0);
+    if (slot < JOURNAL_SLOTS) {
+        XMEMSET(rec.raw, JOURNAL_ERASED, sizeof(rec.raw));
+        rec.r.off = (uint16_t)(addr - base);
+        rec.r.len = (uint8_t)len;
+        XMEMSET(rec.r.data, 0, JOURNAL_MAX_LEN);
+        XMEMCPY(rec.r.data, data, len);
+        rec.r.check = journal_check(&rec.r);
+        return hal_flash_write(base + slot * WOLFBOOT_JOURNAL_RECORD_SIZE,
+                rec.raw, WOLFBOOT_JOURNAL_RECORD_SIZE);
+    }
+    /* Journal full: compact. Only the area after the journal is
+     * programmed again, leaving the slots erased. */
+    XMEMCPY(NVM_CACHE, (void *)(uintptr_t)base, WOLFBOOT_SECTOR_SIZE);
+    journal_replay(base, tail, NVM_CACHE + tail, WOLFBOOT_SECTOR_SIZE - tail);
+    XMEMCPY(NVM_CACHE + addr - base, data, len);
+    ret = hal_flash_erase(base, WOLFBOOT_SECTOR_SIZE);
+    if (ret != 0)
+        return ret;
+    return hal_flash_write(base + tail, NVM_CACHE + tail, WOLFBOOT_SECTOR_SIZE - tail);
+}
+
+#   define hal_trailer_read(addr) journal_read(addr)
+#   define hal_trailer_write(addr, val) journal_write(addr, &(val), 1)
+#   define hal_set_partition_magic(addr) \
+        journal_write(addr, (const uint8_t *)&wolfboot_magic_trail, sizeof(uint32_t))
+
+#else
+
 int RAMFUNCTION hal_trailer_write(uint32_t addr, uint8_t val) {
     uint32_t addr_align = addr & (~(WOLFBOOT_SECTOR_SIZE - 1));
     uint32_t addr_off = addr & (WOLFBOOT_SECTOR_SIZE - 1);
     int ret = 0;
-    XMEMCPY(NVM_CACHE, (void *)addr_align, WOLFBOOT_SECTOR_SIZE);
+    XMEMCPY(NVM_CACHE, (void *)(uintptr_t)addr_align, WOLFBOOT_SECTOR_SIZE);
     ret = hal_flash_erase(addr_align, WOLFBOOT_SECTOR_SIZE);
     if (ret != 0)
         return ret;
@@ -114,7 +274,7 @@ int RAMFUNCTION hal_set_partition_magic(uint32_t addr)
     uint32_t off = addr % NVM_CACHE_SIZE;
     uint32_t base = addr - off;
     int ret;
-    XMEMCPY(NVM_CACHE, (void *)base, NVM_CACHE_SIZE);
+    XMEMCPY(NVM_CACHE, (void *)(uintptr_t)base, NVM_CACHE_SIZE);
     ret = hal_flash_erase(base, WOLFBOOT_SECTOR_SIZE);
     if (ret != 0)
         return ret;
@@ -122,12 +282,17 @@ int RAMFUNCTION hal_set_partition_magic(uint32_t addr)
     ret = hal_flash_write(base, NVM_CACHE, WOLFBOOT_SECTOR_SIZE);
     return ret;
 }
+#endif /* FLAGS_JOURNAL */
 
 #else
 #   define hal_trailer_write(addr, val) hal_flash_write(addr, (void *)&val, 1)
 #   define hal_set_partition_magic(addr) hal_flash_write(addr, (void*)&wolfboot_magic_trail, sizeof(uint32_t));
 #endif
 
+#ifndef hal_trailer_read
+#   define hal_trailer_read(addr) ((uint8_t *)(uintptr_t)(addr))
+#endif
+
 #if defined EXT_FLASH
 
 
@@ -138,7 +303,7 @@ static uint8_t* RAMFUNCTION get_trailer_at(uint8_t part, uint32_t at)
             ext_flash_check_read(PART_BOOT_ENDFLAGS - (sizeof(uint32_t) + at), (void *)&ext_cache, sizeof(uint32_t));
             return (uint8_t *)&ext_cache;
         } else {
-            return (void *)(PART_BOOT_ENDFLAGS - (sizeof(uint32_t) + at));
+            return hal_trailer_read(PART_BOOT_ENDFLAGS - (sizeof(uint32_t) + at));
         }
     }
     else if (part == PART_UPDATE) {
@@ -146,7 +311,7 @@ static uint8_t* RAMFUNCTION get_trailer_at(uint8_t part, uint32_t at)
             ext_flash_check_read(PART_UPDATE_ENDFLAGS - (sizeof(uint32_t) + at), (void *)&ext_cache, sizeof(uint32_t));
             return (uint8_t *)&ext_cache;
         } else {
-            return (void *)(PART_UPDATE_ENDFLAGS - (sizeof(uint32_t) + at));
+            return hal_trailer_read(PART_UPDATE_ENDFLAGS - (sizeof(uint32_t) + at));
         }
     } else
         return NULL;
@@ -192,9 +357,9 @@ static void RAMFUNCTION set_partition_magic(uint8_t part)
 static uint8_t* RAMFUNCTION get_trailer_at(uint8_t part, uint32_t at)
 {
     if (part == PART_BOOT)
-        return (void *)(PART_BOOT_ENDFLAGS - (sizeof(uint32_t) + at));
+        return hal_trailer_read(PART_BOOT_ENDFLAGS - (sizeof(uint32_t) + at));
     else if (part == PART_UPDATE) {
-        return (void *)(PART_UPDATE_ENDFLAGS - (sizeof(uint32_t) + at));
+        return hal_trailer_read(PART_UPDATE_ENDFLAGS - (sizeof(uint32_t) + at));
     } else
         return NULL;
 }
@@ -447,7 +612,8 @@ uint32_t wolfBoot_get_blob_version(uint8_t *blob)
     return 0;
 }
 
-uint32_t wolfBoot_get_image_version(uint8_t part)
+/* Header of the image in 'part' (copied to a local buffer if external) */
+static uint8_t *get_image_header(uint8_t part)
 {
     uint8_t *image = (uint8_t *)0x00000000;
     if(part == PART_UPDATE) {
@@ -472,9 +638,55 @@ uint32_t wolfBoot_get_image_version(uint8_t part)
             image = (uint8_t *)WOLFBOOT_PARTITION_BOOT_ADDRESS;
         }
     }
+    return image;
+}
+
+uint32_t wolfBoot_get_image_version(uint8_t part)
+{
     /* Don't check image against NULL to allow using address 0x00000000 */
-    return wolfBoot_get_blob_version(image);
+    return wolfBoot_get_blob_version(get_image_header(part));
+}
+
+#ifdef MULTI_IMAGE
+/* Manifest entry of component 'id' in the image stored in 'part' */
+static uint8_t *get_component_entry(uint8_t part, uint8_t id)
+{
+    uint8_t *image = get_image_header(part);
+    uint8_t *manifest = NULL;
+    uint16_t len, i;
+
+    if (*((uint32_t *)image) != WOLFBOOT_MAGIC)
+        return NULL;
+    len = wolfBoot_find_header(image + IMAGE_HEADER_OFFSET, HDR_COMPONENTS,
+            &manifest);
+    for (i = 0; i + WOLFBOOT_COMPONENT_ENTRY_SIZE <= len;
+            i += WOLFBOOT_COMPONENT_ENTRY_SIZE) {
+        if (manifest[i] == id)
+            return manifest + i;
+    }
+    return NULL;
+}
+
+uint32_t wolfBoot_get_component_version(uint8_t part, uint8_t id)
+{
+    uint8_t *entry = get_component_entry(part, id);
+    if (entry == NULL)
+        return 0;
+    return entry[4] | (entry[5] << 8) | (entry[6] << 16) |
+        ((uint32_t)entry[7] << 24);
+}
+
+/* Address of the slot holding component 'id' for the image in 'part',
+ * or 0 if the image does not list it.
+ */
+uint32_t wolfBoot_get_component_address(uint8_t part, uint8_t id)
+{
+    uint8_t *entry = get_component_entry(part, id);
+    if ((entry == NULL) || (id >= WOLFBOOT_COMPONENTS) || (entry[1] > 1))
+        return 0;
+    return WOLFBOOT_COMPONENT_SLOT_ADDRESS(id, entry[1]);
 }
+#endif /* MULTI_IMAGE */
 
 uint16_t wolfBoot_get_image_type(uint8_t part)
 {
@@ -515,7 +727,24 @@ uint16_t wolfBoot_get_image_type(uint8_t part)
     return 0;
 }
 
-#if defined(ARCH_AARCH64) || defined(DUALBANK_SWAP)
+#if defined(WOLFBOOT_PROFILE) && !defined(__WOLFBOOT)
+/* Boot time profile left by wolfBoot at WOLFBOOT_PROFILE_ADDRESS, or NULL
+ * if there is none (see src/profile.c)
+ */
+const struct wolfBoot_profile *wolfBoot_get_profile(void)
+{
+#ifdef WOLFBOOT_PROFILE_ADDRESS
+    const struct wolfBoot_profile *p =
+        (const struct wolfBoot_profile *)(WOLFBOOT_PROFILE_ADDRESS);
+    if ((p->magic == WOLFBOOT_PROFILE_MAGIC) &&
+            (p->n_phases == WOLFBOOT_PROFILE_PHASES))
+        return p;
+#endif
+    return NULL;
+}
+#endif
+
+#if defined(ARCH_AARCH64) || defined(DUALBANK_SWAP) || defined(SIM_UPDATE_RAM)
 int wolfBoot_fallback_is_possible(void)
 {
     uint32_t boot_v, update_v;
@@ -566,7 +795,7 @@ int wolfBoot_fallback_is_possible(void)
         return 1;
     return 0;
 }
-#endif /* ARCH_AARCH64 || DUALBANK_SWAP */
+#endif /* ARCH_AARCH64 || DUALBANK_SWAP || SIM_UPDATE_RAM */
 
 #ifdef EXT_ENCRYPTED
 #include "encrypt.h"
@@ -589,7 +818,7 @@ static int RAMFUNCTION hal_set_key(const uint8_t *k, const uint8_t *nonce)
     uint32_t addr_off = addr & (WOLFBOOT_SECTOR_SIZE - 1);
     int ret = 0;
     hal_flash_unlock();
-    XMEMCPY(ENCRYPT_CACHE, (void *)addr_align, WOLFBOOT_SECTOR_SIZE);
+    XMEMCPY(ENCRYPT_CACHE, (void *)(uintptr_t)addr_align, WOLFBOOT_SECTOR_SIZE);
     ret = hal_flash_erase(addr_align, WOLFBOOT_SECTOR_SIZE);
     if (ret != 0)
         return ret;
@@ -627,11 +856,20 @@ int RAMFUNCTION wolfBoot_erase_encrypt_key(void)
 
 #ifdef __WOLFBOOT
 
+/* The UPDATE and SWAP partitions are encrypted with a single keystream each,
+ * starting at the beginning of the partition: the byte at offset N is
+ * combined with byte N of the keystream. Any range can then be processed in
+ * one call to the cipher, after positioning the keystream at its offset.
+ */
+#if defined(ENCRYPT_WITH_AES128) || defined(ENCRYPT_WITH_AES256)
+static Aes aes;
+#else
 static ChaCha chacha;
-static int chacha_initialized = 0;
-static uint8_t chacha_iv_nonce[ENCRYPT_NONCE_SIZE];
+#endif
+static int encrypt_initialized = 0;
+static uint8_t encrypt_iv_nonce[ENCRYPT_NONCE_SIZE];
 
-static int chacha_init(void)
+static int encrypt_init(void)
 {
     uint8_t *key = (uint8_t *)(WOLFBOOT_PARTITION_BOOT_ADDRESS + ENCRYPT_TMP_SECRET_OFFSET);
     uint8_t ff[ENCRYPT_KEY_SIZE];
@@ -645,12 +883,104 @@ static int chacha_init(void)
     if (XMEMCMP(key, ff, ENCRYPT_KEY_SIZE) == 0)
         return -1;
 
-    XMEMCPY(chacha_iv_nonce, stored_nonce, ENCRYPT_NONCE_SIZE);
+    XMEMCPY(encrypt_iv_nonce, stored_nonce, ENCRYPT_NONCE_SIZE);
+#if defined(ENCRYPT_WITH_AES128) || defined(ENCRYPT_WITH_AES256)
+    wc_AesInit(&aes, NULL, INVALID_DEVID);
+    /* CTR mode only uses the forward cipher, for both directions */
+    if (wc_AesSetKeyDirect(&aes, key, ENCRYPT_KEY_SIZE, encrypt_iv_nonce,
+                AES_ENCRYPTION) != 0)
+        return -1;
+#else
     wc_Chacha_SetKey(&chacha, key, ENCRYPT_KEY_SIZE);
-    chacha_initialized = 1;
+#endif
+    encrypt_initialized = 1;
     return 0;
 }
 
+#if defined(WOLFBOOT_THUMB2_ASM) && !defined(ENCRYPT_WITH_AES128) && \
+    !defined(ENCRYPT_WITH_AES256)
+/* ChaCha20 block function in Thumb-2 assembly (src/chacha_thumb2.S) */
+void chacha20_block_thumb2(uint32_t *out, const uint32_t *in);
+
+/* Same as wc_Chacha_Process, on the state set up by wolfCrypt: 'left' bytes
+ * of the current block are still unused, the counter is incremented once a
+ * block has been used up.
+ */
+static void chacha_process(ChaCha *ctx, uint8_t *out, const uint8_t *in,
+        uint32_t len)
+{
+    uint32_t ks[CHACHA_CHUNK_WORDS];
+    const uint8_t *ks8 = (const uint8_t *)ks;
+    uint32_t off, n, i;
+
+    while (len > 0) {
+        chacha20_block_thumb2(ks, ctx->X);
+        off = (ctx->left > 0) ? (CHACHA_CHUNK_BYTES - ctx->left) : 0;
+        n = CHACHA_CHUNK_BYTES - off;
+        if (n > len)
+            n = len;
+        if ((n == CHACHA_CHUNK_BYTES) &&
+                ((((uintptr_t)in | (uintptr_t)out) & 3) == 0)) {
+            for (i = 0; i < CHACHA_CHUNK_WORDS; i++)
+                ((uint32_t *)out)[i] = ((const uint32_t *)in)[i] ^ ks[i];
+        } else {
+            for (i = 0; i < n; i++)
+                out[i] = in[i] ^ ks8[off + i];
+        }
+        if (off + n == CHACHA_CHUNK_BYTES) {
+            ctx->X[CHACHA_MATRIX_CNT_IV]++;
+            ctx->left = 0;
+        } else {
+            ctx->left = CHACHA_CHUNK_BYTES - (off + n);
+        }
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
+#endif
+
+/* Encryption and decryption are the same operation on a stream cipher.
+ * 'in' and 'out' may point to the same buffer.
+ */
+static inline void encrypt_process(uint8_t *out, const uint8_t *in, uint32_t len)
+{
+#if defined(ENCRYPT_WITH_AES128) || defined(ENCRYPT_WITH_AES256)
+    wc_AesCtrEncrypt(&aes, out, in, len);
+#elif defined(WOLFBOOT_THUMB2_ASM)
+    chacha_process(&chacha, out, in, len);
+#else
+    wc_Chacha_Process(&chacha, out, in, len);
+#endif
+}
+
+/* Position the keystream at byte 'offset' of the partition */
+static void encrypt_seek(uint32_t offset)
+{
+    uint8_t skip[ENCRYPT_BLOCK_SIZE];
+    uint32_t block = offset / ENCRYPT_BLOCK_SIZE;
+#if defined(ENCRYPT_WITH_AES128) || defined(ENCRYPT_WITH_AES256)
+    uint8_t ctr[ENCRYPT_NONCE_SIZE];
+    uint32_t carry = block;
+    int i;
+
+    /* Initial counter block + block number, big endian */
+    for (i = ENCRYPT_NONCE_SIZE - 1; i >= 0; i--) {
+        carry += encrypt_iv_nonce[i];
+        ctr[i] = (uint8_t)carry;
+        carry >>= 8;
+    }
+    wc_AesSetIV(&aes, ctr);
+    aes.left = 0;
+#else
+    wc_Chacha_SetIV(&chacha, encrypt_iv_nonce, block);
+#endif
+    /* Discard the keystream before 'offset' in the first block */
+    offset &= (ENCRYPT_BLOCK_SIZE - 1);
+    if (offset > 0)
+        encrypt_process(skip, skip, offset);
+}
+
 
 static inline uint8_t part_address(uintptr_t a)
 {
@@ -669,127 +999,71 @@ static inline uint8_t part_address(uintptr_t a)
     return PART_NONE;
 }
 
-int ext_flash_encrypt_write(uintptr_t address, const uint8_t *data, int len)
+/* Offset of 'address' in its partition, or -1 if the area at 'address' is
+ * not encrypted (-2 if it is outside of the external partitions)
+ */
+static int encrypt_offset(uintptr_t address, uint32_t *offset)
 {
-    uint32_t iv_counter;
-    uint8_t block[ENCRYPT_BLOCK_SIZE];
-    uint8_t part;
-    int sz = len;
-    uint32_t row_address = address, row_offset;
-    int i;
-    uint8_t enc_block[ENCRYPT_BLOCK_SIZE];
-    row_offset = address & (ENCRYPT_BLOCK_SIZE - 1);
-    if (row_offset != 0) {
-        row_address = address & ~(ENCRYPT_BLOCK_SIZE - 1);
-        sz += ENCRYPT_BLOCK_SIZE - row_offset;
-    }
-    if (sz < ENCRYPT_BLOCK_SIZE) {
-        sz = ENCRYPT_BLOCK_SIZE;
-    }
-    if (!chacha_initialized)
-        if (chacha_init() < 0)
-            return -1;
-    part = part_address(address);
-    switch(part) {
+    switch(part_address(address)) {
         case PART_UPDATE:
-            iv_counter = (address - WOLFBOOT_PARTITION_UPDATE_ADDRESS) / ENCRYPT_BLOCK_SIZE;
+            *offset = address - WOLFBOOT_PARTITION_UPDATE_ADDRESS;
             /* Do not encrypt last sectors */
-            if (iv_counter >= (START_FLAGS_OFFSET - ENCRYPT_BLOCK_SIZE) / ENCRYPT_BLOCK_SIZE) {
-                return ext_flash_write(address, data, len);
-            }
-            break;
+            if (*offset >= START_FLAGS_OFFSET - ENCRYPT_BLOCK_SIZE)
+                return -1;
+            return 0;
         case PART_SWAP:
-            {
-                uint32_t row_number;
-                row_number = (address - WOLFBOOT_PARTITION_SWAP_ADDRESS) / ENCRYPT_BLOCK_SIZE;
-                iv_counter = row_number;
-                break;
-            }
+            *offset = address - WOLFBOOT_PARTITION_SWAP_ADDRESS;
+            return 0;
         default:
-            return -1;
+            return -2;
     }
-    if (sz > len) {
-        int step = ENCRYPT_BLOCK_SIZE - row_offset;
-        if (ext_flash_read(row_address, block, ENCRYPT_BLOCK_SIZE) != ENCRYPT_BLOCK_SIZE)
+}
+
+int ext_flash_encrypt_write(uintptr_t address, const uint8_t *data, int len)
+{
+    uint32_t offset;
+    int ret, step, pos = 0;
+
+    if (!encrypt_initialized)
+        if (encrypt_init() < 0)
             return -1;
-        XMEMCPY(block + row_offset, data, step);
-        wc_Chacha_SetIV(&chacha, chacha_iv_nonce, iv_counter);
-        wc_Chacha_Process(&chacha, enc_block, block, ENCRYPT_BLOCK_SIZE);
-        ext_flash_write(row_address, enc_block, ENCRYPT_BLOCK_SIZE);
-        address += step;
-        data += step;
-        sz -= step;
-        iv_counter++;
-    }
-    for (i = 0; i < sz / ENCRYPT_BLOCK_SIZE; i++) {
-        wc_Chacha_SetIV(&chacha, chacha_iv_nonce, iv_counter);
-        XMEMCPY(block, data + (ENCRYPT_BLOCK_SIZE * i), ENCRYPT_BLOCK_SIZE);
-        wc_Chacha_Process(&chacha, ENCRYPT_CACHE + (ENCRYPT_BLOCK_SIZE * i), block, ENCRYPT_BLOCK_SIZE);
-        iv_counter++;
+    ret = encrypt_offset(address, &offset);
+    if (ret == -1)
+        return ext_flash_write(address, data, len);
+    if (ret < 0)
+        return -1;
+    encrypt_seek(offset);
+    while (pos < len) {
+        step = len - pos;
+        if (step > NVM_CACHE_SIZE)
+            step = NVM_CACHE_SIZE;
+        encrypt_process(ENCRYPT_CACHE, data + pos, step);
+        ret = ext_flash_write(address + pos, ENCRYPT_CACHE, step);
+        if (ret < 0)
+            return ret;
+        pos += step;
     }
-    return ext_flash_write(address, ENCRYPT_CACHE, len);
+    return 0;
 }
 
 int ext_flash_decrypt_read(uintptr_t address, uint8_t *data, int len)
 {
-    uint32_t iv_counter = 0;
-    uint8_t block[ENCRYPT_BLOCK_SIZE];
-    uint8_t part;
-    int sz = len;
-    uint32_t row_address = address, row_offset;
-    int i;
+    uint32_t offset;
+    int ret;
 
-    row_offset = address & (ENCRYPT_BLOCK_SIZE - 1);
-    if (row_offset != 0) {
-        row_address = address & ~(ENCRYPT_BLOCK_SIZE - 1);
-        sz += ENCRYPT_BLOCK_SIZE - row_offset;
-    }
-    if (sz < ENCRYPT_BLOCK_SIZE) {
-        sz = ENCRYPT_BLOCK_SIZE;
-    }
-    if (!chacha_initialized)
-        if (chacha_init() < 0)
-            return -1;
-    part = part_address(row_address);
-    switch(part) {
-        case PART_UPDATE:
-            iv_counter = (address - WOLFBOOT_PARTITION_UPDATE_ADDRESS) / ENCRYPT_BLOCK_SIZE;
-            /* Do not decrypt last sector */
-            if (iv_counter >= (START_FLAGS_OFFSET - ENCRYPT_BLOCK_SIZE) / ENCRYPT_BLOCK_SIZE) {
-                return ext_flash_read(address, data, len);
-            }
-            break;
-        case PART_SWAP:
-            {
-                uint32_t row_number;
-                row_number = (address - WOLFBOOT_PARTITION_SWAP_ADDRESS) / ENCRYPT_BLOCK_SIZE;
-                iv_counter = row_number;
-                break;
-            }
-        default:
+    if (!encrypt_initialized)
+        if (encrypt_init() < 0)
             return -1;
-    }
-    if (sz > len) {
-        uint8_t dec_block[ENCRYPT_BLOCK_SIZE];
-        int step = ENCRYPT_BLOCK_SIZE - row_offset;
-        if (ext_flash_read(row_address, block, ENCRYPT_BLOCK_SIZE) != ENCRYPT_BLOCK_SIZE)
-            return -1;
-        wc_Chacha_SetIV(&chacha, chacha_iv_nonce, iv_counter);
-        wc_Chacha_Process(&chacha, dec_block, block, ENCRYPT_BLOCK_SIZE);
-        XMEMCPY(data, dec_block + row_offset, step);
-        address += step;
-        data += step;
-        sz -= step;
-        iv_counter++;
-    }
-    if (ext_flash_read(address, data, sz) != sz)
+    ret = encrypt_offset(address, &offset);
+    if (ret == -1)
+        return ext_flash_read(address, data, len);
+    if (ret < 0)
         return -1;
-    for (i = 0; i < sz / ENCRYPT_BLOCK_SIZE; i++) {
-        wc_Chacha_SetIV(&chacha, chacha_iv_nonce, iv_counter);
-        XMEMCPY(block, data + (ENCRYPT_BLOCK_SIZE * i), ENCRYPT_BLOCK_SIZE);
-        wc_Chacha_Process(&chacha, data + (ENCRYPT_BLOCK_SIZE * i), block, ENCRYPT_BLOCK_SIZE);
-        iv_counter++;
-    }
+    if (ext_flash_read(address, data, len) != len)
+        return -1;
+    /* Decrypt in place */
+    encrypt_seek(offset);
+    encrypt_process(data, data, len);
     return len;
 }
 #endif
@@ -24,6 +24,7 @@
 #include "hal.h"
 #include "spi_flash.h"
 #include "uart_flash.h"
+#include "profile.h"
 #include "wolfboot/wolfboot.h"
 
 #ifdef RAM_CODE
@@ -35,6 +36,7 @@ extern void (** const IV_RAM)(void);
 
 int main(void)
 {
+    wolfBoot_profile_init();
     hal_init();
     spi_flash_probe();
 #ifdef UART_FLASH
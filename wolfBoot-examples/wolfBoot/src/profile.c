@@ -0,0 +1,86 @@
+/* profile.c
+ *
+ * Boot time profiling (WOLFBOOT_PROFILE=1).
+ *
+ * Each phase of the boot is timestamped with the architecture cycle
+ * counter (arch_profile_ticks), and accumulated in a table, which is left
+ * in RAM at WOLFBOOT_PROFILE_ADDRESS (if defined) for the application, and
+ * printed via wolfBoot_printf right before booting.
+ *
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+#include <stdint.h>
+#include <string.h>
+#include "wolfboot/wolfboot.h"
+#include "printf.h"
+#include "profile.h"
+
+#ifdef WOLFBOOT_PROFILE_ADDRESS
+#define profile (*((struct wolfBoot_profile *)(WOLFBOOT_PROFILE_ADDRESS)))
+#else
+static struct wolfBoot_profile profile;
+#endif
+
+static uint64_t phase_start[WOLFBOOT_PROFILE_PHASES];
+
+void wolfBoot_profile_init(void)
+{
+    arch_profile_init();
+    memset(&profile, 0, sizeof(profile));
+    profile.magic = WOLFBOOT_PROFILE_MAGIC;
+    profile.n_phases = WOLFBOOT_PROFILE_PHASES;
+    profile.tick_hz = arch_profile_hz();
+    phase_start[WOLFBOOT_PROF_TOTAL] = arch_profile_ticks();
+}
+
+void wolfBoot_profile_start(int phase)
+{
+    phase_start[phase] = arch_profile_ticks();
+}
+
+void wolfBoot_profile_end(int phase)
+{
+    profile.phase[phase].ticks += arch_profile_ticks() - phase_start[phase];
+    profile.phase[phase].calls++;
+}
+
+/* Close the table, and print it. Called after hal_prepare_boot. */
+void wolfBoot_profile_report(void)
+{
+#ifdef PRINTF_ENABLED
+    static const char *name[] = WOLFBOOT_PROFILE_PHASE_NAMES;
+    int i;
+#endif
+    profile.phase[WOLFBOOT_PROF_TOTAL].calls = 0;
+    wolfBoot_profile_end(WOLFBOOT_PROF_TOTAL);
+#ifdef PRINTF_ENABLED
+    wolfBoot_printf("Boot profile (%lu ticks/s):\n", (unsigned long)profile.tick_hz);
+    for (i = 0; i < WOLFBOOT_PROFILE_PHASES; i++) {
+        wolfBoot_printf("  %s: %lu calls, %lu ticks\n", name[i],
+                (unsigned long)profile.phase[i].calls,
+                (unsigned long)profile.phase[i].ticks);
+    }
+#endif
+}
+
+const struct wolfBoot_profile *wolfBoot_get_profile(void)
+{
+    return &profile;
+}
@@ -3,6 +3,11 @@
  * Generic implementation of the read/write/erase
  * functionalities, on top of the spi_drv.h HAL.
  *
+ * The geometry of the chip (erase types, page size, address length) is
+ * discovered from its JEDEC SFDP tables (JESD216) at probe time. Chips
+ * without SFDP are accessed with 4KB sector erase (0x20), 256B pages and
+ * 24-bit addresses.
+ *
  *
  * Copyright (C) 2020 wolfSSL Inc.
  *
@@ -23,6 +28,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
  */
 
+#include <stddef.h>
+#include <string.h>
 #include "spi_drv.h"
 #include "spi_flash.h"
 
@@ -43,11 +50,14 @@
 #define WRDI            0x04
 #define SECTOR_ERASE    0x20
 #define BYTE_READ       0x03
+#define FAST_READ       0x0B
 #define BYTE_WRITE      0x02
 #define AUTOINC         0xAD
 #define EWSR            0x50
 #define EBSY            0x70
 #define DBSY            0x80
+#define READ_SFDP       0x5A
+#define ENTER_4B        0xB7
 
 
 static enum write_mode {
@@ -55,33 +65,63 @@ static enum write_mode {
     SST_SINGLEBYTE = 0x01
 } chip_write_mode = WB_WRITEPAGE;
 
-static void RAMFUNCTION write_address(uint32_t address)
+#define SPI_FLASH_ERASE_TYPES 4
+
+struct spi_flash_erase_type {
+    uint32_t size;
+    uint8_t opcode;
+};
+
+/* Largest erase type first */
+static struct spi_flash_geometry {
+    uint32_t size;          /* 0 if unknown */
+    uint32_t page_size;
+    uint8_t addr_bytes;
+    uint8_t n_erase;
+    struct spi_flash_erase_type erase[SPI_FLASH_ERASE_TYPES];
+} chip = {
+    0, SPI_FLASH_PAGE_SIZE, 3, 1,
+    { { SPI_FLASH_SECTOR_SIZE, SECTOR_ERASE } }
+};
+
+/* Single-byte programming is verified in bursts of this size */
+#ifndef SPI_FLASH_SB_VERIFY_SIZE
+#define SPI_FLASH_SB_VERIFY_SIZE 64
+#endif
+
+/* Opcode and address, sent as a single transfer. The dummy byte of
+ * FAST_READ and READ_SFDP (8 clocks on a single line) is part of it.
+ * SFDP is always addressed with 24 bits.
+ */
+static void RAMFUNCTION send_command(uint8_t cmd, uint32_t address)
 {
-    spi_write((address & 0xFF0000) >> 16);
-    spi_read();
-    spi_write((address & 0xFF00) >> 8);
-    spi_read();
-    spi_write((address & 0xFF));
-    spi_read();
+    uint8_t hdr[6];
+    uint32_t len = 0;
+    hdr[len++] = cmd;
+    if ((chip.addr_bytes == 4) && (cmd != READ_SFDP))
+        hdr[len++] = (address >> 24) & 0xFF;
+    hdr[len++] = (address & 0xFF0000) >> 16;
+    hdr[len++] = (address & 0xFF00) >> 8;
+    hdr[len++] = (address & 0xFF);
+    if ((cmd == FAST_READ) || (cmd == READ_SFDP))
+        hdr[len++] = 0xFF;
+    spi_xfer(hdr, NULL, len);
 }
 
 static uint8_t RAMFUNCTION read_status(void)
 {
-    uint8_t status;
+    uint8_t cmd[2] = { RDSR, 0xFF };
+    uint8_t status[2];
     spi_cs_on(SPI_CS_FLASH);
-    spi_write(RDSR);
-    spi_read();
-    spi_write(0xFF);
-    status = spi_read();
+    spi_xfer(cmd, status, 2);
     spi_cs_off(SPI_CS_FLASH);
-    return status;
+    return status[1];
 }
 
 static void spi_cmd(uint8_t cmd)
 {
     spi_cs_on(SPI_CS_FLASH);
-    spi_write(cmd);
-    spi_read();
+    spi_xfer(&cmd, NULL, 1);
     spi_cs_off(SPI_CS_FLASH);
 }
 
@@ -107,59 +147,196 @@ static void RAMFUNCTION wait_busy(void)
     } while(status & ST_BUSY);
 }
 
+/* One transaction per page: the data never crosses a page boundary, where
+ * the chip would wrap around to the start of the page.
+ */
 static int spi_flash_write_page(uint32_t address, const void *data, int len)
 {
     const uint8_t *buf = data;
+    uint32_t chunk;
     int j = 0;
     while (len > 0) {
+        chunk = chip.page_size - (address & (chip.page_size - 1));
+        if (chunk > (uint32_t)len)
+            chunk = len;
         wait_busy();
         flash_write_enable();
-        wait_busy();
-
         spi_cs_on(SPI_CS_FLASH);
-        spi_write(BYTE_WRITE);
-        spi_read();
-        write_address(address);
-        do {
-            spi_write(buf[j++]);
-            address++;
-            spi_read();
-            len--;
-        } while ((address & (SPI_FLASH_PAGE_SIZE - 1)) != 0);
+        send_command(BYTE_WRITE, address);
+        spi_xfer(buf + j, NULL, chunk);
         spi_cs_off(SPI_CS_FLASH);
+        address += chunk;
+        j += chunk;
+        len -= chunk;
     }
     wait_busy();
     return j;
 }
 
+static void spi_flash_program_byte(uint32_t address, uint8_t byte)
+{
+    flash_write_enable();
+    spi_cs_on(SPI_CS_FLASH);
+    send_command(BYTE_WRITE, address);
+    spi_xfer(&byte, NULL, 1);
+    spi_cs_off(SPI_CS_FLASH);
+    wait_busy();
+}
+
+/* SST chips program a single byte per command. The result is read back
+ * with one burst every SPI_FLASH_SB_VERIFY_SIZE bytes, and the bytes that
+ * still have bits to clear are programmed again.
+ */
 static int spi_flash_write_sb(uint32_t address, const void *data, int len)
 {
     const uint8_t *buf = data;
-    uint8_t verify = 0;
-    int j = 0;
+    uint8_t verify[SPI_FLASH_SB_VERIFY_SIZE];
+    int i, chunk, retry;
     wait_busy();
     if (len < 1)
         return -1;
     while (len > 0) {
-        flash_write_enable();
-        spi_cs_on(SPI_CS_FLASH);
-        spi_write(BYTE_WRITE);
-        spi_read();
-        write_address(address);
-        spi_write(buf[j]);
-        spi_read();
-        spi_cs_off(SPI_CS_FLASH);
-        wait_busy();
-        spi_flash_read(address, &verify, 1);
-        if ((verify & ~(buf[j])) == 0) {
-            if (verify != buf[j])
-                return -1;
-            j++;
-            len--;
-            address++;
+        chunk = len;
+        if (chunk > SPI_FLASH_SB_VERIFY_SIZE)
+            chunk = SPI_FLASH_SB_VERIFY_SIZE;
+        for (i = 0; i < chunk; i++)
+            spi_flash_program_byte(address + i, buf[i]);
+        do {
+            retry = 0;
+            spi_flash_read(address, verify, chunk);
+            for (i = 0; i < chunk; i++) {
+                if (verify[i] == buf[i])
+                    continue;
+                if ((verify[i] & ~(buf[i])) == 0)
+                    return -1;
+                spi_flash_program_byte(address + i, buf[i]);
+                retry++;
+            }
+        } while (retry);
+        buf += chunk;
+        address += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+static uint32_t sfdp_dword(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void sfdp_read(uint32_t address, uint8_t *buf, uint32_t len)
+{
+    spi_cs_on(SPI_CS_FLASH);
+    send_command(READ_SFDP, address);
+    spi_xfer(NULL, buf, len);
+    spi_cs_off(SPI_CS_FLASH);
+}
+
+#define SFDP_SIGNATURE      0x50444653 /* "SFDP" */
+#define SFDP_BFPT_DWORDS    16
+/* JESD216 numbering: DWORD 1 is the first of the table */
+#define BFPT(n)             sfdp_dword(bfpt + 4 * ((n) - 1))
+
+/* Parse the Basic Flash Parameter Table, pointed by the first parameter
+ * header. Only the information needed on a single line bus is used.
+ */
+static int sfdp_probe(void)
+{
+    uint8_t hdr[16];
+    uint8_t bfpt[4 * SFDP_BFPT_DWORDS];
+    uint32_t dwords, ptp, density, size, mode, enter;
+    uint32_t i, j, d, exp;
+    struct spi_flash_erase_type e;
+
+    sfdp_read(0, hdr, sizeof(hdr));
+    if (sfdp_dword(hdr) != SFDP_SIGNATURE)
+        return -1;
+    /* Parameter header 0: ID 0xFF00, major revision 1 */
+    if ((hdr[8] != 0x00) || (hdr[15] != 0xFF) || (hdr[10] != 1))
+        return -1;
+    dwords = hdr[11];
+    if (dwords < 9)
+        return -1;
+    if (dwords > SFDP_BFPT_DWORDS)
+        dwords = SFDP_BFPT_DWORDS;
+    ptp = hdr[12] | (hdr[13] << 8) | (hdr[14] << 16);
+    sfdp_read(ptp, bfpt, 4 * dwords);
+
+    /* DWORD 2: density in bits */
+    density = BFPT(2);
+    if (density & 0x80000000) {
+        exp = density & 0x7FFFFFFF;
+        if ((exp < 3) || (exp > 34))
+            return -1;
+        size = 1UL << (exp - 3);
+    } else {
+        size = (density >> 3) + 1;
+    }
+
+    /* DWORD 8-9: erase types 1 to 4, 2^N bytes, N = 0 if not present */
+    chip.n_erase = 0;
+    for (i = 0; i < SPI_FLASH_ERASE_TYPES; i++) {
+        d = BFPT(8 + (i >> 1)) >> (16 * (i & 1));
+        exp = d & 0xFF;
+        if ((exp == 0) || (exp > 31))
+            continue;
+        e.size = 1UL << exp;
+        e.opcode = (d >> 8) & 0xFF;
+        for (j = chip.n_erase; (j > 0) && (chip.erase[j - 1].size < e.size); j--)
+            chip.erase[j] = chip.erase[j - 1];
+        chip.erase[j] = e;
+        chip.n_erase++;
+    }
+    if (chip.n_erase == 0) {
+        chip.n_erase = 1;
+        chip.erase[0].size = SPI_FLASH_SECTOR_SIZE;
+        chip.erase[0].opcode = SECTOR_ERASE;
+        return -1;
+    }
+    /* Erasing a sector must not erase its neighbours. Without an erase type
+     * of at most WOLFBOOT_SECTOR_SIZE the chip is not used at all: it reads
+     * as erased, and writes and erases fail.
+     */
+    if (chip.erase[chip.n_erase - 1].size > WOLFBOOT_SECTOR_SIZE) {
+        chip.n_erase = 0;
+        return -1;
+    }
+
+    /* DWORD 1, bit 2: write granularity of 64 bytes or more */
+    if (BFPT(1) & (1 << 2))
+        chip_write_mode = WB_WRITEPAGE;
+    else
+        chip_write_mode = SST_SINGLEBYTE;
+
+    /* DWORD 11 (JESD216A): page size, 2^N bytes */
+    if (dwords >= 11)
+        chip.page_size = 1UL << ((BFPT(11) >> 4) & 0x0F);
+
+    /* DWORD 1, bits 18:17: 3-byte only, 3 or 4-byte, 4-byte only.
+     * Chips larger than 16MB are switched to 4-byte addressing, with the
+     * method described in DWORD 16 (JESD216B), or B7h if not described.
+     */
+    mode = (BFPT(1) >> 17) & 0x03;
+    if (mode == 2) {
+        chip.addr_bytes = 4;
+    } else if ((mode == 1) && (size > (1UL << 24))) {
+        enter = 0x01;
+        if (dwords >= 16)
+            enter = BFPT(16) >> 24;
+        if (enter & 0x40) {
+            chip.addr_bytes = 4;
+        } else if (enter & 0x03) {
+            if (enter & 0x02)
+                flash_write_enable();
+            spi_cmd(ENTER_4B);
+            chip.addr_bytes = 4;
+        } else {
+            /* Only the first 16MB can be used */
+            size = 1UL << 24;
         }
-        wait_busy();
     }
+    chip.size = size;
     return 0;
 }
 
@@ -167,71 +344,99 @@ static int spi_flash_write_sb(uint32_t address, const void *data, int len)
 
 uint16_t spi_flash_probe(void)
 {
-    uint8_t manuf, product, b0;
-    int i;
+    uint8_t cmd[6] = { MDID, 0x00, 0x00, 0x00, 0xFF, 0xFF };
+    uint8_t id[6];
+    uint8_t manuf, product;
     spi_init(0,0);
     wait_busy();
     spi_cs_on(SPI_CS_FLASH);
-    spi_write(MDID);
-    b0 = spi_read();
-
-    write_address(0);
-    spi_write(0xFF);
-    manuf = spi_read();
-    spi_write(0xFF);
-    product = spi_read();
+    spi_xfer(cmd, id, sizeof(cmd));
     spi_cs_off(SPI_CS_FLASH);
+    manuf = id[4];
+    product = id[5];
     if (manuf == 0xBF || manuf == 0xC2)
         chip_write_mode = SST_SINGLEBYTE;
     if (manuf == 0xEF)
         chip_write_mode = WB_WRITEPAGE;
+    sfdp_probe();
 
 #ifndef READONLY
+    cmd[0] = WRSR;
+    cmd[1] = 0x00;
     spi_cs_on(SPI_CS_FLASH);
-    spi_write(WRSR);
-    spi_read();
-    spi_write(0x00);
-    spi_read();
+    spi_xfer(cmd, NULL, 2);
     spi_cs_off(SPI_CS_FLASH);
 #endif
     return (uint16_t)(manuf << 8 | product);
 }
 
 
-void spi_flash_sector_erase(uint32_t address)
+static void spi_flash_erase_block(uint32_t address, uint8_t opcode)
 {
-    address &= (~(SPI_FLASH_SECTOR_SIZE - 1));
-
     wait_busy();
     flash_write_enable();
     spi_cs_on(SPI_CS_FLASH);
-    spi_write(SECTOR_ERASE);
-    spi_read();
-    write_address(address);
+    send_command(opcode, address);
     spi_cs_off(SPI_CS_FLASH);
     wait_busy();
 }
 
+/* Smallest erase type */
+void spi_flash_sector_erase(uint32_t address)
+{
+    const struct spi_flash_erase_type *e;
+    if (chip.n_erase == 0)
+        return;
+    e = &chip.erase[chip.n_erase - 1];
+    spi_flash_erase_block(address & ~(e->size - 1), e->opcode);
+}
+
+/* Each step uses the largest erase type that is aligned and fits in what is
+ * left of the range, e.g. a 64KB block instead of sixteen 4KB sectors. The
+ * end of a range that is not aligned to the smallest erase type is rounded
+ * up, as with spi_flash_sector_erase().
+ */
+int spi_flash_erase(uint32_t address, int len)
+{
+    uint32_t end = address + len;
+    const struct spi_flash_erase_type *e;
+    int i;
+    if ((len <= 0) || (chip.n_erase == 0))
+        return -1;
+    while (address < end) {
+        for (i = 0; i < chip.n_erase - 1; i++) {
+            e = &chip.erase[i];
+            if (((address & (e->size - 1)) == 0) && (end - address >= e->size))
+                break;
+        }
+        e = &chip.erase[i];
+        address &= ~(e->size - 1);
+        spi_flash_erase_block(address, e->opcode);
+        address += e->size;
+    }
+    return 0;
+}
+
 int RAMFUNCTION spi_flash_read(uint32_t address, void *data, int len)
 {
-    uint8_t *buf = data;
-    int i = 0;
+    if (len < 0)
+        return -1;
+    if (chip.n_erase == 0) {
+        memset(data, 0xFF, len);
+        return -1;
+    }
     wait_busy();
     spi_cs_on(SPI_CS_FLASH);
-    spi_write(BYTE_READ);
-    spi_read();
-    write_address(address);
-    while (len > 0) {
-        spi_write(0xFF);
-        buf[i++] = spi_read();
-        len--;
-    }
+    send_command(FAST_READ, address);
+    spi_xfer(NULL, data, len);
     spi_cs_off(SPI_CS_FLASH);
-    return i;
+    return len;
 }
 
 int spi_flash_write(uint32_t address, const void *data, int len)
 {
+    if (chip.n_erase == 0)
+        return -1;
     if (chip_write_mode == SST_SINGLEBYTE)
         return spi_flash_write_sb(address, data, len);
     if (chip_write_mode == WB_WRITEPAGE)
@@ -5,7 +5,8 @@
  *
  * This interface creates the communication to access an emulated
  * non-volatile memory, hosted on a remote machine, through the UART 
- * interface.
+ * interface. Data is transferred in CRC-protected frames, with several
+ * requests in flight (see uart_flash.h).
  *
  *
  * Copyright (C) 2020 wolfSSL Inc.
@@ -28,152 +29,293 @@
  */
 #include "wolfboot/wolfboot.h"
 #include "hal.h"
+#include "uart_flash.h"
 #include <stdint.h>
 #include <string.h>
 
-#define CMD_HDR_WOLF  'W'
-#define CMD_HDR_WRITE 0x01
-#define CMD_HDR_READ  0x02
-#define CMD_HDR_ERASE 0x03
-#define CMD_ACK       0x06
-
 #define WAIT_CYCLES 500000
 #define ERASE_TIMEOUT 5
 #define READ_TIMEOUT 1
+#define MAX_RETRIES 8
+
+#if (UART_FLASH_WINDOW < 1) || (UART_FLASH_WINDOW > 32)
+#   error "UART_FLASH_WINDOW must be between 1 and 32"
+#endif
 
 int uart_tx(const uint8_t c);
 int uart_rx(uint8_t *c);
 
-static int wait_ack(void)
+/* Sequence number of the next request. Never reset, so that late replies
+ * to a previous operation cannot be mistaken for the current ones.
+ */
+static uint8_t uf_seq;
+
+/* Bytes received while transmitting. UART peripherals usually have a
+ * single-byte receive register, so the replies to the requests in flight
+ * are polled after each transmitted byte and stored here.
+ */
+#define RX_RING_SIZE 256
+static uint8_t rx_ring[RX_RING_SIZE];
+static uint16_t rx_head, rx_tail;
+
+/* Payload of the last UF_DATA frame received */
+static uint8_t rx_payload[UART_FLASH_FRAME_SIZE];
+
+static void rx_poll(void)
 {
-    volatile int count = 0;
-    while(++count < WAIT_CYCLES) {
-        uint8_t c;
-        if ((uart_rx(&c) == 1) && (c == CMD_ACK))
-            return 0;
+    uint8_t c;
+    while (uart_rx(&c) == 1) {
+        if ((uint16_t)(rx_head - rx_tail) < RX_RING_SIZE)
+            rx_ring[(rx_head++) % RX_RING_SIZE] = c;
     }
-    return -1;
 }
 
-static int uart_rx_timeout(uint8_t *c)
+static int uart_rx_timeout(uint8_t *c, int timeout)
 {
     volatile int count = 0;
-    while(++count < (WAIT_CYCLES * READ_TIMEOUT)) {
+    if (rx_head != rx_tail) {
+        *c = rx_ring[(rx_tail++) % RX_RING_SIZE];
+        return 0;
+    }
+    while(++count < (WAIT_CYCLES * timeout)) {
         if (uart_rx(c) == 1) /* Success */
-           return 0; 
+           return 0;
     }
     *c = 0x00;
     return -1;
 }
 
-
-int  ext_flash_write(uintptr_t address, const uint8_t *data, int len)
+static uint16_t crc16(uint16_t crc, const uint8_t *data, uint32_t len)
 {
     int i;
-    uint8_t cmd[10];
-    cmd[0] = CMD_HDR_WOLF;
-    cmd[1] = CMD_HDR_WRITE;
-    cmd[2] = address & 0xFF;
-    cmd[3] = (address >> 8) & 0xFF;
-    cmd[4] = (address >> 16) & 0xFF;
-    cmd[5] = (address >> 24) & 0xFF;
-    cmd[6] = len & 0xFF;
-    cmd[7] = (len >> 8) & 0xFF;
-    cmd[8] = (len >> 16) & 0xFF;
-    cmd[9] = (len >> 24) & 0xFF;
-    for (i = 0; i < 10; i++) {
-        uart_tx(cmd[i]);
-        if (wait_ack() != 0)
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+static void tx_bytes(const uint8_t *b, uint32_t len)
+{
+    while (len--) {
+        uart_tx(*b++);
+        rx_poll();
+    }
+}
+
+static void frame_send(uint8_t type, uint8_t seq, uint32_t address,
+        uint32_t len, const uint8_t *payload)
+{
+    uint8_t hdr[UF_HDR_SIZE];
+    uint16_t crc;
+    hdr[0] = UF_SOF;
+    hdr[1] = type;
+    hdr[2] = seq;
+    hdr[3] = address & 0xFF;
+    hdr[4] = (address >> 8) & 0xFF;
+    hdr[5] = (address >> 16) & 0xFF;
+    hdr[6] = (address >> 24) & 0xFF;
+    hdr[7] = len & 0xFF;
+    hdr[8] = (len >> 8) & 0xFF;
+    hdr[9] = (len >> 16) & 0xFF;
+    hdr[10] = (len >> 24) & 0xFF;
+    crc = crc16(0xFFFF, hdr + 1, UF_HDR_SIZE - 1);
+    tx_bytes(hdr, UF_HDR_SIZE);
+    if (payload) {
+        crc = crc16(crc, payload, len);
+        tx_bytes(payload, len);
+    }
+    hdr[0] = crc & 0xFF;
+    hdr[1] = (crc >> 8) & 0xFF;
+    tx_bytes(hdr, UF_CRC_SIZE);
+}
+
+static uint32_t frame_address(const uint8_t *hdr)
+{
+    return hdr[3] | (hdr[4] << 8) | (hdr[5] << 16) | ((uint32_t)hdr[6] << 24);
+}
+
+static uint32_t frame_len(const uint8_t *hdr)
+{
+    return hdr[7] | (hdr[8] << 8) | (hdr[9] << 16) | ((uint32_t)hdr[10] << 24);
+}
+
+/* Receive the next valid reply. The payload of UF_DATA frames is stored in
+ * rx_payload. Returns 0 on success, -1 on timeout or corrupted frame.
+ */
+static int frame_recv(uint8_t *hdr, int timeout)
+{
+    uint8_t c;
+    uint16_t crc;
+    uint32_t i, len;
+    do {
+        if (uart_rx_timeout(&c, timeout) != 0)
+            return -1;
+    } while (c != UF_SOF);
+    hdr[0] = c;
+    for (i = 1; i < UF_HDR_SIZE; i++) {
+        if (uart_rx_timeout(&hdr[i], READ_TIMEOUT) != 0)
             return -1;
     }
-    for (i = 0; i < len; i++) {
-        uart_tx(data[i]);
-        if (wait_ack() != 0)
+    crc = crc16(0xFFFF, hdr + 1, UF_HDR_SIZE - 1);
+    if (hdr[1] == UF_DATA) {
+        len = frame_len(hdr);
+        if (len > UART_FLASH_FRAME_SIZE)
             return -1;
+        for (i = 0; i < len; i++) {
+            if (uart_rx_timeout(&rx_payload[i], READ_TIMEOUT) != 0)
+                return -1;
+        }
+        crc = crc16(crc, rx_payload, len);
     }
-    return i;
+    for (i = 0; i < UF_CRC_SIZE; i++) {
+        if (uart_rx_timeout(&c, READ_TIMEOUT) != 0)
+            return -1;
+        crc ^= (uint16_t)c << (8 * i);
+    }
+    return (crc == 0) ? 0 : -1;
+}
+
+
+/* Transfer 'len' bytes to/from the remote flash, split in frames of
+ * UART_FLASH_FRAME_SIZE bytes. Up to UART_FLASH_WINDOW requests are in
+ * flight at any time; when the oldest one times out, all the requests not
+ * acknowledged yet are sent again.
+ */
+static int uf_transfer(uint8_t type, uintptr_t address, uint8_t *data, int len)
+{
+    uint8_t hdr[UF_HDR_SIZE];
+    uint32_t n_frames, base = 0, next = 0, idx, done = 0;
+    uint32_t off, sz;
+    int retries = 0;
+    uint8_t seq0 = uf_seq;
+
+    if (len <= 0)
+        return 0;
+    n_frames = (len + UART_FLASH_FRAME_SIZE - 1) / UART_FLASH_FRAME_SIZE;
+    uf_seq += n_frames;
+    while (base < n_frames) {
+        while ((next < n_frames) && (next < base + UART_FLASH_WINDOW)) {
+            if ((done & (1UL << (next - base))) == 0) {
+                off = next * UART_FLASH_FRAME_SIZE;
+                sz = len - off;
+                if (sz > UART_FLASH_FRAME_SIZE)
+                    sz = UART_FLASH_FRAME_SIZE;
+                frame_send(type, (uint8_t)(seq0 + next), address + off, sz,
+                        (type == UF_WRITE) ? data + off : NULL);
+            }
+            next++;
+        }
+        if (frame_recv(hdr, READ_TIMEOUT) != 0) {
+            if (++retries > MAX_RETRIES)
+                return -1;
+            next = base;
+            continue;
+        }
+        idx = base + (uint8_t)(hdr[2] - (uint8_t)(seq0 + base));
+        if ((idx >= next) || (done & (1UL << (idx - base))))
+            continue;
+        off = idx * UART_FLASH_FRAME_SIZE;
+        sz = len - off;
+        if (sz > UART_FLASH_FRAME_SIZE)
+            sz = UART_FLASH_FRAME_SIZE;
+        if (frame_address(hdr) != address + off)
+            continue;
+        if (type == UF_READ) {
+            if ((hdr[1] != UF_DATA) || (frame_len(hdr) != sz))
+                continue;
+            memcpy(data + off, rx_payload, sz);
+        } else if (hdr[1] != UF_ACK) {
+            continue;
+        }
+        done |= (1UL << (idx - base));
+        retries = 0;
+        while (done & 1) {
+            done >>= 1;
+            base++;
+        }
+    }
+    return len;
+}
+
+/* Single request, waiting for its UF_ACK */
+static int uf_request(uint8_t type, uintptr_t address, int len,
+        const uint8_t *payload, int timeout, int max_retries)
+{
+    uint8_t hdr[UF_HDR_SIZE];
+    uint8_t seq = uf_seq++;
+    int retries;
+    for (retries = 0; retries <= max_retries; retries++) {
+        frame_send(type, seq, address, len, payload);
+        while (frame_recv(hdr, timeout) == 0) {
+            if ((hdr[1] == UF_ACK) && (hdr[2] == seq) &&
+                    (frame_address(hdr) == address))
+                return 0;
+        }
+    }
+    return -1;
+}
+
+/* Read-ahead cache for small reads (e.g. while hashing the image, or
+ * accessing the partition flags), filled with a whole window of frames
+ * without crossing the boundary of the flash sector.
+ */
+static uint8_t rd_cache[UART_FLASH_FRAME_SIZE * UART_FLASH_WINDOW];
+static uintptr_t rd_cache_addr;
+static uint32_t rd_cache_len;
+
+int  ext_flash_write(uintptr_t address, const uint8_t *data, int len)
+{
+    rd_cache_len = 0;
+    return uf_transfer(UF_WRITE, address, (uint8_t *)data, len);
 }
 
 int  ext_flash_read(uintptr_t address, uint8_t *data, int len)
 {
-    int i;
-    uint8_t cmd[10];
-    cmd[0] = CMD_HDR_WOLF;
-    cmd[1] = CMD_HDR_READ;
-    cmd[2] = address & 0xFF;
-    cmd[3] = (address >> 8) & 0xFF;
-    cmd[4] = (address >> 16) & 0xFF;
-    cmd[5] = (address >> 24) & 0xFF;
-    cmd[6] = len & 0xFF;
-    cmd[7] = (len >> 8) & 0xFF;
-    cmd[8] = (len >> 16) & 0xFF;
-    cmd[9] = (len >> 24) & 0xFF;
-    for (i = 0; i < 10; i++) {
-        uart_tx(cmd[i]);
-        if (wait_ack() != 0)
+    uintptr_t start, end;
+    if ((len <= 0) || (len >= UART_FLASH_FRAME_SIZE))
+        return uf_transfer(UF_READ, address, data, len);
+    if ((address < rd_cache_addr) ||
+            (address + len > rd_cache_addr + rd_cache_len)) {
+        start = address - (address % UART_FLASH_FRAME_SIZE);
+        end = start + sizeof(rd_cache);
+        if (end > address - (address % WOLFBOOT_SECTOR_SIZE) + WOLFBOOT_SECTOR_SIZE)
+            end = address - (address % WOLFBOOT_SECTOR_SIZE) + WOLFBOOT_SECTOR_SIZE;
+        if (address + len > end)
+            return uf_transfer(UF_READ, address, data, len);
+        rd_cache_len = 0;
+        if (uf_transfer(UF_READ, start, rd_cache, end - start) < 0)
             return -1;
+        rd_cache_addr = start;
+        rd_cache_len = end - start;
     }
-    for (i = 0; i < len; i++) {
-        if (uart_rx_timeout(&data[i]) != 0)
-            return 0;
-        uart_tx(CMD_ACK);
-    }
+    memcpy(data, rd_cache + (address - rd_cache_addr), len);
     return len;
 }
 
 int  ext_flash_erase(uintptr_t address, int len)
 {
-    int i;
-    uint8_t cmd[10];
-    cmd[0] = CMD_HDR_WOLF;
-    cmd[1] = CMD_HDR_ERASE;
-    cmd[2] = address & 0xFF;
-    cmd[3] = (address >> 8) & 0xFF;
-    cmd[4] = (address >> 16) & 0xFF;
-    cmd[5] = (address >> 24) & 0xFF;
-    cmd[6] = len & 0xFF;
-    cmd[7] = (len >> 8) & 0xFF;
-    cmd[8] = (len >> 16) & 0xFF;
-    cmd[9] = (len >> 24) & 0xFF;
-    for (i = 0; i < 10; i++) {
-        uart_tx(cmd[i]);
-        if (wait_ack() != 0)
-            return -1;
-    }
-    /* Wait for extra ack at the end of Erase */
-    if (wait_ack() == 0)
-        return 0;
-    return -1;
+    rd_cache_len = 0;
+    return uf_request(UF_ERASE, address, len, NULL, ERASE_TIMEOUT, MAX_RETRIES);
 }
 
 void ext_flash_lock(void)
 {
-    wait_ack();
 }
 
 void ext_flash_unlock(void)
 {
-    wait_ack();
 }
-    
+
 void uart_send_current_version(void)
 {
     uint32_t version = wolfBoot_current_firmware_version();
-    uart_tx('V');
-    if (wait_ack() != 0)
-        return;
-    uart_tx(version & 0x000000FF);
-    if (wait_ack() != 0)
-        return;
-    uart_tx((version >> 8) & 0x000000FF);
-    if (wait_ack() != 0)
-        return;
-    uart_tx((version >> 16) & 0x000000FF);
-    if (wait_ack() != 0)
-        return;
-    uart_tx((version >> 24) & 0x000000FF);
-    if (wait_ack() != 0)
-        return;
+    uint8_t payload[4];
+    payload[0] = version & 0xFF;
+    payload[1] = (version >> 8) & 0xFF;
+    payload[2] = (version >> 16) & 0xFF;
+    payload[3] = (version >> 24) & 0xFF;
+    /* Best effort: the host may not be listening yet */
+    uf_request(UF_VERSION, 0, sizeof(payload), payload, READ_TIMEOUT, 0);
 }
-
-
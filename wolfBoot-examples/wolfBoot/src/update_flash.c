@@ -26,8 +26,9 @@
 #include "image.h"
 #include "hal.h"
 #include "spi_flash.h"
+#include "profile.h"
 #include "wolfboot/wolfboot.h"
-
+#include <string.h>
 
 #ifdef RAM_CODE
 extern unsigned int _start_text;
@@ -99,6 +100,11 @@ void wolfBoot_check_self_update(void)
             hal_flash_lock();
             return;
         }
+#ifdef COMPRESSED_IMAGES
+        /* The bootloader is copied as it is */
+        if (wolfBoot_get_compressed_size(&update) != 0)
+            return;
+#endif
         if (wolfBoot_verify_integrity(&update) < 0)
             return;
         if (wolfBoot_verify_authenticity(&update) < 0)
@@ -108,7 +114,7 @@ void wolfBoot_check_self_update(void)
 }
 #endif /* RAM_CODE for self_update */
 
-static int wolfBoot_copy_sector(struct wolfBoot_image *src, struct wolfBoot_image *dst, uint32_t sector)
+static int copy_sector(struct wolfBoot_image *src, struct wolfBoot_image *dst, uint32_t sector)
 {
     uint32_t pos = 0;
     uint32_t src_sector_offset = (sector * WOLFBOOT_SECTOR_SIZE);
@@ -148,6 +154,520 @@ static int wolfBoot_copy_sector(struct wolfBoot_image *src, struct wolfBoot_imag
     return pos;
 }
 
+static int wolfBoot_copy_sector(struct wolfBoot_image *src, struct wolfBoot_image *dst, uint32_t sector)
+{
+    int ret;
+    PROFILE_START(WOLFBOOT_PROF_COPY_SECTOR);
+    ret = copy_sector(src, dst, sector);
+    PROFILE_END(WOLFBOOT_PROF_COPY_SECTOR);
+    return ret;
+}
+
+static int wolfBoot_read(struct wolfBoot_image *img, uint32_t off, uint8_t *data, uint32_t len)
+{
+#ifdef EXT_FLASH
+    if (PART_IS_EXT(img))
+        return ext_flash_check_read((uintptr_t)(img->hdr) + off, data, len);
+#endif
+    memcpy(data, img->hdr + off, len);
+    return len;
+}
+
+#ifdef SKIP_UNCHANGED_SECTORS
+/* Returns 1 if the sector at offset 'a_off' in 'a' has the same content as
+ * the sector at offset 'b_off' in 'b', 0 otherwise.
+ */
+static int wolfBoot_compare_sector(struct wolfBoot_image *a, uint32_t a_off,
+        struct wolfBoot_image *b, uint32_t b_off)
+{
+    uint32_t pos;
+#ifdef EXT_FLASH
+    static uint8_t a_buf[FLASHBUFFER_SIZE], b_buf[FLASHBUFFER_SIZE];
+#endif
+    for (pos = 0; pos < WOLFBOOT_SECTOR_SIZE; pos += FLASHBUFFER_SIZE) {
+#ifdef EXT_FLASH
+        if (PART_IS_EXT(a) || PART_IS_EXT(b)) {
+            wolfBoot_read(a, a_off + pos, a_buf, FLASHBUFFER_SIZE);
+            wolfBoot_read(b, b_off + pos, b_buf, FLASHBUFFER_SIZE);
+            if (memcmp(a_buf, b_buf, FLASHBUFFER_SIZE) != 0)
+                return 0;
+            continue;
+        }
+#endif
+        if (memcmp(a->hdr + a_off + pos, b->hdr + b_off + pos, FLASHBUFFER_SIZE) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+/* Sectors with the same content in BOOT and UPDATE do not need to be swapped.
+ * Sector 0 is always swapped, as its flag marks an update in progress, and so
+ * is the sector holding the partition trailer, which has no flag.
+ */
+static int wolfBoot_sector_unchanged(struct wolfBoot_image *boot,
+        struct wolfBoot_image *update, uint32_t sector)
+{
+    const uint32_t off = sector * WOLFBOOT_SECTOR_SIZE;
+    if ((sector == 0) || ((off + WOLFBOOT_SECTOR_SIZE) >= WOLFBOOT_PARTITION_SIZE))
+        return 0;
+    return wolfBoot_compare_sector(update, off, boot, off);
+}
+#endif /* SKIP_UNCHANGED_SECTORS */
+
+#ifdef DELTA_UPDATES
+#include "delta.h"
+
+static uint8_t delta_buf[FLASHBUFFER_SIZE];
+
+/* Rebuild sector 'sector' of the target image into the SWAP partition,
+ * reading the patch from 'patch' (starting at 'p_off' in its payload) and
+ * the unmodified portions of the source image from 'src'.
+ */
+static int wolfBoot_delta_sector(struct wolfBoot_image *src,
+        struct wolfBoot_image *patch, uint32_t p_off, uint32_t p_size,
+        struct wolfBoot_image *swap, uint32_t sector)
+{
+    const uint32_t start = sector * WOLFBOOT_SECTOR_SIZE;
+    const uint32_t end = start + WOLFBOOT_SECTOR_SIZE;
+    uint32_t pos = 0, p = DELTA_PATCH_HDR_SIZE;
+    uint32_t fill = 0, written = 0;
+    uint32_t len, off, done, chunk;
+    uint8_t op[DELTA_OP_COPY_SIZE];
+
+    p_off += IMAGE_HEADER_SIZE;
+    wb_flash_erase(swap, 0, WOLFBOOT_SECTOR_SIZE);
+    while ((p < p_size) && (pos < end)) {
+        wolfBoot_read(patch, p_off + p, op, 1);
+        if ((op[0] == DELTA_OP_INSERT) && (p + DELTA_OP_INSERT_SIZE <= p_size)) {
+            wolfBoot_read(patch, p_off + p, op, DELTA_OP_INSERT_SIZE);
+            len = op[1] | (op[2] << 8);
+            off = p + DELTA_OP_INSERT_SIZE;
+            p = off + len;
+            if (p > p_size)
+                return -1;
+        } else if ((op[0] == DELTA_OP_COPY) && (p + DELTA_OP_COPY_SIZE <= p_size)) {
+            wolfBoot_read(patch, p_off + p, op, DELTA_OP_COPY_SIZE);
+            off = op[1] | (op[2] << 8) | (op[3] << 16) | ((uint32_t)op[4] << 24);
+            len = op[5] | (op[6] << 8);
+            p += DELTA_OP_COPY_SIZE;
+        } else {
+            return -1;
+        }
+        if ((len == 0) || ((pos % WOLFBOOT_SECTOR_SIZE) + len > WOLFBOOT_SECTOR_SIZE))
+            return -1;
+        if (pos < start) {
+            /* Operation for a sector already in place: skip it */
+            pos += len;
+            continue;
+        }
+        if (op[0] == DELTA_OP_COPY) {
+            /* Only read from sectors that have not been overwritten yet */
+            if ((off >= WOLFBOOT_PARTITION_SIZE) ||
+                    (len > WOLFBOOT_PARTITION_SIZE - off))
+                return -1;
+            if ((off + len > WOLFBOOT_SECTOR_SIZE) &&
+                    ((sector == 0) || (off < start)))
+                return -1;
+        }
+        done = 0;
+        while (done < len) {
+            chunk = len - done;
+            if (chunk > FLASHBUFFER_SIZE - fill)
+                chunk = FLASHBUFFER_SIZE - fill;
+            if (op[0] == DELTA_OP_COPY)
+                wolfBoot_read(src, off + done, delta_buf + fill, chunk);
+            else
+                wolfBoot_read(patch, p_off + off + done, delta_buf + fill, chunk);
+            fill += chunk;
+            done += chunk;
+            if (fill == FLASHBUFFER_SIZE) {
+                wb_flash_write(swap, written, delta_buf, FLASHBUFFER_SIZE);
+                written += FLASHBUFFER_SIZE;
+                fill = 0;
+            }
+        }
+        pos += len;
+    }
+    if (fill > 0) {
+        memset(delta_buf + fill, 0xFF, FLASHBUFFER_SIZE - fill);
+        wb_flash_write(swap, written, delta_buf, FLASHBUFFER_SIZE);
+    }
+    return 0;
+}
+
+/* Delta update: the target image is rebuilt in place in BOOT, one sector at
+ * a time, using the SWAP sector as temporary storage. Each sector goes
+ * through NEW -> SWAPPING (SWAP contains the new sector) -> UPDATED.
+ * Sector 0 is processed last, so the version in the header of the image in
+ * BOOT tells which patch (forward or inverse) has to be applied when resuming
+ * an interrupted update.
+ */
+static int wolfBoot_delta_update(struct wolfBoot_image *boot,
+        struct wolfBoot_image *update, struct wolfBoot_image *swap,
+        int fallback_allowed)
+{
+    const uint32_t sector_size = WOLFBOOT_SECTOR_SIZE;
+    uint32_t sector, i, n_sectors = 0, total_size;
+    uint32_t base_v, boot_v, update_v, p_off, p_size;
+    uint32_t p_hdr[DELTA_PATCH_HDR_SIZE / sizeof(uint32_t)];
+    int resume = 0, inverse = 0;
+    uint8_t flag, st;
+#ifdef EXT_ENCRYPTED
+    uint8_t key[ENCRYPT_KEY_SIZE];
+    uint8_t nonce[ENCRYPT_NONCE_SIZE];
+#endif
+
+    for (sector = 0; ((sector + 1) * sector_size) < WOLFBOOT_PARTITION_SIZE; sector++) {
+        if ((wolfBoot_get_update_sector_flag(sector, &flag) == 0) &&
+                (flag != SECT_FLAG_NEW)) {
+            resume = 1;
+            break;
+        }
+    }
+
+    if (!resume) {
+        struct wolfBoot_image *images[2];
+        uint16_t update_type = wolfBoot_get_image_type(PART_UPDATE);
+        if (((update_type & HDR_IMG_TYPE_PART_MASK) != HDR_IMG_TYPE_APP) ||
+                ((update_type & 0xFF00) != HDR_IMG_TYPE_AUTH))
+            return -1;
+        /* The patch applies to the current image, which must be intact:
+         * both signatures are verified together
+         */
+        images[0] = update;
+        images[1] = boot;
+        if (!update->hdr_ok || (wolfBoot_verify_integrity(update) < 0)
+                || !boot->hdr_ok || (wolfBoot_verify_integrity(boot) < 0)
+                || (wolfBoot_verify_authenticity_batch(images, 2) < 0))
+            return -1;
+    }
+
+    if ((wolfBoot_get_update_sector_flag(0, &flag) != 0) || (flag == SECT_FLAG_NEW)) {
+        /* Source image header still in BOOT: select the patch */
+        boot_v = wolfBoot_current_firmware_version();
+        update_v = wolfBoot_update_firmware_version();
+        if (wolfBoot_get_delta_info(update, 0, &base_v, &p_off, &p_size) < 0)
+            return -1;
+        if (boot_v == base_v) {
+#ifndef ALLOW_DOWNGRADE
+            if (!resume && !fallback_allowed && (update_v <= boot_v))
+                return -1;
+#endif
+        } else if (fallback_allowed && (boot_v == update_v)) {
+            inverse = 1;
+            if (wolfBoot_get_delta_info(update, 1, &base_v, &p_off, &p_size) < 0)
+                return -1;
+        } else {
+            return -1;
+        }
+        if (p_size < DELTA_PATCH_HDR_SIZE)
+            return -1;
+        wolfBoot_read(update, IMAGE_HEADER_SIZE + p_off, (uint8_t *)p_hdr, DELTA_PATCH_HDR_SIZE);
+        if ((p_hdr[0] != DELTA_PATCH_MAGIC) || (p_hdr[1] <= IMAGE_HEADER_SIZE) ||
+                (p_hdr[1] > WOLFBOOT_PARTITION_SIZE - sector_size))
+            return -1;
+        n_sectors = (p_hdr[1] + sector_size - 1) / sector_size;
+    }
+
+    hal_flash_unlock();
+#ifdef EXT_FLASH
+    ext_flash_unlock();
+#endif
+#ifdef EXT_ENCRYPTED
+    wolfBoot_get_encrypt_key(key, nonce);
+#endif
+
+    /* Sectors 1 .. N-1 (only when the source image is still in BOOT) */
+    for (i = 1; i < n_sectors; i++) {
+        if ((wolfBoot_get_update_sector_flag(i, &flag) != 0) || (flag == SECT_FLAG_NEW)) {
+            if (wolfBoot_delta_sector(boot, update, p_off, p_size, swap, i) < 0)
+                goto fail;
+            flag = SECT_FLAG_SWAPPING;
+            wolfBoot_set_update_sector_flag(i, flag);
+        }
+        if (flag == SECT_FLAG_SWAPPING) {
+#ifdef SKIP_UNCHANGED_SECTORS
+            if (!wolfBoot_compare_sector(swap, 0, boot, i * sector_size))
+#endif
+                wolfBoot_copy_sector(swap, boot, i);
+            flag = SECT_FLAG_UPDATED;
+            wolfBoot_set_update_sector_flag(i, flag);
+        }
+    }
+
+    /* Sector 0, containing the header */
+    if ((wolfBoot_get_update_sector_flag(0, &flag) != 0) || (flag == SECT_FLAG_NEW)) {
+        if (wolfBoot_delta_sector(boot, update, p_off, p_size, swap, 0) < 0)
+            goto fail;
+        flag = SECT_FLAG_SWAPPING;
+        wolfBoot_set_update_sector_flag(0, flag);
+    }
+    if (flag == SECT_FLAG_SWAPPING) {
+        wolfBoot_copy_sector(swap, boot, 0);
+        flag = SECT_FLAG_UPDATED;
+        wolfBoot_set_update_sector_flag(0, flag);
+    }
+
+    /* Target image in place. Clean up the rest of BOOT, and the
+     * trailer of UPDATE, keeping the delta image for a possible fallback.
+     */
+    if (wolfBoot_open_image(boot, PART_BOOT) < 0)
+        goto fail;
+    total_size = boot->fw_size + IMAGE_HEADER_SIZE;
+    sector = (total_size + sector_size - 1) / sector_size;
+    while ((sector * sector_size) < WOLFBOOT_PARTITION_SIZE) {
+        wb_flash_erase(boot, sector * sector_size, sector_size);
+        sector++;
+    }
+    sector = (update->fw_size + IMAGE_HEADER_SIZE + sector_size - 1) / sector_size;
+    while ((sector * sector_size) < WOLFBOOT_PARTITION_SIZE) {
+        wb_flash_erase(update, sector * sector_size, sector_size);
+        sector++;
+    }
+    wb_flash_erase(swap, 0, WOLFBOOT_SECTOR_SIZE);
+    st = IMG_STATE_TESTING;
+    wolfBoot_set_partition_state(PART_BOOT, st);
+
+#ifdef EXT_FLASH
+    ext_flash_lock();
+#endif
+    hal_flash_lock();
+#ifdef EXT_ENCRYPTED
+    wolfBoot_set_encrypt_key(key, nonce);
+#endif
+    return 0;
+
+fail:
+#ifdef EXT_FLASH
+    ext_flash_lock();
+#endif
+    hal_flash_lock();
+    return -1;
+}
+#endif /* DELTA_UPDATES */
+
+#ifdef COMPRESSED_IMAGES
+static struct wolfBoot_decompress update_dctx;
+static uint8_t comp_buf[FLASHBUFFER_SIZE];
+static uint8_t comp_hdr[IMAGE_HEADER_SIZE];
+
+/* Decompress sector 'sector' of the image in 'update' into the SWAP
+ * partition. The header is copied without the HDR_IMG_COMPRESSED tag, so
+ * the result is the plain image that has been signed.
+ */
+static int wolfBoot_decompress_sector(struct wolfBoot_image *update,
+        struct wolfBoot_image *swap, uint32_t sector)
+{
+    uint32_t pos = 0, off, len, chunk;
+    uint8_t *tlv = NULL;
+
+    wb_flash_erase(swap, 0, WOLFBOOT_SECTOR_SIZE);
+    if (sector == 0) {
+        wolfBoot_read(update, 0, comp_hdr, IMAGE_HEADER_SIZE);
+        if (wolfBoot_find_header(comp_hdr + IMAGE_HEADER_OFFSET,
+                    HDR_IMG_COMPRESSED, &tlv) != COMPRESS_TLV_LEN)
+            return -1;
+        memset(tlv - 4, HDR_PADDING, 4 + COMPRESS_TLV_LEN);
+        wb_flash_write(swap, 0, comp_hdr, IMAGE_HEADER_SIZE);
+        pos = IMAGE_HEADER_SIZE;
+        off = 0;
+    } else {
+        off = sector * WOLFBOOT_SECTOR_SIZE - IMAGE_HEADER_SIZE;
+    }
+    if ((off < update->fw_size) &&
+            (wolfBoot_decompress_seek(&update_dctx, off) < 0))
+        return -1;
+    while ((pos < WOLFBOOT_SECTOR_SIZE) && (off < update->fw_size)) {
+        chunk = WOLFBOOT_SECTOR_SIZE - pos;
+        if (chunk > FLASHBUFFER_SIZE)
+            chunk = FLASHBUFFER_SIZE;
+        len = update->fw_size - off;
+        if (len > chunk)
+            len = chunk;
+        if (wolfBoot_decompress(&update_dctx, comp_buf, len) < 0)
+            return -1;
+        if (len < chunk)
+            memset(comp_buf + len, 0xFF, chunk - len);
+        wb_flash_write(swap, pos, comp_buf, chunk);
+        pos += chunk;
+        off += len;
+    }
+    return 0;
+}
+
+/* Copy one sector from offset 'src_off' of 'src' to offset 'dst_off'
+ * of 'dst'
+ */
+static void wolfBoot_move_sector(struct wolfBoot_image *src, uint32_t src_off,
+        struct wolfBoot_image *dst, uint32_t dst_off)
+{
+    uint32_t pos;
+    wb_flash_erase(dst, dst_off, WOLFBOOT_SECTOR_SIZE);
+    for (pos = 0; pos < WOLFBOOT_SECTOR_SIZE; pos += FLASHBUFFER_SIZE) {
+        wolfBoot_read(src, src_off + pos, comp_buf, FLASHBUFFER_SIZE);
+        wb_flash_write(dst, dst_off + pos, comp_buf, FLASHBUFFER_SIZE);
+    }
+}
+
+/* Compressed update: the image in UPDATE is decompressed into BOOT one
+ * sector at a time, through the SWAP sector. The compressed image itself is
+ * never modified: the previous content of BOOT is saved in UPDATE, in the
+ * first sectors after the compressed image, for a possible fallback.
+ * Sectors are processed in the order 1 .. N-1, 0, so the version in the
+ * header in BOOT tells whether the image has to be installed or restored
+ * when resuming an interrupted update.
+ *   install:  NEW -> SWAPPING (new sector in SWAP)
+ *                 -> BACKUP (old sector saved) -> UPDATED
+ *   restore:  NEW -> BACKUP (saved sector in SWAP) -> UPDATED
+ */
+static int wolfBoot_compressed_update(struct wolfBoot_image *boot,
+        struct wolfBoot_image *update, struct wolfBoot_image *swap,
+        int fallback_allowed)
+{
+    const uint32_t sector_size = WOLFBOOT_SECTOR_SIZE;
+    const uint32_t trailer_off = WOLFBOOT_PARTITION_SIZE - sector_size;
+    uint32_t sector, i, n_sectors = 0, n_backup = 1, total_size;
+    uint32_t boot_v, update_v, backup_off;
+    uint32_t backup_hdr[2];
+    int resume = 0, restore = 0;
+    uint8_t flag, st;
+#ifdef EXT_ENCRYPTED
+    uint8_t key[ENCRYPT_KEY_SIZE];
+    uint8_t nonce[ENCRYPT_NONCE_SIZE];
+#endif
+
+    backup_off = IMAGE_HEADER_SIZE + wolfBoot_get_compressed_size(update);
+    backup_off = (backup_off + sector_size - 1) / sector_size * sector_size;
+    if (backup_off >= trailer_off)
+        return -1;
+
+    for (sector = 0; ((sector + 1) * sector_size) < WOLFBOOT_PARTITION_SIZE; sector++) {
+        if ((wolfBoot_get_update_sector_flag(sector, &flag) == 0) &&
+                (flag != SECT_FLAG_NEW)) {
+            resume = 1;
+            break;
+        }
+    }
+
+    if (!resume) {
+        uint16_t update_type = wolfBoot_get_image_type(PART_UPDATE);
+        if (((update_type & HDR_IMG_TYPE_PART_MASK) != HDR_IMG_TYPE_APP) ||
+                ((update_type & 0xFF00) != HDR_IMG_TYPE_AUTH))
+            return -1;
+        if ((wolfBoot_verify_integrity(update) < 0)
+                || (wolfBoot_verify_authenticity(update) < 0))
+            return -1;
+    }
+
+    if ((wolfBoot_get_update_sector_flag(0, &flag) != 0) || (flag == SECT_FLAG_NEW)) {
+        /* Header of the current image still in BOOT */
+        boot_v = wolfBoot_current_firmware_version();
+        update_v = wolfBoot_update_firmware_version();
+        if (fallback_allowed && boot->hdr_ok && (boot_v == update_v)) {
+            /* The compressed image is installed: restore the saved one */
+            wolfBoot_read(update, backup_off, (uint8_t *)backup_hdr, sizeof(backup_hdr));
+            if ((backup_hdr[0] != WOLFBOOT_MAGIC) ||
+                    (backup_hdr[1] > WOLFBOOT_PARTITION_SIZE - IMAGE_HEADER_SIZE))
+                return -1;
+            n_sectors = (backup_hdr[1] + IMAGE_HEADER_SIZE + sector_size - 1) / sector_size;
+            if (backup_off + n_sectors * sector_size > trailer_off)
+                return -1;
+            restore = 1;
+        } else {
+#ifndef ALLOW_DOWNGRADE
+            if (!resume && !fallback_allowed && (update_v <= boot_v))
+                return -1;
+#endif
+            n_backup = 0;
+            if (boot->hdr_ok)
+                n_backup = (boot->fw_size + IMAGE_HEADER_SIZE + sector_size - 1) / sector_size;
+            if (backup_off + n_backup * sector_size > trailer_off)
+                return -1;
+            n_sectors = (update->fw_size + IMAGE_HEADER_SIZE + sector_size - 1) / sector_size;
+            if (n_sectors < n_backup)
+                n_sectors = n_backup;
+        }
+    }
+    if (!restore && (wolfBoot_decompress_init(&update_dctx, update) < 0))
+        return -1;
+
+    hal_flash_unlock();
+#ifdef EXT_FLASH
+    ext_flash_unlock();
+#endif
+#ifdef EXT_ENCRYPTED
+    wolfBoot_get_encrypt_key(key, nonce);
+#endif
+
+    /* Sectors 1 .. N-1 (only when the header in BOOT is the original one),
+     * then sector 0
+     */
+    i = 1;
+    do {
+        sector = (i < n_sectors) ? i : 0;
+        if ((wolfBoot_get_update_sector_flag(sector, &flag) != 0) || (flag == SECT_FLAG_NEW)) {
+            if (restore) {
+                wolfBoot_move_sector(update, backup_off + sector * sector_size, swap, 0);
+                flag = SECT_FLAG_BACKUP;
+            } else {
+                if (wolfBoot_decompress_sector(update, swap, sector) < 0)
+                    goto fail;
+                flag = SECT_FLAG_SWAPPING;
+            }
+            wolfBoot_set_update_sector_flag(sector, flag);
+        }
+        if (flag == SECT_FLAG_SWAPPING) {
+            if (sector < n_backup)
+                wolfBoot_move_sector(boot, sector * sector_size, update,
+                        backup_off + sector * sector_size);
+            flag = SECT_FLAG_BACKUP;
+            wolfBoot_set_update_sector_flag(sector, flag);
+        }
+        if (flag == SECT_FLAG_BACKUP) {
+#ifdef SKIP_UNCHANGED_SECTORS
+            if (!wolfBoot_compare_sector(swap, 0, boot, sector * sector_size))
+#endif
+                wolfBoot_copy_sector(swap, boot, sector);
+            flag = SECT_FLAG_UPDATED;
+            wolfBoot_set_update_sector_flag(sector, flag);
+        }
+        i++;
+    } while (sector != 0);
+
+    /* New image in place. Clean up the rest of BOOT, and the trailer of
+     * UPDATE, keeping the compressed image and the saved one.
+     */
+    if (wolfBoot_open_image(boot, PART_BOOT) < 0)
+        goto fail;
+    total_size = boot->fw_size + IMAGE_HEADER_SIZE;
+    sector = (total_size + sector_size - 1) / sector_size;
+    while ((sector * sector_size) < WOLFBOOT_PARTITION_SIZE) {
+        wb_flash_erase(boot, sector * sector_size, sector_size);
+        sector++;
+    }
+    wb_flash_erase(update, trailer_off, sector_size);
+    wb_flash_erase(swap, 0, WOLFBOOT_SECTOR_SIZE);
+    st = IMG_STATE_TESTING;
+    wolfBoot_set_partition_state(PART_BOOT, st);
+
+#ifdef EXT_FLASH
+    ext_flash_lock();
+#endif
+    hal_flash_lock();
+#ifdef EXT_ENCRYPTED
+    wolfBoot_set_encrypt_key(key, nonce);
+#endif
+    return 0;
+
+fail:
+#ifdef EXT_FLASH
+    ext_flash_lock();
+#endif
+    hal_flash_lock();
+    return -1;
+}
+#endif /* COMPRESSED_IMAGES */
+
 static int wolfBoot_update(int fallback_allowed)
 {
     uint32_t total_size = 0;
@@ -165,6 +685,36 @@ static int wolfBoot_update(int fallback_allowed)
     wolfBoot_open_image(&boot, PART_BOOT);
     wolfBoot_open_image(&swap, PART_SWAP);
 
+#ifdef DELTA_UPDATES
+    if ((wolfBoot_get_image_type(PART_UPDATE) & HDR_IMG_TYPE_DIFF) == HDR_IMG_TYPE_DIFF)
+        return wolfBoot_delta_update(&boot, &update, &swap, fallback_allowed);
+#endif
+#ifdef COMPRESSED_IMAGES
+    if (update.hdr_ok && (wolfBoot_get_compressed_size(&update) != 0))
+        return wolfBoot_compressed_update(&boot, &update, &swap, fallback_allowed);
+#endif
+
+    /* If the update was interrupted while swapping the first sector, the
+     * header being overwritten can be incomplete, or already contain the
+     * header of the other image, even if it looks valid. The state of the
+     * first sector tells which one: in SWAPPING, the UPDATE sector is being
+     * replaced with the BOOT one, in BACKUP the BOOT sector is being replaced
+     * with the SWAP one. The header copy in SWAP provides the size of the
+     * image being moved.
+     */
+    if ((wolfBoot_get_update_sector_flag(0, &flag) == 0) &&
+            ((flag == SECT_FLAG_SWAPPING) || (flag == SECT_FLAG_BACKUP))) {
+        uint32_t swap_hdr[2];
+        wolfBoot_read(&swap, 0, (uint8_t *)swap_hdr, sizeof(swap_hdr));
+        if ((swap_hdr[0] == WOLFBOOT_MAGIC) &&
+                (swap_hdr[1] <= (WOLFBOOT_PARTITION_SIZE - IMAGE_HEADER_SIZE))) {
+            if (flag == SECT_FLAG_SWAPPING)
+                update.fw_size = swap_hdr[1];
+            else
+                boot.fw_size = swap_hdr[1];
+        }
+    }
+
     /* Use biggest size for the swap */
     total_size = boot.fw_size + IMAGE_HEADER_SIZE;
     if ((update.fw_size + IMAGE_HEADER_SIZE) > total_size)
@@ -173,6 +723,14 @@ static int wolfBoot_update(int fallback_allowed)
     if (total_size <= IMAGE_HEADER_SIZE)
         return -1;
 
+    /* When resuming, the header in each partition may belong to the other
+     * image than the sectors following it: copy both up to the larger size.
+     */
+    if ((wolfBoot_get_update_sector_flag(0, &flag) == 0) && (flag != SECT_FLAG_NEW)) {
+        boot.fw_size = total_size - IMAGE_HEADER_SIZE;
+        update.fw_size = total_size - IMAGE_HEADER_SIZE;
+    }
+
     /* Check the first sector to detect interrupted update */
     if ((wolfBoot_get_update_sector_flag(0, &flag) < 0) || (flag == SECT_FLAG_NEW))
     {
@@ -213,6 +771,13 @@ static int wolfBoot_update(int fallback_allowed)
      */
     while ((sector * sector_size) < total_size) {
         if ((wolfBoot_get_update_sector_flag(sector, &flag) != 0) || (flag == SECT_FLAG_NEW)) {
+#ifdef SKIP_UNCHANGED_SECTORS
+            if (wolfBoot_sector_unchanged(&boot, &update, sector)) {
+                wolfBoot_set_update_sector_flag(sector, SECT_FLAG_UNCHANGED);
+                sector++;
+                continue;
+            }
+#endif
            flag = SECT_FLAG_SWAPPING;
            wolfBoot_copy_sector(&update, &swap, sector);
            if (((sector + 1) * sector_size) < WOLFBOOT_PARTITION_SIZE)
@@ -254,6 +819,13 @@ static int wolfBoot_update(int fallback_allowed)
      */
     while ((sector * sector_size) < total_size) {
         if ((wolfBoot_get_update_sector_flag(sector, &flag) != 0) || (flag == SECT_FLAG_NEW)) {
+#ifdef SKIP_UNCHANGED_SECTORS
+            if (wolfBoot_sector_unchanged(&boot, &update, sector)) {
+                wolfBoot_set_update_sector_flag(sector, SECT_FLAG_UNCHANGED);
+                sector++;
+                continue;
+            }
+#endif
            flag = SECT_FLAG_SWAPPING;
            wolfBoot_copy_sector(&update, &boot, sector);
            if (((sector + 1) * sector_size) < WOLFBOOT_PARTITION_SIZE)
@@ -281,6 +853,13 @@ static int wolfBoot_update(int fallback_allowed)
     return 0;
 }
 
+#ifdef COMPRESSED_IMAGES
+/* Images are run in place from BOOT: a compressed one is not bootable */
+#define boot_image_compressed(img) (wolfBoot_get_compressed_size(img) != 0)
+#else
+#define boot_image_compressed(img) (0)
+#endif
+
 void RAMFUNCTION wolfBoot_start(void)
 {
     uint8_t st;
@@ -301,23 +880,26 @@ void RAMFUNCTION wolfBoot_start(void)
         wolfBoot_update(0);
     }
     if ((wolfBoot_open_image(&boot, PART_BOOT) < 0) ||
+            boot_image_compressed(&boot) ||
             (wolfBoot_verify_integrity(&boot) < 0)  ||
             (wolfBoot_verify_authenticity(&boot) < 0)) {
         if (wolfBoot_update(1) < 0) {
             /* panic: no boot option available. */
-            while(1)
-                ;
+            wolfBoot_panic();
         } else {
             /* Emergency update successful, try to re-open boot image */
             if ((wolfBoot_open_image(&boot, PART_BOOT) < 0) ||
+                    boot_image_compressed(&boot) ||
                     (wolfBoot_verify_integrity(&boot) < 0)  ||
                     (wolfBoot_verify_authenticity(&boot) < 0)) {
                 /* panic: something went wrong after the emergency update */
-                while(1)
-                    ;
+                wolfBoot_panic();
             }
         }
     }
+    PROFILE_START(WOLFBOOT_PROF_PREPARE_BOOT);
     hal_prepare_boot();
+    PROFILE_END(WOLFBOOT_PROF_PREPARE_BOOT);
+    wolfBoot_profile_report();
     do_boot((void *)boot.fw_base);
 }
@@ -26,16 +26,11 @@
 #include "image.h"
 #include "hal.h"
 #include "spi_flash.h"
+#include "profile.h"
 #include "wolfboot/wolfboot.h"
 
 extern void hal_flash_dualbank_swap(void);
 
-static inline void boot_panic(void)
-{
-    while(1)
-        ;
-}
-
 void RAMFUNCTION wolfBoot_start(void)
 {
     int active;
@@ -44,7 +39,7 @@ void RAMFUNCTION wolfBoot_start(void)
     active = wolfBoot_dualboot_candidate();
 
     if (active < 0) /* panic if no images available */
-        boot_panic();
+        wolfBoot_panic();
 
     for (;;) {
         if ((wolfBoot_open_image(&fw_image, active) < 0) ||
@@ -53,7 +48,7 @@ void RAMFUNCTION wolfBoot_start(void)
 
             /* panic if authentication fails and no backup */
             if (!wolfBoot_fallback_is_possible())
-                boot_panic();
+                wolfBoot_panic();
             else {
                 /* Invalidate failing image and switch to the
                  * other partition
@@ -80,6 +75,9 @@ void RAMFUNCTION wolfBoot_start(void)
     if (active == PART_UPDATE)
         hal_flash_dualbank_swap();
 
+    PROFILE_START(WOLFBOOT_PROF_PREPARE_BOOT);
     hal_prepare_boot();
+    PROFILE_END(WOLFBOOT_PROF_PREPARE_BOOT);
+    wolfBoot_profile_report();
     do_boot((void *)WOLFBOOT_PARTITION_BOOT_ADDRESS + IMAGE_HEADER_SIZE);
 }
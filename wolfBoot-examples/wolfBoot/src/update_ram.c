@@ -27,16 +27,41 @@
 #include "hal.h"
 #include "spi_flash.h"
 #include "printf.h"
+#include "profile.h"
 #include "wolfboot/wolfboot.h"
 #include <string.h>
 
 extern void hal_flash_dualbank_swap(void);
 
-static inline void boot_panic(void)
+#if defined(EXT_FLASH) || defined(COMPRESSED_IMAGES)
+/* Images on external flash are verified while being copied to RAM: the
+ * payload is read only once from the external memory, and its digest is
+ * computed over the RAM copy, which is the one authenticated and booted.
+ * Compressed images are decompressed to RAM while being verified.
+ * Returns 1 if the image has been loaded to 'dst' in the process.
+ */
+static int RAMFUNCTION wolfBoot_ram_verify_integrity(struct wolfBoot_image *img,
+        uint8_t *dst)
 {
-    while(1)
-        ;
+#ifdef COMPRESSED_IMAGES
+    if (wolfBoot_get_compressed_size(img) != 0) {
+        if (wolfBoot_verify_integrity_copy(img, dst) < 0)
+            return -1;
+        return 1;
+    }
+#endif
+#ifdef EXT_FLASH
+    if (PART_IS_EXT(img)) {
+        if (wolfBoot_verify_integrity_copy(img, dst) < 0)
+            return -1;
+        return 1;
+    }
+#endif
+    return wolfBoot_verify_integrity(img);
 }
+#else
+#define wolfBoot_ram_verify_integrity(img, dst) wolfBoot_verify_integrity(img)
+#endif
 
 void RAMFUNCTION wolfBoot_start(void)
 {
@@ -45,6 +70,7 @@ void RAMFUNCTION wolfBoot_start(void)
     uint32_t* load_address = (uint32_t*)WOLFBOOT_LOAD_ADDRESS;
     uint8_t* image_ptr;
     uint8_t p_state;
+    int loaded = 0;
 #ifdef MMU
     uint32_t* dts_address = NULL;
 #endif
@@ -54,7 +80,7 @@ void RAMFUNCTION wolfBoot_start(void)
     wolfBoot_printf("Active Part %d\n", active);
 
     if (active < 0) /* panic if no images available */
-        boot_panic();
+        wolfBoot_panic();
 
     /* Check current status for failure (image still in TESTING), and fall-back
      * if an alternative is available
@@ -68,7 +94,8 @@ void RAMFUNCTION wolfBoot_start(void)
 
     for (;;) {
         if (((ret = wolfBoot_open_image(&os_image, active)) < 0) ||
-            ((ret = wolfBoot_verify_integrity(&os_image) < 0)) ||
+            ((ret = loaded = wolfBoot_ram_verify_integrity(&os_image,
+                    (uint8_t *)load_address)) < 0) ||
             ((ret = wolfBoot_verify_authenticity(&os_image)) < 0)) {
 
         wolfBoot_printf("Failure %d: Part %d, Hdr %d, Hash %d, Sig %d\n", ret, 
@@ -76,7 +103,7 @@ void RAMFUNCTION wolfBoot_start(void)
 
             /* panic if authentication fails and no backup */
             if (!wolfBoot_fallback_is_possible())
-                boot_panic();
+                wolfBoot_panic();
             else {
                 /* Invalidate failing image and switch to the
                  * other partition
@@ -103,7 +130,10 @@ void RAMFUNCTION wolfBoot_start(void)
     }
 
     /* Check for U-Boot Legacy format image header */
-    image_ptr = wolfBoot_peek_image(&os_image, 0, NULL);
+    if (loaded)
+        image_ptr = (uint8_t *)load_address;
+    else
+        image_ptr = wolfBoot_peek_image(&os_image, 0, NULL);
     if (image_ptr) {
         if (*((uint32_t*)image_ptr) == UBOOT_IMG_HDR_MAGIC) {
             /* Note: Could parse header and get load_address at 0x10 */
@@ -111,12 +141,15 @@ void RAMFUNCTION wolfBoot_start(void)
             /* Skip 64 bytes (size of Legacy format image header) */
             os_image.fw_base += UBOOT_IMG_HDR_SZ;
             os_image.fw_size -= UBOOT_IMG_HDR_SZ;
+            if (loaded)
+                memmove(load_address, (uint8_t *)load_address + UBOOT_IMG_HDR_SZ,
+                        os_image.fw_size);
         }
     }
 
 #ifdef EXT_FLASH
     /* Load image to RAM */
-    if (PART_IS_EXT(&os_image)) {
+    if (PART_IS_EXT(&os_image) && !loaded) {
         wolfBoot_printf("Loading %d to RAM at %08lx\n", os_image.fw_size, load_address);
 
         ext_flash_read((uintptr_t)os_image.fw_base, 
@@ -143,7 +176,10 @@ void RAMFUNCTION wolfBoot_start(void)
     }
 #endif
 
+    PROFILE_START(WOLFBOOT_PROF_PREPARE_BOOT);
     hal_prepare_boot();
+    PROFILE_END(WOLFBOOT_PROF_PREPARE_BOOT);
+    wolfBoot_profile_report();
 	
     wolfBoot_printf("Booting at %08lx\n", load_address);
 
@@ -0,0 +1,404 @@
+/* update_stream.c
+ *
+ * Streaming receive of a new firmware into the UPDATE partition, for the
+ * applications (see wolfBoot_update_open() in docs/API.md).
+ *
+ * The image is received in chunks of any size, copied into one of two
+ * buffers of WOLFBOOT_UPDATE_BUF_SIZE bytes and hashed on the fly. A full
+ * buffer is programmed by wolfBoot_update_poll(), which the application can
+ * call while it waits for more data, so that the reception of the next
+ * buffer overlaps with the programming of the previous one. The sectors are
+ * erased ahead of the write pointer by the same calls. If both buffers are
+ * full, wolfBoot_update_write() programs the oldest one itself.
+ *
+ * wolfBoot_update_finalize() compares the digest with the manifest header,
+ * verifies the signature with the embedded public key, and only then
+ * triggers the update.
+ *
+ * Link with libwolfboot, the public key (src/<algo>_pub_key.c) and the
+ * wolfCrypt hash and signature algorithms selected for wolfBoot.
+ *
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "hal.h"
+#include "wolfboot/wolfboot.h"
+#include "image.h"
+#include "loader.h"
+
+#include <wolfssl/wolfcrypt/settings.h>
+#if defined(WOLFBOOT_HASH_SHA256)
+#include <wolfssl/wolfcrypt/sha256.h>
+#elif defined(WOLFBOOT_HASH_SHA3_384)
+#include <wolfssl/wolfcrypt/sha3.h>
+#endif
+
+#if defined(EXT_ENCRYPTED)
+#   error "The update streaming API does not support encrypted partitions"
+#endif
+
+#if defined(WOLFBOOT_SIGN_ED25519)
+#include <wolfssl/wolfcrypt/ed25519.h>
+#   define STREAM_IMG_TYPE_AUTH HDR_IMG_TYPE_AUTH_ED25519
+#elif defined(WOLFBOOT_SIGN_ECC256)
+#include <wolfssl/wolfcrypt/ecc.h>
+#   define STREAM_IMG_TYPE_AUTH HDR_IMG_TYPE_AUTH_ECC256
+#   define ECC_KEY_SIZE 32
+#else
+#   error "The update streaming API supports ED25519 and ECC256 only"
+#endif
+
+#ifndef WOLFBOOT_UPDATE_BUF_SIZE
+#   if WOLFBOOT_SECTOR_SIZE < 2048
+#       define WOLFBOOT_UPDATE_BUF_SIZE WOLFBOOT_SECTOR_SIZE
+#   else
+#       define WOLFBOOT_UPDATE_BUF_SIZE 2048
+#   endif
+#endif
+
+#if (WOLFBOOT_SECTOR_SIZE % WOLFBOOT_UPDATE_BUF_SIZE) != 0
+#   error "WOLFBOOT_UPDATE_BUF_SIZE must divide WOLFBOOT_SECTOR_SIZE"
+#endif
+#if WOLFBOOT_UPDATE_BUF_SIZE < IMAGE_HEADER_SIZE
+#   error "WOLFBOOT_UPDATE_BUF_SIZE must hold the manifest header"
+#endif
+
+#define STREAM_CLOSED   0
+#define STREAM_OPEN     1
+#define STREAM_FAILED   2
+
+static struct {
+    uint8_t buf[2][WOLFBOOT_UPDATE_BUF_SIZE];
+    uint8_t hdr[IMAGE_HEADER_SIZE];
+    uint32_t received;      /* bytes received */
+    uint32_t total;         /* header + firmware size, 0 until known */
+    uint32_t programmed;    /* bytes programmed in the partition */
+    uint32_t erased;        /* bytes erased in the partition */
+    uint16_t fill_len;      /* bytes in buf[fill] */
+    uint8_t fill;           /* buffer being filled */
+    uint8_t pending;        /* buf[fill ^ 1] waits to be programmed */
+    uint8_t hash_payload;   /* the digest covers the payload as stored */
+    uint8_t compressed;     /* the digest covers the decompressed payload */
+    uint8_t state;
+#if defined(WOLFBOOT_HASH_SHA256)
+    wc_Sha256 hash;
+#elif defined(WOLFBOOT_HASH_SHA3_384)
+    wc_Sha3 hash;
+#endif
+} stream;
+
+#if defined(WOLFBOOT_HASH_SHA256)
+#   define stream_hash_init(h) wc_InitSha256(h)
+#   define stream_hash_update(h, d, l) wc_Sha256Update(h, d, l)
+#   define stream_hash_final(h, out) wc_Sha256Final(h, out)
+#elif defined(WOLFBOOT_HASH_SHA3_384)
+#   define stream_hash_init(h) wc_InitSha3_384(h, NULL, INVALID_DEVID)
+#   define stream_hash_update(h, d, l) wc_Sha3_384_Update(h, d, l)
+#   define stream_hash_final(h, out) wc_Sha3_384_Final(h, out)
+#endif
+
+static int stream_erase(uint32_t off)
+{
+    int ret;
+    if (PARTN_IS_EXT(PART_UPDATE)) {
+        ext_flash_unlock();
+        ret = ext_flash_erase(WOLFBOOT_PARTITION_UPDATE_ADDRESS + off,
+                WOLFBOOT_SECTOR_SIZE);
+        ext_flash_lock();
+    } else {
+        hal_flash_unlock();
+        ret = hal_flash_erase(WOLFBOOT_PARTITION_UPDATE_ADDRESS + off,
+                WOLFBOOT_SECTOR_SIZE);
+        hal_flash_lock();
+    }
+    return ret;
+}
+
+static int stream_program(uint32_t off, const uint8_t *data, uint32_t len)
+{
+    int ret;
+    if (PARTN_IS_EXT(PART_UPDATE)) {
+        ext_flash_unlock();
+        ret = ext_flash_write(WOLFBOOT_PARTITION_UPDATE_ADDRESS + off, data,
+                len);
+        ext_flash_lock();
+    } else {
+        hal_flash_unlock();
+        ret = hal_flash_write(WOLFBOOT_PARTITION_UPDATE_ADDRESS + off, data,
+                len);
+        hal_flash_lock();
+    }
+    return ret;
+}
+
+/* Program 'len' bytes of buffer 'b' at the write pointer, erasing the
+ * sectors it spans first if they have not been erased ahead
+ */
+static int stream_flush(int b, uint32_t len)
+{
+    while (stream.erased < stream.programmed + len) {
+        if (stream_erase(stream.erased) < 0)
+            return -1;
+        stream.erased += WOLFBOOT_SECTOR_SIZE;
+    }
+    if (stream_program(stream.programmed, stream.buf[b], len) < 0)
+        return -1;
+    stream.programmed += len;
+    return 0;
+}
+
+/* The header is complete: check it and hash it, up to the digest TLV */
+static int stream_header(void)
+{
+    uint8_t *p;
+    uint16_t len, type;
+    uint8_t *tlv = stream.hdr + IMAGE_HEADER_OFFSET;
+
+    len = wolfBoot_find_header(tlv, HDR_IMG_TYPE, &p);
+    if (len != sizeof(uint16_t))
+        return -1;
+    type = p[0] | (p[1] << 8);
+    if (((type & HDR_IMG_TYPE_PART_MASK) != HDR_IMG_TYPE_APP) ||
+            ((type & 0xFF00) != STREAM_IMG_TYPE_AUTH))
+        return -1;
+    if ((wolfBoot_find_header(tlv, HDR_SIGNATURE, &p) != IMAGE_SIGNATURE_SIZE)
+            || (wolfBoot_find_header(tlv, WOLFBOOT_SHA_HDR, &p) !=
+                WOLFBOOT_SHA_DIGEST_SIZE))
+        return -1;
+    /* As image_hash() in src/image.c: the payload of merkle tree images is
+     * covered by the root in the header, and the digest of compressed images
+     * by their decompressed payload, which is only checked by wolfBoot.
+     */
+    stream.compressed =
+        (wolfBoot_find_header(tlv, HDR_IMG_COMPRESSED, &p) != 0);
+    stream.hash_payload = !stream.compressed &&
+        (wolfBoot_find_header(tlv, HDR_MERKLE_BLOCK_SIZE, &p) == 0);
+    if (stream_hash_init(&stream.hash) != 0)
+        return -1;
+    p = tlv;
+    wolfBoot_find_header(tlv, WOLFBOOT_SHA_HDR, &p);
+    p -= 2 * sizeof(uint16_t); /* Type + Len */
+    return stream_hash_update(&stream.hash, stream.hdr, p - stream.hdr);
+}
+
+static int stream_key_hash(uint8_t *digest)
+{
+    if (stream_hash_init(&stream.hash) != 0)
+        return -1;
+    if (stream_hash_update(&stream.hash, KEY_BUFFER, KEY_LEN) != 0)
+        return -1;
+    return stream_hash_final(&stream.hash, digest);
+}
+
+static int stream_verify_signature(const uint8_t *hash, const uint8_t *sig)
+{
+    int ret, res = 0;
+#if defined(WOLFBOOT_SIGN_ED25519)
+    ed25519_key ed;
+
+    ret = wc_ed25519_init(&ed);
+    if (ret == 0)
+        ret = wc_ed25519_import_public(KEY_BUFFER, KEY_LEN, &ed);
+    if (ret == 0)
+        ret = wc_ed25519_verify_msg(sig, IMAGE_SIGNATURE_SIZE, hash,
+                WOLFBOOT_SHA_DIGEST_SIZE, &res, &ed);
+#elif defined(WOLFBOOT_ECC_TABLE)
+    ret = ecc256_verify_table(hash, sig, &res);
+#else
+    mp_int r, s;
+    ecc_key ecc;
+
+    ret = wc_ecc_init(&ecc);
+    if (ret == 0)
+        ret = wc_ecc_import_unsigned(&ecc, (byte *)KEY_BUFFER,
+                (byte *)(KEY_BUFFER + ECC_KEY_SIZE), NULL, ECC_SECP256R1);
+    if ((ret == 0) && (ecc.type != ECC_PUBLICKEY))
+        ret = -1;
+    if (ret == 0) {
+        mp_init(&r);
+        mp_init(&s);
+        mp_read_unsigned_bin(&r, sig, ECC_KEY_SIZE);
+        mp_read_unsigned_bin(&s, sig + ECC_KEY_SIZE, ECC_KEY_SIZE);
+        ret = wc_ecc_verify_hash_ex(&r, &s, hash, WOLFBOOT_SHA_DIGEST_SIZE,
+                &res, &ecc);
+    }
+    wc_ecc_free(&ecc);
+#endif
+    if ((ret < 0) || (res == 0))
+        return -1;
+    return 0;
+}
+
+int wolfBoot_update_open(void)
+{
+    memset(&stream, 0, sizeof(stream));
+    stream.state = STREAM_OPEN;
+    return 0;
+}
+
+int wolfBoot_update_write(const uint8_t *data, uint32_t len)
+{
+    uint32_t done = 0, n;
+    uint32_t magic, size;
+
+    if (stream.state != STREAM_OPEN)
+        return -1;
+    while (done < len) {
+        if ((stream.total != 0) && (stream.received == stream.total))
+            break;
+        if (stream.fill_len == WOLFBOOT_UPDATE_BUF_SIZE) {
+            /* Not polled often enough: program the oldest buffer now */
+            if (stream.pending && (stream_flush(stream.fill ^ 1,
+                            WOLFBOOT_UPDATE_BUF_SIZE) < 0))
+                goto fail;
+            stream.pending = 1;
+            stream.fill ^= 1;
+            stream.fill_len = 0;
+        }
+        n = WOLFBOOT_UPDATE_BUF_SIZE - stream.fill_len;
+        if (n > len - done)
+            n = len - done;
+        if (stream.received < IMAGE_HEADER_SIZE) {
+            if (n > IMAGE_HEADER_SIZE - stream.received)
+                n = IMAGE_HEADER_SIZE - stream.received;
+        } else if (n > stream.total - stream.received) {
+            n = stream.total - stream.received;
+        }
+        memcpy(stream.buf[stream.fill] + stream.fill_len, data + done, n);
+
+        if (stream.received < IMAGE_HEADER_SIZE) {
+            memcpy(stream.hdr + stream.received, data + done, n);
+            stream.received += n;
+            if ((stream.total == 0) &&
+                    (stream.received >= IMAGE_HEADER_OFFSET)) {
+                memcpy(&magic, stream.hdr, sizeof(uint32_t));
+                memcpy(&size, stream.hdr + sizeof(uint32_t),
+                        sizeof(uint32_t));
+                if ((magic != WOLFBOOT_MAGIC) ||
+                        (size > (WOLFBOOT_PARTITION_SIZE - IMAGE_HEADER_SIZE)))
+                    goto fail;
+                stream.total = IMAGE_HEADER_SIZE + size;
+            }
+            if ((stream.received == IMAGE_HEADER_SIZE) &&
+                    (stream_header() != 0))
+                goto fail;
+        } else {
+            if (stream.hash_payload && (stream_hash_update(&stream.hash,
+                            data + done, n) != 0))
+                goto fail;
+            stream.received += n;
+        }
+        stream.fill_len += n;
+        done += n;
+    }
+    return (int)done;
+
+fail:
+    stream.state = STREAM_FAILED;
+    return -1;
+}
+
+int wolfBoot_update_poll(void)
+{
+    uint32_t end;
+
+    if (stream.state != STREAM_OPEN)
+        return -1;
+    if (stream.pending) {
+        if (stream_flush(stream.fill ^ 1, WOLFBOOT_UPDATE_BUF_SIZE) < 0) {
+            stream.state = STREAM_FAILED;
+            return -1;
+        }
+        stream.pending = 0;
+        return 1;
+    }
+    /* Erase ahead the sectors where the two buffers are going to be
+     * programmed
+     */
+    end = stream.programmed + 2 * WOLFBOOT_UPDATE_BUF_SIZE;
+    if ((stream.erased < stream.total) && (stream.erased < end)) {
+        if (stream_erase(stream.erased) < 0) {
+            stream.state = STREAM_FAILED;
+            return -1;
+        }
+        stream.erased += WOLFBOOT_SECTOR_SIZE;
+        return 1;
+    }
+    return 0;
+}
+
+uint32_t wolfBoot_update_remaining(void)
+{
+    if (stream.total == 0)
+        return IMAGE_HEADER_SIZE - stream.received;
+    return stream.total - stream.received;
+}
+
+int wolfBoot_update_finalize(void)
+{
+    uint8_t digest[WOLFBOOT_SHA_DIGEST_SIZE];
+    uint8_t *stored, *sig;
+    uint8_t *tlv = stream.hdr + IMAGE_HEADER_OFFSET;
+    int ret = -1;
+
+    if ((stream.state != STREAM_OPEN) || (stream.total == 0) ||
+            (stream.received != stream.total))
+        goto out;
+    if (stream.pending && (stream_flush(stream.fill ^ 1,
+                    WOLFBOOT_UPDATE_BUF_SIZE) < 0))
+        goto out;
+    stream.pending = 0;
+    if ((stream.fill_len > 0) && (stream_flush(stream.fill,
+                    stream.fill_len) < 0))
+        goto out;
+
+    if (stream_hash_final(&stream.hash, digest) != 0)
+        goto out;
+    wolfBoot_find_header(tlv, WOLFBOOT_SHA_HDR, &stored);
+    if (!stream.compressed &&
+            (memcmp(digest, stored, WOLFBOOT_SHA_DIGEST_SIZE) != 0))
+        goto out;
+    if (wolfBoot_find_header(tlv, HDR_PUBKEY, &stored) ==
+            WOLFBOOT_SHA_DIGEST_SIZE) {
+        if ((stream_key_hash(digest) != 0) ||
+                (memcmp(digest, stored, WOLFBOOT_SHA_DIGEST_SIZE) != 0))
+            goto out;
+    }
+    wolfBoot_find_header(tlv, HDR_SIGNATURE, &sig);
+    wolfBoot_find_header(tlv, WOLFBOOT_SHA_HDR, &stored);
+    if (stream_verify_signature(stored, sig) < 0)
+        goto out;
+
+#ifndef FLAGS_HOME
+    /* Stale flags of a previous update in the last sector */
+    if (stream.erased < WOLFBOOT_PARTITION_SIZE) {
+        if (stream_erase(WOLFBOOT_PARTITION_SIZE - WOLFBOOT_SECTOR_SIZE) < 0)
+            goto out;
+    }
+#endif
+    wolfBoot_update_trigger();
+    ret = 0;
+out:
+    stream.state = STREAM_CLOSED;
+    return ret;
+}
@@ -0,0 +1,85 @@
+/* app_sim.c
+ *
+ * Test application for the host simulator (TARGET=sim).
+ *
+ * Receives a signed update with the streaming API of libwolfboot
+ * (src/update_stream.c), as an application would from the network: the
+ * image is read from a file in chunks of varying sizes, and the flash is
+ * polled between two chunks, but not after all of them.
+ *
+ * Usage: app_sim.elf image_vN_signed.bin
+ * Returns 0 if the update has been triggered.
+ *
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "hal.h"
+#include "wolfboot/wolfboot.h"
+
+static const uint32_t chunk_sizes[] = { 3, 1, 700, 1460, 5, 4096, 1460, 999 };
+#define N_CHUNK_SIZES (sizeof(chunk_sizes) / sizeof(chunk_sizes[0]))
+
+int main(int argc, char **argv)
+{
+    static uint8_t chunk[4096];
+    FILE *f;
+    uint32_t i = 0, len;
+    int ret;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s image_signed.bin\n", argv[0]);
+        return 2;
+    }
+    f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        perror(argv[1]);
+        return 2;
+    }
+    hal_init();
+
+    wolfBoot_update_open();
+    while (wolfBoot_update_remaining() > 0) {
+        len = chunk_sizes[i++ % N_CHUNK_SIZES];
+        len = fread(chunk, 1, len, f);
+        if (len == 0)
+            break;
+        ret = wolfBoot_update_write(chunk, len);
+        if (ret < 0) {
+            printf("app sim: image rejected at offset %ld\n", ftell(f));
+            fclose(f);
+            return 1;
+        }
+        /* Every third chunk arrives before the flash is ready */
+        if ((i % 3) != 0) {
+            while (wolfBoot_update_poll() > 0)
+                ;
+        }
+    }
+    fclose(f);
+    if (wolfBoot_update_finalize() < 0) {
+        printf("app sim: update rejected\n");
+        return 1;
+    }
+    printf("app sim: update to version %u triggered\n",
+            (unsigned)wolfBoot_update_firmware_version());
+    return 0;
+}
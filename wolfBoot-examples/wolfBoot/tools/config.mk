@@ -17,6 +17,7 @@ ifeq ($(ARCH),)
   VTOR?=1
   CORTEX_M0?=0
   NO_ASM?=0
+  THUMB2_ASM?=1
   EXT_FLASH?=0
   SPI_FLASH?=0
   NO_XIP?=0
@@ -24,13 +25,25 @@ ifeq ($(ARCH),)
   ALLOW_DOWNGRADE?=0
   NVM_FLASH_WRITEONCE?=0
   DISABLE_BACKUP?=0
+  SKIP_UNCHANGED_SECTORS?=0
+  DELTA_UPDATES?=0
+  COMPRESSED_IMAGES?=0
+  MERKLE_TREE?=0
+  VERIFY_CACHE?=0
+  MULTI_IMAGE?=0
+  WOLFBOOT_PROFILE?=0
   WOLFBOOT_VERSION?=0
   V?=0
   NO_MPU?=0
   ENCRYPT?=0
+  ENCRYPT_WITH_AES128?=0
+  ENCRYPT_WITH_AES256?=0
   FLAGS_HOME?=0
   FLAGS_INVERT?=0
+  FLAGS_JOURNAL?=0
   SPMATH?=1
+  ECC_TABLE?=1
+  VERIFY_BATCH?=1
   RAM_CODE?=0
   DUALBANK_SWAP?=0
   IMAGE_HEADER_SIZE?=256
@@ -47,14 +60,17 @@ ifeq ($(ARCH),)
   WOLFBOOT_DTS_UPDATE_ADDRESS=0x50000
   WOLFBOOT_LOAD_ADDRESS?=0x200000
   WOLFBOOT_LOAD_DTS_ADDRESS?=0x400000
+  WOLFBOOT_COMPONENTS?=1
 endif
 
 CONFIG_VARS:= ARCH TARGET SIGN HASH MCUXPRESSO MCUXPRESSO_CPU MCUXPRESSO_DRIVERS \
 	MCUXPRESSO_CMSIS FREEDOM_E_SDK STM32CUBE CYPRESS_PDL CYPRESS_CORE_LIB CYPRESS_TARGET_LIB DEBUG VTOR \
-	CORTEX_M0 CORTEX_M33 NO_ASM EXT_FLASH SPI_FLASH NO_XIP UART_FLASH ALLOW_DOWNGRADE NVM_FLASH_WRITEONCE \
-	DISABLE_BACKUP WOLFBOOT_VERSION V NO_MPU ENCRYPT FLAGS_HOME FLAGS_INVERT \
-	SPMATH RAM_CODE DUALBANK_SWAP IMAGE_HEADER_SIZE PKA TZEN PSOC6_CRYPTO WOLFTPM \
+	CORTEX_M0 CORTEX_M33 NO_ASM THUMB2_ASM EXT_FLASH SPI_FLASH NO_XIP UART_FLASH ALLOW_DOWNGRADE NVM_FLASH_WRITEONCE \
+	DISABLE_BACKUP SKIP_UNCHANGED_SECTORS DELTA_UPDATES COMPRESSED_IMAGES MERKLE_TREE VERIFY_CACHE MULTI_IMAGE WOLFBOOT_PROFILE WOLFBOOT_VERSION V NO_MPU ENCRYPT ENCRYPT_WITH_AES128 ENCRYPT_WITH_AES256 FLAGS_HOME \
+	FLAGS_INVERT FLAGS_JOURNAL FLAGS_JOURNAL_SLOTS SPMATH ECC_TABLE VERIFY_BATCH RAM_CODE DUALBANK_SWAP IMAGE_HEADER_SIZE PKA TZEN PSOC6_CRYPTO WOLFTPM \
 	WOLFBOOT_PARTITION_SIZE WOLFBOOT_SECTOR_SIZE  \
 	WOLFBOOT_PARTITION_BOOT_ADDRESS WOLFBOOT_PARTITION_UPDATE_ADDRESS \
 	WOLFBOOT_PARTITION_SWAP_ADDRESS WOLFBOOT_LOAD_ADDRESS \
-	WOLFBOOT_LOAD_DTS_ADDRESS
+	WOLFBOOT_LOAD_DTS_ADDRESS WOLFBOOT_VERIFY_CACHE_ADDRESS \
+	WOLFBOOT_COMPONENTS WOLFBOOT_COMPONENT_ADDRESS WOLFBOOT_COMPONENT_SIZE \
+	WOLFBOOT_PROFILE_ADDRESS WOLFBOOT_PROFILE_HZ
@@ -75,11 +75,20 @@ const char Cfile_Banner[] = "/* Public-key file for wolfBoot, automatically gene
                              " */" \
                              "\n#include <stdint.h>\n\n";
 
+const char Cfile_Table_Banner[] = "/* Public-key tables for wolfBoot, automatically generated. Do not edit.  */\n" \
+                             "/*\n" \
+                             " * This file has been generated and contains the pre-computed multiples\n" \
+                             " * of the base point and of the public key used by wolfBoot to verify\n" \
+                             " * the updates.\n" \
+                             " */" \
+                             "\n#include <stdint.h>\n\n";
+
 
 
 static void usage(const char *pname) /* implies exit */
 {
     printf("Usage: %s [--ed25519 | --ecc256 | --rsa2048 | --rsa4096 ]  pub_key_file.c\n", pname);
+    printf("  - or -   %s --ecc256 --table pub_key_table.c\n", pname);
     exit(125);
 }
 
@@ -205,6 +214,141 @@ static void keygen_ecc256(WC_RNG *rng, char *pubkfile)
     fprintf(fpub, "const uint32_t ecc256_pub_key_len = 64;\n");
     fclose(fpub);
 }
+
+/* Comb tables for the verification in wolfBoot (src/ecc256_verify.c).
+ * Entry i (1..15) of the table of a point P is the sum of 2^(64 * j) * P for
+ * each bit j set in i, in affine coordinates. The coordinates are stored
+ * big-endian, in Montgomery form (x * 2^256 mod prime).
+ */
+#define ECC256_TABLE_TEETH    4
+#define ECC256_TABLE_SPACING  (256 / ECC256_TABLE_TEETH)
+#define ECC256_TABLE_ENTRIES  ((1 << ECC256_TABLE_TEETH) - 1)
+
+/* 2^256 mod prime */
+static const char Ecc256_mont_norm[] =
+    "00000000FFFFFFFEFFFFFFFFFFFFFFFFFFFFFFFF000000000000000000000001";
+
+static int ecc256_write_table(FILE *f, const char *name, ecc_point *P,
+        mp_int *a, mp_int *prime, mp_int *norm)
+{
+    ecc_point *T;
+    mp_int k, m;
+    uint8_t scalar[ECC256_KEY_SIZE];
+    uint8_t entry[2 * ECC256_KEY_SIZE];
+    int i, j, ret;
+
+    T = wc_ecc_new_point();
+    if (T == NULL)
+        return MEMORY_E;
+    ret = mp_init_multi(&k, &m, NULL, NULL, NULL, NULL);
+    fprintf(f, "const uint8_t %s[%d] = {", name,
+            ECC256_TABLE_ENTRIES * (int)sizeof(entry));
+    for (i = 1; (i <= ECC256_TABLE_ENTRIES) && (ret == 0); i++) {
+        memset(scalar, 0, sizeof(scalar));
+        for (j = 0; j < ECC256_TABLE_TEETH; j++) {
+            if (i & (1 << j))
+                scalar[ECC256_KEY_SIZE - 1 - j * (ECC256_TABLE_SPACING / 8)] = 1;
+        }
+        ret = mp_read_unsigned_bin(&k, scalar, sizeof(scalar));
+        if (ret == 0)
+            ret = wc_ecc_mulmod(&k, P, T, a, prime, 1);
+        if (ret == 0)
+            ret = mp_mulmod(T->x, norm, prime, &m);
+        if (ret == 0)
+            ret = mp_to_unsigned_bin_len(&m, entry, ECC256_KEY_SIZE);
+        if (ret == 0)
+            ret = mp_mulmod(T->y, norm, prime, &m);
+        if (ret == 0)
+            ret = mp_to_unsigned_bin_len(&m, entry + ECC256_KEY_SIZE,
+                    ECC256_KEY_SIZE);
+        if (ret == 0) {
+            if (i > 1)
+                fprintf(f, ",");
+            fwritekey(entry, sizeof(entry), f);
+        }
+    }
+    fprintf(f, "\n};\n");
+    mp_clear(&k);
+    mp_clear(&m);
+    wc_ecc_del_point(T);
+    return ret;
+}
+
+/* Generate the tables for the generator and for the public key stored in
+ * 'keyfile' (Qx | Qy | d, as written by keygen_ecc256)
+ */
+static void keygen_ecc256_table(const char *keyfile, char *tablefile)
+{
+    const ecc_set_type *curve;
+    ecc_point *G, *Q;
+    mp_int a, prime, norm;
+    uint8_t Qxy[2 * ECC256_KEY_SIZE];
+    FILE *fkey, *ftab;
+    int ret;
+
+    fkey = fopen(keyfile, "rb");
+    if (fkey == NULL) {
+        fprintf(stderr, "Unable to open key file '%s': %s\n", keyfile, strerror(errno));
+        exit(1);
+    }
+    if (fread(Qxy, sizeof(Qxy), 1, fkey) != 1) {
+        fprintf(stderr, "Unable to read the public key from '%s'\n", keyfile);
+        exit(1);
+    }
+    fclose(fkey);
+
+    curve = wc_ecc_get_curve_params(wc_ecc_get_curve_idx(ECC_SECP256R1));
+    G = wc_ecc_new_point();
+    Q = wc_ecc_new_point();
+    if ((curve == NULL) || (G == NULL) || (Q == NULL)) {
+        fprintf(stderr, "Unable to set up the curve parameters\n");
+        exit(2);
+    }
+    ret = mp_init_multi(&a, &prime, &norm, NULL, NULL, NULL);
+    if (ret == 0)
+        ret = mp_read_radix(&a, curve->Af, MP_RADIX_HEX);
+    if (ret == 0)
+        ret = mp_read_radix(&prime, curve->prime, MP_RADIX_HEX);
+    if (ret == 0)
+        ret = mp_read_radix(&norm, Ecc256_mont_norm, MP_RADIX_HEX);
+    if (ret == 0)
+        ret = mp_read_radix(G->x, curve->Gx, MP_RADIX_HEX);
+    if (ret == 0)
+        ret = mp_read_radix(G->y, curve->Gy, MP_RADIX_HEX);
+    if (ret == 0)
+        ret = mp_set(G->z, 1);
+    if (ret == 0)
+        ret = mp_read_unsigned_bin(Q->x, Qxy, ECC256_KEY_SIZE);
+    if (ret == 0)
+        ret = mp_read_unsigned_bin(Q->y, Qxy + ECC256_KEY_SIZE, ECC256_KEY_SIZE);
+    if (ret == 0)
+        ret = mp_set(Q->z, 1);
+    if (ret != 0) {
+        fprintf(stderr, "Invalid public key in '%s'\n", keyfile);
+        exit(2);
+    }
+
+    ftab = fopen(tablefile, "w");
+    if (ftab == NULL) {
+        fprintf(stderr, "Unable to open file '%s' for writing: %s", tablefile, strerror(errno));
+        exit(4);
+    }
+    fprintf(ftab, "%s", Cfile_Table_Banner);
+    ret = ecc256_write_table(ftab, "ecc256_base_table", G, &a, &prime, &norm);
+    if (ret == 0)
+        ret = ecc256_write_table(ftab, "ecc256_pub_key_table", Q, &a, &prime, &norm);
+    fclose(ftab);
+    if (ret != 0) {
+        fprintf(stderr, "Unable to compute the tables (%d)\n", ret);
+        remove(tablefile);
+        exit(3);
+    }
+    mp_clear(&a);
+    mp_clear(&prime);
+    mp_clear(&norm);
+    wc_ecc_del_point(G);
+    wc_ecc_del_point(Q);
+}
 #endif
 
 
@@ -253,6 +397,7 @@ int main(int argc, char** argv)
 {
     int i;
     int force = 0;
+    int table = 0;
     int  keytype = 0;
     const char *kfilename = NULL;
     char *output_pubkey_file;
@@ -288,6 +433,9 @@ int main(int argc, char** argv)
         else if (strcmp(argv[i], "--force") == 0) {
             force = 1;
         }
+        else if (strcmp(argv[i], "--table") == 0) {
+            table = 1;
+        }
         else {
             fprintf(stderr, "Invalid argument '%s'.", argv[i]);
             usage(argv[0]);
@@ -295,6 +443,18 @@ int main(int argc, char** argv)
     }
     output_pubkey_file = strdup(argv[argc - 1]);
 
+#ifdef HAVE_ECC
+    if (table) {
+        if (keytype != KEYGEN_ECC256)
+            usage(argv[0]);
+        printf("Public key:            %s\n", kfilename);
+        printf("Generated table C file:        %s\n", output_pubkey_file);
+        keygen_ecc256_table(kfilename, output_pubkey_file);
+        printf("Done.\n");
+        return 0;
+    }
+#endif
+
     f = fopen(kfilename, "rb");
     if (!force && (f != NULL)) {
         char reply[40];
@@ -22,10 +22,10 @@
 '''
 
 import sys,os
-from wolfcrypt import ciphers
 
 def usage():
     print("Usage: %s [--ed25519 | --ecc256 | --rsa2048 | --rsa4096] [ --force ] pub_key_file.c\n" % sys.argv[0])
+    print("  - or -   %s --ecc256 --table pub_key_table.c\n" % sys.argv[0])
     parser.print_help()
     sys.exit(1)
 
@@ -42,6 +42,14 @@ Cfile_Banner="/* Public-key file for wolfBoot, automatically generated. Do not e
              " */" \
              "\n#include <stdint.h>\n\n"
 
+Cfile_Table_Banner="/* Public-key tables for wolfBoot, automatically generated. Do not edit.  */\n"+ \
+             "/*\n" + \
+             " * This file has been generated and contains the pre-computed multiples\n"+ \
+             " * of the base point and of the public key used by wolfBoot to verify\n"+ \
+             " * the updates.\n"+ \
+             " */" \
+             "\n#include <stdint.h>\n\n"
+
 Ed25519_pub_key_define = "const uint8_t ed25519_pub_key[32] = {\n\t"
 Ecc256_pub_key_define = "const uint8_t ecc256_pub_key[64] = {\n\t"
 Rsa_2048_pub_key_define = "const uint8_t rsa2048_pub_key[%d] = {\n\t"
@@ -57,6 +65,7 @@ parser.add_argument('--ecc256',  dest='ecc256', action='store_true')
 parser.add_argument('--rsa2048', dest='rsa2048', action='store_true')
 parser.add_argument('--rsa4096', dest='rsa4096', action='store_true')
 parser.add_argument('--force', dest='force', action='store_true')
+parser.add_argument('--table', dest='table', action='store_true')
 parser.add_argument('cfile')
 
 args=parser.parse_args()
@@ -93,6 +102,81 @@ if pubkey_cfile[-2:] != '.c':
 
 key_file=sign+".der"
 
+# Comb tables for the verification in wolfBoot (src/ecc256_verify.c).
+# Entry i (1..15) of the table of a point P is the sum of 2^(64 * j) * P for
+# each bit j set in i, in affine coordinates. The coordinates are stored
+# big-endian, in Montgomery form (x * 2^256 mod prime).
+ECC256_P = 0xFFFFFFFF00000001000000000000000000000000FFFFFFFFFFFFFFFFFFFFFFFF
+ECC256_A = ECC256_P - 3
+ECC256_GX = 0x6B17D1F2E12C4247F8BCE6E563A440F277037D812DEB33A0F4A13945D898C296
+ECC256_GY = 0x4FE342E2FE1A7F9B8EE7EB4A7C0F9E162BCE33576B315ECECBB6406837BF51F5
+ECC256_TABLE_TEETH = 4
+ECC256_TABLE_SPACING = 256 // ECC256_TABLE_TEETH
+
+def ecc256_add(P, Q):
+    if P is None:
+        return Q
+    if Q is None:
+        return P
+    if P[0] == Q[0]:
+        if (P[1] + Q[1]) % ECC256_P == 0:
+            return None
+        l = (3 * P[0] * P[0] + ECC256_A) * pow(2 * P[1], ECC256_P - 2, ECC256_P)
+    else:
+        l = (Q[1] - P[1]) * pow(Q[0] - P[0], ECC256_P - 2, ECC256_P)
+    x = (l * l - P[0] - Q[0]) % ECC256_P
+    return (x, (l * (P[0] - x) - P[1]) % ECC256_P)
+
+def ecc256_mul(k, P):
+    R = None
+    while k > 0:
+        if k & 1:
+            R = ecc256_add(R, P)
+        P = ecc256_add(P, P)
+        k >>= 1
+    return R
+
+def ecc256_write_table(f, name, P):
+    f.write("const uint8_t %s[%d] = {" % (name, ((1 << ECC256_TABLE_TEETH) - 1) * 64))
+    n = 0
+    for i in range(1, 1 << ECC256_TABLE_TEETH):
+        k = 0
+        for j in range(ECC256_TABLE_TEETH):
+            if i & (1 << j):
+                k += 1 << (j * ECC256_TABLE_SPACING)
+        x, y = ecc256_mul(k, P)
+        entry = ((x << 256) % ECC256_P).to_bytes(32, 'big') + \
+                ((y << 256) % ECC256_P).to_bytes(32, 'big')
+        for c in entry:
+            if n > 0:
+                f.write(",")
+            if n % 8 == 0:
+                f.write("\n\t")
+            else:
+                f.write(" ")
+            f.write("0x%02X" % c)
+            n += 1
+    f.write("\n};\n")
+
+if args.table:
+    if sign != "ecc256":
+        usage()
+    with open(key_file, "rb") as f:
+        qxy = f.read(64)
+    Q = (int.from_bytes(qxy[0:32], 'big'), int.from_bytes(qxy[32:64], 'big'))
+    if (Q[1] * Q[1] - Q[0] ** 3 - ECC256_A * Q[0]) % ECC256_P != \
+            0x5AC635D8AA3A93E7B3EBBD55769886BC651D06B0CC53B0F63BCE3C3E27D2604B:
+        print("Invalid public key in " + key_file)
+        sys.exit(2)
+    print("Creating file " + pubkey_cfile)
+    with open(pubkey_cfile, "w") as f:
+        f.write(Cfile_Table_Banner)
+        ecc256_write_table(f, "ecc256_base_table", (ECC256_GX, ECC256_GY))
+        ecc256_write_table(f, "ecc256_pub_key_table", Q)
+    sys.exit(0)
+
+from wolfcrypt import ciphers
+
 print ("Selected cipher:      " + sign)
 print ("Output Private key:   " + key_file)
 print ("Output C file:        " + pubkey_cfile)
@@ -35,6 +35,12 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <pthread.h>
+#endif
 
 #include <wolfssl/wolfcrypt/settings.h>
 #include <wolfssl/wolfcrypt/asn.h>
@@ -42,6 +48,9 @@
 #ifdef HAVE_CHACHA
 #include <wolfssl/wolfcrypt/chacha.h>
 #endif
+#ifndef NO_AES
+#include <wolfssl/wolfcrypt/aes.h>
+#endif
 
 #ifndef NO_RSA
     #include <wolfssl/wolfcrypt/rsa.h>
@@ -64,6 +73,9 @@
     #include <wolfssl/wolfcrypt/logging.h>
 #endif
 
+#include "delta.h"
+#include "compress.h"
+
 #if defined(_WIN32) && !defined(PATH_MAX)
 	#define PATH_MAX 256
 #endif
@@ -75,6 +87,14 @@
 #define HDR_PUBKEY      0x10
 #define HDR_SIGNATURE   0x20
 #define HDR_IMG_TYPE    0x04
+#define HDR_IMG_DELTA_BASE          0x05
+#define HDR_IMG_DELTA_SIZE          0x06
+#define HDR_MERKLE_BLOCK_SIZE       0x07
+#define HDR_MERKLE_ROOT             0x08
+#define HDR_COMPONENTS              0x09
+#define HDR_IMG_COMPRESSED          0x0A
+#define HDR_IMG_DELTA_INVERSE       0x15
+#define HDR_IMG_DELTA_INVERSE_SIZE  0x16
 
 #define HDR_SHA256      0x03
 #define HDR_SHA3_384    0x13
@@ -91,6 +111,7 @@
 #define HDR_IMG_TYPE_AUTH_RSA4096 0x0400
 #define HDR_IMG_TYPE_WOLFBOOT     0x0000
 #define HDR_IMG_TYPE_APP          0x0001
+#define HDR_IMG_TYPE_DIFF         0x00D0
 
 #define HASH_SHA256    HDR_SHA256
 #define HASH_SHA3      HDR_SHA3_384
@@ -101,7 +122,26 @@
 #define SIGN_RSA2048   HDR_IMG_TYPE_AUTH_RSA2048
 #define SIGN_RSA4096   HDR_IMG_TYPE_AUTH_RSA4096
 
-#define ENC_BLOCK_SIZE 16
+/* Ciphers for encrypted external partitions (see docs/encrypted_partitions.md) */
+#define ENC_OFF        0
+#define ENC_CHACHA     1
+#define ENC_AES128     2
+#define ENC_AES256     3
+
+#define ENC_MAX_KEY_SZ 32
+#define ENC_MAX_IV_SZ  16
+
+/* Size of the buffer used to encrypt the output image */
+#define ENC_CHUNK_SZ   (64 * 1024)
+
+/* Batch mode: every image is signed by one worker thread, the state of the
+ * image being signed (options, key) is private to the thread.
+ */
+#if defined(_WIN32)
+    #define THREAD_LOCAL __declspec(thread)
+#else
+    #define THREAD_LOCAL __thread
+#endif
 
 static void header_append_u32(uint8_t* header, uint32_t* idx, uint32_t tmp32)
 {
@@ -122,131 +162,1245 @@ static void header_append_tag(uint8_t* header, uint32_t* idx, uint16_t tag,
     *idx += len;
 }
 
-int main(int argc, char** argv)
+
+#define MAX_COMPONENTS 8
+
+/* Longest command line (also for the entries of a batch manifest) */
+#define MAX_ARGS (16 + 2 * MAX_COMPONENTS)
+
+/* Component listed in the manifest of the image (see docs/multi_image.md) */
+struct component {
+    uint8_t id;
+    uint8_t slot;
+    uint32_t version;
+    const char *file;
+};
+
+/* Signing options, shared by all the images produced in one run */
+struct cmd_options {
+    int sign;
+    int hash_algo;
+    int self_update;
+    int sha_only;
+    int manual_sign;
+    int sign_wenc;
+    int encrypt;
+    int encrypt_algo;
+    const char *signature_file;
+    const char *encrypt_key_file;
+    uint32_t header_sz;
+    uint32_t signature_sz;
+    uint8_t *pubkey;
+    uint32_t pubkey_sz;
+    uint32_t merkle_block_size;
+    int compress;
+    struct component components[MAX_COMPONENTS];
+    int n_components;
+};
+
+static const struct cmd_options CMD_DEFAULTS = {
+    .sign = SIGN_AUTO,
+    .hash_algo = HASH_SHA256,
+    .encrypt_algo = ENC_CHACHA
+};
+
+static THREAD_LOCAL struct cmd_options CMD;
+
+static THREAD_LOCAL union {
+#ifdef HAVE_ED25519
+    ed25519_key ed;
+#endif
+#ifdef HAVE_ECC
+    ecc_key ecc;
+#endif
+#ifndef NO_RSA
+    RsaKey rsa;
+#endif
+} key;
+
+/* Digest of a buffer, with the hash algorithm selected for the image */
+static int hash_buffer(const uint8_t *data, uint32_t len, uint8_t *out)
+{
+    int ret = NOT_COMPILED_IN;
+    if (CMD.hash_algo == HASH_SHA256) {
+    #ifndef NO_SHA256
+        wc_Sha256 sha;
+        ret = wc_InitSha256_ex(&sha, NULL, INVALID_DEVID);
+        if (ret == 0)
+            ret = wc_Sha256Update(&sha, data, len);
+        if (ret == 0)
+            ret = wc_Sha256Final(&sha, out);
+        wc_Sha256Free(&sha);
+    #endif
+    }
+    else if (CMD.hash_algo == HASH_SHA3) {
+    #ifdef WOLFSSL_SHA3
+        wc_Sha3 sha;
+        ret = wc_InitSha3_384(&sha, NULL, INVALID_DEVID);
+        if (ret == 0)
+            ret = wc_Sha3_384_Update(&sha, data, len);
+        if (ret == 0)
+            ret = wc_Sha3_384_Final(&sha, out);
+        wc_Sha3_384_Free(&sha);
+    #endif
+    }
+    return ret;
+}
+
+/* Merkle tree over the payload, verified by wolfBoot (see src/image.c):
+ *   - leaf:       H(0x00 | block)
+ *   - inner node: H(0x01 | left | right)
+ * A node without a sibling is promoted to the upper level as it is.
+ */
+static int merkle_hash(uint8_t prefix, const uint8_t *d1, uint32_t l1,
+        const uint8_t *d2, uint32_t l2, uint8_t *out)
+{
+    int ret = NOT_COMPILED_IN;
+    if (CMD.hash_algo == HASH_SHA256) {
+    #ifndef NO_SHA256
+        wc_Sha256 sha;
+        ret = wc_InitSha256_ex(&sha, NULL, INVALID_DEVID);
+        if (ret == 0)
+            ret = wc_Sha256Update(&sha, &prefix, 1);
+        if (ret == 0)
+            ret = wc_Sha256Update(&sha, d1, l1);
+        if ((ret == 0) && (l2 > 0))
+            ret = wc_Sha256Update(&sha, d2, l2);
+        if (ret == 0)
+            ret = wc_Sha256Final(&sha, out);
+        wc_Sha256Free(&sha);
+    #endif
+    }
+    else if (CMD.hash_algo == HASH_SHA3) {
+    #ifdef WOLFSSL_SHA3
+        wc_Sha3 sha;
+        ret = wc_InitSha3_384(&sha, NULL, INVALID_DEVID);
+        if (ret == 0)
+            ret = wc_Sha3_384_Update(&sha, &prefix, 1);
+        if (ret == 0)
+            ret = wc_Sha3_384_Update(&sha, d1, l1);
+        if ((ret == 0) && (l2 > 0))
+            ret = wc_Sha3_384_Update(&sha, d2, l2);
+        if (ret == 0)
+            ret = wc_Sha3_384_Final(&sha, out);
+        wc_Sha3_384_Free(&sha);
+    #endif
+    }
+    return ret;
+}
+
+static int merkle_root(const uint8_t *data, uint32_t size, uint32_t block_size,
+        uint8_t *root, uint32_t digest_sz)
+{
+    uint32_t n = (size + block_size - 1) / block_size;
+    uint32_t i, len;
+    uint8_t *nodes;
+    int ret = 0;
+
+    if (n == 0)
+        n = 1;
+    nodes = malloc(n * digest_sz);
+    if (nodes == NULL)
+        return -1;
+    for (i = 0; (ret == 0) && (i < n); i++) {
+        len = size - i * block_size;
+        if (len > block_size)
+            len = block_size;
+        ret = merkle_hash(0x00, data + i * block_size, len, NULL, 0,
+                nodes + i * digest_sz);
+    }
+    while ((ret == 0) && (n > 1)) {
+        for (i = 0; (ret == 0) && (i < n / 2); i++) {
+            ret = merkle_hash(0x01, nodes + 2 * i * digest_sz, digest_sz,
+                    nodes + (2 * i + 1) * digest_sz, digest_sz, nodes + i * digest_sz);
+        }
+        if (n & 1)
+            memmove(nodes + (n / 2) * digest_sz, nodes + (n - 1) * digest_sz, digest_sz);
+        n = (n + 1) / 2;
+    }
+    if (ret == 0)
+        memcpy(root, nodes, digest_sz);
+    free(nodes);
+    return ret;
+}
+
+/* Input file (image, component, delta base), mapped read-only in memory */
+struct input_file {
+    const uint8_t *data;
+    uint32_t size;
+    int mapped;
+};
+
+static int open_input(const char *fname, struct input_file *in)
+{
+#ifndef _WIN32
+    struct stat st;
+    void *map;
+    int fd;
+#endif
+    FILE *f;
+    uint8_t *buf;
+    long sz;
+
+    memset(in, 0, sizeof(*in));
+#ifndef _WIN32
+    fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        printf("Open file %s failed\n", fname);
+        return -1;
+    }
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0) &&
+            ((uint64_t)st.st_size <= UINT32_MAX)) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+        #ifdef MADV_SEQUENTIAL
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+        #endif
+            close(fd);
+            in->data = map;
+            in->size = (uint32_t)st.st_size;
+            in->mapped = 1;
+            return 0;
+        }
+    }
+    close(fd);
+#endif
+    /* Empty file, or no mmap: read it in a buffer */
+    f = fopen(fname, "rb");
+    if (f == NULL) {
+        printf("Open file %s failed\n", fname);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    sz = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(sz > 0 ? sz : 1);
+    if (buf && (fread(buf, 1, sz, f) != (size_t)sz)) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    if (buf == NULL) {
+        printf("Read file %s failed\n", fname);
+        return -1;
+    }
+    in->data = buf;
+    in->size = (uint32_t)sz;
+    return 0;
+}
+
+static void close_input(struct input_file *in)
+{
+#ifndef _WIN32
+    if (in->mapped)
+        munmap((void *)in->data, in->size);
+    else
+#endif
+        free((void *)in->data);
+    in->data = NULL;
+}
+
+/* Append the component manifest: a single TLV with one entry per component,
+ *   id (1) | slot (1) | reserved (2) | version (LE32) | size (LE32) | digest
+ */
+static int append_components(uint8_t *header, uint32_t *idx, uint32_t digest_sz)
+{
+    uint8_t *entry;
+    struct input_file data;
+    uint32_t entry_sz = 12 + digest_sz;
+    uint16_t len = (uint16_t)(CMD.n_components * entry_sz);
+    int i, ret = 0;
+
+    header_append_u16(header, idx, HDR_COMPONENTS);
+    header_append_u16(header, idx, len);
+    for (i = 0; (ret == 0) && (i < CMD.n_components); i++) {
+        entry = header + *idx;
+        if (open_input(CMD.components[i].file, &data) < 0)
+            return -1;
+        entry[0] = CMD.components[i].id;
+        entry[1] = CMD.components[i].slot;
+        entry[2] = 0;
+        entry[3] = 0;
+        memcpy(entry + 4, &CMD.components[i].version, sizeof(uint32_t));
+        memcpy(entry + 8, &data.size, sizeof(uint32_t));
+        /* Plain digest of the component: no prefix byte */
+        ret = hash_buffer(data.data, data.size, entry + 12);
+        close_input(&data);
+        *idx += entry_sz;
+    }
+    return ret;
+}
+
+/* Compressed images: LZSS encoder (see include/compress.h for the format) */
+struct bit_writer {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t bits;
+    int n_bits;
+};
+
+static void put_bits(struct bit_writer *w, uint32_t val, int n)
+{
+    while (n-- > 0) {
+        w->bits = (w->bits << 1) | ((val >> n) & 1);
+        if (++w->n_bits == 8) {
+            w->buf[w->size++] = (uint8_t)w->bits;
+            w->bits = 0;
+            w->n_bits = 0;
+        }
+    }
+}
+
+/* Greedy parsing: at each position, the longest match in the window is
+ * found by walking a hash chain of the positions starting with the same
+ * two bytes. A back-reference is worth it from two bytes on.
+ */
+static uint8_t *compress_lzss(const uint8_t *in, uint32_t in_sz,
+        uint32_t *out_sz)
+{
+    const uint32_t window = 1U << COMPRESS_WINDOW_BITS;
+    const uint32_t max_len = 1U << COMPRESS_LOOKAHEAD_BITS;
+    struct bit_writer w = { 0 };
+    int32_t *head, *prev, c;
+    uint32_t pos = 0, end, best, best_dist, len, h;
+    int chain;
+
+    w.buf = malloc(in_sz + in_sz / 8 + 2);
+    head = malloc(0x10000 * sizeof(int32_t));
+    prev = malloc((in_sz + 1) * sizeof(int32_t));
+    if (!w.buf || !head || !prev) {
+        free(w.buf);
+        w.buf = NULL;
+        goto exit;
+    }
+    memset(head, 0xFF, 0x10000 * sizeof(int32_t));
+    while (pos < in_sz) {
+        best = 0;
+        best_dist = 0;
+        if (pos + 1 < in_sz) {
+            h = in[pos] | (in[pos + 1] << 8);
+            for (c = head[h], chain = 0; (c >= 0) && (pos - c <= window) &&
+                    (chain < 256); c = prev[c], chain++) {
+                len = 0;
+                while ((len < max_len) && (pos + len < in_sz) &&
+                        (in[c + len] == in[pos + len]))
+                    len++;
+                if (len > best) {
+                    best = len;
+                    best_dist = pos - c;
+                    if (len == max_len)
+                        break;
+                }
+            }
+        }
+        if (best >= 2) {
+            put_bits(&w, 0, 1);
+            put_bits(&w, best_dist - 1, COMPRESS_WINDOW_BITS);
+            put_bits(&w, best - 1, COMPRESS_LOOKAHEAD_BITS);
+        } else {
+            best = 1;
+            put_bits(&w, 1, 1);
+            put_bits(&w, in[pos], 8);
+        }
+        for (end = pos + best; pos < end; pos++) {
+            if (pos + 1 < in_sz) {
+                h = in[pos] | (in[pos + 1] << 8);
+                prev[pos] = head[h];
+                head[h] = pos;
+            }
+        }
+    }
+    if (w.n_bits > 0)
+        w.buf[w.size++] = (uint8_t)(w.bits << (8 - w.n_bits));
+    *out_sz = w.size;
+exit:
+    free(head);
+    free(prev);
+    return w.buf;
+}
+
+/* Create a signed image 'outfile' from the content of 'image_file'.
+ * Optional extra TLV fields (already encoded) are appended to the header.
+ */
+static int make_image(const char *image_file, const char *outfile,
+        const char *enc_outfile, uint32_t fw_version32, uint16_t image_type,
+        const uint8_t *extra_tlv, uint32_t extra_tlv_sz)
 {
     int ret = 0;
+    FILE *f, *fek, *fef;
+    uint8_t* header = NULL;
+    uint32_t header_idx = 0;
+    uint8_t* signature = NULL;
+    uint32_t signature_sz = CMD.signature_sz;
+    uint32_t image_sz = 0;
+    uint8_t  digest[48]; /* max digest */
+    uint32_t digest_sz = 0;
+    uint8_t  buf[1024];
+    uint32_t read_sz, pos;
+    struct input_file image;
+    const uint8_t *payload;
+    uint32_t payload_sz;
+    uint8_t *comp = NULL;
+    uint32_t comp_sz = 0;
+    uint8_t *enc_buf = NULL;
+    struct stat attrib;
+    WC_RNG rng;
+
+    /* Map the image, which is hashed, compressed and copied from memory */
+    if (open_input(image_file, &image) < 0)
+        return -1;
+    image_sz = image.size;
+
+    header_idx = 0;
+    header = malloc(CMD.header_sz);
+    if (header == NULL) {
+        printf("Header malloc error!\n");
+        close_input(&image);
+        return -1;
+    }
+    memset(header, 0xFF, CMD.header_sz);
+
+    /* Append Magic header (spells 'WOLF') */
+    header_append_u32(header, &header_idx, WOLFBOOT_MAGIC);
+    /* Append Image size */
+    header_append_u32(header, &header_idx, image_sz);
+
+    /* No pad bytes, version is aligned */
+
+    /* Append Version field */
+    header_append_tag(header, &header_idx, HDR_VERSION, HDR_VERSION_LEN,
+        &fw_version32);
+
+    /* Append Four pad bytes, so timestamp is aligned */
+    header_idx += 4; /* memset 0xFF above handles value */
+
+    /* Append Timestamp field */
+    stat(image_file, &attrib);
+    header_append_tag(header, &header_idx, HDR_TIMESTAMP, HDR_TIMESTAMP_LEN,
+        &attrib.st_ctime);
+
+    /* Append Image type field */
+    header_append_tag(header, &header_idx, HDR_IMG_TYPE, HDR_IMG_TYPE_LEN,
+        &image_type);
+
+    /* Extra fields, 4-byte aligned */
+    if ((extra_tlv_sz > 0) || (CMD.merkle_block_size > 0) ||
+            (CMD.n_components > 0))
+        header_idx += 2; /* memset 0xFF above handles value */
+    if (extra_tlv_sz > 0) {
+        memcpy(&header[header_idx], extra_tlv, extra_tlv_sz);
+        header_idx += extra_tlv_sz;
+    }
+
+    /* Merkle root of the image, the digest only covers the header */
+    if (CMD.merkle_block_size > 0) {
+        uint32_t root_sz = (CMD.hash_algo == HASH_SHA3) ? HDR_SHA3_384_LEN : HDR_SHA256_LEN;
+        ret = merkle_root(image.data, image_sz, CMD.merkle_block_size, digest,
+                root_sz);
+        if (ret != 0) {
+            printf("Merkle tree error %d\n", ret);
+            goto exit;
+        }
+        header_append_tag(header, &header_idx, HDR_MERKLE_BLOCK_SIZE,
+            sizeof(uint32_t), &CMD.merkle_block_size);
+        header_append_tag(header, &header_idx, HDR_MERKLE_ROOT, root_sz, digest);
+    }
+
+    /* Component manifest, covered by the digest of the header */
+    if (CMD.n_components > 0) {
+        uint32_t comp_digest_sz = (CMD.hash_algo == HASH_SHA3) ? HDR_SHA3_384_LEN : HDR_SHA256_LEN;
+        uint32_t room = header_idx + 4 + CMD.n_components * (12 + comp_digest_sz);
+        if (room + 2 * (4 + comp_digest_sz) + 4 + signature_sz > CMD.header_sz) {
+            printf("Error: header size (%u) too small for %d components, set IMAGE_HEADER_SIZE\n",
+                CMD.header_sz, CMD.n_components);
+            ret = -1;
+            goto exit;
+        }
+        ret = append_components(header, &header_idx, comp_digest_sz);
+        if (ret != 0) {
+            printf("Error hashing the components\n");
+            goto exit;
+        }
+    }
+
+    /* Pad bytes, Sha-3 requires 8-byte alignment of the digest. */
+    while (((header_idx + 4) % 8) != 0)
+        header_idx++; /* memset 0xFF above handles value */
+
+    /* Check room for digest, pubkey hint and signature */
+    digest_sz = (CMD.hash_algo == HASH_SHA3) ? HDR_SHA3_384_LEN : HDR_SHA256_LEN;
+    if (header_idx + 2 * (4 + digest_sz) + 4 + signature_sz > CMD.header_sz) {
+        printf("Error: header size (%u) too small for the selected options\n",
+            CMD.header_sz);
+        ret = -1;
+        goto exit;
+    }
+    digest_sz = 0;
+
+    /* Calculate hashes */
+    if (CMD.hash_algo == HASH_SHA256)
+    {
+    #ifndef NO_SHA256
+        wc_Sha256 sha;
+
+        printf("Calculating SHA256 digest...\n");
+        ret = wc_InitSha256_ex(&sha, NULL, INVALID_DEVID);
+        if (ret == 0) {
+            /* Hash Header */
+            ret = wc_Sha256Update(&sha, header, header_idx);
+
+            /* Hash image, unless covered by the merkle root */
+            if ((ret == 0) && (CMD.merkle_block_size == 0))
+                ret = wc_Sha256Update(&sha, image.data, image_sz);
+            if (ret == 0)
+                wc_Sha256Final(&sha, digest);
+            wc_Sha256Free(&sha);
+        }
+
+        /* pubkey hash calculation */
+        if (ret == 0) {
+            ret = wc_InitSha256_ex(&sha, NULL, INVALID_DEVID);
+            if (ret == 0) {
+                ret = wc_Sha256Update(&sha, CMD.pubkey, CMD.pubkey_sz);
+                if (ret == 0)
+                    wc_Sha256Final(&sha, buf);
+                wc_Sha256Free(&sha);
+            }
+        }
+        if (ret == 0)
+            digest_sz = HDR_SHA256_LEN;
+    #endif
+    }
+    else if (CMD.hash_algo == HASH_SHA3)
+    {
+    #ifdef WOLFSSL_SHA3
+        wc_Sha3 sha;
+
+        printf("Calculating SHA3 digest...\n");
+
+        ret = wc_InitSha3_384(&sha, NULL, INVALID_DEVID);
+        if (ret == 0) {
+            /* Hash Header */
+            ret = wc_Sha3_384_Update(&sha, header, header_idx);
+
+            /* Hash image, unless covered by the merkle root */
+            if ((ret == 0) && (CMD.merkle_block_size == 0))
+                ret = wc_Sha3_384_Update(&sha, image.data, image_sz);
+            if (ret == 0)
+                ret = wc_Sha3_384_Final(&sha, digest);
+            wc_Sha3_384_Free(&sha);
+        }
+
+        /* pubkey hash calculation */
+        if (ret == 0) {
+            ret = wc_InitSha3_384(&sha, NULL, INVALID_DEVID);
+            if (ret == 0) {
+                ret = wc_Sha3_384_Update(&sha, CMD.pubkey, CMD.pubkey_sz);
+                if (ret == 0)
+                    ret = wc_Sha3_384_Final(&sha, buf);
+                wc_Sha3_384_Free(&sha);
+            }
+        }
+        if (ret == 0)
+            digest_sz = HDR_SHA3_384_LEN;
+    #endif
+    }
+    if (digest_sz == 0) {
+        printf("Hash algorithm error %d\n", ret);
+        ret = -1;
+        goto exit;
+    }
+#ifdef DEBUG_SIGNTOOL
+    printf("Image hash %d\n", digest_sz);
+    WOLFSSL_BUFFER(digest, digest_sz);
+    printf("Pubkey hash %d\n", digest_sz);
+    WOLFSSL_BUFFER(buf, digest_sz);
+#endif
+
+    /* Add image hash to header */
+    header_append_tag(header, &header_idx, CMD.hash_algo, digest_sz, digest);
+
+    /* Add Pubkey Hash to header */
+    header_append_tag(header, &header_idx, HDR_PUBKEY, digest_sz, buf);
+
+    /* If hash only, then save digest and exit */
+    if (CMD.sha_only) {
+        f = fopen(outfile, "wb");
+        if (f == NULL) {
+            printf("Open output file %s failed\n", outfile);
+            ret = -1;
+            goto exit;
+        }
+        fwrite(digest, digest_sz, 1, f);
+        fclose(f);
+        printf("Digest image %s successfully created.\n", outfile);
+        ret = 0;
+        goto exit;
+    }
+
+    /* Sign the digest */
+    ret = NOT_COMPILED_IN; /* default error */
+    signature = malloc(signature_sz);
+    if (signature == NULL) {
+        printf("Signature malloc error!\n");
+        goto exit;
+    }
+    memset(signature, 0, signature_sz);
+    if (!CMD.manual_sign) {
+        printf("Signing the firmware...\n");
+
+        wc_InitRng(&rng);
+        if (CMD.sign == SIGN_ED25519) {
+        #ifdef HAVE_ED25519
+            ret = wc_ed25519_sign_msg(digest, digest_sz, signature, &signature_sz, &key.ed);
+        #endif
+        }
+        else if (CMD.sign == SIGN_ECC256) {
+        #ifdef HAVE_ECC
+            mp_int r, s;
+            mp_init(&r); mp_init(&s);
+            ret = wc_ecc_sign_hash_ex(digest, digest_sz, &rng, &key.ecc, &r, &s);
+            /* r and s are left-padded with zeros to 32 bytes each */
+            mp_to_unsigned_bin_len(&r, &signature[0], 32);
+            mp_to_unsigned_bin_len(&s, &signature[32], 32);
+            mp_clear(&r); mp_clear(&s);
+        #endif
+        }
+        else if (CMD.sign == SIGN_RSA2048 || CMD.sign == SIGN_RSA4096) {
+        #ifndef NO_RSA
+            uint32_t enchash_sz = digest_sz;
+            uint8_t* enchash = digest;
+            if (CMD.sign_wenc) {
+                /* add ASN.1 signature encoding */
+                int hashOID = 0;
+                if (CMD.hash_algo == HASH_SHA256)
+                    hashOID = SHA256h;
+                else if (CMD.hash_algo == HASH_SHA3)
+                    hashOID = SHA3_384h;
+                enchash_sz = wc_EncodeSignature(buf, digest, digest_sz, hashOID);
+                enchash = buf;
+            }
+            ret = wc_RsaSSL_Sign(enchash, enchash_sz, signature, signature_sz,
+                &key.rsa, &rng);
+            if (ret > 0) {
+                signature_sz = ret;
+                ret = 0;
+            }
+        #endif
+        }
+        wc_FreeRng(&rng);
+
+        if (ret != 0) {
+            printf("Signing error %d\n", ret);
+            goto exit;
+        }
+    }
+    else {
+        printf("Opening signature file %s\n", CMD.signature_file);
+
+        f = fopen(CMD.signature_file, "rb");
+        if (f == NULL) {
+            printf("Open signature file %s failed\n", CMD.signature_file);
+            ret = -1;
+            goto exit;
+        }
+        fread(signature, signature_sz, 1, f);
+        fclose(f);
+        ret = 0;
+    }
+#ifdef DEBUG_SIGNTOOL
+    printf("Signature %d\n", signature_sz);
+    WOLFSSL_BUFFER(signature, signature_sz);
+#endif
+
+    /* Add signature to header */
+    header_append_tag(header, &header_idx, HDR_SIGNATURE, signature_sz, signature);
+
+    /* Compressed payload: its parameters follow the signature, outside of
+     * the area covered by the digest */
+    if (CMD.compress) {
+        uint8_t tlv[COMPRESS_TLV_LEN];
+        while ((header_idx % 4) != 0)
+            header_idx++; /* memset 0xFF above handles value */
+        if (header_idx + 4 + COMPRESS_TLV_LEN > CMD.header_sz) {
+            printf("Error: header size (%u) too small for the selected options\n",
+                CMD.header_sz);
+            ret = -1;
+            goto exit;
+        }
+        comp = compress_lzss(image.data, image_sz, &comp_sz);
+        if (comp == NULL) {
+            printf("Error compressing %s\n", image_file);
+            ret = -1;
+            goto exit;
+        }
+        tlv[0] = COMPRESS_ALGO_LZSS;
+        tlv[1] = COMPRESS_WINDOW_BITS;
+        tlv[2] = COMPRESS_LOOKAHEAD_BITS;
+        tlv[3] = 0xFF;
+        memcpy(tlv + 4, &comp_sz, sizeof(uint32_t));
+        header_append_tag(header, &header_idx, HDR_IMG_COMPRESSED,
+            COMPRESS_TLV_LEN, tlv);
+        printf("Compressed payload:   %u -> %u bytes\n", (uint32_t)image_sz,
+            comp_sz);
+    }
+
+    /* Add padded header at end */
+    while (header_idx < CMD.header_sz) {
+        header[header_idx++] = 0xFF;
+    }
+
+    /* Create output image */
+    if (comp != NULL) {
+        payload = comp;
+        payload_sz = comp_sz;
+    } else {
+        payload = image.data;
+        payload_sz = image_sz;
+    }
+    f = fopen(outfile, "wb");
+    if (f == NULL) {
+        printf("Open output image file %s failed\n", outfile);
+        ret = -1;
+        goto exit;
+    }
+    if ((fwrite(header, 1, header_idx, f) != header_idx) ||
+            (fwrite(payload, 1, payload_sz, f) != payload_sz)) {
+        printf("Write output image file %s failed\n", outfile);
+        ret = -1;
+    }
+    fclose(f);
+    if (ret != 0)
+        goto exit;
+
+    if (CMD.encrypt && CMD.encrypt_key_file) {
+        uint8_t key[ENC_MAX_KEY_SZ], iv[ENC_MAX_IV_SZ];
+        uint32_t key_sz, iv_sz;
+        uint32_t fsize = header_idx + payload_sz;
+#ifdef HAVE_CHACHA
+        ChaCha cha;
+#endif
+#ifndef NO_AES
+        Aes aes;
+#endif
+        ret = -1;
+        if (CMD.encrypt_algo == ENC_CHACHA) {
+#ifndef HAVE_CHACHA
+            fprintf(stderr, "Encryption not supported: chacha support not found in wolfssl configuration.\n");
+            goto exit;
+#endif
+            key_sz = 32;
+            iv_sz = 12;
+        } else {
+#ifdef NO_AES
+            fprintf(stderr, "Encryption not supported: AES support not found in wolfssl configuration.\n");
+            goto exit;
+#endif
+            key_sz = (CMD.encrypt_algo == ENC_AES128) ? 16 : 32;
+            iv_sz = 16;
+        }
+        fek = fopen(CMD.encrypt_key_file, "rb");
+        if (fek == NULL) {
+            fprintf(stderr, "Open encryption key file %s: %s\n", CMD.encrypt_key_file, strerror(errno));
+            goto exit;
+        }
+        if ((fread(key, 1, key_sz, fek) != key_sz) ||
+                (fread(iv, 1, iv_sz, fek) != iv_sz)) {
+            fprintf(stderr, "Encryption key file %s: expected %u bytes of key and %u bytes of IV\n",
+                CMD.encrypt_key_file, key_sz, iv_sz);
+            fclose(fek);
+            goto exit;
+        }
+        fclose(fek);
+        enc_buf = malloc(ENC_CHUNK_SZ);
+        if (enc_buf == NULL) {
+            printf("Encryption buffer malloc error!\n");
+            goto exit;
+        }
+        fef = fopen(enc_outfile, "wb");
+        if (!fef) {
+            fprintf(stderr, "Open encrypted output file %s: %s\n", enc_outfile, strerror(errno));
+            goto exit;
+        }
+
+        /* One keystream for the whole partition: byte N of the image is
+         * always encrypted with byte N of the keystream, so that wolfBoot
+         * can decrypt any range in one pass starting from its offset. */
+#ifdef HAVE_CHACHA
+        if (CMD.encrypt_algo == ENC_CHACHA) {
+            wc_Chacha_SetKey(&cha, key, key_sz);
+            wc_Chacha_SetIV(&cha, iv, 0);
+        }
+#endif
+#ifndef NO_AES
+        if (CMD.encrypt_algo != ENC_CHACHA) {
+            wc_AesInit(&aes, NULL, INVALID_DEVID);
+            wc_AesSetKeyDirect(&aes, key, key_sz, iv, AES_ENCRYPTION);
+        }
+#endif
+        /* Header and payload are encrypted in place, one chunk at a time */
+        ret = 0;
+        for (pos = 0; (ret == 0) && (pos < fsize); pos += read_sz) {
+            uint32_t hdr_part = 0;
+            read_sz = fsize - pos;
+            if (read_sz > ENC_CHUNK_SZ)
+                read_sz = ENC_CHUNK_SZ;
+            if (pos < header_idx) {
+                hdr_part = header_idx - pos;
+                if (hdr_part > read_sz)
+                    hdr_part = read_sz;
+                memcpy(enc_buf, header + pos, hdr_part);
+            }
+            memcpy(enc_buf + hdr_part, payload + pos + hdr_part - header_idx,
+                    read_sz - hdr_part);
+#ifdef HAVE_CHACHA
+            if (CMD.encrypt_algo == ENC_CHACHA)
+                wc_Chacha_Process(&cha, enc_buf, enc_buf, read_sz);
+#endif
+#ifndef NO_AES
+            if (CMD.encrypt_algo != ENC_CHACHA)
+                wc_AesCtrEncrypt(&aes, enc_buf, enc_buf, read_sz);
+#endif
+            if (fwrite(enc_buf, 1, read_sz, fef) != read_sz) {
+                printf("Write encrypted output file %s failed\n", enc_outfile);
+                ret = -1;
+            }
+        }
+        fclose(fef);
+    }
+
+exit:
+    close_input(&image);
+    if (comp)
+        free(comp);
+    if (enc_buf)
+        free(enc_buf);
+    if (header)
+        free(header);
+    if (signature)
+        free(signature);
+    return ret;
+}
+
+/* Delta updates: patch encoder (see include/delta.h for the format) */
+#define DELTA_HASH_BITS      18
+#define DELTA_BLOCK          8   /* bytes indexed to look up a match */
+#define DELTA_MIN_MATCH      16  /* shorter matches are stored as data */
+#define DELTA_MAX_CANDIDATES 256
+
+struct delta_patch {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t alloc;
+};
+
+static int delta_append(struct delta_patch *p, const void *data, uint32_t len)
+{
+    if (p->size + len > p->alloc) {
+        uint32_t alloc = (p->alloc == 0) ? 4096 : p->alloc;
+        uint8_t *tmp;
+        while (p->size + len > alloc)
+            alloc *= 2;
+        tmp = realloc(p->data, alloc);
+        if (tmp == NULL)
+            return -1;
+        p->data = tmp;
+        p->alloc = alloc;
+    }
+    memcpy(p->data + p->size, data, len);
+    p->size += len;
+    return 0;
+}
+
+static int delta_append_u16(struct delta_patch *p, uint16_t val)
+{
+    uint8_t b[2] = { val & 0xFF, val >> 8 };
+    return delta_append(p, b, 2);
+}
+
+static int delta_append_u32(struct delta_patch *p, uint32_t val)
+{
+    uint8_t b[4] = { val & 0xFF, (val >> 8) & 0xFF, (val >> 16) & 0xFF, val >> 24 };
+    return delta_append(p, b, 4);
+}
+
+static int delta_insert(struct delta_patch *p, const uint8_t *data, uint32_t len)
+{
+    uint8_t op = DELTA_OP_INSERT;
+    uint32_t chunk;
+    while (len > 0) {
+        chunk = len;
+        if (chunk > DELTA_OP_MAX_LEN)
+            chunk = DELTA_OP_MAX_LEN;
+        if ((delta_append(p, &op, 1) < 0) || (delta_append_u16(p, chunk) < 0) ||
+                (delta_append(p, data, chunk) < 0))
+            return -1;
+        data += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+static int delta_copy(struct delta_patch *p, uint32_t off, uint32_t len)
+{
+    uint8_t op = DELTA_OP_COPY;
+    if ((delta_append(p, &op, 1) < 0) || (delta_append_u32(p, off) < 0) ||
+            (delta_append_u16(p, len) < 0))
+        return -1;
+    return 0;
+}
+
+static uint32_t delta_hash(const uint8_t *data)
+{
+    uint32_t h = 2166136261U;
+    int i;
+    for (i = 0; i < DELTA_BLOCK; i++)
+        h = (h ^ data[i]) * 16777619U;
+    return h >> (32 - DELTA_HASH_BITS);
+}
+
+/* Compute the patch to rebuild 'dst' in place over 'src', one sector at a
+ * time. Matches are only searched in the portions of 'src' that are still
+ * intact when each sector of 'dst' is written (see include/delta.h).
+ */
+static int delta_diff(const uint8_t *src, uint32_t src_sz, const uint8_t *dst,
+        uint32_t dst_sz, uint32_t sector_sz, struct delta_patch *p)
+{
+    int32_t *head, *next;
+    uint32_t i, start, end, pos, lit, sect0_end;
+    int ret = -1;
+
+    head = malloc(sizeof(int32_t) << DELTA_HASH_BITS);
+    next = malloc(sizeof(int32_t) * (src_sz + 1));
+    if ((head == NULL) || (next == NULL))
+        goto out;
+    memset(head, 0xFF, sizeof(int32_t) << DELTA_HASH_BITS);
+    for (i = 0; i + DELTA_BLOCK <= src_sz; i++) {
+        uint32_t h = delta_hash(src + i);
+        next[i] = head[h];
+        head[h] = i;
+    }
+    sect0_end = (src_sz < sector_sz) ? src_sz : sector_sz;
+
+    if ((delta_append_u32(p, DELTA_PATCH_MAGIC) < 0) ||
+            (delta_append_u32(p, dst_sz) < 0))
+        goto out;
+
+    for (start = 0; start < dst_sz; start += sector_sz) {
+        end = start + sector_sz;
+        if (end > dst_sz)
+            end = dst_sz;
+        pos = lit = start;
+        while (pos < end) {
+            uint32_t best = 0, best_off = 0;
+            if (pos + DELTA_MIN_MATCH <= end) {
+                int32_t c = head[delta_hash(dst + pos)];
+                int visited = 0;
+                while ((c >= 0) && (visited++ < DELTA_MAX_CANDIDATES)) {
+                    uint32_t limit, len = 0;
+                    if ((start > 0) && ((uint32_t)c >= start))
+                        limit = src_sz - c;
+                    else if ((uint32_t)c < sect0_end)
+                        limit = sect0_end - c;
+                    else {
+                        c = next[c];
+                        continue;
+                    }
+                    if (limit > end - pos)
+                        limit = end - pos;
+                    if (limit > DELTA_OP_MAX_LEN)
+                        limit = DELTA_OP_MAX_LEN;
+                    while ((len < limit) && (src[c + len] == dst[pos + len]))
+                        len++;
+                    if (len > best) {
+                        best = len;
+                        best_off = c;
+                        if (len == limit)
+                            break;
+                    }
+                    c = next[c];
+                }
+            }
+            if (best >= DELTA_MIN_MATCH) {
+                if ((delta_insert(p, dst + lit, pos - lit) < 0) ||
+                        (delta_copy(p, best_off, best) < 0))
+                    goto out;
+                pos += best;
+                lit = pos;
+            } else {
+                pos++;
+            }
+        }
+        if (delta_insert(p, dst + lit, end - lit) < 0)
+            goto out;
+    }
+    ret = 0;
+out:
+    free(head);
+    free(next);
+    return ret;
+}
+
+/* Parse the version of a signed image */
+static int image_version(const uint8_t *img, uint32_t img_sz, uint32_t *version)
+{
+    uint32_t idx = 2 * sizeof(uint32_t);
+    uint32_t magic;
+    uint16_t tag, len;
+    if (img_sz < CMD.header_sz)
+        return -1;
+    memcpy(&magic, img, sizeof(magic));
+    if (magic != WOLFBOOT_MAGIC)
+        return -1;
+    while (idx + 4 < CMD.header_sz) {
+        if (img[idx] == 0xFF) {
+            idx++;
+            continue;
+        }
+        tag = img[idx] | (img[idx + 1] << 8);
+        len = img[idx + 2] | (img[idx + 3] << 8);
+        if ((tag == 0) || (idx + 4 + len > CMD.header_sz))
+            break;
+        if ((tag == HDR_VERSION) && (len == HDR_VERSION_LEN)) {
+            memcpy(version, img + idx + 4, sizeof(uint32_t));
+            return 0;
+        }
+        idx += 4 + len;
+    }
+    return -1;
+}
+
+/* Create a delta image, containing the patch from the signed base image to
+ * the signed image just created, and the inverse patch (used for fallback).
+ */
+static int make_delta(const char *base_file, const char *new_file,
+        const char *patch_file, const char *outfile, const char *enc_outfile,
+        uint32_t fw_version32)
+{
+    struct input_file base = { 0 }, img = { 0 };
+    uint32_t base_version, sector_sz;
+    struct delta_patch fwd = { 0 }, inv = { 0 };
+    uint8_t tlv[32];
+    uint32_t tlv_idx = 0;
+    uint16_t image_type;
+    const char *env;
+    FILE *f;
+    int ret = -1;
+
+    env = getenv("WOLFBOOT_SECTOR_SIZE");
+    if (env == NULL) {
+        printf("Delta update: WOLFBOOT_SECTOR_SIZE must be set to the flash sector size\n");
+        return -1;
+    }
+    sector_sz = strtoul(env, NULL, 0);
+    if (sector_sz < CMD.header_sz) {
+        printf("Delta update: invalid sector size %s\n", env);
+        return -1;
+    }
+    if ((open_input(base_file, &base) < 0) || (open_input(new_file, &img) < 0))
+        goto out;
+    if (image_version(base.data, base.size, &base_version) < 0) {
+        printf("Delta update: %s is not a signed image\n", base_file);
+        goto out;
+    }
+    if (base_version == fw_version32) {
+        printf("Delta update: base and update have the same version\n");
+        goto out;
+    }
+    printf("Delta base version:   %u\n", base_version);
+
+    if ((delta_diff(base.data, base.size, img.data, img.size, sector_sz, &fwd) < 0) ||
+            (delta_diff(img.data, img.size, base.data, base.size, sector_sz, &inv) < 0)) {
+        printf("Delta update: error creating patch\n");
+        goto out;
+    }
+    printf("Delta patch:          %u bytes (%u%% of %u), inverse %u bytes\n",
+            fwd.size, (uint32_t)(((uint64_t)fwd.size * 100) / img.size), img.size, inv.size);
+
+    f = fopen(patch_file, "wb");
+    if (f == NULL) {
+        printf("Open patch file %s failed\n", patch_file);
+        goto out;
+    }
+    fwrite(fwd.data, 1, fwd.size, f);
+    fwrite(inv.data, 1, inv.size, f);
+    fclose(f);
+
+    header_append_tag(tlv, &tlv_idx, HDR_IMG_DELTA_BASE, sizeof(uint32_t), &base_version);
+    header_append_tag(tlv, &tlv_idx, HDR_IMG_DELTA_SIZE, sizeof(uint32_t), &fwd.size);
+    header_append_tag(tlv, &tlv_idx, HDR_IMG_DELTA_INVERSE, sizeof(uint32_t), &fwd.size);
+    header_append_tag(tlv, &tlv_idx, HDR_IMG_DELTA_INVERSE_SIZE, sizeof(uint32_t), &inv.size);
+
+    image_type = (uint16_t)CMD.sign | HDR_IMG_TYPE_DIFF;
+    if (!CMD.self_update)
+        image_type |= HDR_IMG_TYPE_APP;
+    ret = make_image(patch_file, outfile, enc_outfile, fw_version32, image_type,
+            tlv, tlv_idx);
+    remove(patch_file);
+
+out:
+    close_input(&base);
+    close_input(&img);
+    free(fwd.data);
+    free(inv.data);
+    return ret;
+}
+
+static int batch_claim_output(const char *outfile);
+
+/* Sign one image: argv holds the options of a single image, as passed on
+ * the command line (or in one entry of the batch manifest).
+ */
+static int sign_image(int argc, char** argv)
+{
+    int ret = -1;
     int i;
-    int self_update = 0;
-    int sha_only = 0;
-    int manual_sign = 0;
-    int encrypt = 0;
-    int hash_algo = HASH_SHA256;
-    int sign = SIGN_AUTO;
     const char* image_file = NULL;
     const char* key_file = NULL;
     const char* fw_version = NULL;
-    const char* signature_file = NULL;
+    const char* delta_base_file = NULL;
     char output_image_file[PATH_MAX];
     char output_encrypted_image_file[PATH_MAX];
+    char output_delta_file[PATH_MAX];
+    char output_delta_encrypted_file[PATH_MAX];
+    char output_patch_file[PATH_MAX];
     char* tmpstr;
-    char *encrypt_key_file = NULL;
     const char* sign_str = "AUTO";
     const char* hash_str = "SHA256";
-    FILE *f, *f2, *fek, *fef;
+    FILE *f;
     uint8_t* key_buffer = NULL;
     size_t   key_buffer_sz = 0;
-    uint8_t* header = NULL;
-    uint32_t header_sz = 0;
-    uint32_t header_idx = 0;
-    uint8_t* signature = NULL;
-    uint32_t signature_sz = 0;
-    uint8_t* pubkey = NULL;
-    uint32_t pubkey_sz = 0;
-    size_t   image_sz = 0;
-    uint8_t  digest[48]; /* max digest */
-    uint32_t digest_sz = 0;
     uint8_t  buf[1024];
-    uint32_t idx, read_sz, pos;
+    uint32_t idx;
     uint16_t image_type;
     uint32_t fw_version32;
-    uint32_t sign_wenc = 0;
-    struct stat attrib;
-    union {
-#ifdef HAVE_ED25519
-    ed25519_key ed;
-#endif
-#ifdef HAVE_ECC
-    ecc_key ecc;
-#endif
-#ifndef NO_RSA
-    RsaKey rsa;
-#endif
-    } key;
-    WC_RNG rng;
+    int key_loaded = 0;
+    const char *env;
 
-#ifdef DEBUG_SIGNTOOL
-    wolfSSL_Debugging_ON();
-#endif
+    CMD = CMD_DEFAULTS;
 
     /* Check arguments and print usage */
-    if (argc < 4 || argc > 10) {
-        printf("Usage: %s [--ed25519 | --ecc256 | --rsa2048 | --rsa2048enc | --rsa4096 | --rsa4096enc ] [--sha256 | --sha3] [--wolfboot-update] [--encrypt enc_key.bin] image key.der fw_version\n", argv[0]);
+    if (argc < 4 || argc > MAX_ARGS) {
+        printf("Usage: %s [--ed25519 | --ecc256 | --rsa2048 | --rsa2048enc | --rsa4096 | --rsa4096enc ] [--sha256 | --sha3] [--wolfboot-update] [--encrypt enc_key.bin [--chacha | --aes128 | --aes256]] [--delta base_signed_img.bin] [--merkle block_size] [--compress] [--component id:slot:version:file ...] image key.der fw_version\n", argv[0]);
         printf("  - or - ");
         printf("       %s [--sha256 | --sha3] [--sha-only] [--wolfboot-update] image pub_key.der fw_version\n", argv[0]);
         printf("  - or - ");
         printf("       %s [--ed25519 | --ecc256 | --rsa2048 | --rsa4096 ] [--sha256 | --sha3] [--manual-sign] image pub_key.der fw_version signature.sig\n", argv[0]);
+        printf("  - or - ");
+        printf("       %s [--jobs n] --batch manifest.txt\n", argv[0]);
         return 0;
     }
 
     /* Parse Arguments */
     for (i=1; i<argc; i++) {
         if (strcmp(argv[i], "--ed25519") == 0) {
-            sign = SIGN_ED25519;
+            CMD.sign = SIGN_ED25519;
             sign_str = "ED25519";
         }
         else if (strcmp(argv[i], "--ecc256") == 0) {
-            sign = SIGN_ECC256;
+            CMD.sign = SIGN_ECC256;
             sign_str = "ECC256";
         }
         else if (strcmp(argv[i], "--rsa2048enc") == 0) {
-            sign = SIGN_RSA2048;
+            CMD.sign = SIGN_RSA2048;
             sign_str = "RSA2048ENC";
-            sign_wenc = 1;
+            CMD.sign_wenc = 1;
         }
         else if (strcmp(argv[i], "--rsa2048") == 0) {
-            sign = SIGN_RSA2048;
+            CMD.sign = SIGN_RSA2048;
             sign_str = "RSA2048";
         }
         else if (strcmp(argv[i], "--rsa4096enc") == 0) {
-            sign = SIGN_RSA4096;
+            CMD.sign = SIGN_RSA4096;
             sign_str = "RSA4096ENC";
-            sign_wenc = 1;
+            CMD.sign_wenc = 1;
         }
         else if (strcmp(argv[i], "--rsa4096") == 0) {
-            sign = SIGN_RSA4096;
+            CMD.sign = SIGN_RSA4096;
             sign_str = "RSA4096";
         }
         else if (strcmp(argv[i], "--sha256") == 0) {
-            hash_algo = HASH_SHA256;
+            CMD.hash_algo = HASH_SHA256;
             hash_str = "SHA256";
         }
-        else if (strcmp(argv[i], "--sha3") == 0) {
-            hash_algo = HASH_SHA3;
-            hash_str = "SHA3";
+        else if (strcmp(argv[i], "--sha3") == 0) {
+            CMD.hash_algo = HASH_SHA3;
+            hash_str = "SHA3";
+        }
+        else if (strcmp(argv[i], "--wolfboot-update") == 0) {
+            CMD.self_update = 1;
+        }
+        else if (strcmp(argv[i], "--sha-only") == 0) {
+            CMD.sha_only = 1;
+        }
+        else if (strcmp(argv[i], "--manual-sign") == 0) {
+            CMD.manual_sign = 1;
+        }
+        else if (strcmp(argv[i], "--encrypt") == 0) {
+            CMD.encrypt = 1;
+            CMD.encrypt_key_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--chacha") == 0) {
+            CMD.encrypt_algo = ENC_CHACHA;
+        }
+        else if (strcmp(argv[i], "--aes128") == 0) {
+            CMD.encrypt_algo = ENC_AES128;
+        }
+        else if (strcmp(argv[i], "--aes256") == 0) {
+            CMD.encrypt_algo = ENC_AES256;
         }
-        else if (strcmp(argv[i], "--wolfboot-update") == 0) {
-            self_update = 1;
+        else if (strcmp(argv[i], "--delta") == 0) {
+            delta_base_file = argv[++i];
         }
-        else if (strcmp(argv[i], "--sha-only") == 0) {
-            sha_only = 1;
+        else if (strcmp(argv[i], "--component") == 0) {
+            struct component *c = &CMD.components[CMD.n_components];
+            unsigned long id, slot, version;
+            int off = 0;
+            if ((CMD.n_components == MAX_COMPONENTS) || (++i >= argc) ||
+                    (sscanf(argv[i], "%lu:%lu:%lu:%n", &id, &slot, &version, &off) != 3) ||
+                    (off == 0) || (id > 0xFF) || (slot > 1)) {
+                printf("Invalid component (id:slot:version:file, up to %d)\n",
+                    MAX_COMPONENTS);
+                return 1;
+            }
+            c->id = (uint8_t)id;
+            c->slot = (uint8_t)slot;
+            c->version = (uint32_t)version;
+            c->file = argv[i] + off;
+            CMD.n_components++;
         }
-        else if (strcmp(argv[i], "--manual-sign") == 0) {
-            manual_sign = 1;
+        else if (strcmp(argv[i], "--compress") == 0) {
+            CMD.compress = 1;
         }
-        else if (strcmp(argv[i], "--encrypt") == 0) {
-            encrypt = 1;
-            encrypt_key_file = argv[++i];
+        else if (strcmp(argv[i], "--merkle") == 0) {
+            CMD.merkle_block_size = strtoul(argv[++i], NULL, 0);
+            if (CMD.merkle_block_size == 0) {
+                printf("Invalid merkle tree block size\n");
+                return 1;
+            }
         } else {
             i--;
             break;
         }
     }
 
+    if (CMD.compress && (delta_base_file || (CMD.merkle_block_size > 0) ||
+                CMD.self_update || CMD.sha_only || CMD.manual_sign)) {
+        printf("--compress cannot be combined with --delta, --merkle, "
+            "--wolfboot-update, --sha-only or --manual-sign\n");
+        return 1;
+    }
+
+    if (argc - i - 1 < (CMD.manual_sign ? 4 : 3)) {
+        printf("Missing arguments: image, key, version%s\n",
+            CMD.manual_sign ? ", signature" : "");
+        return 1;
+    }
     image_file = argv[i+1];
     key_file = argv[i+2];
     fw_version = argv[i+3];
-    if (manual_sign) {
-        signature_file = argv[i+4];
+    if (CMD.manual_sign) {
+        CMD.signature_file = argv[i+4];
     }
 
     strncpy((char*)buf, image_file, sizeof(buf)-1);
@@ -255,19 +1409,47 @@ int main(int argc, char** argv)
         *tmpstr = '\0'; /* null terminate at last "." */
     }
     snprintf(output_image_file, sizeof(output_image_file), "%s_v%s_%s.bin",
-        (char*)buf, fw_version, sha_only ? "digest" : "signed");
+        (char*)buf, fw_version, CMD.sha_only ? "digest" : "signed");
 
     snprintf(output_encrypted_image_file, sizeof(output_encrypted_image_file), "%s_v%s_signed_and_encrypted.bin",
         (char*)buf, fw_version);
 
-    printf("Update type:          %s\n", self_update ? "wolfBoot" : "Firmware");
+    snprintf(output_delta_file, sizeof(output_delta_file), "%s_v%s_signed_diff.bin",
+        (char*)buf, fw_version);
+    snprintf(output_delta_encrypted_file, sizeof(output_delta_encrypted_file),
+        "%s_v%s_signed_diff_and_encrypted.bin", (char*)buf, fw_version);
+    snprintf(output_patch_file, sizeof(output_patch_file), "%s_v%s.patch",
+        (char*)buf, fw_version);
+    if (batch_claim_output(output_image_file) < 0)
+        return 1;
+
+    printf("Update type:          %s\n", CMD.self_update ? "wolfBoot" : "Firmware");
     printf("Input image:          %s\n", image_file);
     printf("Selected cipher:      %s\n", sign_str);
     printf("Selected hash  :      %s\n", hash_str);
     printf("Public key:           %s\n", key_file);
-    printf("Output %6s:        %s\n",    sha_only ? "digest" : "image", output_image_file);
-    if (encrypt) {
+    printf("Output %6s:        %s\n",    CMD.sha_only ? "digest" : "image", output_image_file);
+    if (CMD.encrypt) {
         printf ("Encrypted output: %s\n", output_encrypted_image_file);
+        printf("Encryption:           %s\n",
+            (CMD.encrypt_algo == ENC_CHACHA) ? "ChaCha20" :
+            (CMD.encrypt_algo == ENC_AES128) ? "AES128-CTR" : "AES256-CTR");
+    }
+    if (CMD.merkle_block_size > 0) {
+        printf("Merkle tree blocks:   %u bytes\n", CMD.merkle_block_size);
+    }
+    if (CMD.compress) {
+        printf("Compression:          LZSS, window %u, lookahead %u\n",
+            1U << COMPRESS_WINDOW_BITS, 1U << COMPRESS_LOOKAHEAD_BITS);
+    }
+    for (i = 0; i < CMD.n_components; i++) {
+        printf("Component %u:          %s, version %u, slot %c\n",
+            CMD.components[i].id, CMD.components[i].file,
+            CMD.components[i].version, 'A' + CMD.components[i].slot);
+    }
+    if (delta_base_file) {
+        printf("Delta base image:     %s\n", delta_base_file);
+        printf("Delta output:         %s\n", output_delta_file);
     }
 
     /* open and load key buffer */
@@ -290,57 +1472,57 @@ int main(int argc, char** argv)
 
     /* key type "auto" selection */
     if (key_buffer_sz == 32) {
-        if ((sign != SIGN_ED25519) && !manual_sign && !sha_only ) {
+        if ((CMD.sign != SIGN_ED25519) && !CMD.manual_sign && !CMD.sha_only ) {
             printf("Error: key too short for cipher\n");
             goto exit;
         }
-        if (sign == SIGN_AUTO && (manual_sign || sha_only)) {
+        if (CMD.sign == SIGN_AUTO && (CMD.manual_sign || CMD.sha_only)) {
             printf("ed25519 public key autodetected\n");
-            sign = SIGN_ED25519;
+            CMD.sign = SIGN_ED25519;
         }
 
     }
     else if (key_buffer_sz == 64) {
-        if (sign == SIGN_ECC256) {
-            if (!manual_sign && !sha_only) {
+        if (CMD.sign == SIGN_ECC256) {
+            if (!CMD.manual_sign && !CMD.sha_only) {
                 printf("Error: key size does not match the cipher selected\n");
                 goto exit;
             } else {
                 printf("ECC256 public key detected\n");
             }
         }
-        if (sign == SIGN_AUTO) {
-            if (!manual_sign && !sha_only) {
-                sign = SIGN_ED25519;
+        if (CMD.sign == SIGN_AUTO) {
+            if (!CMD.manual_sign && !CMD.sha_only) {
+                CMD.sign = SIGN_ED25519;
                 printf("ed25519 key autodetected\n");
             } else {
-                sign = SIGN_ECC256;
+                CMD.sign = SIGN_ECC256;
                 printf("ecc256 public key autodetected\n");
             }
         }
     }
     else if (key_buffer_sz == 96) {
-        if (sign == SIGN_ED25519) {
+        if (CMD.sign == SIGN_ED25519) {
             printf("Error: key size does not match the cipher selected\n");
             goto exit;
         }
-        if (sign == SIGN_AUTO) {
-            sign = SIGN_ECC256;
+        if (CMD.sign == SIGN_AUTO) {
+            CMD.sign = SIGN_ECC256;
             printf("ecc256 key autodetected\n");
         }
     }
     else if (key_buffer_sz > 512) {
-        if (sign == SIGN_AUTO) {
-            sign = SIGN_RSA4096;
+        if (CMD.sign == SIGN_AUTO) {
+            CMD.sign = SIGN_RSA4096;
             printf("rsa4096 key autodetected\n");
         }
     }
     else if (key_buffer_sz > 128) {
-        if (sign == SIGN_AUTO) {
-            sign = SIGN_RSA2048;
+        if (CMD.sign == SIGN_AUTO) {
+            CMD.sign = SIGN_RSA2048;
             printf("rsa2048 key autodetected\n");
         }
-        if (sign != SIGN_RSA2048) {
+        if (CMD.sign != SIGN_RSA2048) {
             printf("Error: key size too large for the selected cipher\n");
             goto exit;
         }
@@ -351,54 +1533,60 @@ int main(int argc, char** argv)
     }
 
     /* get header and signature sizes */
-    if (sign == SIGN_ED25519) {
-        header_sz = 256;
-        signature_sz = 64;
+    if (CMD.sign == SIGN_ED25519) {
+        CMD.header_sz = 256;
+        CMD.signature_sz = 64;
     }
-    else if (sign == SIGN_ECC256) {
-        header_sz = 256;
-        signature_sz = 64;
+    else if (CMD.sign == SIGN_ECC256) {
+        CMD.header_sz = 256;
+        CMD.signature_sz = 64;
     }
-    else if (sign == SIGN_RSA2048) {
-        header_sz = 512;
-        signature_sz = 256;
+    else if (CMD.sign == SIGN_RSA2048) {
+        CMD.header_sz = 512;
+        CMD.signature_sz = 256;
     }
-    else if (sign == SIGN_RSA4096) {
-        header_sz = 1024;
-        signature_sz = 512;
+    else if (CMD.sign == SIGN_RSA4096) {
+        CMD.header_sz = 1024;
+        CMD.signature_sz = 512;
     }
-    if (signature_sz == 0 || header_sz == 0) {
+    if (CMD.signature_sz == 0 || CMD.header_sz == 0) {
         printf("Invalid hash or signature type!\n");
         goto exit;
     }
+    /* Optionally larger header, e.g. to fit the component manifest. It must
+     * match IMAGE_HEADER_SIZE in the bootloader configuration.
+     */
+    env = getenv("IMAGE_HEADER_SIZE");
+    if ((env != NULL) && (strtoul(env, NULL, 0) > CMD.header_sz))
+        CMD.header_sz = strtoul(env, NULL, 0);
 
     /* import (decode) private key for signing */
-    if (!sha_only && !manual_sign) {
+    if (!CMD.sha_only && !CMD.manual_sign) {
         /* import (decode) private key for signing */
-        if (sign == SIGN_ED25519) {
+        if (CMD.sign == SIGN_ED25519) {
         #ifdef HAVE_ED25519
             ret = wc_ed25519_init(&key.ed);
             if (ret == 0) {
-                pubkey = key_buffer + ED25519_KEY_SIZE;
-                pubkey_sz = ED25519_PUB_KEY_SIZE;
-                ret = wc_ed25519_import_private_key(key_buffer, ED25519_KEY_SIZE, pubkey, pubkey_sz, &key.ed);
+                CMD.pubkey = key_buffer + ED25519_KEY_SIZE;
+                CMD.pubkey_sz = ED25519_PUB_KEY_SIZE;
+                ret = wc_ed25519_import_private_key(key_buffer, ED25519_KEY_SIZE, CMD.pubkey, CMD.pubkey_sz, &key.ed);
             }
         #endif
         }
-        else if (sign == SIGN_ECC256) {
+        else if (CMD.sign == SIGN_ECC256) {
         #ifdef HAVE_ECC
             ret = wc_ecc_init(&key.ecc);
             if (ret == 0) {
                 ret = wc_ecc_import_unsigned(&key.ecc, &key_buffer[0], &key_buffer[32],
                     &key_buffer[64], ECC_SECP256R1);
                 if (ret == 0) {
-                    pubkey = key_buffer; /* first 64 bytes is public portion */
-                    pubkey_sz = 64;
+                    CMD.pubkey = key_buffer; /* first 64 bytes is public portion */
+                    CMD.pubkey_sz = 64;
                 }
             }
         #endif
         }
-        else if (sign == SIGN_RSA2048 || sign == SIGN_RSA4096) {
+        else if (CMD.sign == SIGN_RSA2048 || CMD.sign == SIGN_RSA4096) {
         #ifndef NO_RSA
             idx = 0;
             ret = wc_InitRsaKey(&key.rsa, NULL);
@@ -407,8 +1595,8 @@ int main(int argc, char** argv)
                 if (ret == 0) {
                     ret = wc_RsaKeyToPublicDer(&key.rsa, key_buffer, key_buffer_sz);
                     if (ret > 0) {
-                        pubkey = key_buffer;
-                        pubkey_sz = ret;
+                        CMD.pubkey = key_buffer;
+                        CMD.pubkey_sz = ret;
                         ret = 0;
                     }
                 }
@@ -419,336 +1607,284 @@ int main(int argc, char** argv)
             printf("Error %d loading key\n", ret);
             goto exit;
         }
+        key_loaded = 1;
     }
     else {
         /* using external key to sign, so only public portion is used */
-        pubkey = key_buffer;
-        pubkey_sz = key_buffer_sz;
+        CMD.pubkey = key_buffer;
+        CMD.pubkey_sz = key_buffer_sz;
     }
 #ifdef DEBUG_SIGNTOOL
-    printf("Pubkey %d\n", pubkey_sz);
-    WOLFSSL_BUFFER(pubkey, pubkey_sz);
+    printf("Pubkey %d\n", CMD.pubkey_sz);
+    WOLFSSL_BUFFER(CMD.pubkey, CMD.pubkey_sz);
 #endif
 
-    /* Get size of image */
-    f = fopen(image_file, "rb");
-    if (f == NULL) {
-        printf("Open image file %s failed\n", image_file);
-        goto exit;
-    }
-    fseek(f, 0, SEEK_END);
-    image_sz = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    fclose(f);
+    fw_version32 = strtol(fw_version, NULL, 10);
+    image_type = (uint16_t)CMD.sign;
+    if (!CMD.self_update)
+        image_type |= HDR_IMG_TYPE_APP;
 
-    header_idx = 0;
-    header = malloc(header_sz);
-    if (header == NULL) {
-        printf("Header malloc error!\n");
-        goto exit;
+    ret = make_image(image_file, output_image_file, output_encrypted_image_file,
+            fw_version32, image_type, NULL, 0);
+    if ((ret == 0) && delta_base_file && !CMD.sha_only) {
+        ret = make_delta(delta_base_file, output_image_file, output_patch_file,
+                output_delta_file, output_delta_encrypted_file, fw_version32);
     }
-    memset(header, 0xFF, header_sz);
+    if ((ret == 0) && !CMD.sha_only)
+        printf("Output image(s) successfully created.\n");
 
-    /* Append Magic header (spells 'WOLF') */
-    header_append_u32(header, &header_idx, WOLFBOOT_MAGIC);
-    /* Append Image size */
-    header_append_u32(header, &header_idx, image_sz);
+exit:
+    if (key_loaded) {
+    #ifdef HAVE_ECC
+        if (CMD.sign == SIGN_ECC256)
+            wc_ecc_free(&key.ecc);
+    #endif
+    #ifndef NO_RSA
+        if (CMD.sign == SIGN_RSA2048 || CMD.sign == SIGN_RSA4096)
+            wc_FreeRsaKey(&key.rsa);
+    #endif
+    }
+    if (key_buffer)
+        free(key_buffer);
 
-    /* No pad bytes, version is aligned */
+    return ret;
+}
 
-    /* Append Version field */
-    fw_version32 = strtol(fw_version, NULL, 10);
-    header_append_tag(header, &header_idx, HDR_VERSION, HDR_VERSION_LEN,
-        &fw_version32);
+/* Batch mode: sign all the images listed in a manifest, one entry per line
+ * with the same arguments as a single image (e.g.
+ * "--ed25519 --encrypt enc.key image.bin ed25519.der 2"). Blank lines and
+ * lines starting with '#' are ignored. The entries are signed in parallel by
+ * a pool of worker threads, the output is the same as signing the images one
+ * by one.
+ */
+#define BATCH_LINE_MAX 4096
 
-    /* Append Four pad bytes, so timestamp is aligned */
-    header_idx += 4; /* memset 0xFF above handles value */
+struct batch_job {
+    int line;
+    int argc;
+    char *argv[MAX_ARGS + 1];
+    char *args;
+    int ret;
+};
 
-    /* Append Timestamp field */
-    stat(image_file, &attrib);
-    header_append_tag(header, &header_idx, HDR_TIMESTAMP, HDR_TIMESTAMP_LEN,
-        &attrib.st_ctime);
+static struct {
+    int active;
+    struct batch_job *jobs;
+    int n_jobs;
+    int next;
+    char **outputs;
+    int n_outputs;
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+} batch;
 
-    /* Append Image type field */
-    image_type = (uint16_t)sign;
-    if (!self_update)
-        image_type |= HDR_IMG_TYPE_APP;
-    header_append_tag(header, &header_idx, HDR_IMG_TYPE, HDR_IMG_TYPE_LEN,
-        &image_type);
+#ifndef _WIN32
+    #define BATCH_LOCK()   pthread_mutex_lock(&batch.lock)
+    #define BATCH_UNLOCK() pthread_mutex_unlock(&batch.lock)
+#else
+    #define BATCH_LOCK()   do{}while(0)
+    #define BATCH_UNLOCK() do{}while(0)
+#endif
 
-    /* Six pad bytes, Sha-3 requires 8-byte alignment. */
-    header_idx += 6; /* memset 0xFF above handles value */
+/* Two entries of the batch must not write the same output file */
+static int batch_claim_output(const char *outfile)
+{
+    int i, ret = 0;
+    if (!batch.active)
+        return 0;
+    BATCH_LOCK();
+    for (i = 0; i < batch.n_outputs; i++) {
+        if (strcmp(batch.outputs[i], outfile) == 0) {
+            printf("Error: %s is already created by another entry of the batch\n",
+                outfile);
+            ret = -1;
+            break;
+        }
+    }
+    if (ret == 0) {
+        batch.outputs[batch.n_outputs] = strdup(outfile);
+        if (batch.outputs[batch.n_outputs] == NULL)
+            ret = -1;
+        else
+            batch.n_outputs++;
+    }
+    BATCH_UNLOCK();
+    return ret;
+}
 
-    /* Calculate hashes */
-    if (hash_algo == HASH_SHA256)
-    {
-    #ifndef NO_SHA256
-        wc_Sha256 sha;
+static void *batch_worker(void *arg)
+{
+    struct batch_job *job;
+    (void)arg;
+    for (;;) {
+        BATCH_LOCK();
+        job = NULL;
+        if (batch.next < batch.n_jobs)
+            job = &batch.jobs[batch.next++];
+        BATCH_UNLOCK();
+        if (job == NULL)
+            break;
+        job->ret = sign_image(job->argc, job->argv);
+    }
+    return NULL;
+}
 
-        printf("Calculating SHA256 digest...\n");
-        ret = wc_InitSha256_ex(&sha, NULL, INVALID_DEVID);
-        if (ret == 0) {
-            /* Hash Header */
-            ret = wc_Sha256Update(&sha, header, header_idx);
+static int batch_load(const char *prog, const char *manifest)
+{
+    char line[BATCH_LINE_MAX];
+    struct batch_job *job;
+    int n_lines = 0, n_alloc = 0;
+    char *tok;
+    FILE *f;
 
-            /* Hash image file */
-            f = fopen(image_file, "rb");
-            pos = 0;
-            while (ret == 0 && pos < image_sz) {
-                read_sz = image_sz - pos;
-                if (read_sz > 32)
-                    read_sz = 32;
-                fread(buf, read_sz, 1, f);
-                ret = wc_Sha256Update(&sha, buf, read_sz);
-                pos += read_sz;
-            }
+    f = fopen(manifest, "r");
+    if (f == NULL) {
+        printf("Open batch manifest %s failed\n", manifest);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        n_lines++;
+        if ((strchr(line, '\n') == NULL) && !feof(f)) {
+            printf("%s:%d: line too long\n", manifest, n_lines);
             fclose(f);
-            if (ret == 0)
-                wc_Sha256Final(&sha, digest);
-            wc_Sha256Free(&sha);
+            return -1;
         }
-
-        /* pubkey hash calculation */
-        if (ret == 0) {
-            ret = wc_InitSha256_ex(&sha, NULL, INVALID_DEVID);
-            if (ret == 0) {
-                ret = wc_Sha256Update(&sha, pubkey, pubkey_sz);
-                if (ret == 0)
-                    wc_Sha256Final(&sha, buf);
-                wc_Sha256Free(&sha);
+        tok = line + strspn(line, " \t\r\n");
+        if ((*tok == '\0') || (*tok == '#'))
+            continue;
+        if (batch.n_jobs == n_alloc) {
+            n_alloc = n_alloc ? 2 * n_alloc : 64;
+            job = realloc(batch.jobs, n_alloc * sizeof(*job));
+            if (job == NULL) {
+                fclose(f);
+                return -1;
             }
+            batch.jobs = job;
         }
-        if (ret == 0)
-            digest_sz = HDR_SHA256_LEN;
-    #endif
-    }
-    else if (hash_algo == HASH_SHA3)
-    {
-    #ifdef WOLFSSL_SHA3
-        wc_Sha3 sha;
-
-        printf("Calculating SHA3 digest...\n");
-
-        ret = wc_InitSha3_384(&sha, NULL, INVALID_DEVID);
-        if (ret == 0) {
-            /* Hash Header */
-            ret = wc_Sha3_384_Update(&sha, header, header_idx);
-
-            /* Hash image file */
-            f = fopen(image_file, "rb");
-            pos = 0;
-            while (ret == 0 && pos < image_sz) {
-                read_sz = image_sz - pos;
-                if (read_sz > 128)
-                    read_sz = 128;
-                fread(buf, read_sz, 1, f);
-                ret = wc_Sha3_384_Update(&sha, buf, read_sz);
-                pos += read_sz;
-            }
+        job = &batch.jobs[batch.n_jobs];
+        memset(job, 0, sizeof(*job));
+        job->line = n_lines;
+        job->args = strdup(tok);
+        if (job->args == NULL) {
             fclose(f);
-            if (ret == 0)
-                ret = wc_Sha3_384_Final(&sha, digest);
-            wc_Sha3_384_Free(&sha);
+            return -1;
         }
-
-        /* pubkey hash calculation */
-        if (ret == 0) {
-            ret = wc_InitSha3_384(&sha, NULL, INVALID_DEVID);
-            if (ret == 0) {
-                ret = wc_Sha3_384_Update(&sha, pubkey, pubkey_sz);
-                if (ret == 0)
-                    ret = wc_Sha3_384_Final(&sha, buf);
-                wc_Sha3_384_Free(&sha);
+        batch.n_jobs++;
+        job->argv[job->argc++] = (char *)prog;
+        for (tok = strtok(job->args, " \t\r\n"); tok != NULL;
+                tok = strtok(NULL, " \t\r\n")) {
+            if (job->argc == MAX_ARGS) {
+                printf("%s:%d: too many arguments\n", manifest, n_lines);
+                fclose(f);
+                return -1;
             }
+            job->argv[job->argc++] = tok;
         }
-        if (ret == 0)
-            digest_sz = HDR_SHA3_384_LEN;
-    #endif
-    }
-    if (digest_sz == 0) {
-        printf("Hash algorithm error %d\n", ret);
-        goto exit;
-    }
-#ifdef DEBUG_SIGNTOOL
-    printf("Image hash %d\n", digest_sz);
-    WOLFSSL_BUFFER(digest, digest_sz);
-    printf("Pubkey hash %d\n", digest_sz);
-    WOLFSSL_BUFFER(buf, digest_sz);
-#endif
-
-    /* Add image hash to header */
-    header_append_tag(header, &header_idx, hash_algo, digest_sz, digest);
-
-    /* Add Pubkey Hash to header */
-    header_append_tag(header, &header_idx, HDR_PUBKEY, digest_sz, buf);
-
-    /* If hash only, then save digest and exit */
-    if (sha_only) {
-        f = fopen(output_image_file, "wb");
-        if (f == NULL) {
-            printf("Open output file %s failed\n", output_image_file);
-            goto exit;
+        if (job->argc < 4) {
+            printf("%s:%d: missing arguments\n", manifest, n_lines);
+            fclose(f);
+            return -1;
         }
-        fwrite(digest, digest_sz, 1, f);
-        fclose(f);
-        printf("Digest image %s successfully created.\n", output_image_file);
-        ret = 0;
-        goto exit;
     }
+    fclose(f);
+    batch.outputs = calloc(batch.n_jobs + 1, sizeof(char *));
+    return (batch.outputs != NULL) ? 0 : -1;
+}
 
-    /* Sign the digest */
-    ret = NOT_COMPILED_IN; /* default error */
-    signature = malloc(signature_sz);
-    if (signature == NULL) {
-        printf("Signature malloc error!\n");
-        goto exit;
+static int sign_batch(const char *prog, const char *manifest, int n_threads)
+{
+    int i, failed = 0;
+    int ret;
+
+    ret = batch_load(prog, manifest);
+    if ((ret == 0) && (batch.n_jobs == 0)) {
+        printf("Batch manifest %s is empty\n", manifest);
+        ret = -1;
     }
-    memset(signature, 0, signature_sz);
-    if (!manual_sign) {
-        printf("Signing the firmware...\n");
+    if (ret == 0) {
+        if ((n_threads <= 0) || (n_threads > batch.n_jobs))
+            n_threads = batch.n_jobs;
+        printf("Batch signing:        %d images, %d threads\n", batch.n_jobs,
+            n_threads);
+        batch.active = 1;
+#ifndef _WIN32
+        {
+            pthread_t *workers = calloc(n_threads, sizeof(pthread_t));
+            pthread_attr_t attr;
+            int started = 0;
 
-        wc_InitRng(&rng);
-        if (sign == SIGN_ED25519) {
-        #ifdef HAVE_ED25519
-            ret = wc_ed25519_sign_msg(digest, digest_sz, signature, &signature_sz, &key.ed);
-        #endif
-        }
-        else if (sign == SIGN_ECC256) {
-        #ifdef HAVE_ECC
-            mp_int r, s;
-            mp_init(&r); mp_init(&s);
-            ret = wc_ecc_sign_hash_ex(digest, digest_sz, &rng, &key.ecc, &r, &s);
-            mp_to_unsigned_bin(&r, &signature[0]);
-            mp_to_unsigned_bin(&s, &signature[32]);
-            mp_clear(&r); mp_clear(&s);
-            wc_ecc_free(&key.ecc);
-        #endif
-        }
-        else if (sign == SIGN_RSA2048 || sign == SIGN_RSA4096) {
-        #ifndef NO_RSA
-            uint32_t enchash_sz = digest_sz;
-            uint8_t* enchash = digest;
-            if (sign_wenc) {
-                /* add ASN.1 signature encoding */
-                int hashOID = 0;
-                if (hash_algo == HASH_SHA256)
-                    hashOID = SHA256h;
-                else if (hash_algo == HASH_SHA3)
-                    hashOID = SHA3_384h;
-                enchash_sz = wc_EncodeSignature(buf, digest, digest_sz, hashOID);
-                enchash = buf;
-            }
-            ret = wc_RsaSSL_Sign(enchash, enchash_sz, signature, signature_sz, 
-                &key.rsa, &rng);
-            wc_FreeRsaKey(&key.rsa);
-            if (ret > 0) {
-                signature_sz = ret;
-                ret = 0;
+            pthread_mutex_init(&batch.lock, NULL);
+            pthread_attr_init(&attr);
+            /* RSA-4096 needs a large stack */
+            pthread_attr_setstacksize(&attr, 8 * 1024 * 1024);
+            for (i = 0; (workers != NULL) && (i < n_threads); i++) {
+                if (pthread_create(&workers[i], &attr, batch_worker, NULL) != 0)
+                    break;
+                started++;
             }
-        #endif
+            /* No worker at all: sign from this thread */
+            if (started == 0)
+                batch_worker(NULL);
+            for (i = 0; i < started; i++)
+                pthread_join(workers[i], NULL);
+            pthread_attr_destroy(&attr);
+            pthread_mutex_destroy(&batch.lock);
+            free(workers);
         }
-        wc_FreeRng(&rng);
-
-        if (ret != 0) {
-            printf("Signing error %d\n", ret);
-            goto exit;
+#else
+        batch_worker(NULL);
+#endif
+        for (i = 0; i < batch.n_jobs; i++) {
+            if (batch.jobs[i].ret != 0) {
+                printf("%s:%d: signing failed (%d)\n", manifest,
+                    batch.jobs[i].line, batch.jobs[i].ret);
+                failed++;
+            }
         }
+        printf("Batch signing:        %d images signed, %d failed\n",
+            batch.n_jobs - failed, failed);
+        ret = (failed == 0) ? 0 : 1;
     }
-    else {
-        printf("Opening signature file %s\n", signature_file);
 
-        f = fopen(signature_file, "rb");
-        if (f == NULL) {
-            printf("Open signature file %s failed\n", signature_file);
-            goto exit;
-        }
-        fread(signature, signature_sz, 1, f);
-        fclose(f);
-    }
-#ifdef DEBUG_SIGNTOOL
-    printf("Signature %d\n", signature_sz);
-    WOLFSSL_BUFFER(signature, signature_sz);
-#endif
+    for (i = 0; i < batch.n_jobs; i++)
+        free(batch.jobs[i].args);
+    free(batch.jobs);
+    for (i = 0; (batch.outputs != NULL) && (i < batch.n_outputs); i++)
+        free(batch.outputs[i]);
+    free(batch.outputs);
+    return ret;
+}
 
-    /* Add signature to header */
-    header_append_tag(header, &header_idx, HDR_SIGNATURE, signature_sz, signature);
+int main(int argc, char** argv)
+{
+    const char *manifest = NULL;
+    int n_threads = 0;
+    int i;
 
-    /* Add padded header at end */
-    while (header_idx < header_sz) {
-        header[header_idx++] = 0xFF;
-    }
+#ifdef DEBUG_SIGNTOOL
+    wolfSSL_Debugging_ON();
+#endif
 
-    /* Create output image */
-    f = fopen(output_image_file, "w+b");
-    if (f == NULL) {
-        printf("Open output image file %s failed\n", output_image_file);
-        goto exit;
-    }
-    fwrite(header, header_idx, 1, f);
-    /* Copy image to output */
-    f2 = fopen(image_file, "rb");
-    pos = 0;
-    while (pos < image_sz) {
-        read_sz = image_sz;
-        if (read_sz > sizeof(buf))
-            read_sz = sizeof(buf);
-        read_sz = fread(buf, 1, read_sz, f2);
-        if ((read_sz == 0) && (feof(f2)))
+    for (i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], "--batch") == 0)
+            manifest = argv[++i];
+        else if (strcmp(argv[i], "--jobs") == 0)
+            n_threads = atoi(argv[++i]);
+        else
             break;
-        fwrite(buf, 1, read_sz, f);
-        pos += read_sz;
     }
-
-    if (encrypt && encrypt_key_file) {
-        uint8_t key[32], iv[12];
-        uint8_t enc_buf[ENC_BLOCK_SIZE];
-        uint32_t fsize = 0;
-        ChaCha cha;
-#ifndef HAVE_CHACHA
-        fprintf(stderr, "Encryption not supported: chacha support not found in wolfssl configuration.\n");
-        exit(100);
-#endif
-        fek = fopen(encrypt_key_file, "rb");
-        if (fek == NULL) {
-            fprintf(stderr, "Open encryption key file %s: %s\n", encrypt_key_file, strerror(errno));
-            exit(1);
-        }
-        fread(key, 32, 1, fek);
-        fread(iv, 12, 1, fek);
-        fclose(fek);
-        fef = fopen(output_encrypted_image_file, "wb");
-        if (!fef) {
-            fprintf(stderr, "Open encrypted output file %s: %s\n", encrypt_key_file, strerror(errno));
-        }
-        fsize = ftell(f);
-        fseek(f, 0, SEEK_SET); /* restart the _signed file from 0 */
-
-        wc_Chacha_SetKey(&cha, key, 32);
-        for (pos = 0; pos < fsize; pos += ENC_BLOCK_SIZE) {
-            int fread_retval;
-            fread_retval = fread(buf, 1, ENC_BLOCK_SIZE, f);
-            if ((fread_retval == 0) && feof(f)) {
-                break;
-            }
-            wc_Chacha_SetIV(&cha, iv, (pos >> 4));
-            wc_Chacha_Process(&cha, enc_buf, buf, fread_retval);
-            fwrite(enc_buf, 1, fread_retval, fef);
-        }
-        fclose(fef);
+    if ((manifest == NULL) && (n_threads == 0))
+        return sign_image(argc, argv);
+    if ((manifest == NULL) || (i != argc)) {
+        printf("Usage: %s [--jobs n] --batch manifest.txt\n", argv[0]);
+        return 1;
     }
-    printf("Output image(s) successfully created.\n");
-    ret = 0;
-
-    fclose(f2);
-    fclose(f);
-
-exit:
-    if (header)
-        free(header);
-    if (key_buffer)
-        free(key_buffer);
-    if (signature)
-        free(signature);
-
-    return ret;
+#ifndef _WIN32
+    if (n_threads <= 0)
+        n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    /* Keep the output of the worker threads readable */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+#endif
+    return sign_batch(argv[0], manifest, n_threads);
 }
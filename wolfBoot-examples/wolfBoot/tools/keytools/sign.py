@@ -386,20 +386,19 @@ infile.close()
 outfile.close()
 if (encrypt):
     sz = 0
-    off = 0
     outfile = open(output_image_file, 'rb')
     ekeyfile = open(encrypt_key_file, 'rb')
     key = ekeyfile.read(32)
     iv_nonce = ekeyfile.read(12)
     enc_outfile = open(encrypted_output_image_file, 'wb')
     cha = ciphers.ChaCha(key, 32)
+    # One keystream for the whole partition, starting at block 0
+    cha.set_iv(iv_nonce, 0)
     while(True):
-        cha.set_iv(iv_nonce, off)
-        buf = outfile.read(16)
+        buf = outfile.read(1024)
         if len(buf) == 0:
             break
         enc_outfile.write(cha.encrypt(buf))
-        off += 1
     outfile.close()
     ekeyfile.close()
     enc_outfile.close()
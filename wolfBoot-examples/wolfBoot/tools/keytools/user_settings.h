@@ -30,7 +30,9 @@
 
 /* System */
 #define WOLFSSL_GENERAL_ALIGNMENT 4
-#define SINGLE_THREADED
+/* Not SINGLE_THREADED: 'sign --batch' signs from several threads, so
+ * wolfCrypt must keep the locks around the state that they share.
+ */
 #define WOLFCRYPT_ONLY
 #define SIZEOF_LONG_LONG 8
 
@@ -63,8 +65,11 @@
 /* Chacha stream cipher */
 #define HAVE_CHACHA
 
+/* AES-CTR */
+#define WOLFSSL_AES_COUNTER
+#define WOLFSSL_AES_DIRECT
+
 /* Disables */
-#define NO_AES
 #define NO_CMAC
 #define NO_HMAC
 #define NO_RC4
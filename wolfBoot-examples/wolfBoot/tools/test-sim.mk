@@ -0,0 +1,611 @@
+## Host simulator (TARGET=sim) tests
+#
+# The simulated internal flash is the file internal_flash.dd, mapped at
+# ARCH_FLASH_OFFSET. Images are staged directly into the file, then
+# wolfboot.elf runs the update and reports the version it boots.
+#
+SIM_IMAGE_KB?=100
+SIM_POWERFAIL_POINTS?=1 5 20 40 60
+SIM_FLASH=internal_flash.dd
+SIM_FLASH_END=$$(( $(WOLFBOOT_PARTITION_SWAP_ADDRESS) + $(WOLFBOOT_SECTOR_SIZE) ))
+ifeq ($(MULTI_IMAGE),1)
+  SIM_FLASH_END=$$(( $(WOLFBOOT_COMPONENT_ADDRESS) + 2 * $(WOLFBOOT_COMPONENTS) * $(WOLFBOOT_COMPONENT_SIZE) ))
+endif
+SIM_BOOT_END=$$(( $(WOLFBOOT_PARTITION_BOOT_ADDRESS) + $(WOLFBOOT_PARTITION_SIZE) ))
+SIM_FLASH_SIZE=$$(( ($(SIM_FLASH_END) > $(SIM_BOOT_END) ? $(SIM_FLASH_END) : $(SIM_BOOT_END)) - $(ARCH_FLASH_OFFSET) ))
+SIM_BOOT_OFF=$$(( $(WOLFBOOT_PARTITION_BOOT_ADDRESS) - $(ARCH_FLASH_OFFSET) ))
+SIM_UPDATE_OFF=$$(( $(WOLFBOOT_PARTITION_UPDATE_ADDRESS) - $(ARCH_FLASH_OFFSET) ))
+SIM_UPDATE_END=$$(( $(WOLFBOOT_PARTITION_UPDATE_ADDRESS) + $(WOLFBOOT_PARTITION_SIZE) - $(ARCH_FLASH_OFFSET) ))
+
+internal_flash.dd: test-app/image_v1_signed.bin
+	@echo "\t[FLASH] $@"
+	$(Q)dd if=/dev/zero bs=$(SIM_FLASH_SIZE) count=1 2>/dev/null | tr "\000" "\377" > $@
+	$(Q)dd if=test-app/image_v1_signed.bin of=$@ bs=1 seek=$(SIM_BOOT_OFF) conv=notrunc 2>/dev/null
+
+# Stage version $(TEST_UPDATE_VERSION) of $(SIM_UPDATE_IMAGE).bin in the update
+# partition, and mark it as 'UPDATING' ("pBOOT" at the end of the partition)
+SIM_UPDATE_IMAGE?=test-app/image
+sim-update-stage: test-app/image.bin FORCE
+	$(Q)$(SIGN_TOOL) $(SIGN_OPTIONS) $(SIM_COMPONENT_ARGS) $(SIM_UPDATE_IMAGE).bin $(PRIVATE_KEY) $(TEST_UPDATE_VERSION) >/dev/null
+	$(Q)dd if=/dev/zero bs=$$(( $(WOLFBOOT_PARTITION_SIZE) )) count=1 2>/dev/null | tr "\000" "\377" | \
+		dd of=$(SIM_FLASH) bs=$$(( $(WOLFBOOT_SECTOR_SIZE) )) seek=$$(( $(SIM_UPDATE_OFF) / $(WOLFBOOT_SECTOR_SIZE) )) conv=notrunc 2>/dev/null
+	$(Q)dd if=$(SIM_UPDATE_IMAGE)_v$(TEST_UPDATE_VERSION)_signed.bin of=$(SIM_FLASH) bs=1 \
+		seek=$(SIM_UPDATE_OFF) conv=notrunc 2>/dev/null
+	$(Q)printf "pBOOT" | dd of=$(SIM_FLASH) bs=1 seek=$$(( $(SIM_UPDATE_END) - 5 )) conv=notrunc 2>/dev/null
+
+test-sim-update: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-update-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+test-sim-rollback: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-update-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Corrupt one byte of the staged payload: the update must be rejected
+test-sim-update-tampered: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-update-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)printf "\252" | dd of=$(SIM_FLASH) bs=1 \
+		seek=$$(( $(SIM_UPDATE_OFF) + $(IMAGE_HEADER_SIZE) + $(SIM_IMAGE_KB) * 512 )) conv=notrunc 2>/dev/null
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Interrupt the update at different points, then resume it
+test-sim-powerfail: wolfboot.elf FORCE
+	$(Q)for n in $(SIM_POWERFAIL_POINTS); do \
+		rm -f $(SIM_FLASH); make -s $(SIM_FLASH) >/dev/null; \
+		make -s sim-update-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION) >/dev/null; \
+		WOLFBOOT_SIM_POWERFAIL=$$n ./wolfboot.elf > sim.log; \
+		WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf > sim.log; \
+		grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || \
+			(echo "TEST FAILED (power fail at $$n)" && exit 1) || exit 1; \
+	done
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Interrupt the swap of the first sector at every flash operation, with an
+# update larger than the running image. Both headers may look valid at that
+# point: the image sizes must be taken from the right ones on resume.
+SIM_POWERFAIL_SECTOR0_OPS?=60
+test-sim-powerfail-sector0: wolfboot.elf FORCE
+	$(Q)cp test-app/image.bin test-app/image_large.bin
+	$(Q)head -c 8192 /dev/urandom >> test-app/image_large.bin
+	$(Q)n=1; while [ $$n -le $(SIM_POWERFAIL_SECTOR0_OPS) ]; do \
+		rm -f $(SIM_FLASH); make -s $(SIM_FLASH) >/dev/null; \
+		make -s sim-update-stage SIM_UPDATE_IMAGE=test-app/image_large \
+			TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION) >/dev/null; \
+		WOLFBOOT_SIM_POWERFAIL=$$n ./wolfboot.elf > sim.log 2>&1; \
+		WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf > sim.log; \
+		grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || \
+			(echo "TEST FAILED (power fail at $$n)" && exit 1) || exit 1; \
+		n=$$((n + 1)); \
+	done
+	$(Q)rm -f sim.log test-app/image_large*.bin
+	@echo "TEST PASSED"
+
+# Unchanged sectors (SKIP_UNCHANGED_SECTORS=1): an update that differs from
+# the running image only in the sectors SIM_SKIP_SECTORS must take fewer erase
+# operations than an update that differs everywhere, and must not erase the
+# other sectors of the image, in BOOT or in UPDATE.
+SIM_SKIP_SECTORS?=3 10 20
+SIM_IMAGE_SECTORS=$$(( ($(SIM_IMAGE_KB) * 1024 + $(IMAGE_HEADER_SIZE)) / $(WOLFBOOT_SECTOR_SIZE) ))
+SIM_ERASE_OPS=sed -n 's/.*internal erase: \([0-9]*\) ops.*/\1/p' sim.log
+test-sim-skip-unchanged: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make -s $(SIM_FLASH) >/dev/null
+	$(Q)head -c $$(( $(SIM_IMAGE_KB) * 1024 )) /dev/urandom > test-app/image_full.bin
+	$(Q)cp test-app/image.bin test-app/image_skip.bin
+	$(Q)for s in $(SIM_SKIP_SECTORS); do \
+		head -c 16 /dev/urandom | dd of=test-app/image_skip.bin bs=1 conv=notrunc 2>/dev/null \
+			seek=$$(( $$s * $(WOLFBOOT_SECTOR_SIZE) - $(IMAGE_HEADER_SIZE) + 16 )); \
+	done
+	$(Q)make -s sim-update-stage SIM_UPDATE_IMAGE=test-app/image_full TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION) >/dev/null
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED (full update)" && exit 1)
+	$(Q)$(SIM_ERASE_OPS) > sim_full.log
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make -s $(SIM_FLASH) >/dev/null
+	$(Q)make -s sim-update-stage SIM_UPDATE_IMAGE=test-app/image_skip TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION) >/dev/null
+	$(Q)WOLFBOOT_SIM_ERASE_LOG=1 ./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)dd if=$(SIM_FLASH) bs=1 skip=$(SIM_BOOT_OFF) 2>/dev/null | \
+		cmp -s -n $$(wc -c < test-app/image_skip_v$(TEST_UPDATE_VERSION)_signed.bin) \
+			- test-app/image_skip_v$(TEST_UPDATE_VERSION)_signed.bin || \
+		(echo "TEST FAILED (BOOT content)" && exit 1)
+	$(Q)full=$$(cat sim_full.log); part=$$($(SIM_ERASE_OPS)); \
+		echo "erase operations: $$part, full swap: $$full"; \
+		[ $$part -lt $$full ] || (echo "TEST FAILED (no erase saved)" && exit 1)
+	$(Q)s=1; while [ $$s -lt $(SIM_IMAGE_SECTORS) ]; do \
+		for p in $(SIM_BOOT_OFF) $(SIM_UPDATE_OFF); do \
+			off=$$(printf "0x%08x" $$(( $$p + $$s * $(WOLFBOOT_SECTOR_SIZE) ))); \
+			if echo " $(SIM_SKIP_SECTORS) " | grep -q " $$s "; then \
+				grep -q "internal erase at $$off," sim.log || \
+					(echo "TEST FAILED (sector $$s not swapped)" && exit 1) || exit 1; \
+			else \
+				! grep -q "internal erase at $$off," sim.log || \
+					(echo "TEST FAILED (sector $$s erased)" && exit 1) || exit 1; \
+			fi; \
+		done; \
+		s=$$((s + 1)); \
+	done
+	$(Q)rm -f sim.log sim_full.log test-app/image_full*.bin test-app/image_skip*.bin
+	@echo "TEST PASSED"
+
+# Verification cache (VERIFY_CACHE=1): the MAC is stored on the first boot
+# of a confirmed image, then used on the following boots. Flash statistics
+# tell whether the cache sector has been (re)written.
+SIM_CACHE_STORED=grep -q "internal erase: 1 ops" sim.log
+SIM_CACHE_HIT=grep -q "internal erase: 0 ops" sim.log
+test-sim-verify-cache: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf > sim.log
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)$(SIM_CACHE_STORED) || (echo "TEST FAILED (cache not stored)" && exit 1)
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)$(SIM_CACHE_HIT) || (echo "TEST FAILED (cache not used)" && exit 1)
+	$(Q)WOLFBOOT_SIM_DEVICE_SECRET=1 ./wolfboot.elf > sim.log
+	$(Q)$(SIM_CACHE_STORED) || (echo "TEST FAILED (cache from another device)" && exit 1)
+	$(Q)make sim-update-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf > sim.log
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)$(SIM_CACHE_STORED) || (echo "TEST FAILED (cache not updated)" && exit 1)
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)$(SIM_CACHE_HIT) || (echo "TEST FAILED (cache not used)" && exit 1)
+	$(Q)printf "\252" | dd of=$(SIM_FLASH) bs=1 \
+		seek=$$(( $(SIM_BOOT_OFF) + $(IMAGE_HEADER_SIZE) + $(SIM_IMAGE_KB) * 512 )) conv=notrunc 2>/dev/null
+	$(Q)./wolfboot.elf > sim.log || true
+	$(Q)! grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED (tampered image)" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Remote UPDATE/SWAP partitions (config/examples/sim-uart.config): ufserver
+# provides the partitions through a pair of pseudo-terminals, connected by
+# pty-bridge.py at SIM_UART_BITRATE. SIM_UART_ERROR_RATE corrupts random bytes.
+SIM_UART_BITRATE?=921600
+SIM_UART_ERROR_RATE?=0
+SIM_UART_TARGET=sim_uart_target
+SIM_UART_HOST=sim_uart_host
+# Polls for up to 10s until the shell condition $(1) is true
+SIM_WAIT_FOR=n=0; while ! $(1); do [ $$n -lt 100 ] || break; sleep 0.1; n=$$((n + 1)); done
+test-sim-uart-update: wolfboot.elf FORCE
+	$(Q)make -C tools/uart-flash-server >/dev/null
+	$(Q)rm -f $(SIM_FLASH) $(SIM_UART_TARGET) $(SIM_UART_HOST)
+	$(Q)make $(SIM_FLASH)
+	$(Q)$(SIGN_TOOL) $(SIGN_OPTIONS) test-app/image.bin $(PRIVATE_KEY) $(TEST_UPDATE_VERSION) >/dev/null
+	$(Q)cp test-app/image_v$(TEST_UPDATE_VERSION)_signed.bin sim_uart_update.bin
+	$(Q)python3 tools/uart-flash-server/pty-bridge.py $(SIM_UART_TARGET) $(SIM_UART_HOST) \
+		$(SIM_UART_BITRATE) $(SIM_UART_ERROR_RATE) > sim_uart.log & bridge=$$!; \
+		$(call SIM_WAIT_FOR,[ -e $(SIM_UART_TARGET) -a -e $(SIM_UART_HOST) ]); \
+		tools/uart-flash-server/ufserver sim_uart_update.bin $(SIM_UART_HOST) > sim_ufserver.log & server=$$!; \
+		$(call SIM_WAIT_FOR,grep -q "Serving on" sim_ufserver.log); \
+		WOLFBOOT_SIM_UART=$(SIM_UART_TARGET) WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf > sim.log; \
+		WOLFBOOT_SIM_UART=$(SIM_UART_TARGET) ./wolfboot.elf >> sim.log; \
+		kill $$server; kill $$bridge; wait $$bridge
+	$(Q)cat sim.log sim_uart.log
+	$(Q)test "`grep -c "booting version $(TEST_UPDATE_VERSION) " sim.log`" = 2 || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log sim_uart.log sim_ufserver.log sim_uart_update.bin
+	@echo "TEST PASSED"
+
+# Delta updates (DELTA_UPDATES=1): stage a patch from version 1 to a
+# partially modified image, signed as version $(TEST_UPDATE_VERSION)
+sim-delta-stage: test-app/image_v1_signed.bin FORCE
+	$(Q)cp test-app/image.bin test-app/image_delta.bin
+	$(Q)head -c 2048 /dev/urandom | dd of=test-app/image_delta.bin bs=1 \
+		seek=$$(( $(SIM_IMAGE_KB) * 512 )) conv=notrunc 2>/dev/null
+	$(Q)WOLFBOOT_SECTOR_SIZE=$(WOLFBOOT_SECTOR_SIZE) $(SIGN_TOOL) $(SIGN_OPTIONS) \
+		--delta test-app/image_v1_signed.bin test-app/image_delta.bin $(PRIVATE_KEY) \
+		$(TEST_UPDATE_VERSION) >/dev/null
+	$(Q)dd if=/dev/zero bs=$$(( $(WOLFBOOT_PARTITION_SIZE) )) count=1 2>/dev/null | tr "\000" "\377" | \
+		dd of=$(SIM_FLASH) bs=$$(( $(WOLFBOOT_SECTOR_SIZE) )) seek=$$(( $(SIM_UPDATE_OFF) / $(WOLFBOOT_SECTOR_SIZE) )) conv=notrunc 2>/dev/null
+	$(Q)dd if=test-app/image_delta_v$(TEST_UPDATE_VERSION)_signed_diff.bin of=$(SIM_FLASH) bs=1 \
+		seek=$(SIM_UPDATE_OFF) conv=notrunc 2>/dev/null
+	$(Q)printf "pBOOT" | dd of=$(SIM_FLASH) bs=1 seek=$$(( $(SIM_UPDATE_END) - 5 )) conv=notrunc 2>/dev/null
+
+test-sim-delta-update: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-delta-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# The delta update verifies the signatures of the patch and of the current
+# firmware together (VERIFY_BATCH, with SIGN=ED25519 or SIGN=ECC256): the
+# update is installed, and rejected when the signature of the patch is altered
+SIM_SIG_TLV_OFF=grep -obUaP '\x20\x00\x40\x00' test-app/image_delta_v$(TEST_UPDATE_VERSION)_signed_diff.bin | \
+	head -n 1 | cut -d: -f1
+test-sim-delta-batch: wolfboot.elf FORCE
+	$(Q)nm wolfboot.elf | grep -q -e ' ed25519_verify_batch$$' -e ' ecc256_verify_table_batch$$' || \
+		(echo "TEST FAILED (no batch verification)" && exit 1)
+	$(Q)make -s test-sim-delta-update TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make -s $(SIM_FLASH)
+	$(Q)make -s sim-delta-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)printf "\252" | dd of=$(SIM_FLASH) bs=1 \
+		seek=$$(( $(SIM_UPDATE_OFF) + $$($(SIM_SIG_TLV_OFF)) + 4 + 16 )) conv=notrunc 2>/dev/null
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED (altered signature)" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Not confirmed: the inverse patch restores version 1
+test-sim-delta-rollback: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-delta-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Interrupt the delta update at different points, then resume it
+test-sim-delta-powerfail: wolfboot.elf FORCE
+	$(Q)for n in $(SIM_POWERFAIL_POINTS); do \
+		rm -f $(SIM_FLASH); make -s $(SIM_FLASH) >/dev/null; \
+		make -s sim-delta-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION) >/dev/null; \
+		WOLFBOOT_SIM_POWERFAIL=$$n ./wolfboot.elf > sim.log; \
+		WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf > sim.log; \
+		grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || \
+			(echo "TEST FAILED (power fail at $$n)" && exit 1) || exit 1; \
+	done
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Compressed updates (COMPRESSED_IMAGES=1): a compressible image (the
+# sources of wolfBoot) is signed as version $(TEST_UPDATE_VERSION) with
+# --compress, and decompressed into BOOT while being installed
+sim-compressed-stage: FORCE
+	$(Q)cat src/*.c include/*.h | head -c $$(( $(SIM_IMAGE_KB) * 1024 )) > test-app/image_compressed.bin
+	$(Q)$(SIGN_TOOL) $(SIGN_OPTIONS) --compress test-app/image_compressed.bin $(PRIVATE_KEY) \
+		$(TEST_UPDATE_VERSION) >/dev/null
+	$(Q)dd if=/dev/zero bs=$$(( $(WOLFBOOT_PARTITION_SIZE) )) count=1 2>/dev/null | tr "\000" "\377" | \
+		dd of=$(SIM_FLASH) bs=$$(( $(WOLFBOOT_SECTOR_SIZE) )) seek=$$(( $(SIM_UPDATE_OFF) / $(WOLFBOOT_SECTOR_SIZE) )) conv=notrunc 2>/dev/null
+	$(Q)dd if=test-app/image_compressed_v$(TEST_UPDATE_VERSION)_signed.bin of=$(SIM_FLASH) bs=1 \
+		seek=$(SIM_UPDATE_OFF) conv=notrunc 2>/dev/null
+	$(Q)printf "pBOOT" | dd of=$(SIM_FLASH) bs=1 seek=$$(( $(SIM_UPDATE_END) - 5 )) conv=notrunc 2>/dev/null
+
+test-sim-compressed-update: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-compressed-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Not confirmed: the copy of version 1 saved in UPDATE is restored
+test-sim-compressed-rollback: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-compressed-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Corrupt one byte of the compressed stream: the update must be rejected
+test-sim-compressed-tampered: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-compressed-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)printf "\252" | dd of=$(SIM_FLASH) bs=1 \
+		seek=$$(( $(SIM_UPDATE_OFF) + $(IMAGE_HEADER_SIZE) + $(SIM_IMAGE_KB) * 128 )) conv=notrunc 2>/dev/null
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Interrupt the compressed update at different points, then resume it
+test-sim-compressed-powerfail: wolfboot.elf FORCE
+	$(Q)for n in $(SIM_POWERFAIL_POINTS); do \
+		rm -f $(SIM_FLASH); make -s $(SIM_FLASH) >/dev/null; \
+		make -s sim-compressed-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION) >/dev/null; \
+		WOLFBOOT_SIM_POWERFAIL=$$n ./wolfboot.elf > sim.log; \
+		WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf > sim.log; \
+		grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || \
+			(echo "TEST FAILED (power fail at $$n)" && exit 1) || exit 1; \
+	done
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Update received by the application with the streaming API of libwolfboot
+# (test-app/app_sim.c): a tampered image is rejected before the update is
+# triggered, then the valid one is written and installed. The payload of
+# merkle tree images is only checked by wolfBoot: tamper with the version.
+SIM_STREAM_TAMPER_OFF=$$(( $(IMAGE_HEADER_SIZE) + $(SIM_IMAGE_KB) * 512 ))
+ifeq ($(MERKLE_TREE),1)
+  SIM_STREAM_TAMPER_OFF=12
+endif
+SIM_APP_OBJS=test-app/app_sim.o hal/sim.o src/libwolfboot.o src/update_stream.o \
+	$(WOLFCRYPT_OBJS) $(PUBLIC_KEY_OBJS)
+
+test-app/app_sim.elf: $(SIM_APP_OBJS)
+	@echo "\t[LD] $@"
+	$(Q)$(LD) -Wl,-gc-sections $(filter -pthread,$(LDFLAGS)) -o $@ $(SIM_APP_OBJS)
+
+test-sim-update-stream: wolfboot.elf test-app/app_sim.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)$(SIGN_TOOL) $(SIGN_OPTIONS) test-app/image.bin $(PRIVATE_KEY) $(TEST_UPDATE_VERSION) >/dev/null
+	$(Q)cp test-app/image_v$(TEST_UPDATE_VERSION)_signed.bin sim_update_tampered.bin
+	$(Q)printf "\252" | dd of=sim_update_tampered.bin bs=1 \
+		seek=$(SIM_STREAM_TAMPER_OFF) conv=notrunc 2>/dev/null
+	$(Q)! ./test-app/app_sim.elf sim_update_tampered.bin || (echo "TEST FAILED (tampered image)" && exit 1)
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)./test-app/app_sim.elf test-app/image_v$(TEST_UPDATE_VERSION)_signed.bin
+	$(Q)WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log sim_update_tampered.bin
+	@echo "TEST PASSED"
+
+# Encrypted external partitions (ENCRYPT=1, EXT_FLASH=1): UPDATE and SWAP are
+# in the file external_flash.dd, addressed from 0, e.g. with
+# WOLFBOOT_PARTITION_UPDATE_ADDRESS=0x0 WOLFBOOT_PARTITION_SWAP_ADDRESS=0x40000.
+# The key and the nonce are stored at the end of BOOT, the update is signed
+# with --encrypt. ENCRYPT_WITH_AES128=1 or ENCRYPT_WITH_AES256=1 select AES-CTR.
+SIM_EXT_FLASH=external_flash.dd
+SIM_ENC_KEY=sim_enc_key.bin
+ifeq ($(ENCRYPT_WITH_AES128),1)
+  SIM_ENC_ARGS=--aes128
+  SIM_ENC_SECRET_SIZE=32
+else ifeq ($(ENCRYPT_WITH_AES256),1)
+  SIM_ENC_ARGS=--aes256
+  SIM_ENC_SECRET_SIZE=48
+else
+  SIM_ENC_ARGS=--chacha
+  SIM_ENC_SECRET_SIZE=44
+endif
+SIM_ENC_UPDATE_END=$$(( $(WOLFBOOT_PARTITION_UPDATE_ADDRESS) + $(WOLFBOOT_PARTITION_SIZE) - $(SIM_ENC_SECRET_SIZE) ))
+
+sim-encrypted-stage: test-app/image.bin FORCE
+	$(Q)printf "0123456789abcdef0123456789abcdef0123456789abcdef" | head -c $(SIM_ENC_SECRET_SIZE) > $(SIM_ENC_KEY)
+	$(Q)dd if=$(SIM_ENC_KEY) of=$(SIM_FLASH) bs=1 conv=notrunc 2>/dev/null \
+		seek=$$(( $(SIM_BOOT_OFF) + $(WOLFBOOT_PARTITION_SIZE) - $(SIM_ENC_SECRET_SIZE) ))
+	$(Q)$(SIGN_TOOL) $(SIGN_OPTIONS) --encrypt $(SIM_ENC_KEY) $(SIM_ENC_ARGS) test-app/image.bin $(PRIVATE_KEY) \
+		$(TEST_UPDATE_VERSION) >/dev/null
+	$(Q)dd if=/dev/zero bs=$$(( $(WOLFBOOT_PARTITION_SWAP_ADDRESS) + $(WOLFBOOT_SECTOR_SIZE) )) count=1 2>/dev/null | \
+		tr "\000" "\377" > $(SIM_EXT_FLASH)
+	$(Q)dd if=test-app/image_v$(TEST_UPDATE_VERSION)_signed_and_encrypted.bin of=$(SIM_EXT_FLASH) bs=1 \
+		seek=$$(( $(WOLFBOOT_PARTITION_UPDATE_ADDRESS) )) conv=notrunc 2>/dev/null
+	$(Q)printf "pBOOT" | dd of=$(SIM_EXT_FLASH) bs=1 seek=$$(( $(SIM_ENC_UPDATE_END) - 5 )) conv=notrunc 2>/dev/null
+
+# After the swap, the previous version is stored in UPDATE, encrypted
+SIM_ENC_CHECK=! dd if=$(SIM_EXT_FLASH) bs=1 count=4 skip=$$(( $(WOLFBOOT_PARTITION_UPDATE_ADDRESS) )) \
+	2>/dev/null | grep -q WOLF || (echo "TEST FAILED (plaintext in UPDATE)" && exit 1)
+
+test-sim-encrypted-update: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-encrypted-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)$(SIM_ENC_CHECK)
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log $(SIM_ENC_KEY)
+	@echo "TEST PASSED"
+
+# Not confirmed: version 1 is decrypted back from UPDATE
+test-sim-encrypted-rollback: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-encrypted-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)$(SIM_ENC_CHECK)
+	$(Q)rm -f sim.log $(SIM_ENC_KEY)
+	@echo "TEST PASSED"
+
+# Interrupt the encrypted update at different points, then resume it
+test-sim-encrypted-powerfail: wolfboot.elf FORCE
+	$(Q)for n in $(SIM_POWERFAIL_POINTS); do \
+		rm -f $(SIM_FLASH); make -s $(SIM_FLASH) >/dev/null; \
+		make -s sim-encrypted-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION) >/dev/null; \
+		WOLFBOOT_SIM_POWERFAIL=$$n ./wolfboot.elf > sim.log; \
+		WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf > sim.log; \
+		grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || \
+			(echo "TEST FAILED (power fail at $$n)" && exit 1) || exit 1; \
+	done
+	$(Q)rm -f sim.log $(SIM_ENC_KEY)
+	@echo "TEST PASSED"
+
+# SPI flash (SPI_FLASH=1): UPDATE and SWAP are in external_flash.dd, addressed
+# as for the encrypted partitions, behind the mock SPI controller and NOR
+# flash model of hal/spi/spi_drv_sim.c (WOLFBOOT_SIM_SPI_PART selects the
+# part). The flash statistics include the bus counters: src/spi_flash.c must
+# not use byte-wide driver calls.
+SIM_SPI_UPDATE_END=$$(( $(WOLFBOOT_PARTITION_UPDATE_ADDRESS) + $(WOLFBOOT_PARTITION_SIZE) ))
+SIM_SPI_CHECK=grep -q "calls: [0-9]* xfer, 0 byte" sim.log || (echo "TEST FAILED (byte-wide SPI access)" && exit 1)
+
+sim-spi-stage: test-app/image.bin FORCE
+	$(Q)$(SIGN_TOOL) $(SIGN_OPTIONS) $(SIM_UPDATE_IMAGE).bin $(PRIVATE_KEY) $(TEST_UPDATE_VERSION) >/dev/null
+	$(Q)dd if=/dev/zero bs=$$(( $(WOLFBOOT_PARTITION_SWAP_ADDRESS) + $(WOLFBOOT_SECTOR_SIZE) )) count=1 2>/dev/null | \
+		tr "\000" "\377" > $(SIM_EXT_FLASH)
+	$(Q)dd if=$(SIM_UPDATE_IMAGE)_v$(TEST_UPDATE_VERSION)_signed.bin of=$(SIM_EXT_FLASH) bs=1 \
+		seek=$$(( $(WOLFBOOT_PARTITION_UPDATE_ADDRESS) )) conv=notrunc 2>/dev/null
+	$(Q)printf "pBOOT" | dd of=$(SIM_EXT_FLASH) bs=1 seek=$$(( $(SIM_SPI_UPDATE_END) - 5 )) conv=notrunc 2>/dev/null
+
+test-sim-spi-update: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-spi-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)$(SIM_SPI_CHECK)
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Not confirmed: version 1 is restored from UPDATE
+test-sim-spi-rollback: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-spi-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)./wolfboot.elf > sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)$(SIM_SPI_CHECK)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Interrupt the update at different points, then resume it
+test-sim-spi-powerfail: wolfboot.elf FORCE
+	$(Q)for n in $(SIM_POWERFAIL_POINTS); do \
+		rm -f $(SIM_FLASH); make -s $(SIM_FLASH) >/dev/null; \
+		make -s sim-spi-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION) >/dev/null; \
+		WOLFBOOT_SIM_POWERFAIL=$$n ./wolfboot.elf > sim.log; \
+		WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf > sim.log; \
+		grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || \
+			(echo "TEST FAILED (power fail at $$n)" && exit 1) || exit 1; \
+	done
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Same update on each part emulated by the NOR flash model, with the geometry
+# found in its SFDP tables (sst25vf016b has none)
+SIM_SPI_PARTS?=w25q128jv mx25l12835f mt25ql256 s25fl256l sst25vf016b
+test-sim-spi-parts: wolfboot.elf FORCE
+	$(Q)for p in $(SIM_SPI_PARTS); do \
+		rm -f $(SIM_FLASH); make -s $(SIM_FLASH) >/dev/null; \
+		make -s sim-spi-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION) >/dev/null; \
+		WOLFBOOT_SIM_SPI_PART=$$p WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf > sim.log; \
+		grep "spi  \|external" sim.log; \
+		grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || \
+			(echo "TEST FAILED ($$p)" && exit 1) || exit 1; \
+		$(SIM_SPI_CHECK) || exit 1; \
+	done
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# A part whose smallest erase type (s25fl512s: 256KB) is larger than
+# WOLFBOOT_SECTOR_SIZE must not be erased with it: the update is not installed
+test-sim-spi-large-erase: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-spi-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)WOLFBOOT_SIM_SPI_PART=s25fl512s WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf | tee sim.log
+	$(Q)grep -q "erase commands: 256K x 0$$" sim.log || (echo "TEST FAILED (sectors erased with 256KB)" && exit 1)
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# Boot time profile (WOLFBOOT_PROFILE=1): each phase of the update must be
+# accounted in the report printed before booting
+SIM_PROFILE_PHASES=open_image header image_hash key_hash sig_verify copy_sector prepare_boot total
+test-sim-profile: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-update-stage TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)WOLFBOOT_SIM_SUCCESS=1 ./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)for p in $(SIM_PROFILE_PHASES); do \
+		grep -q "^  $$p  *[1-9][0-9]* calls" sim.log || \
+			(echo "TEST FAILED (phase $$p)" && exit 1) || exit 1; \
+	done
+	$(Q)rm -f sim.log
+	@echo "TEST PASSED"
+
+# RAM loading (SIM_UPDATE_RAM=1, with EXT_FLASH=1 or SPI_FLASH=1): the
+# update staged in external flash is copied to WOLFBOOT_LOAD_ADDRESS while
+# being verified. The RAM staging area must hold the payload of the update
+# as signed, which differs from the one of version 1 in the boot partition.
+# The RAM image has no header in front of it: the sim reports version 0.
+SIM_RAM_DUMP=sim_ram.bin
+test-sim-ram-load: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)cp test-app/image.bin test-app/image_ram.bin
+	$(Q)head -c 4096 /dev/urandom >> test-app/image_ram.bin
+	$(Q)make sim-spi-stage SIM_UPDATE_IMAGE=test-app/image_ram TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)WOLFBOOT_SIM_RAM_DUMP=$(SIM_RAM_DUMP) ./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 0 at 0x$(subst 0x,,$(WOLFBOOT_LOAD_ADDRESS))" sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)cmp -s -n $$(stat -c %s test-app/image_ram.bin) test-app/image_ram.bin $(SIM_RAM_DUMP) || \
+		(echo "TEST FAILED (RAM copy)" && exit 1)
+	$(Q)rm -f sim.log $(SIM_RAM_DUMP) test-app/image_ram*.bin
+	@echo "TEST PASSED"
+
+# Multi-component images (MULTI_IMAGE=1, IMAGE_HEADER_SIZE=512): the
+# manifest of each version lists its components, stored in slot A for
+# version 1 and in slot B for the update.
+SIM_COMPONENT_KB?=40
+SIM_COMPONENT_IDS=$(shell seq 0 $$(( $(WOLFBOOT_COMPONENTS) - 1 )))
+SIM_COMPONENT_OFF=$$(( $(WOLFBOOT_COMPONENT_ADDRESS) - $(ARCH_FLASH_OFFSET) ))
+SIM_COMPONENT_ARGS=$(if $(SIM_COMPONENT_SLOT),$(foreach c,$(SIM_COMPONENT_IDS), \
+	--component $(c):$(SIM_COMPONENT_SLOT):$(SIM_COMPONENT_VERSION):sim_component$(c).bin))
+
+# Store new components in $(SIM_COMPONENT_SLOT), and sign the
+# application as version $(SIM_COMPONENT_VERSION) with their manifest
+sim-components-stage: test-app/image.bin FORCE
+	$(Q)for c in $(SIM_COMPONENT_IDS); do \
+		dd if=/dev/urandom of=sim_component$$c.bin bs=1024 count=$(SIM_COMPONENT_KB) 2>/dev/null; \
+		dd if=sim_component$$c.bin of=$(SIM_FLASH) bs=1024 conv=notrunc 2>/dev/null \
+			seek=$$(( ($(SIM_COMPONENT_OFF) + (2 * $$c + $(SIM_COMPONENT_SLOT)) * $(WOLFBOOT_COMPONENT_SIZE)) / 1024 )); \
+	done
+	$(Q)$(SIGN_TOOL) $(SIGN_OPTIONS) $(SIM_COMPONENT_ARGS) test-app/image.bin $(PRIVATE_KEY) \
+		$(SIM_COMPONENT_VERSION) >/dev/null
+
+test-sim-multi-image: wolfboot.elf FORCE
+	$(Q)rm -f $(SIM_FLASH)
+	$(Q)make $(SIM_FLASH)
+	$(Q)make sim-components-stage SIM_COMPONENT_SLOT=0 SIM_COMPONENT_VERSION=1
+	$(Q)dd if=test-app/image_v1_signed.bin of=$(SIM_FLASH) bs=1 seek=$(SIM_BOOT_OFF) conv=notrunc 2>/dev/null
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)grep -q "component 1 version 1 slot A" sim.log || (echo "TEST FAILED" && exit 1)
+	@# One of the new components is corrupted: the whole update is rejected
+	$(Q)make sim-components-stage SIM_COMPONENT_SLOT=1 SIM_COMPONENT_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)make sim-update-stage SIM_COMPONENT_SLOT=1 SIM_COMPONENT_VERSION=$(TEST_UPDATE_VERSION) \
+		TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)printf "\252" | dd of=$(SIM_FLASH) bs=1 conv=notrunc 2>/dev/null \
+		seek=$$(( $(SIM_COMPONENT_OFF) + 3 * $(WOLFBOOT_COMPONENT_SIZE) + 1000 ))
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED (tampered component)" && exit 1)
+	@# Update, not confirmed: version 1 and its components come back
+	$(Q)make sim-components-stage SIM_COMPONENT_SLOT=1 SIM_COMPONENT_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)make sim-update-stage SIM_COMPONENT_SLOT=1 SIM_COMPONENT_VERSION=$(TEST_UPDATE_VERSION) \
+		TEST_UPDATE_VERSION=$(TEST_UPDATE_VERSION)
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version $(TEST_UPDATE_VERSION) " sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)grep -q "component 1 version $(TEST_UPDATE_VERSION) slot B" sim.log || (echo "TEST FAILED" && exit 1)
+	$(Q)./wolfboot.elf | tee sim.log
+	$(Q)grep -q "booting version 1 " sim.log || (echo "TEST FAILED (rollback)" && exit 1)
+	$(Q)grep -q "component 1 version 1 slot A" sim.log || (echo "TEST FAILED (rollback)" && exit 1)
+	$(Q)rm -f sim.log sim_component*.bin test-app/image_v1_signed.bin
+	@echo "TEST PASSED"
+
+test-sim: test-sim-update test-sim-rollback test-sim-update-tampered test-sim-powerfail \
+	test-sim-powerfail-sector0 test-sim-update-stream
@@ -40,6 +40,10 @@
 #include <termios.h>
 #include <signal.h>
 #include <errno.h>
+#include <time.h>
+#include <wolfssl/wolfcrypt/settings.h>
+#include <wolfssl/wolfcrypt/sha256.h>
+#include "update_stream.h"
 
 #define MSGLEN      (4 + 4 + 8)
 #ifndef UART_DEV
@@ -53,6 +57,11 @@
 #define B115200 115200
 #endif
 
+/* Streaming mode defaults, see update_stream.h */
+#define STREAM_FRAME_SIZE   256
+#define STREAM_WINDOW       8
+#define STREAM_MAX_RETRIES  10
+
 static volatile int cleanup;                 /* To handle shutdown */
 union usb_ack {
     uint32_t offset;
@@ -64,12 +73,14 @@ static uint8_t      pktbuf[MSGLEN];
 static unsigned int pktbuf_size = 0;
 static int serialfd = -1;
 static uint32_t high_ack;
+static unsigned int legacy_retx;
 
 
 void alarm_handler(int signo)
 {
     if (serialfd >= 0 && pktbuf_size > 0) {
         write(serialfd, pktbuf, pktbuf_size);
+        legacy_retx++;
         printf("retransmitting...\n");
         alarm(2);
     }
@@ -120,24 +131,345 @@ static void check(uint8_t *pkt, int size)
 }
 
 
+
+static speed_t rate_to_constant(int baudrate)
+{
+#ifdef __MACH__
+#define B(x) case x: return x
+#else
+#define B(x) case x: return B##x
+#endif
+    switch(baudrate) {
+        B(9600);   B(19200);  B(38400);  B(57600);  B(115200);
+        B(230400);
+#ifdef B460800
+        B(460800); B(921600);
+#endif
+        default: return 0;
+    }
+#undef B
+}
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void legacy_update(int ffd, uint32_t tot_len)
+{
+    int           res;
+    uint32_t      len;
+    union usb_ack ack;
+
+    do {
+        uint8_t hdr[2] = { 0xA5, 0x5A};
+        len = 0;
+        lseek(ffd, 0, SEEK_SET);
+        write(serialfd, &hdr, 2);
+        write(serialfd, &tot_len, sizeof(uint32_t));
+        printf("Sent image file size (%d)\n", tot_len);
+        while (len < tot_len) {
+            res = recv_ack(&ack);
+            if (res == 0) {
+                if (ack.offset > tot_len) {
+                    printf("Ignore bogus ack...\n");
+                    continue;
+                }
+                if (ack.offset < high_ack) {
+                    printf("Ignore low ack...\n");
+                    continue;
+                }
+                high_ack = ack.offset;
+                pktbuf_size = 0;
+                if (ack.offset != len) {
+                    printf("buf rewind %u\n", ack.offset);
+                    lseek(ffd, ack.offset, SEEK_SET);
+                    len = ack.offset;
+                }
+                memcpy(pktbuf + 4, &len, sizeof(len));
+                res = read(ffd, pktbuf + 4 + sizeof(uint32_t), MSGLEN - (4 + sizeof(uint32_t)));
+                if (res < 0) {
+                    printf("EOF\r\n");
+                    cleanup = 1;
+                    break;
+                }
+                pktbuf_size = res + 4 + sizeof(uint32_t);
+                check(pktbuf, pktbuf_size);
+                write(serialfd, pktbuf, pktbuf_size);
+                len += res;
+
+                printf("Sent bytes: %d/%d  %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x                \r",
+                    len, tot_len, pktbuf[0], pktbuf[1], pktbuf[2], pktbuf[3], pktbuf[4], pktbuf[5], pktbuf[6], pktbuf[7]);
+
+                fflush(stdout);
+                alarm(2);
+            }
+        }
+        printf("\n\n");
+    } while (0);
+
+    printf("waiting for last ack...\n");
+    while(!cleanup) {
+        res = recv_ack(&ack);
+        if ((res == 0 ) && (ack.offset == tot_len)) {
+            printf("Transfer complete.\n");
+            break;
+        }
+    }
+    alarm(0);
+}
+
+/* Streaming mode (see update_stream.h): a window of data frames in flight,
+ * selective retransmission, SHA-256 of the whole image checked by the
+ * target at the end.
+ */
+struct stream_stats {
+    unsigned int frames;
+    unsigned int timeout_retx;
+    unsigned int sack_retx;
+    unsigned long line_bytes;
+};
+
+struct tx_frame {
+    uint32_t tx;        /* Transmission counter at the last send, 0: never */
+    long long sent;
+    int acked;
+    int lost;
+};
+
+static struct stream_rx rx;
+static struct stream_frame rxf;
+static struct stream_stats st_stream;
+
+static void stream_tx(uint8_t type, uint32_t off, const uint8_t *p, uint16_t len)
+{
+    int res = stream_send(serialfd, type, off, p, len);
+    if (res > 0)
+        st_stream.line_bytes += res;
+}
+
+static int stream_result_status(void)
+{
+    if (rxf.type == STREAM_RESULT && rxf.len == 1)
+        return rxf.payload[0];
+    return -1;
+}
+
+static int stream_update(const uint8_t *fw, uint32_t tot_len,
+        uint32_t frame_sz, int window, int rto)
+{
+    struct tx_frame *fr;
+    uint32_t n_frames = (tot_len + frame_sz - 1) / frame_sz;
+    uint32_t base = 0, tx_count = 0, max_acked_tx = 0;
+    uint32_t i, ack_base, bitmap, len;
+    uint8_t open[7];
+    uint8_t digest[STREAM_HASH_SIZE];
+    wc_Sha256 sha;
+    long long now, wait;
+    int retries = 0, status;
+
+    fr = calloc(n_frames, sizeof(*fr));
+    if (!fr)
+        return -1;
+    stream_rx_init(&rx, serialfd);
+
+    open[0] = tot_len & 0xFF;
+    open[1] = (tot_len >> 8) & 0xFF;
+    open[2] = (tot_len >> 16) & 0xFF;
+    open[3] = tot_len >> 24;
+    open[4] = frame_sz & 0xFF;
+    open[5] = frame_sz >> 8;
+    open[6] = (uint8_t)window;
+    while (1) {
+        if (retries++ > STREAM_MAX_RETRIES) {
+            printf("No answer from target.\n");
+            goto fail;
+        }
+        stream_tx(STREAM_OPEN, 0, open, sizeof(open));
+        if (!stream_recv(&rx, &rxf, rto, NULL))
+            continue;
+        status = stream_result_status();
+        if (status > 0) {
+            printf("Target refused the update (status %d)\n", status);
+            goto fail;
+        }
+        if (rxf.type == STREAM_ACK && rxf.offset == 0)
+            break;
+    }
+    printf("Streaming %u bytes, %u frames of %u bytes, window %d\n",
+            tot_len, n_frames, frame_sz, window);
+
+    retries = 0;
+    while (base < n_frames) {
+        /* (Re)send what the window allows */
+        for (i = base; i < n_frames && i < base + window; i++) {
+            now = now_ms();
+            if (fr[i].acked)
+                continue;
+            if (fr[i].tx != 0 && !fr[i].lost && now - fr[i].sent < rto)
+                continue;
+            if (fr[i].lost)
+                st_stream.sack_retx++;
+            else if (fr[i].tx != 0)
+                st_stream.timeout_retx++;
+            len = (i == n_frames - 1) ? tot_len - i * frame_sz : frame_sz;
+            stream_tx(STREAM_DATA, i * frame_sz, fw + i * frame_sz, len);
+            st_stream.frames++;
+            fr[i].tx = ++tx_count;
+            fr[i].sent = now_ms();
+            fr[i].lost = 0;
+        }
+
+        /* Wait for an ACK, at most until the oldest frame expires */
+        wait = rto;
+        now = now_ms();
+        for (i = base; i < n_frames && i < base + window; i++) {
+            if (!fr[i].acked && fr[i].sent + rto - now < wait)
+                wait = fr[i].sent + rto - now;
+        }
+        if (wait < 1)
+            wait = 1;
+        if (!stream_recv(&rx, &rxf, (int)wait, NULL) ||
+                rxf.type != STREAM_ACK || rxf.len != 4) {
+            if (now_ms() - now >= wait && ++retries > STREAM_MAX_RETRIES *
+                    window) {
+                printf("Target stopped answering.\n");
+                goto fail;
+            }
+            continue;
+        }
+        retries = 0;
+        ack_base = rxf.offset;
+        bitmap = rxf.payload[0] | (rxf.payload[1] << 8) |
+            (rxf.payload[2] << 16) | ((uint32_t)rxf.payload[3] << 24);
+        if (ack_base > n_frames)
+            continue;
+        for (i = base; i < ack_base; i++)
+            fr[i].acked = 1;
+        for (i = 0; i < 32 && ack_base + 1 + i < n_frames; i++) {
+            if (bitmap & (1U << i))
+                fr[ack_base + 1 + i].acked = 1;
+        }
+        for (i = base; i < n_frames && i < ack_base + 33; i++) {
+            if (fr[i].acked && fr[i].tx > max_acked_tx)
+                max_acked_tx = fr[i].tx;
+        }
+        /* A frame sent before one that made it through is lost */
+        for (i = base; i < n_frames && i < base + window; i++) {
+            if (!fr[i].acked && fr[i].tx < max_acked_tx)
+                fr[i].lost = 1;
+        }
+        while (base < n_frames && fr[base].acked)
+            base++;
+        printf("Sent bytes: %u/%u                \r",
+                (base < n_frames) ? base * frame_sz : tot_len, tot_len);
+        fflush(stdout);
+    }
+    printf("\n");
+
+    /* End-to-end check */
+    wc_InitSha256(&sha);
+    wc_Sha256Update(&sha, fw, tot_len);
+    wc_Sha256Final(&sha, digest);
+    retries = 0;
+    while (1) {
+        if (retries++ > STREAM_MAX_RETRIES) {
+            printf("No SHA-256 verification result from target.\n");
+            goto fail;
+        }
+        stream_tx(STREAM_HASH, 0, digest, sizeof(digest));
+        if (!stream_recv(&rx, &rxf, rto, NULL))
+            continue;
+        status = stream_result_status();
+        if (status == STREAM_OK)
+            break;
+        if (status > 0) {
+            printf("Target SHA-256 verification failed (status %d)\n", status);
+            goto fail;
+        }
+    }
+    printf("Transfer complete, SHA-256 verified by target.\n");
+    free(fr);
+    return 0;
+
+fail:
+    free(fr);
+    return -1;
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [-d uart_device] [-b baudrate] [-s] [-f frame_size] "
+            "[-w window] firmware_filename\n", name);
+    printf("  -s  streaming mode (default: legacy 8-byte packets)\n");
+    printf("  -f  streaming frame size, 1-%d (default %d)\n",
+            STREAM_MAX_FRAME, STREAM_FRAME_SIZE);
+    printf("  -w  streaming window, 1-%d frames (default %d)\n",
+            STREAM_MAX_WINDOW, STREAM_WINDOW);
+    exit(1);
+}
+
 int main(int argc, char** argv)
 {
     /* Variables for awaiting datagram */
     int           res = 1;
-    uint32_t      len, tot_len;
+    uint32_t      tot_len;
     int           ffd; /* Firmware file descriptor */
     struct stat   st;
-    union usb_ack ack;
     struct termios tty;
+    const char    *uart_dev = UART_DEV;
+    int           baudrate = 115200;
+    int           stream = 0;
+    uint32_t      frame_sz = STREAM_FRAME_SIZE;
+    int           window = STREAM_WINDOW;
+    uint8_t       *fw = NULL;
+    long long     t_start, t_elapsed;
+    uint32_t      version = 0;
+    speed_t       speed;
+    uint8_t       vb;
+    int           opt, i;
+
     sigset(SIGALRM, alarm_handler);
 
-    if (argc != 2) {
-        printf("Usage: %s firmware_filename\n", argv[0]);
+    while ((opt = getopt(argc, argv, "d:b:sf:w:")) != -1) {
+        switch (opt) {
+            case 'd':
+                uart_dev = optarg;
+                break;
+            case 'b':
+                baudrate = atoi(optarg);
+                break;
+            case 's':
+                stream = 1;
+                break;
+            case 'f':
+                frame_sz = atoi(optarg);
+                stream = 1;
+                break;
+            case 'w':
+                window = atoi(optarg);
+                stream = 1;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1)
+        usage(argv[0]);
+    if (frame_sz < 1 || frame_sz > STREAM_MAX_FRAME || window < 1 ||
+            window > STREAM_MAX_WINDOW) {
+        usage(argv[0]);
+    }
+    speed = rate_to_constant(baudrate);
+    if (speed == 0) {
+        fprintf(stderr, "Unsupported baudrate %d\n", baudrate);
         exit(1);
     }
 
     /* open file and get size */
-    ffd = open(argv[1], O_RDONLY);
+    ffd = open(argv[optind], O_RDONLY);
     if (ffd < 0) {
         perror("opening file");
         exit(2);
@@ -148,17 +480,24 @@ int main(int argc, char** argv)
         exit(2);
     }
     tot_len = st.st_size;
+    if (stream) {
+        fw = malloc(tot_len);
+        if (!fw || read(ffd, fw, tot_len) != (ssize_t)tot_len) {
+            perror("reading file");
+            exit(2);
+        }
+    }
 
     /* open UART */
-    printf("Opening %s UART\n", UART_DEV);
-    serialfd = open(UART_DEV, O_RDWR | O_NOCTTY);
+    printf("Opening %s UART\n", uart_dev);
+    serialfd = open(uart_dev, O_RDWR | O_NOCTTY);
     if (serialfd < 0) {
-        fprintf(stderr, "failed opening serial %s\n", UART_DEV);
+        fprintf(stderr, "failed opening serial %s\n", uart_dev);
         exit(2);
     }
     tcgetattr(serialfd, &tty);
-    cfsetospeed(&tty, B115200);
-    cfsetispeed(&tty, B115200);
+    cfsetospeed(&tty, speed);
+    cfsetispeed(&tty, speed);
     tty.c_cflag = (tty.c_cflag & ~CSIZE) | (CS8);
     tty.c_iflag &= ~(IGNBRK | IXON | IXOFF | IXANY| INLCR | ICRNL);
     tty.c_oflag &= ~OPOST;
@@ -189,66 +528,51 @@ int main(int argc, char** argv)
 
     }
     printf("Target connected.\n");
-    usleep(500000);
-    printf("Starting update.\n");
-
-    do {
-        uint8_t hdr[2] = { 0xA5, 0x5A};
-        len = 0;
-        lseek(ffd, 0, SEEK_SET);
-        write(serialfd, &hdr, 2);
-        write(serialfd, &tot_len, sizeof(uint32_t));
-        printf("Sent image file size (%d)\n", tot_len);
-        while (len < tot_len) {
-            res = recv_ack(&ack);
-            if (res == 0) {
-                if (ack.offset > tot_len) {
-                    printf("Ignore bogus ack...\n");
-                    continue;
-                }
-                if (ack.offset < high_ack) {
-                    printf("Ignore low ack...\n");
-                    continue;
-                }
-                high_ack = ack.offset;
-                pktbuf_size = 0;
-                if (ack.offset != len) {
-                    printf("buf rewind %u\n", ack.offset);
-                    lseek(ffd, ack.offset, SEEK_SET);
-                    len = ack.offset;
-                }
-                memcpy(pktbuf + 4, &len, sizeof(len));
-                res = read(ffd, pktbuf + 4 + sizeof(uint32_t), MSGLEN - (4 + sizeof(uint32_t)));
-                if (res < 0) {
-                    printf("EOF\r\n");
-                    cleanup = 1;
-                    break;
-                }
-                pktbuf_size = res + 4 + sizeof(uint32_t);
-                check(pktbuf, pktbuf_size);
-                write(serialfd, pktbuf, pktbuf_size);
-                len += res;
-
-                printf("Sent bytes: %d/%d  %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x                \r",
-                    len, tot_len, pktbuf[0], pktbuf[1], pktbuf[2], pktbuf[3], pktbuf[4], pktbuf[5], pktbuf[6], pktbuf[7]);
-
-                fflush(stdout);
-                alarm(2);
+    if (stream) {
+        /* Current version, MSB first */
+        for (i = 0; i < 4; i++) {
+            res = read(serialfd, &vb, 1);
+            if (res < 1) {
+                usleep(10000);
+                i--;
+                continue;
             }
+            version = (version << 8) | vb;
         }
-        printf("\n\n");
-    } while (0);
-
-    printf("waiting for last ack...\n");
-    while(!cleanup) {
-        res = recv_ack(&ack);
-        if ((res == 0 ) && (ack.offset == tot_len)) {
-            printf("Transfer complete.\n");
-            break;
-        }
+        printf("Target version: %u\n", version);
+        /* Retransmission timeout: twice the time to send a full window,
+         * plus some slack for the target to process it */
+        res = 100 + (int)(2ULL * window * (frame_sz + STREAM_HDR_SIZE +
+                    STREAM_CRC_SIZE + 15) * 10 * 1000 / baudrate);
+        t_start = now_ms();
+        res = stream_update(fw, tot_len, frame_sz, window, res);
+    }
+    else {
+        usleep(500000);
+        printf("Starting update.\n");
+        t_start = now_ms();
+        legacy_update(ffd, tot_len);
+        res = 0;
+    }
+    t_elapsed = now_ms() - t_start;
+    if (t_elapsed < 1)
+        t_elapsed = 1;
+    printf("%u bytes in %lld.%03lld s: %.1f bytes/s\n", tot_len,
+            t_elapsed / 1000, t_elapsed % 1000,
+            tot_len * 1000.0 / t_elapsed);
+    if (stream) {
+        printf("Frames sent: %u, retransmitted: %u (%u on timeout, %u "
+                "selective), %lu bytes on the line\n", st_stream.frames,
+                st_stream.timeout_retx + st_stream.sack_retx,
+                st_stream.timeout_retx, st_stream.sack_retx,
+                st_stream.line_bytes);
+    }
+    else {
+        printf("Retransmitted on timeout: %u\n", legacy_retx);
     }
     printf("All done.\n");
     close(serialfd);
+    free(fw);
 
-    return 0;
+    return (res == 0) ? 0 : 1;
 }
@@ -0,0 +1,344 @@
+/* target-sim.c
+ *
+ * Host stand-in for the update receiver of the test applications.
+ *
+ * Speaks both the legacy protocol (16-byte packets, one ACK each, as in
+ * test-app/app_stm32f4.c) and the streaming protocol (update_stream.h) on
+ * a serial port or pty, and stores the received image into a file that
+ * emulates the UPDATE partition, erased one sector at a time.
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <wolfssl/wolfcrypt/settings.h>
+#include <wolfssl/wolfcrypt/sha256.h>
+#include "update_stream.h"
+
+#define PARTITION_SIZE  0x40000
+#define SECTOR_SIZE     0x1000
+#define MSGSIZE         16
+#define PAGESIZE        256
+
+static const char ERR = '!';
+static const char START = '*';
+static const char ACK = '#';
+
+static int uart = -1;
+static int part = -1;
+static struct stream_rx rx;
+static uint8_t sector[SECTOR_SIZE];
+static uint32_t erased_end;
+
+static void uart_write(const char c)
+{
+    if (write(uart, &c, 1) != 1)
+        perror("uart write");
+}
+
+static uint8_t uart_read(void)
+{
+    int c = stream_getc(&rx, -1);
+    if (c < 0) {
+        fprintf(stderr, "target-sim: line closed\n");
+        exit(2);
+    }
+    return (uint8_t)c;
+}
+
+/* Flash emulation: sectors are erased before the first write into them,
+ * in increasing order, like the test applications do.
+ */
+static void flash_write(uint32_t off, const uint8_t *data, uint32_t len)
+{
+    while (erased_end < off + len) {
+        memset(sector, 0xFF, SECTOR_SIZE);
+        pwrite(part, sector, SECTOR_SIZE, erased_end);
+        erased_end += SECTOR_SIZE;
+    }
+    pwrite(part, data, len, off);
+}
+
+static void ack(uint32_t _off)
+{
+    uint8_t *off = (uint8_t *)(&_off);
+    int i;
+    uart_write(ACK);
+    for (i = 0; i < 4; i++) {
+        uart_write(off[i]);
+    }
+}
+
+static int check(uint8_t *pkt, int size)
+{
+    int i;
+    uint16_t c = 0;
+    uint16_t c_rx = *((uint16_t *)(pkt + 2));
+    uint16_t *p = (uint16_t *)(pkt + 4);
+    for (i = 0; i < ((size - 4) >> 1); i++)
+        c += p[i];
+    if (c == c_rx)
+        return 0;
+    return -1;
+}
+
+/* Receive loop of test-app/app_stm32f4.c, entered after the preamble */
+static int legacy_update(void)
+{
+    static uint8_t page[PAGESIZE];
+    uint8_t msg[MSGSIZE];
+    uint32_t recv_seq;
+    uint32_t r_total = 2;
+    uint32_t tot_len = 0;
+    uint32_t next_seq = 0;
+    uint32_t tlen;
+
+    memset(page, 0xFF, PAGESIZE);
+    msg[0] = 0xA5;
+    msg[1] = 0x5A;
+    while (1) {
+        do {
+            while (r_total < 2) {
+                msg[r_total++] = uart_read();
+                if ((r_total == 2) && ((msg[0] != 0xA5) || msg[1] != 0x5A)) {
+                    r_total = 0;
+                    continue;
+                }
+            }
+            msg[r_total++] = uart_read();
+            if ((tot_len == 0) && r_total == 2 + sizeof(uint32_t))
+                break;
+            if ((r_total > 8) && (tot_len <= ((r_total - 8) + next_seq)))
+                break;
+        } while (r_total < MSGSIZE);
+        if (tot_len == 0) {
+            tlen = msg[2] + (msg[3] << 8) + (msg[4] << 16) + (msg[5] << 24);
+            r_total = 0;
+            if (tlen > PARTITION_SIZE - 8) {
+                uart_write(ERR);
+                uart_write(ERR);
+                uart_write(ERR);
+                uart_write(ERR);
+                uart_write(START);
+                continue;
+            }
+            tot_len = tlen;
+            ack(0);
+            continue;
+        }
+        if (check(msg, r_total) < 0) {
+            r_total = 0;
+            ack(next_seq);
+            continue;
+        }
+        recv_seq = msg[4] + (msg[5] << 8) + (msg[6] << 16) + (msg[7] << 24);
+        if (recv_seq == next_seq) {
+            int psize = r_total - 8;
+            int page_idx = recv_seq % PAGESIZE;
+            memcpy(&page[recv_seq % PAGESIZE], msg + 8, psize);
+            page_idx += psize;
+            if ((page_idx == PAGESIZE) || (next_seq + psize >= tot_len)) {
+                uint32_t dst = (recv_seq + psize) - page_idx;
+                flash_write(dst, page, PAGESIZE);
+                memset(page, 0xFF, PAGESIZE);
+            }
+            next_seq += psize;
+        }
+        r_total = 0;
+        ack(next_seq);
+        if (next_seq >= tot_len) {
+            printf("target-sim: legacy update complete, %u bytes\n", tot_len);
+            return 0;
+        }
+    }
+}
+
+static void stream_ack(uint32_t base, uint32_t bitmap)
+{
+    uint8_t p[4] = { bitmap & 0xFF, (bitmap >> 8) & 0xFF,
+        (bitmap >> 16) & 0xFF, bitmap >> 24 };
+    stream_send(uart, STREAM_ACK, base, p, sizeof(p));
+}
+
+static void stream_result(uint8_t status)
+{
+    stream_send(uart, STREAM_RESULT, 0, &status, 1);
+}
+
+static int stream_verify(uint32_t tot_len, const uint8_t *expected)
+{
+    wc_Sha256 sha;
+    uint8_t digest[STREAM_HASH_SIZE];
+    uint32_t pos = 0;
+    int len;
+
+    /* Hash what has been stored, not what has been received */
+    wc_InitSha256(&sha);
+    while (pos < tot_len) {
+        len = tot_len - pos;
+        if (len > SECTOR_SIZE)
+            len = SECTOR_SIZE;
+        if (pread(part, sector, len, pos) != len)
+            return -1;
+        wc_Sha256Update(&sha, sector, len);
+        pos += len;
+    }
+    wc_Sha256Final(&sha, digest);
+    return memcmp(digest, expected, STREAM_HASH_SIZE) == 0 ? 0 : -1;
+}
+
+static int stream_update(void)
+{
+    static struct stream_frame f;
+    uint32_t tot_len = 0, frame_sz = 0, n_frames = 0;
+    uint32_t base = 0, bitmap = 0, n, exp_len;
+    int open = 0, legacy = 0;
+    int result = -1;
+
+    while (1) {
+        /* Once the result is out, answer retransmitted HASH frames until
+         * the host goes quiet */
+        if (!stream_recv(&rx, &f, (result < 0) ? -1 : 1000, &legacy)) {
+            if (result >= 0)
+                return result;
+            if (legacy && !open)
+                return legacy_update();
+            legacy = 0;
+            continue;
+        }
+        switch (f.type) {
+        case STREAM_OPEN:
+            if (f.len < 7)
+                break;
+            n = f.payload[0] | (f.payload[1] << 8) |
+                (f.payload[2] << 16) | ((uint32_t)f.payload[3] << 24);
+            exp_len = f.payload[4] | (f.payload[5] << 8);
+            if (open && n == tot_len && exp_len == frame_sz) {
+                /* Retransmitted: the first ACK was lost */
+                stream_ack(base, bitmap);
+                break;
+            }
+            tot_len = n;
+            frame_sz = exp_len;
+            open = 0;
+            if (tot_len > PARTITION_SIZE) {
+                stream_result(STREAM_TOO_LARGE);
+                break;
+            }
+            if (frame_sz == 0 || frame_sz > STREAM_MAX_FRAME ||
+                    f.payload[6] > STREAM_MAX_WINDOW) {
+                stream_result(STREAM_BAD_PARAMS);
+                break;
+            }
+            n_frames = (tot_len + frame_sz - 1) / frame_sz;
+            base = bitmap = 0;
+            erased_end = 0;
+            open = 1;
+            stream_ack(base, bitmap);
+            break;
+        case STREAM_DATA:
+            if (!open || (f.offset % frame_sz) != 0)
+                break;
+            n = f.offset / frame_sz;
+            if (n >= n_frames)
+                break;
+            exp_len = (n == n_frames - 1) ? tot_len - f.offset : frame_sz;
+            if (f.len != exp_len)
+                break;
+            if (n > base && n <= base + STREAM_MAX_WINDOW &&
+                    (bitmap & (1U << (n - base - 1))) == 0) {
+                flash_write(f.offset, f.payload, f.len);
+                bitmap |= 1U << (n - base - 1);
+            }
+            else if (n == base) {
+                flash_write(f.offset, f.payload, f.len);
+                base++;
+                while (bitmap & 1) {
+                    bitmap >>= 1;
+                    base++;
+                }
+                bitmap >>= 1;
+            }
+            stream_ack(base, bitmap);
+            break;
+        case STREAM_HASH:
+            if (!open || base < n_frames || f.len != STREAM_HASH_SIZE) {
+                stream_ack(base, bitmap);
+                break;
+            }
+            if (result < 0) {
+                result = (stream_verify(tot_len, f.payload) < 0);
+                if (result)
+                    printf("target-sim: SHA-256 mismatch\n");
+                else
+                    printf("target-sim: update complete, %u bytes, "
+                            "SHA-256 OK\n", tot_len);
+            }
+            stream_result(result ? STREAM_BAD_HASH : STREAM_OK);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct termios tty;
+    uint32_t version = 1;
+    uint8_t *v_array = (uint8_t *)&version;
+    int i, ret;
+
+    if (argc != 3) {
+        printf("Usage: %s uart_device partition_file\n", argv[0]);
+        exit(1);
+    }
+    uart = open(argv[1], O_RDWR | O_NOCTTY);
+    if (uart < 0) {
+        perror("opening uart");
+        exit(2);
+    }
+    if (tcgetattr(uart, &tty) == 0) {
+        cfmakeraw(&tty);
+        tcsetattr(uart, TCSANOW, &tty);
+    }
+    part = open(argv[2], O_RDWR | O_CREAT | O_TRUNC, 0660);
+    if (part < 0) {
+        perror("opening partition file");
+        exit(2);
+    }
+    stream_rx_init(&rx, uart);
+
+    uart_write(START);
+    for (i = 3; i >= 0; i--) {
+        uart_write(v_array[i]);
+    }
+    ret = stream_update();
+    close(part);
+    close(uart);
+    return ret;
+}
@@ -0,0 +1,174 @@
+/* update_stream.c
+ *
+ * Framing for the streaming update protocol (see update_stream.h)
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include "update_stream.h"
+
+static uint16_t crc16(uint16_t crc, const uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+    int b;
+    for (i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void stream_rx_init(struct stream_rx *rx, int fd)
+{
+    rx->fd = fd;
+    rx->head = rx->tail = 0;
+}
+
+int stream_getc(struct stream_rx *rx, int timeout_ms)
+{
+    struct pollfd pfd;
+    int res;
+
+    while (rx->head == rx->tail) {
+        pfd.fd = rx->fd;
+        pfd.events = POLLIN;
+        res = poll(&pfd, 1, timeout_ms);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            return -1;
+        res = read(rx->fd, rx->buf, sizeof(rx->buf));
+        if (res < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (res <= 0)
+            return -1;
+        rx->head = 0;
+        rx->tail = res;
+    }
+    return rx->buf[rx->head++];
+}
+
+int stream_recv(struct stream_rx *rx, struct stream_frame *f, int timeout_ms,
+        int *legacy)
+{
+    uint8_t hdr[STREAM_HDR_SIZE];
+    uint8_t crc_rx[STREAM_CRC_SIZE];
+    long long deadline = now_ms() + timeout_ms;
+    uint16_t crc;
+    int c, i, left;
+
+    while (1) {
+        left = (timeout_ms < 0) ? -1 : (int)(deadline - now_ms());
+        if (timeout_ms >= 0 && left < 0)
+            left = 0;
+        c = stream_getc(rx, left);
+        if (c < 0)
+            return 0;
+        if (c != STREAM_PREAMBLE0)
+            continue;
+        c = stream_getc(rx, left);
+        if (legacy && c == 0x5A) {
+            *legacy = 1;
+            return 0;
+        }
+        if (c != STREAM_PREAMBLE1)
+            continue;
+        /* Past the preamble, a silent line means a truncated frame */
+        for (i = 2; i < STREAM_HDR_SIZE; i++) {
+            c = stream_getc(rx, 100);
+            if (c < 0)
+                break;
+            hdr[i] = (uint8_t)c;
+        }
+        if (i < STREAM_HDR_SIZE)
+            continue;
+        f->type = hdr[2];
+        f->len = hdr[3] | (hdr[4] << 8);
+        f->offset = hdr[5] | (hdr[6] << 8) | (hdr[7] << 16) |
+            ((uint32_t)hdr[8] << 24);
+        if (f->len > STREAM_MAX_FRAME)
+            continue;
+        for (i = 0; i < f->len + STREAM_CRC_SIZE; i++) {
+            c = stream_getc(rx, 100);
+            if (c < 0)
+                break;
+            if (i < f->len)
+                f->payload[i] = (uint8_t)c;
+            else
+                crc_rx[i - f->len] = (uint8_t)c;
+        }
+        if (i < f->len + STREAM_CRC_SIZE)
+            continue;
+        crc = crc16(0xFFFF, hdr + 2, STREAM_HDR_SIZE - 2);
+        crc = crc16(crc, f->payload, f->len);
+        if (crc == (crc_rx[0] | (crc_rx[1] << 8)))
+            return 1;
+    }
+}
+
+int stream_send(int fd, uint8_t type, uint32_t offset, const uint8_t *payload,
+        uint16_t len)
+{
+    uint8_t frame[STREAM_HDR_SIZE + STREAM_MAX_FRAME + STREAM_CRC_SIZE];
+    uint16_t crc;
+    int sz = 0, res;
+
+    if (len > STREAM_MAX_FRAME)
+        return -1;
+    frame[0] = STREAM_PREAMBLE0;
+    frame[1] = STREAM_PREAMBLE1;
+    frame[2] = type;
+    frame[3] = len & 0xFF;
+    frame[4] = len >> 8;
+    frame[5] = offset & 0xFF;
+    frame[6] = (offset >> 8) & 0xFF;
+    frame[7] = (offset >> 16) & 0xFF;
+    frame[8] = offset >> 24;
+    if (len > 0)
+        memcpy(frame + STREAM_HDR_SIZE, payload, len);
+    crc = crc16(0xFFFF, frame + 2, STREAM_HDR_SIZE - 2 + len);
+    frame[STREAM_HDR_SIZE + len] = crc & 0xFF;
+    frame[STREAM_HDR_SIZE + len + 1] = crc >> 8;
+    len += STREAM_HDR_SIZE + STREAM_CRC_SIZE;
+    while (sz < len) {
+        res = write(fd, frame + sz, len - sz);
+        if (res < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (res <= 0)
+            return -1;
+        sz += res;
+    }
+    return sz;
+}
@@ -0,0 +1,102 @@
+/* update_stream.h
+ *
+ * Streaming update protocol, shared by the test update server and the
+ * host target stand-in.
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef UPDATE_STREAM_H
+#define UPDATE_STREAM_H
+#include <stdint.h>
+
+/* Every frame, in both directions, is:
+ *
+ *   0xA5 0x5B | type | len (LE16) | offset (LE32) | payload | CRC16 (LE16)
+ *
+ * The CRC (CCITT, init 0xFFFF) covers all the fields from 'type' to the
+ * end of the payload. Frames with a bad CRC are dropped by the receiver.
+ *
+ * Host to target:
+ *   STREAM_OPEN  payload: image size (LE32), frame size (LE16), window (u8)
+ *   STREAM_DATA  'len' bytes of the image at 'offset'. 'offset' is a
+ *                multiple of the frame size; only the last frame is short.
+ *   STREAM_HASH  payload: SHA-256 of the whole image
+ *
+ * Target to host:
+ *   STREAM_ACK   'offset' is the number of frames received in sequence;
+ *                bit i of the payload (LE32) is set if frame offset + 1 + i
+ *                has been received out of order.
+ *   STREAM_RESULT payload: one status byte (STREAM_OK, ...)
+ *
+ * The host keeps up to 'window' data frames (at most 32) in flight, and
+ * resends a frame when it times out, or as soon as an ACK covers a frame
+ * that was sent after it. All requests are idempotent.
+ */
+#define STREAM_PREAMBLE0    0xA5
+#define STREAM_PREAMBLE1    0x5B
+
+#define STREAM_OPEN         'O'
+#define STREAM_DATA         'D'
+#define STREAM_HASH         'H'
+#define STREAM_ACK          'A'
+#define STREAM_RESULT       'R'
+
+#define STREAM_OK           0
+#define STREAM_BAD_HASH     1
+#define STREAM_TOO_LARGE    2
+#define STREAM_BAD_PARAMS   3
+
+#define STREAM_HDR_SIZE     9
+#define STREAM_CRC_SIZE     2
+#define STREAM_HASH_SIZE    32
+#define STREAM_MAX_FRAME    4096
+#define STREAM_MAX_WINDOW   32
+
+struct stream_frame {
+    uint8_t type;
+    uint16_t len;
+    uint32_t offset;
+    uint8_t payload[STREAM_MAX_FRAME];
+};
+
+/* Buffered reader on a serial/pty file descriptor */
+struct stream_rx {
+    int fd;
+    uint8_t buf[4096];
+    unsigned int head, tail;
+};
+
+void stream_rx_init(struct stream_rx *rx, int fd);
+
+/* Next byte from the line, or -1 after 'timeout_ms' (< 0: wait forever) */
+int stream_getc(struct stream_rx *rx, int timeout_ms);
+
+/* Receive the next valid frame. Returns 1 on success, 0 on timeout.
+ * With 'legacy' non-NULL, a 0xA5 0x5A preamble stops the search and sets
+ * *legacy to 1.
+ */
+int stream_recv(struct stream_rx *rx, struct stream_frame *f, int timeout_ms,
+        int *legacy);
+
+/* Send a frame, returns the number of bytes written on the line */
+int stream_send(int fd, uint8_t type, uint32_t offset, const uint8_t *payload,
+        uint16_t len);
+
+#endif /* !UPDATE_STREAM_H */
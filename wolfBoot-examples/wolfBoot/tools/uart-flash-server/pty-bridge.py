@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+#
+# pty-bridge.py
+#
+# Connects two pseudo-terminals back to back, emulating a serial line
+# with the given bitrate (8N1), so that ufserver can serve the wolfBoot
+# host simulator without any hardware:
+#
+#   ./pty-bridge.py /tmp/target /tmp/host 460800 &
+#   ./ufserver image_v2_signed.bin /tmp/host &
+#   WOLFBOOT_SIM_UART=/tmp/target ./wolfboot.elf
+#
+# An optional error rate corrupts random bytes on the line, in both
+# directions, to exercise the recovery of the protocol.
+#
+# On SIGTERM/SIGINT, the amount of data transferred is printed.
+#
+# Copyright (C) 2020 wolfSSL Inc.
+#
+# This file is part of wolfBoot.
+#
+# wolfBoot is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# wolfBoot is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+
+import os
+import pty
+import random
+import signal
+import sys
+import threading
+import time
+import tty
+
+CHUNK = 64
+
+if len(sys.argv) < 3:
+    print("Usage: %s link_a link_b [bitrate [error_rate]]" % sys.argv[0])
+    sys.exit(1)
+
+bitrate = int(sys.argv[3]) if len(sys.argv) > 3 else 0
+error_rate = float(sys.argv[4]) if len(sys.argv) > 4 else 0.0
+byte_time = 10.0 / bitrate if bitrate else 0.0
+
+ends = []
+for link in sys.argv[1:3]:
+    master, slave = pty.openpty()
+    tty.setraw(slave)
+    if os.path.lexists(link):
+        os.unlink(link)
+    os.symlink(os.ttyname(slave), link)
+    ends.append((master, slave, link))
+
+count = [0, 0]
+errors = [0, 0]
+start = [None]
+
+def forward(src, dst, d):
+    line_free = 0.0
+    while True:
+        try:
+            data = os.read(src, CHUNK)
+        except OSError:
+            time.sleep(0.01)
+            continue
+        now = time.monotonic()
+        if start[0] is None:
+            start[0] = now
+        if byte_time:
+            # Deliver once the last byte has gone through the line
+            line_free = max(now, line_free) + len(data) * byte_time
+            if line_free > now:
+                time.sleep(line_free - now)
+        if error_rate:
+            data = bytearray(data)
+            for i in range(len(data)):
+                if random.random() < error_rate:
+                    data[i] ^= 1 << random.randrange(8)
+                    errors[d] += 1
+        os.write(dst, data)
+        count[d] += len(data)
+
+def report(signum, frame):
+    elapsed = time.monotonic() - start[0] if start[0] else 0.0
+    print("pty-bridge: %s -> %s: %d bytes, %s -> %s: %d bytes, %.3f s" %
+          (ends[0][2], ends[1][2], count[0], ends[1][2], ends[0][2], count[1],
+           elapsed))
+    if error_rate:
+        print("pty-bridge: %d corrupted bytes" % (errors[0] + errors[1]))
+    for e in ends:
+        os.unlink(e[2])
+    sys.stdout.flush()
+    os._exit(0)
+
+signal.signal(signal.SIGTERM, report)
+signal.signal(signal.SIGINT, report)
+threading.Thread(target=forward, args=(ends[0][0], ends[1][0], 0), daemon=True).start()
+threading.Thread(target=forward, args=(ends[1][0], ends[0][0], 1), daemon=True).start()
+while True:
+    signal.pause()
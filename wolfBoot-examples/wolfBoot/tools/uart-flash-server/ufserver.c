@@ -30,6 +30,7 @@
 #include <fcntl.h>
 #include "wolfboot/wolfboot.h"
 #include "hal.h"
+#include "uart_flash.h"
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <termios.h>
@@ -43,6 +44,7 @@
 #endif
 
 
+/* Legacy protocol (one ACK per byte), still used by older bootloaders */
 #define CMD_HDR_WOLF  'W'
 #define CMD_HDR_VER   'V'
 #define CMD_HDR_WRITE 0x01
@@ -337,6 +339,113 @@ static void uart_flash_write(uint8_t *base, int ud)
 }
 
 
+/* Framed protocol (see include/uart_flash.h) */
+
+static int read_full(int ud, uint8_t *buf, uint32_t len)
+{
+    uint32_t pos = 0;
+    int ret;
+    while (pos < len) {
+        ret = read(ud, buf + pos, len - pos);
+        if (ret <= 0)
+            return -1;
+        pos += ret;
+    }
+    return 0;
+}
+
+static uint16_t crc16(uint16_t crc, const uint8_t *data, uint32_t len)
+{
+    int i;
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+static void frame_reply(int ud, const uint8_t *req, uint8_t type,
+        const uint8_t *payload, uint32_t len)
+{
+    uint8_t frame[UF_HDR_SIZE + UART_FLASH_FRAME_SIZE + UF_CRC_SIZE];
+    uint16_t crc;
+    memcpy(frame, req, UF_HDR_SIZE);
+    frame[1] = type;
+    if (type != UF_DATA)
+        len = 0;
+    memcpy(frame + UF_HDR_SIZE, payload, len);
+    crc = crc16(0xFFFF, frame + 1, UF_HDR_SIZE - 1 + len);
+    frame[UF_HDR_SIZE + len] = crc & 0xFF;
+    frame[UF_HDR_SIZE + len + 1] = (crc >> 8) & 0xFF;
+    write(ud, frame, UF_HDR_SIZE + len + UF_CRC_SIZE);
+}
+
+/* Called after the SOF byte has been received */
+static void serve_frame(uint8_t *base, int ud)
+{
+    uint8_t hdr[UF_HDR_SIZE];
+    uint8_t payload[UART_FLASH_FRAME_SIZE];
+    uint8_t crc_buf[UF_CRC_SIZE];
+    uint32_t address, len, plen = 0;
+    uint16_t crc;
+
+    hdr[0] = UF_SOF;
+    if (read_full(ud, hdr + 1, UF_HDR_SIZE - 1) != 0)
+        return;
+    address = hdr[3] | (hdr[4] << 8) | (hdr[5] << 16) | ((uint32_t)hdr[6] << 24);
+    len = hdr[7] | (hdr[8] << 8) | (hdr[9] << 16) | ((uint32_t)hdr[10] << 24);
+    if ((hdr[1] == UF_WRITE) || (hdr[1] == UF_VERSION)) {
+        if (len > UART_FLASH_FRAME_SIZE)
+            return;
+        plen = len;
+    }
+    if (read_full(ud, payload, plen) != 0)
+        return;
+    if (read_full(ud, crc_buf, UF_CRC_SIZE) != 0)
+        return;
+    crc = crc16(0xFFFF, hdr + 1, UF_HDR_SIZE - 1);
+    crc = crc16(crc, payload, plen);
+    if (crc != (crc_buf[0] | (crc_buf[1] << 8))) {
+        fprintf(stderr, "Bad frame CRC, dropped\n");
+        return;
+    }
+    if ((hdr[1] != UF_VERSION) &&
+            ((address > FIRMWARE_PARTITION_SIZE + SWAP_SIZE) ||
+             (len > FIRMWARE_PARTITION_SIZE + SWAP_SIZE - address)))
+        return;
+    switch (hdr[1]) {
+        case UF_WRITE:
+            printmsg((address < FIRMWARE_PARTITION_SIZE) ? msgWriteUpdate : msgWriteSwap);
+            memcpy(base + address, payload, len);
+            frame_reply(ud, hdr, UF_ACK, NULL, 0);
+            break;
+        case UF_READ:
+            if (len > UART_FLASH_FRAME_SIZE)
+                return;
+            printmsg((address < FIRMWARE_PARTITION_SIZE) ? msgReadUpdate : msgReadSwap);
+            frame_reply(ud, hdr, UF_DATA, base + address, len);
+            break;
+        case UF_ERASE:
+            printmsg((address < FIRMWARE_PARTITION_SIZE) ? msgEraseUpdate : msgEraseSwap);
+            memset(base + address, 0xFF, len);
+            msync(base, FIRMWARE_PARTITION_SIZE + SWAP_SIZE, MS_SYNC);
+            frame_reply(ud, hdr, UF_ACK, NULL, 0);
+            break;
+        case UF_VERSION:
+            if (len != 4)
+                return;
+            printf("\r\n** TARGET REBOOT **\n");
+            printf("Version running on target: %u\n", payload[0] +
+                    (payload[1] << 8) + (payload[2] << 16) + (payload[3] << 24));
+            frame_reply(ud, hdr, UF_ACK, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "Unrecognized frame: %02X\n", hdr[1]);
+            break;
+    }
+}
+
 static void serve_update(uint8_t *base, const char *uart_dev)
 {
     int ret = 0;
@@ -346,6 +455,8 @@ static void serve_update(uint8_t *base, const char *uart_dev)
         fprintf(stderr, "Cannot open serial port %s: %s.\n", uart_dev, strerror(errno));
         exit(3);
     }
+    printf("Serving on %s\n", uart_dev);
+    fflush(stdout);
     while (1) {
        /* read STX */
        ret = read(ud, buf, 1);
@@ -355,6 +466,10 @@ static void serve_update(uint8_t *base, const char *uart_dev)
        if (ret == 0)
            continue;
 
+       if (buf[0] == UF_SOF) {
+           serve_frame(base, ud);
+           continue;
+       }
        if ((buf[0] != CMD_HDR_WOLF) && (buf[0] != CMD_HDR_VER)) {
            printf("bad hdr: %02x\n", buf[0]);
            continue;
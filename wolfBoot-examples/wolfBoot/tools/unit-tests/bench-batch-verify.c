@@ -0,0 +1,339 @@
+/* bench-batch-verify.c
+ *
+ * Host benchmark of the batch signature verification (VERIFY_BATCH=1),
+ * against the verification of the signatures one by one.
+ *
+ * Usage: bench-batch-verify image_v1_signed.bin image_v2_signed.bin ...
+ * (see 'make bench-batch-verify', which signs the images with the keytools)
+ *
+ * The digests and the signatures are taken from the headers of the images.
+ * Batches of 1 to n of them are verified with the same code as wolfBoot,
+ * checking that they are accepted, and rejected when one of the digests is
+ * altered.
+ * With ED25519, a signature whose R has a small-order component is also
+ * crafted with the private key (ed25519.der): the batch must reject it for
+ * every randomizer, as wc_ed25519_verify_msg() does.
+ *
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "loader.h"
+
+#include <wolfssl/wolfcrypt/settings.h>
+#ifdef WOLFBOOT_SIGN_ED25519
+#include <wolfssl/wolfcrypt/ed25519.h>
+#include <wolfssl/wolfcrypt/ge_operations.h>
+#include <wolfssl/wolfcrypt/sha512.h>
+#include <wolfssl/wolfcrypt/hash.h>
+#endif
+
+/* Header format (include/wolfboot/wolfboot.h) */
+#define BENCH_HEADER_SIZE   256
+#define BENCH_HDR_SHA256    0x03
+#define BENCH_HDR_SIGNATURE 0x20
+#define BENCH_HDR_PADDING   0xFF
+#define BENCH_DIGEST_SIZE   32
+
+/* Best of BENCH_RUNS runs of BENCH_ROUNDS verifications */
+#define BENCH_RUNS          5
+#define BENCH_ROUNDS        10
+
+static uint8_t digest[WOLFBOOT_VERIFY_BATCH_MAX][BENCH_DIGEST_SIZE];
+static uint8_t signature[WOLFBOOT_VERIFY_BATCH_MAX][IMAGE_SIGNATURE_SIZE];
+static uint8_t randomizer[WOLFBOOT_VERIFY_BATCH_MAX][WOLFBOOT_VERIFY_BATCH_Z_SIZE];
+static const uint8_t *hash_p[WOLFBOOT_VERIFY_BATCH_MAX];
+static const uint8_t *sig_p[WOLFBOOT_VERIFY_BATCH_MAX];
+static const uint8_t *z_p[WOLFBOOT_VERIFY_BATCH_MAX];
+
+static int find_tlv(const uint8_t *hdr, uint16_t type, uint16_t len,
+        uint8_t *out)
+{
+    int i = 8;
+    uint16_t t, l;
+
+    while (i + 4 <= BENCH_HEADER_SIZE) {
+        if (hdr[i] == BENCH_HDR_PADDING) {
+            i++;
+            continue;
+        }
+        t = hdr[i] | (hdr[i + 1] << 8);
+        l = hdr[i + 2] | (hdr[i + 3] << 8);
+        if (t == 0 || i + 4 + l > BENCH_HEADER_SIZE)
+            break;
+        if ((t == type) && (l == len)) {
+            memcpy(out, hdr + i + 4, len);
+            return 0;
+        }
+        i += 4 + l;
+    }
+    return -1;
+}
+
+static int load_image(const char *fname, int i)
+{
+    uint8_t hdr[BENCH_HEADER_SIZE];
+    FILE *f = fopen(fname, "rb");
+
+    if (f == NULL)
+        return -1;
+    if (fread(hdr, 1, BENCH_HEADER_SIZE, f) != BENCH_HEADER_SIZE) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    if ((find_tlv(hdr, BENCH_HDR_SHA256, BENCH_DIGEST_SIZE, digest[i]) < 0) ||
+            (find_tlv(hdr, BENCH_HDR_SIGNATURE, IMAGE_SIGNATURE_SIZE,
+                      signature[i]) < 0))
+        return -1;
+    return 0;
+}
+
+/* One signature, as wolfBoot_verify_signature() */
+static int verify_one(int i)
+{
+    int res = 0;
+#ifdef WOLFBOOT_SIGN_ED25519
+    ed25519_key ed;
+
+    if ((wc_ed25519_init(&ed) < 0) ||
+            (wc_ed25519_import_public(KEY_BUFFER, KEY_LEN, &ed) < 0))
+        return -1;
+    if (wc_ed25519_verify_msg(signature[i], IMAGE_SIGNATURE_SIZE, digest[i],
+                BENCH_DIGEST_SIZE, &res, &ed) < 0)
+        return -1;
+#else
+    if (ecc256_verify_table(digest[i], signature[i], &res) < 0)
+        return -1;
+#endif
+    return res ? 0 : -1;
+}
+
+static int verify_batch(int n)
+{
+    int res = 0;
+#ifdef WOLFBOOT_SIGN_ED25519
+    if (ed25519_verify_batch(n, hash_p, BENCH_DIGEST_SIZE, sig_p, z_p,
+                &res) < 0)
+        return -1;
+#else
+    if (ecc256_verify_table_batch(n, hash_p, sig_p, z_p, &res) < 0)
+        return -1;
+#endif
+    return res ? 0 : -1;
+}
+
+#ifdef WOLFBOOT_SIGN_ED25519
+#define BENCH_ED25519_KEY   "ed25519.der"
+#define BENCH_ED25519_SIZE  32
+
+/* Randomizers of signature 1 tried against the crafted signature */
+#define BENCH_TORSION_ROUNDS 16
+
+static const uint8_t ed25519_l[BENCH_ED25519_SIZE] = {
+    0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58,
+    0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+/* h = H(R | A | M) mod l */
+static void challenge(uint8_t *h, const uint8_t *r, const uint8_t *msg)
+{
+    wc_Sha512 sha;
+
+    wc_InitSha512(&sha);
+    wc_Sha512Update(&sha, r, BENCH_ED25519_SIZE);
+    wc_Sha512Update(&sha, KEY_BUFFER, BENCH_ED25519_SIZE);
+    wc_Sha512Update(&sha, msg, BENCH_DIGEST_SIZE);
+    wc_Sha512Final(&sha, h);
+    wc_Sha512Free(&sha);
+    sc_reduce(h);
+}
+
+/* a = b - a, little-endian, 'len' bytes */
+static void sub_from(uint8_t *a, const uint8_t *b, int len)
+{
+    int i, borrow = 0, d;
+
+    for (i = 0; i < len; i++) {
+        d = b[i] - a[i] - borrow;
+        borrow = (d < 0);
+        a[i] = (uint8_t)d;
+    }
+}
+
+/* Re-signs digest 1 with R' = R + T, T = (0, -1) of order 2, and checks that
+ * neither wc_ed25519_verify_msg() nor the batch accept it: with the
+ * cofactorless batch equation, z_1.T cancels for every even z_1.
+ */
+static int test_torsion(int n)
+{
+    uint8_t seed[2 * BENCH_ED25519_SIZE];
+    uint8_t a[WC_SHA512_DIGEST_SIZE];
+    uint8_t h[WC_SHA512_DIGEST_SIZE];
+    uint8_t k[BENCH_ED25519_SIZE];
+    uint8_t saved[IMAGE_SIGNATURE_SIZE];
+    uint8_t *sig = signature[1];
+    FILE *f;
+    int i, fail = 0;
+
+    if (n < 2)
+        return 0;
+    f = fopen(BENCH_ED25519_KEY, "rb");
+    if (f == NULL)
+        return 0;
+    if (fread(seed, 1, sizeof(seed), f) != sizeof(seed)) {
+        fclose(f);
+        return 0;
+    }
+    fclose(f);
+    memcpy(saved, sig, IMAGE_SIGNATURE_SIZE);
+
+    /* Secret scalar a, and k = S - h.a, the nonce of the signature */
+    wc_Sha512Hash(seed, BENCH_ED25519_SIZE, a);
+    a[0] &= 248;
+    a[31] &= 127;
+    a[31] |= 64;
+    memset(a + BENCH_ED25519_SIZE, 0, BENCH_ED25519_SIZE);
+    sc_reduce(a);
+    challenge(h, sig, digest[1]);
+    sub_from(h, ed25519_l, BENCH_ED25519_SIZE);
+    sc_muladd(k, h, a, sig + BENCH_ED25519_SIZE);
+
+    /* R + (0, -1) = (-x, -y): y' = p - y, opposite sign of x */
+    for (i = 0; i < BENCH_ED25519_SIZE; i++)
+        h[i] = 0xFF;
+    h[0] = 0xED;
+    h[BENCH_ED25519_SIZE - 1] = 0x7F;
+    sig[BENCH_ED25519_SIZE - 1] &= 0x7F;
+    sub_from(sig, h, BENCH_ED25519_SIZE);
+    sig[BENCH_ED25519_SIZE - 1] |= (saved[BENCH_ED25519_SIZE - 1] & 0x80) ^ 0x80;
+
+    /* S' = k + h'.a */
+    challenge(h, sig, digest[1]);
+    sc_muladd(sig + BENCH_ED25519_SIZE, h, a, k);
+
+    if (verify_one(1) == 0) {
+        printf("Small-order R: accepted by the single verification\n");
+        fail++;
+    }
+    for (i = 0; i < BENCH_TORSION_ROUNDS; i++) {
+        randomizer[1][0] = (uint8_t)i;
+        if (verify_batch(2) == 0) {
+            printf("Small-order R: batch accepted with z_1 = %d mod 256\n",
+                    i);
+            fail++;
+        }
+    }
+    memcpy(sig, saved, IMAGE_SIGNATURE_SIZE);
+    return fail;
+}
+#endif
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    int n = argc - 1, i, j, k, r, fail = 0;
+    uint32_t x = 0x2545F491;
+    double t0, t1, t2, single, batch;
+
+    if ((n < 1) || (n > WOLFBOOT_VERIFY_BATCH_MAX)) {
+        fprintf(stderr, "Usage: %s image_signed.bin (1 to %d images)\n",
+                argv[0], WOLFBOOT_VERIFY_BATCH_MAX);
+        return 1;
+    }
+    for (i = 0; i < n; i++) {
+        if (load_image(argv[i + 1], i) < 0) {
+            fprintf(stderr, "%s: no digest or signature\n", argv[i + 1]);
+            return 1;
+        }
+        /* wolfBoot derives them from the inputs (src/image.c) */
+        for (j = 0; j < WOLFBOOT_VERIFY_BATCH_Z_SIZE; j++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            randomizer[i][j] = (uint8_t)x;
+        }
+        hash_p[i] = digest[i];
+        sig_p[i] = signature[i];
+        z_p[i] = randomizer[i];
+    }
+
+    for (k = 1; k <= n; k++) {
+        for (i = 0; i < k; i++) {
+            if (verify_one(i) < 0) {
+                printf("Signature %d: single verification failed\n", i);
+                fail++;
+            }
+        }
+        if (verify_batch(k) < 0) {
+            printf("Batch of %d: valid signatures rejected\n", k);
+            fail++;
+        }
+        for (i = 0; i < k; i++) {
+            digest[i][i % BENCH_DIGEST_SIZE] ^= 0x01;
+            if (verify_batch(k) == 0) {
+                printf("Batch of %d: altered digest %d accepted\n", k, i);
+                fail++;
+            }
+            digest[i][i % BENCH_DIGEST_SIZE] ^= 0x01;
+        }
+    }
+#ifdef WOLFBOOT_SIGN_ED25519
+    fail += test_torsion(n);
+#endif
+    if (fail)
+        return 1;
+
+    printf("Signatures  single (us/sig)  batch (us/sig)  speedup\n");
+    for (k = 1; k <= n; k++) {
+        single = batch = 0;
+        for (r = 0; r < BENCH_RUNS; r++) {
+            t0 = now();
+            for (j = 0; j < BENCH_ROUNDS; j++) {
+                for (i = 0; i < k; i++)
+                    verify_one(i);
+            }
+            t1 = now();
+            for (j = 0; j < BENCH_ROUNDS; j++)
+                verify_batch(k);
+            t2 = now();
+            if ((r == 0) || (t1 - t0 < single))
+                single = t1 - t0;
+            if ((r == 0) || (t2 - t1 < batch))
+                batch = t2 - t1;
+        }
+        single *= 1e6 / (BENCH_ROUNDS * k);
+        batch *= 1e6 / (BENCH_ROUNDS * k);
+        printf("%10d  %15.1f  %14.1f  %6.2fx\n", k, single, batch,
+                single / batch);
+    }
+    return 0;
+}
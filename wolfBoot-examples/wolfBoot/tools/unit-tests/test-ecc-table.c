@@ -0,0 +1,320 @@
+/* test-ecc-table.c
+ *
+ * Test of the ECDSA P-256 verification with the pre-computed tables
+ * (ECC_TABLE=1, src/ecc256_verify.c) against the generic SP verification of
+ * wolfCrypt, in the same build of the SP code.
+ *
+ * Usage: test-ecc-table image_v1_signed.bin image_v2_signed.bin ...
+ * (see 'make test-ecc-table', on the host with sp_c32, and
+ * 'make test-ecc-table-cortexm', built for Cortex-M with sp_cortexm and run
+ * in qemu-arm)
+ *
+ * The digests and the signatures are taken from the headers of the images.
+ * Both verifications must accept or reject each of them, and each of them
+ * altered in several ways (digest, r and s out of range, n - s...). With
+ * WOLFBOOT_VERIFY_BATCH, the batch verification must accept the valid
+ * signatures and reject a batch with an altered one. Prints "PASS" and the
+ * time of each verification.
+ *
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "loader.h"
+
+#include <wolfssl/wolfcrypt/settings.h>
+#include <wolfssl/wolfcrypt/ecc.h>
+
+/* Header format (include/wolfboot/wolfboot.h) */
+#define TEST_HEADER_SIZE    256
+#define TEST_HDR_SHA256     0x03
+#define TEST_HDR_SIGNATURE  0x20
+#define TEST_HDR_PADDING    0xFF
+#define TEST_DIGEST_SIZE    32
+#define TEST_MAX_IMAGES     8
+#define ECC_KEY_SIZE        32
+
+/* Verifications timed for the benchmark */
+#define BENCH_ROUNDS        4
+
+static const uint8_t p256_order_bin[ECC_KEY_SIZE] = {
+    0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84,
+    0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51
+};
+
+static uint8_t digest[TEST_MAX_IMAGES][TEST_DIGEST_SIZE];
+static uint8_t signature[TEST_MAX_IMAGES][IMAGE_SIGNATURE_SIZE];
+
+/* Alterations of a signature, and whether it stays valid */
+enum {
+    ALTER_NONE = 0,
+    ALTER_DIGEST,
+    ALTER_R,
+    ALTER_S,
+    ALTER_R_ZERO,
+    ALTER_S_ZERO,
+    ALTER_R_ORDER,
+    ALTER_S_ORDER,
+    ALTER_S_NEG,
+    ALTER_ONES,
+    ALTER_OTHER,
+    ALTER_COUNT
+};
+static const char *alter_name[ALTER_COUNT] = {
+    "valid", "digest", "r", "s", "r = 0", "s = 0", "r = order", "s = order",
+    "s = order - s", "r = s = 2^256 - 1", "signature of another image"
+};
+static const int alter_valid[ALTER_COUNT] = { 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0 };
+
+static int find_tlv(const uint8_t *hdr, uint16_t type, uint16_t len,
+        uint8_t *out)
+{
+    int i = 8;
+    uint16_t t, l;
+
+    while (i + 4 <= TEST_HEADER_SIZE) {
+        if (hdr[i] == TEST_HDR_PADDING) {
+            i++;
+            continue;
+        }
+        t = hdr[i] | (hdr[i + 1] << 8);
+        l = hdr[i + 2] | (hdr[i + 3] << 8);
+        if (t == 0 || i + 4 + l > TEST_HEADER_SIZE)
+            break;
+        if ((t == type) && (l == len)) {
+            memcpy(out, hdr + i + 4, len);
+            return 0;
+        }
+        i += 4 + l;
+    }
+    return -1;
+}
+
+static int load_image(const char *fname, int i)
+{
+    uint8_t hdr[TEST_HEADER_SIZE];
+    FILE *f = fopen(fname, "rb");
+
+    if (f == NULL)
+        return -1;
+    if (fread(hdr, 1, TEST_HEADER_SIZE, f) != TEST_HEADER_SIZE) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    if ((find_tlv(hdr, TEST_HDR_SHA256, TEST_DIGEST_SIZE, digest[i]) < 0) ||
+            (find_tlv(hdr, TEST_HDR_SIGNATURE, IMAGE_SIGNATURE_SIZE,
+                      signature[i]) < 0))
+        return -1;
+    return 0;
+}
+
+/* As wolfBoot_verify_signature() without ECC_TABLE. Returns 1 if valid. */
+static int verify_generic(const uint8_t *hash, const uint8_t *sig)
+{
+    mp_int r, s;
+    ecc_key ecc;
+    int ret, res = 0;
+
+    if (wc_ecc_init(&ecc) < 0)
+        return -1;
+    ret = wc_ecc_import_unsigned(&ecc, (byte*)KEY_BUFFER,
+        (byte*)(KEY_BUFFER + ECC_KEY_SIZE), NULL, ECC_SECP256R1);
+    if ((ret < 0) || ecc.type != ECC_PUBLICKEY)
+        return -1;
+    mp_init(&r);
+    mp_init(&s);
+    mp_read_unsigned_bin(&r, sig, ECC_KEY_SIZE);
+    mp_read_unsigned_bin(&s, sig + ECC_KEY_SIZE, ECC_KEY_SIZE);
+    ret = wc_ecc_verify_hash_ex(&r, &s, hash, TEST_DIGEST_SIZE, &res, &ecc);
+    wc_ecc_free(&ecc);
+    return ((ret < 0) || (res == 0)) ? 0 : 1;
+}
+
+/* As wolfBoot_verify_signature() with ECC_TABLE. Returns 1 if valid. */
+static int verify_table(const uint8_t *hash, const uint8_t *sig)
+{
+    int res = 0;
+
+    if (ecc256_verify_table(hash, sig, &res) < 0)
+        return 0;
+    return res;
+}
+
+/* a = b - a, big-endian */
+static void sub_from(uint8_t *a, const uint8_t *b)
+{
+    int i, borrow = 0, d;
+
+    for (i = ECC_KEY_SIZE - 1; i >= 0; i--) {
+        d = b[i] - a[i] - borrow;
+        borrow = (d < 0);
+        a[i] = (uint8_t)d;
+    }
+}
+
+static void alter(int i, int n, int how, uint8_t *hash, uint8_t *sig)
+{
+    memcpy(hash, digest[i], TEST_DIGEST_SIZE);
+    memcpy(sig, signature[i], IMAGE_SIGNATURE_SIZE);
+    switch (how) {
+        case ALTER_DIGEST:
+            hash[i % TEST_DIGEST_SIZE] ^= 0x01;
+            break;
+        case ALTER_R:
+            sig[ECC_KEY_SIZE - 1] ^= 0x01;
+            break;
+        case ALTER_S:
+            sig[IMAGE_SIGNATURE_SIZE - 1] ^= 0x01;
+            break;
+        case ALTER_R_ZERO:
+            memset(sig, 0, ECC_KEY_SIZE);
+            break;
+        case ALTER_S_ZERO:
+            memset(sig + ECC_KEY_SIZE, 0, ECC_KEY_SIZE);
+            break;
+        case ALTER_R_ORDER:
+            memcpy(sig, p256_order_bin, ECC_KEY_SIZE);
+            break;
+        case ALTER_S_ORDER:
+            memcpy(sig + ECC_KEY_SIZE, p256_order_bin, ECC_KEY_SIZE);
+            break;
+        case ALTER_S_NEG:
+            sub_from(sig + ECC_KEY_SIZE, p256_order_bin);
+            break;
+        case ALTER_ONES:
+            memset(sig, 0xFF, IMAGE_SIGNATURE_SIZE);
+            break;
+        case ALTER_OTHER:
+            memcpy(sig, signature[(i + 1) % n], IMAGE_SIGNATURE_SIZE);
+            break;
+        default:
+            break;
+    }
+}
+
+#ifdef WOLFBOOT_VERIFY_BATCH
+static int test_batch(int n)
+{
+    static uint8_t z[WOLFBOOT_VERIFY_BATCH_MAX][WOLFBOOT_VERIFY_BATCH_Z_SIZE];
+    const uint8_t *hash_p[WOLFBOOT_VERIFY_BATCH_MAX];
+    const uint8_t *sig_p[WOLFBOOT_VERIFY_BATCH_MAX];
+    const uint8_t *z_p[WOLFBOOT_VERIFY_BATCH_MAX];
+    uint32_t x = 0x2545F491;
+    int i, j, k, res, fail = 0;
+
+    if (n > WOLFBOOT_VERIFY_BATCH_MAX)
+        n = WOLFBOOT_VERIFY_BATCH_MAX;
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < WOLFBOOT_VERIFY_BATCH_Z_SIZE; j++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            z[i][j] = (uint8_t)x;
+        }
+        hash_p[i] = digest[i];
+        sig_p[i] = signature[i];
+        z_p[i] = z[i];
+    }
+    for (k = 1; k <= n; k++) {
+        if ((ecc256_verify_table_batch(k, hash_p, sig_p, z_p, &res) < 0) ||
+                (res == 0)) {
+            printf("FAIL: batch of %d: valid signatures rejected\n", k);
+            fail++;
+        }
+        for (i = 0; i < k; i++) {
+            digest[i][i % TEST_DIGEST_SIZE] ^= 0x01;
+            if ((ecc256_verify_table_batch(k, hash_p, sig_p, z_p, &res) == 0)
+                    && (res != 0)) {
+                printf("FAIL: batch of %d: altered digest %d accepted\n", k,
+                        i);
+                fail++;
+            }
+            digest[i][i % TEST_DIGEST_SIZE] ^= 0x01;
+        }
+    }
+    printf("batch: 1 to %d signatures\n", n);
+    return fail;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    uint8_t hash[TEST_DIGEST_SIZE], sig[IMAGE_SIGNATURE_SIZE];
+    int n = argc - 1, i, j, a, t, g, fail = 0;
+    clock_t t0, t1, t2;
+
+    if ((n < 1) || (n > TEST_MAX_IMAGES)) {
+        fprintf(stderr, "Usage: %s image_signed.bin (1 to %d images)\n",
+                argv[0], TEST_MAX_IMAGES);
+        return 1;
+    }
+    for (i = 0; i < n; i++) {
+        if (load_image(argv[i + 1], i) < 0) {
+            fprintf(stderr, "%s: no digest or signature\n", argv[i + 1]);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        for (a = 0; a < ALTER_COUNT; a++) {
+            if ((a == ALTER_OTHER) && (n < 2))
+                continue;
+            alter(i, n, a, hash, sig);
+            t = verify_table(hash, sig);
+            g = verify_generic(hash, sig);
+            if ((t != g) || (t != alter_valid[a])) {
+                printf("FAIL: image %d, %s: table %d, generic %d\n", i,
+                        alter_name[a], t, g);
+                fail++;
+            }
+        }
+    }
+    printf("single: %d signatures, %d alterations each\n", n,
+            ALTER_COUNT - 1);
+#ifdef WOLFBOOT_VERIFY_BATCH
+    fail += test_batch(n);
+#endif
+
+    t0 = clock();
+    for (j = 0; j < BENCH_ROUNDS; j++)
+        verify_table(digest[j % n], signature[j % n]);
+    t1 = clock();
+    for (j = 0; j < BENCH_ROUNDS; j++)
+        verify_generic(digest[j % n], signature[j % n]);
+    t2 = clock();
+    printf("bench: table %lu us/sig, generic %lu us/sig\n",
+            (unsigned long)(((t1 - t0) * 1000000.0) /
+                (CLOCKS_PER_SEC * (double)BENCH_ROUNDS)),
+            (unsigned long)(((t2 - t1) * 1000000.0) /
+                (CLOCKS_PER_SEC * (double)BENCH_ROUNDS)));
+
+    if (fail > 0) {
+        printf("FAIL: %d errors\n", fail);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,298 @@
+/* test-thumb2-asm.c
+ *
+ * Test of the Thumb-2 SHA-256 and ChaCha20 assembly (THUMB2_ASM=1) against
+ * the C code of wolfCrypt, and benchmark of both.
+ *
+ * Built for Cortex-M with arm-none-eabi-gcc and run in qemu-arm, see
+ * 'make test-thumb2-asm'. Prints "PASS" when the assembly gives the same
+ * results as wolfCrypt on:
+ *  - the SHA-256 and ChaCha20 test vectors of wolfcrypt/test/test.c,
+ *    and the ChaCha20 block of RFC 7539, 2.3.2
+ *  - messages of random lengths (SHA-256) and random states (ChaCha20)
+ * The benchmark is in qemu time: it compares the C and the assembly code, it
+ * is not the speed of the target.
+ *
+ *
+ * Copyright (C) 2020 wolfSSL Inc.
+ *
+ * This file is part of wolfBoot.
+ *
+ * wolfBoot is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfBoot is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <wolfssl/wolfcrypt/settings.h>
+#include <wolfssl/wolfcrypt/sha256.h>
+#include <wolfssl/wolfcrypt/hash.h>
+#include <wolfssl/wolfcrypt/chacha.h>
+
+/* src/sha256_thumb2.S, src/chacha_thumb2.S */
+int sha256_transform_thumb2(uint32_t *digest, const uint32_t *data);
+void chacha20_block_thumb2(uint32_t *out, const uint32_t *in);
+
+#define TEST_RANDOM_MSGS    64
+#define TEST_RANDOM_MAXLEN  1024
+#define TEST_RANDOM_STATES  256
+
+/* Best of BENCH_RUNS runs over BENCH_SIZE bytes */
+#define BENCH_RUNS          3
+#define BENCH_SIZE          (64 * 1024)
+
+static int failures = 0;
+
+static void check(int ok, const char *what, int n)
+{
+    if (!ok) {
+        printf("FAIL: %s %d\n", what, n);
+        failures++;
+    }
+}
+
+/* SHA-256 of a message with the assembly transform: same padding as
+ * wc_Sha256Final, the blocks are loaded in host order as wolfCrypt does.
+ */
+static void sha256_asm(const uint8_t *msg, uint32_t len, uint8_t *hash)
+{
+    static const uint32_t iv[8] = {
+        0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+        0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+    };
+    uint32_t digest[8];
+    uint32_t w[16];
+    uint8_t last[2 * WC_SHA256_BLOCK_SIZE];
+    uint32_t rem = len % WC_SHA256_BLOCK_SIZE;
+    uint32_t last_len = (rem < 56) ? WC_SHA256_BLOCK_SIZE :
+        (2 * WC_SHA256_BLOCK_SIZE);
+    uint64_t bits = (uint64_t)len * 8;
+    uint32_t i, j;
+
+    memcpy(digest, iv, sizeof(digest));
+    for (i = 0; i + WC_SHA256_BLOCK_SIZE <= len; i += WC_SHA256_BLOCK_SIZE) {
+        for (j = 0; j < 16; j++)
+            w[j] = ((uint32_t)msg[i + 4 * j] << 24) |
+                ((uint32_t)msg[i + 4 * j + 1] << 16) |
+                ((uint32_t)msg[i + 4 * j + 2] << 8) | msg[i + 4 * j + 3];
+        sha256_transform_thumb2(digest, w);
+    }
+    memset(last, 0, sizeof(last));
+    memcpy(last, msg + len - rem, rem);
+    last[rem] = 0x80;
+    for (j = 0; j < 8; j++)
+        last[last_len - 1 - j] = (uint8_t)(bits >> (8 * j));
+    for (i = 0; i < last_len; i += WC_SHA256_BLOCK_SIZE) {
+        for (j = 0; j < 16; j++)
+            w[j] = ((uint32_t)last[i + 4 * j] << 24) |
+                ((uint32_t)last[i + 4 * j + 1] << 16) |
+                ((uint32_t)last[i + 4 * j + 2] << 8) | last[i + 4 * j + 3];
+        sha256_transform_thumb2(digest, w);
+    }
+    for (j = 0; j < 8; j++) {
+        hash[4 * j] = (uint8_t)(digest[j] >> 24);
+        hash[4 * j + 1] = (uint8_t)(digest[j] >> 16);
+        hash[4 * j + 2] = (uint8_t)(digest[j] >> 8);
+        hash[4 * j + 3] = (uint8_t)digest[j];
+    }
+}
+
+static void test_sha256(void)
+{
+    /* wolfcrypt/test/test.c, sha256_test() */
+    static const char *input[3] = {
+        "",
+        "abc",
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
+    };
+    static const char *output[3] = {
+        "\xe3\xb0\xc4\x42\x98\xfc\x1c\x14\x9a\xfb\xf4\xc8\x99\x6f\xb9"
+        "\x24\x27\xae\x41\xe4\x64\x9b\x93\x4c\xa4\x95\x99\x1b\x78\x52"
+        "\xb8\x55",
+        "\xBA\x78\x16\xBF\x8F\x01\xCF\xEA\x41\x41\x40\xDE\x5D\xAE\x22"
+        "\x23\xB0\x03\x61\xA3\x96\x17\x7A\x9C\xB4\x10\xFF\x61\xF2\x00"
+        "\x15\xAD",
+        "\x24\x8D\x6A\x61\xD2\x06\x38\xB8\xE5\xC0\x26\x93\x0C\x3E\x60"
+        "\x39\xA3\x3C\xE4\x59\x64\xFF\x21\x67\xF6\xEC\xED\xD4\x19\xDB"
+        "\x06\xC1"
+    };
+    static uint8_t msg[TEST_RANDOM_MAXLEN];
+    uint8_t hash[WC_SHA256_DIGEST_SIZE], ref[WC_SHA256_DIGEST_SIZE];
+    uint32_t len, j;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        len = (uint32_t)strlen(input[i]);
+        sha256_asm((const uint8_t *)input[i], len, hash);
+        check(memcmp(hash, output[i], WC_SHA256_DIGEST_SIZE) == 0,
+                "sha256 test vector", i);
+        wc_Sha256Hash((const uint8_t *)input[i], len, ref);
+        check(memcmp(ref, output[i], WC_SHA256_DIGEST_SIZE) == 0,
+                "sha256 test vector (C)", i);
+    }
+    for (i = 0; i < TEST_RANDOM_MSGS; i++) {
+        /* 55 to 57 bytes: both sides of the one/two padding blocks limit */
+        len = (i < 3) ? (uint32_t)(55 + i) : (uint32_t)(rand() % sizeof(msg));
+        for (j = 0; j < len; j++)
+            msg[j] = (uint8_t)rand();
+        sha256_asm(msg, len, hash);
+        wc_Sha256Hash(msg, len, ref);
+        check(memcmp(hash, ref, WC_SHA256_DIGEST_SIZE) == 0,
+                "sha256 random message", i);
+    }
+    printf("sha256: %d test vectors, %d random messages\n", 3,
+            TEST_RANDOM_MSGS);
+}
+
+static void test_chacha(void)
+{
+    /* wolfcrypt/test/test.c, chacha_test(): first 8 bytes of keystream.
+     * The nonce is 4 zero bytes followed by the 8 bytes of 'ivs', as there.
+     */
+    static const uint8_t key[4][32] = {
+        { 0 },
+        { [31] = 0x01 },
+        { 0 },
+        { 0 }
+    };
+    static const uint32_t key_sz[4] = { 32, 32, 32, 16 };
+    static const uint8_t iv[4][CHACHA_IV_BYTES] = {
+        { 0 },
+        { 0 },
+        { [11] = 0x01 },
+        { 0 }
+    };
+    static const uint8_t output[4][8] = {
+        { 0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90 },
+        { 0x45, 0x40, 0xf0, 0x5a, 0x9f, 0x1f, 0xb2, 0x96 },
+        { 0xde, 0x9c, 0xba, 0x7b, 0xf3, 0xd6, 0x9e, 0xf5 },
+        { 0x89, 0x67, 0x09, 0x52, 0x60, 0x83, 0x64, 0xfd }
+    };
+    /* RFC 7539, 2.3.2: state and block function output */
+    static const uint32_t rfc_in[16] = {
+        0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+        0x03020100, 0x07060504, 0x0b0a0908, 0x0f0e0d0c,
+        0x13121110, 0x17161514, 0x1b1a1918, 0x1f1e1d1c,
+        0x00000001, 0x09000000, 0x4a000000, 0x00000000
+    };
+    static const uint32_t rfc_out[16] = {
+        0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3,
+        0xc7f4d1c7, 0x0368c033, 0x9aaa2204, 0x4e6cd4c3,
+        0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9,
+        0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2
+    };
+    ChaCha ctx;
+    uint32_t ks[CHACHA_CHUNK_WORDS];
+    uint8_t zero[CHACHA_CHUNK_BYTES], ref[CHACHA_CHUNK_BYTES];
+    uint8_t rkey[32], riv[CHACHA_IV_BYTES];
+    int i, j;
+
+    memset(zero, 0, sizeof(zero));
+    for (i = 0; i < 4; i++) {
+        wc_Chacha_SetKey(&ctx, key[i], key_sz[i]);
+        wc_Chacha_SetIV(&ctx, iv[i], 0);
+        chacha20_block_thumb2(ks, ctx.X);
+        check(memcmp(ks, output[i], 8) == 0, "chacha20 test vector", i);
+        wc_Chacha_Process(&ctx, ref, zero, sizeof(zero));
+        check(memcmp(ks, ref, sizeof(ref)) == 0, "chacha20 test vector (C)",
+                i);
+    }
+    chacha20_block_thumb2(ks, rfc_in);
+    check(memcmp(ks, rfc_out, sizeof(rfc_out)) == 0, "chacha20 RFC 7539", 0);
+
+    for (i = 0; i < TEST_RANDOM_STATES; i++) {
+        for (j = 0; j < 32; j++)
+            rkey[j] = (uint8_t)rand();
+        for (j = 0; j < CHACHA_IV_BYTES; j++)
+            riv[j] = (uint8_t)rand();
+        wc_Chacha_SetKey(&ctx, rkey, 32);
+        wc_Chacha_SetIV(&ctx, riv, (uint32_t)rand());
+        chacha20_block_thumb2(ks, ctx.X);
+        wc_Chacha_Process(&ctx, ref, zero, sizeof(zero));
+        check(memcmp(ks, ref, sizeof(ref)) == 0, "chacha20 random state", i);
+    }
+    printf("chacha20: %d test vectors, RFC 7539, %d random states\n", 4,
+            TEST_RANDOM_STATES);
+}
+
+/* Throughput in KB/s, best of BENCH_RUNS */
+static unsigned long bench_kbs(clock_t best)
+{
+    if (best == 0)
+        best = 1;
+    return (unsigned long)(((uint64_t)BENCH_SIZE * CLOCKS_PER_SEC) /
+            ((uint64_t)best * 1024));
+}
+
+static void bench(void)
+{
+    static uint8_t buf[BENCH_SIZE];
+    uint8_t hash[WC_SHA256_DIGEST_SIZE];
+    uint32_t ks[CHACHA_CHUNK_WORDS];
+    ChaCha ctx;
+    uint8_t key[32];
+    clock_t t, best[4] = { 0, 0, 0, 0 };
+    int r;
+    uint32_t i;
+
+    memset(key, 0x5A, sizeof(key));
+    wc_Chacha_SetKey(&ctx, key, sizeof(key));
+    wc_Chacha_SetIV(&ctx, key, 0);
+    for (r = 0; r < BENCH_RUNS; r++) {
+        t = clock();
+        wc_Sha256Hash(buf, sizeof(buf), hash);
+        t = clock() - t;
+        if (r == 0 || t < best[0])
+            best[0] = t;
+        t = clock();
+        sha256_asm(buf, sizeof(buf), hash);
+        t = clock() - t;
+        if (r == 0 || t < best[1])
+            best[1] = t;
+        t = clock();
+        wc_Chacha_Process(&ctx, buf, buf, sizeof(buf));
+        t = clock() - t;
+        if (r == 0 || t < best[2])
+            best[2] = t;
+        t = clock();
+        for (i = 0; i < sizeof(buf); i += CHACHA_CHUNK_BYTES) {
+            chacha20_block_thumb2(ks, ctx.X);
+            ctx.X[CHACHA_MATRIX_CNT_IV]++;
+        }
+        t = clock() - t;
+        if (r == 0 || t < best[3])
+            best[3] = t;
+    }
+    printf("bench sha256:   C %6lu KB/s, asm %6lu KB/s\n",
+            bench_kbs(best[0]), bench_kbs(best[1]));
+    printf("bench chacha20: C %6lu KB/s, asm %6lu KB/s (keystream only)\n",
+            bench_kbs(best[2]), bench_kbs(best[3]));
+}
+
+int main(void)
+{
+    srand(1);
+    test_sha256();
+    test_chacha();
+    bench();
+    if (failures > 0) {
+        printf("FAIL: %d errors\n", failures);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}